@@ -0,0 +1,447 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#include <krowkee/sketch/interface.hpp>
+#include <krowkee/stream/interface.hpp>
+
+#include <krowkee/hash/util.hpp>
+#include <krowkee/util/sketch_types.hpp>
+#include <krowkee/util/ygm_tests.hpp>
+
+#include <bench.hpp>
+
+#include <mpi.h>
+#include <ygm/comm.hpp>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using sketch_type_t = krowkee::util::sketch_type_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Message Accounting
+////////////////////////////////////////////////////////////////////////////////
+
+/// point-to-point MPI messages, and their bytes, sent by this rank. YGM packs
+/// many visitors into each message, so these measure traffic on the wire.
+static std::uint64_t mpi_messages(0);
+static std::uint64_t mpi_bytes(0);
+
+inline void count_message(const int count, MPI_Datatype datatype) {
+  int type_size(0);
+  PMPI_Type_size(datatype, &type_size);
+  ++mpi_messages;
+  mpi_bytes += std::uint64_t(count) * type_size;
+}
+
+// Intercept sends through the MPI profiling interface.
+extern "C" {
+int MPI_Send(const void *buf, int count, MPI_Datatype datatype, int dest,
+             int tag, MPI_Comm comm) {
+  count_message(count, datatype);
+  return PMPI_Send(buf, count, datatype, dest, tag, comm);
+}
+
+int MPI_Isend(const void *buf, int count, MPI_Datatype datatype, int dest,
+              int tag, MPI_Comm comm, MPI_Request *request) {
+  count_message(count, datatype);
+  return PMPI_Isend(buf, count, datatype, dest, tag, comm, request);
+}
+}
+
+/**
+ * Struct bundling the benchmark parameters.
+ */
+struct parameters_t {
+  std::uint64_t count;
+  std::uint64_t num_keys;
+  double        exponent;
+  std::uint64_t range_size;
+  std::size_t   compaction_threshold;
+  std::size_t   promotion_threshold;
+  sketch_type_t sketch_type;
+  bool          weak;
+  std::uint64_t seed;
+  std::string   output;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Power-Law Stream
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Stream of `(key, item)` pairs whose keys follow a Zipf distribution with
+ * the given exponent, as the degrees of real graphs do, and whose items are
+ * uniform.
+ */
+class power_law_stream {
+  std::vector<double> _cdf;
+  std::mt19937_64     _rnd_gen;
+
+ public:
+  power_law_stream(const std::uint64_t num_keys, const double exponent,
+                   const std::uint64_t seed)
+      : _cdf(num_keys), _rnd_gen(krowkee::hash::wang64(seed)) {
+    double total(0);
+    for (std::uint64_t key(0); key < num_keys; ++key) {
+      total += 1.0 / std::pow(double(key + 1), exponent);
+      _cdf[key] = total;
+    }
+    for (double &val : _cdf) {
+      val /= total;
+    }
+  }
+
+  std::uint64_t key() {
+    const double u(std::uniform_real_distribution<double>(0, 1)(_rnd_gen));
+    return std::min(std::uint64_t(std::lower_bound(std::begin(_cdf),
+                                                   std::end(_cdf), u) -
+                                  std::begin(_cdf)),
+                    std::uint64_t(_cdf.size() - 1));
+  }
+
+  std::uint64_t item() { return _rnd_gen(); }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Phases
+////////////////////////////////////////////////////////////////////////////////
+
+/// per-rank measurements of a phase, gathered to rank 0 as doubles
+enum rank_field_t {
+  field_ops,
+  field_issue_s,
+  field_barrier_s,
+  field_messages,
+  field_bytes,
+  num_fields
+};
+
+/**
+ * Measurements of one phase on every rank.
+ */
+struct phase_t {
+  std::string         name;
+  std::vector<double> fields;  /// `num_fields` values per rank
+};
+
+/**
+ * Time a phase.
+ *
+ * All ranks start together. `issue()` sends the phase's work and should
+ * flush any buffered updates; `wait()` then waits for every rank to finish
+ * processing, and is reported as barrier wait time.
+ *
+ * @param local_ops the number of operations issued by this rank.
+ */
+template <typename IssueFunc, typename WaitFunc>
+phase_t run_phase(ygm::comm &world, const std::string &name,
+                  const std::uint64_t local_ops, const IssueFunc &issue,
+                  const WaitFunc &wait) {
+  typedef krowkee::bench::bench_clock_t clock_t;
+
+  world.barrier();
+  const std::uint64_t start_messages(mpi_messages);
+  const std::uint64_t start_bytes(mpi_bytes);
+  const auto          start(clock_t::now());
+  issue();
+  const auto issued(clock_t::now());
+  wait();
+  const auto end(clock_t::now());
+
+  typedef std::chrono::duration<double> seconds_t;
+  std::vector<double>                   local(num_fields);
+  local[field_ops]       = double(local_ops);
+  local[field_issue_s]   = seconds_t(issued - start).count();
+  local[field_barrier_s] = seconds_t(end - issued).count();
+  local[field_messages]  = double(mpi_messages - start_messages);
+  local[field_bytes]     = double(mpi_bytes - start_bytes);
+
+  phase_t phase{name, std::vector<double>(num_fields * world.size())};
+  MPI_Gather(local.data(), num_fields, MPI_DOUBLE, phase.fields.data(),
+             num_fields, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+  return phase;
+}
+
+/**
+ * Write the phases as JSON.
+ */
+void write_json(std::ostream &os, const parameters_t &params, const int ranks,
+                const std::string &sketch_name,
+                const std::vector<phase_t> &phases) {
+  typedef krowkee::bench::reporter reporter_t;
+
+  os << "{\n  \"suite\": \"distributed_bench\",\n"
+     << "  \"sketch\": " << reporter_t::quote(sketch_name) << ",\n"
+     << "  \"ranks\": " << ranks << ",\n"
+     << "  \"scaling\": \"" << (params.weak ? "weak" : "strong") << "\",\n"
+     << "  \"count\": " << params.count << ",\n"
+     << "  \"num_keys\": " << params.num_keys << ",\n"
+     << "  \"exponent\": " << params.exponent << ",\n"
+     << "  \"range_size\": " << params.range_size << ",\n"
+     << "  \"seed\": " << params.seed << ",\n"
+     << "  \"peak_rss_bytes\": " << krowkee::bench::peak_rss_bytes() << ",\n"
+     << "  \"phases\": [";
+  for (std::size_t p(0); p < phases.size(); ++p) {
+    const phase_t &phase(phases[p]);
+    double         total_ops(0);
+    double         wall_s(0);
+    for (int rank(0); rank < ranks; ++rank) {
+      const double *fields(&phase.fields[rank * num_fields]);
+      total_ops += fields[field_ops];
+      wall_s =
+          std::max(wall_s, fields[field_issue_s] + fields[field_barrier_s]);
+    }
+    os << ((p == 0) ? "\n" : ",\n") << "    {\"phase\": \"" << phase.name
+       << "\", \"ops\": " << std::uint64_t(total_ops)
+       << ", \"wall_s\": " << wall_s
+       << ", \"ops_per_s\": " << ((wall_s > 0) ? total_ops / wall_s : 0)
+       << ",\n     \"per_rank\": [";
+    for (int rank(0); rank < ranks; ++rank) {
+      const double *fields(&phase.fields[rank * num_fields]);
+      const double  rank_s(fields[field_issue_s] + fields[field_barrier_s]);
+      const double  rank_rate((rank_s > 0) ? fields[field_ops] / rank_s : 0);
+      os << ((rank == 0) ? "\n" : ",\n") << "       {\"rank\": " << rank
+         << ", \"ops\": " << std::uint64_t(fields[field_ops])
+         << ", \"ops_per_s\": " << rank_rate
+         << ", \"issue_s\": " << fields[field_issue_s]
+         << ", \"barrier_wait_s\": " << fields[field_barrier_s]
+         << ", \"messages\": " << std::uint64_t(fields[field_messages])
+         << ", \"bytes\": " << std::uint64_t(fields[field_bytes]) << "}";
+    }
+    os << "\n     ]}";
+  }
+  os << "\n  ]\n}" << std::endl;
+}
+
+/**
+ * Run every phase for one Distributed type.
+ */
+template <typename DistributedType>
+void run(ygm::comm &world, const parameters_t &params) {
+  typedef DistributedType          dsk_t;
+  typedef typename dsk_t::sf_t     sf_t;
+  typedef typename dsk_t::sf_ptr_t sf_ptr_t;
+
+  const int           rank(world.rank());
+  const int           ranks(world.size());
+  const std::uint64_t local_count(
+      params.weak ? params.count
+                  : params.count / ranks + (rank < params.count % ranks));
+
+  make_ygm_ptr_functor_t<sf_t> make_ygm_ptr;
+  sf_ptr_t sf_ptr(make_ygm_ptr(params.range_size, params.seed));
+
+  // every rank draws its own part of the stream
+  std::vector<std::uint64_t> keys(local_count);
+  std::vector<std::uint64_t> items(local_count);
+  {
+    power_law_stream stream(params.num_keys, params.exponent,
+                            params.seed + rank);
+    for (std::uint64_t i(0); i < local_count; ++i) {
+      keys[i]  = stream.key();
+      items[i] = stream.item();
+    }
+  }
+
+  std::vector<phase_t> phases;
+  dsk_t dsk(world, sf_ptr, params.compaction_threshold,
+            params.promotion_threshold);
+  phases.push_back(run_phase(
+      world, "async_update", local_count,
+      [&]() {
+        for (std::uint64_t i(0); i < local_count; ++i) {
+          dsk.async_update(keys[i], items[i]);
+        }
+      },
+      [&]() { dsk.barrier(); }));
+  {
+    dsk_t buffered(world, sf_ptr, params.compaction_threshold,
+                   params.promotion_threshold);
+    phases.push_back(run_phase(
+        world, "buffered_update", local_count,
+        [&]() {
+          for (std::uint64_t i(0); i < local_count; ++i) {
+            buffered.buffered_update(keys[i], items[i]);
+          }
+          buffered.flush();
+        },
+        [&]() { buffered.barrier(); }));
+  }
+  {
+    dsk_t combined(world, sf_ptr, params.compaction_threshold,
+                   params.promotion_threshold);
+    phases.push_back(run_phase(
+        world, "combined_update", local_count,
+        [&]() {
+          for (std::uint64_t i(0); i < local_count; ++i) {
+            combined.combined_update(keys[i], items[i]);
+          }
+          combined.flush();
+        },
+        [&]() { combined.barrier(); }));
+  }
+
+  std::uint64_t local_keys(0);
+  dsk.for_all([&](const auto &kv_pair) { ++local_keys; });
+  phases.push_back(run_phase(
+      world, "compactify", local_keys, [&]() { dsk.compactify(); },
+      [&]() { dsk.barrier(); }));
+
+  // merge the sketches of consecutive keys of the stream into one another
+  const std::uint64_t local_merges(
+      std::min(local_count / 2, local_count / 64 + 1));
+  phases.push_back(run_phase(
+      world, "async_merge", local_merges,
+      [&]() {
+        for (std::uint64_t i(0); i < local_merges; ++i) {
+          dsk.async_merge(keys[2 * i], keys[2 * i + 1]);
+        }
+      },
+      [&]() { dsk.barrier(); }));
+
+  if (rank == 0) {
+    if (params.output.empty() == true) {
+      write_json(std::cout, params, ranks, dsk_t::full_name(), phases);
+    } else {
+      std::ofstream ofs(params.output);
+      write_json(ofs, params, ranks, dsk_t::full_name(), phases);
+    }
+  }
+}
+
+void print_help(char *exe_name) {
+  std::cout << "\nusage:  " << exe_name << "\n"
+            << "\t-c, --count <int>              - updates in total (strong "
+               "scaling) or per rank (weak scaling)\n"
+            << "\t-k, --keys <int>               - number of distinct keys\n"
+            << "\t-e, --exponent <float>         - power law exponent of key "
+               "frequencies\n"
+            << "\t-r, --range <int>              - range of sketch transform\n"
+            << "\t-o, --compaction-thresh <int>  - compaction threshold\n"
+            << "\t-p, --promotion-thresh <int>   - promotion threshold\n"
+            << "\t-t, --sketch-type <str>        - sketch type "
+               "(cst, sparse_cst, promotable_cst)\n"
+            << "\t-w, --weak                     - weak rather than strong "
+               "scaling\n"
+            << "\t-s, --seed <int>               - random seed\n"
+            << "\t-f, --output <path>            - JSON output file "
+               "(default stdout)\n"
+            << "\t-h, --help                     - print this help message\n"
+            << std::endl;
+}
+
+void parse_args(int argc, char **argv, parameters_t &params) {
+  int c;
+
+  while (1) {
+    int                  option_index(0);
+    static struct option long_options[] = {
+        {"count", required_argument, NULL, 'c'},
+        {"keys", required_argument, NULL, 'k'},
+        {"exponent", required_argument, NULL, 'e'},
+        {"range", required_argument, NULL, 'r'},
+        {"compaction-thresh", required_argument, NULL, 'o'},
+        {"promotion-thresh", required_argument, NULL, 'p'},
+        {"sketch-type", required_argument, NULL, 't'},
+        {"weak", no_argument, NULL, 'w'},
+        {"seed", required_argument, NULL, 's'},
+        {"output", required_argument, NULL, 'f'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+
+    c = getopt_long(argc, argv, "c:k:e:r:o:p:t:ws:f:h", long_options,
+                    &option_index);
+    if (c == -1) {
+      break;
+    }
+
+    switch (c) {
+      case 'h':
+        print_help(argv[0]);
+        exit(-1);
+        break;
+      case 'c':
+        params.count = std::atoll(optarg);
+        break;
+      case 'k':
+        params.num_keys = std::atoll(optarg);
+        break;
+      case 'e':
+        params.exponent = std::atof(optarg);
+        break;
+      case 'r':
+        params.range_size = std::atoll(optarg);
+        break;
+      case 'o':
+        params.compaction_threshold = std::atoll(optarg);
+        break;
+      case 'p':
+        params.promotion_threshold = std::atoll(optarg);
+        break;
+      case 't':
+        params.sketch_type = krowkee::util::get_sketch_type(optarg);
+        break;
+      case 'w':
+        params.weak = true;
+        break;
+      case 's':
+        params.seed = std::atoll(optarg);
+        break;
+      case 'f':
+        params.output = optarg;
+        break;
+      default:
+        print_help(argv[0]);
+        exit(-1);
+        break;
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  ygm::comm world(&argc, &argv);
+
+  parameters_t params{std::uint64_t(1) << 20,
+                      std::uint64_t(1) << 16,
+                      1.0,
+                      1024,
+                      128,
+                      4096,
+                      sketch_type_t::promotable_cst,
+                      false,
+                      krowkee::hash::default_seed,
+                      ""};
+  parse_args(argc, argv, params);
+
+  if (params.sketch_type == sketch_type_t::cst) {
+    run<krowkee::stream::CountingDistributedCountSketch<
+        krowkee::sketch::Dense, std::uint64_t, std::int32_t>>(world, params);
+  } else if (params.sketch_type == sketch_type_t::sparse_cst) {
+    run<krowkee::stream::CountingDistributedCountSketch<
+        krowkee::sketch::MapSparse32, std::uint64_t, std::int32_t>>(world,
+                                                                    params);
+  } else if (params.sketch_type == sketch_type_t::promotable_cst) {
+    run<krowkee::stream::CountingDistributedCountSketch<
+        krowkee::sketch::MapPromotable32, std::uint64_t, std::int32_t>>(
+        world, params);
+  } else if (world.rank0()) {
+    std::cerr << "error: unsupported sketch type for distributed_bench!"
+              << std::endl;
+    return 1;
+  }
+  return 0;
+}
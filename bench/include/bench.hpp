@@ -0,0 +1,154 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_BENCH_BENCH_HPP
+#define _KROWKEE_BENCH_BENCH_HPP
+
+#include <krowkee/util/tests.hpp>
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace krowkee {
+namespace bench {
+
+typedef std::chrono::steady_clock bench_clock_t;
+
+/**
+ * Keep the compiler from optimizing away the computation of `val`.
+ */
+template <typename T>
+inline void keep(const T &val) {
+  asm volatile("" : : "g"(&val) : "memory");
+}
+
+/**
+ * The peak resident set size of this process, in bytes.
+ */
+inline std::size_t peak_rss_bytes() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  // ru_maxrss is reported in kilobytes on Linux
+  return std::size_t(usage.ru_maxrss) * 1024;
+}
+
+/**
+ * One measurement of the suite.
+ */
+struct result_t {
+  std::string   group;   /// the operation being measured, e.g. "insert"
+  std::string   name;    /// the measured type
+  std::uint64_t size;    /// the size parameter, e.g. the range size
+  std::uint64_t ops;     /// operations per trial
+  double        ns_mean; /// mean nanoseconds per operation over the trials
+  double        ns_std;  /// standard deviation of the above
+  std::size_t   bytes;   /// bytes per sketch or message, or 0 if not measured
+};
+
+/**
+ * Time `trials` runs of `ops` operations.
+ *
+ * `setup()` runs untimed before each trial, and `func()` performs the `ops`
+ * operations of the trial.
+ *
+ * @return statistics of the nanoseconds per operation of each trial.
+ */
+template <typename SetupFunc, typename Func>
+online_statistics time_trials(const std::size_t trials, const std::uint64_t ops,
+                              const SetupFunc &setup, const Func &func) {
+  online_statistics stats;
+  for (std::size_t trial(0); trial < trials; ++trial) {
+    setup();
+    const auto start(bench_clock_t::now());
+    func();
+    const auto end(bench_clock_t::now());
+    stats.push(
+        double(std::chrono::duration_cast<ns_t>(end - start).count()) / ops);
+  }
+  return stats;
+}
+
+template <typename Func>
+online_statistics time_trials(const std::size_t trials, const std::uint64_t ops,
+                              const Func &func) {
+  return time_trials(trials, ops, []() {}, func);
+}
+
+/**
+ * Collects results and writes them as JSON.
+ */
+class reporter {
+  std::vector<result_t> _results;
+  std::string           _suite;
+
+ public:
+  reporter(const std::string &suite) : _suite(suite) {}
+
+  void add(const std::string &group, const std::string &name,
+           const std::uint64_t size, const std::uint64_t ops,
+           const online_statistics &stats, const std::size_t bytes = 0) {
+    _results.push_back(
+        {group, name, size, ops, stats.mean(), stats.std_dev(), bytes});
+    std::cerr << group << " " << name << " [" << size << "]: " << stats.mean()
+              << " ns/op" << std::endl;
+  }
+
+  const std::vector<result_t> &results() const { return _results; }
+
+  /**
+   * Write the results, along with the peak resident set size and `fields`,
+   * a list of additional top-level numeric fields.
+   */
+  void write(std::ostream &os,
+             const std::vector<std::pair<std::string, std::uint64_t>> &fields)
+      const {
+    os << "{\n  \"suite\": " << quote(_suite) << ",\n";
+    for (const auto &field : fields) {
+      os << "  " << quote(field.first) << ": " << field.second << ",\n";
+    }
+    os << "  \"peak_rss_bytes\": " << peak_rss_bytes() << ",\n";
+    os << "  \"results\": [";
+    for (std::size_t i(0); i < _results.size(); ++i) {
+      const result_t &result(_results[i]);
+      os << ((i == 0) ? "\n" : ",\n") << "    {\"group\": "
+         << quote(result.group) << ", \"name\": " << quote(result.name)
+         << ", \"size\": " << result.size << ", \"ops\": " << result.ops
+         << std::fixed << std::setprecision(3)
+         << ", \"ns_per_op\": " << result.ns_mean
+         << ", \"ns_per_op_std\": " << result.ns_std
+         << std::defaultfloat << ", \"bytes\": " << result.bytes << "}";
+    }
+    os << "\n  ]\n}" << std::endl;
+  }
+
+  static std::string quote(const std::string &str) {
+    std::stringstream ss;
+    ss << '"';
+    for (const char c : str) {
+      if (c == '"' || c == '\\') {
+        ss << '\\' << c;
+      } else if (c == '\n') {
+        ss << "\\n";
+      } else {
+        ss << c;
+      }
+    }
+    ss << '"';
+    return ss.str();
+  }
+};
+
+}  // namespace bench
+}  // namespace krowkee
+
+#endif
@@ -0,0 +1,496 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#include <krowkee/sketch/interface.hpp>
+
+#include <krowkee/hash/hash.hpp>
+#include <krowkee/util/wire.hpp>
+
+#include <bench.hpp>
+
+#if __has_include(<cereal/archives/binary.hpp>)
+#include <cereal/archives/binary.hpp>
+#endif
+
+#include <getopt.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Allocation Tracking
+////////////////////////////////////////////////////////////////////////////////
+
+/// bytes currently allocated through the global operator new
+static std::size_t live_bytes(0);
+
+/// allocations carry their size in a header of this many bytes
+static constexpr std::size_t header_size = alignof(std::max_align_t);
+
+void *operator new(std::size_t size) {
+  if (void *ptr = std::malloc(size + header_size)) {
+    *static_cast<std::size_t *>(ptr) = size;
+    live_bytes += size;
+    return static_cast<char *>(ptr) + header_size;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void *ptr) noexcept {
+  if (ptr != nullptr) {
+    char *base(static_cast<char *>(ptr) - header_size);
+    live_bytes -= *reinterpret_cast<std::size_t *>(base);
+    std::free(base);
+  }
+}
+
+void operator delete[](void *ptr) noexcept { operator delete(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { operator delete(ptr); }
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+  operator delete(ptr);
+}
+
+/**
+ * Struct bundling the benchmark parameters.
+ */
+struct parameters_t {
+  std::uint64_t count;
+  std::size_t   trials;
+  std::uint64_t seed;
+  std::string   output;
+};
+
+typedef krowkee::bench::reporter reporter_t;
+
+/**
+ * A reproducible stream of `count` items.
+ */
+std::vector<std::uint64_t> make_items(const std::uint64_t count,
+                                      const std::uint64_t seed) {
+  std::vector<std::uint64_t> items(count);
+  for (std::uint64_t i(0); i < count; ++i) {
+    items[i] = krowkee::hash::wang64(seed + i);
+  }
+  return items;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Hash Throughput
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename HashType>
+void bench_hash(reporter_t &rep, const parameters_t &params) {
+  const std::uint64_t              range_size(1024);
+  const HashType                   hash(range_size, params.seed);
+  const std::vector<std::uint64_t> items(make_items(params.count, params.seed));
+  std::vector<std::uint64_t>       out(items.size());
+
+  rep.add("hash", HashType::name(), range_size, params.count,
+          krowkee::bench::time_trials(params.trials, params.count, [&]() {
+            std::uint64_t sum(0);
+            for (const std::uint64_t item : items) {
+              sum += hash(item);
+            }
+            krowkee::bench::keep(sum);
+          }));
+  rep.add("hash_many", HashType::name(), range_size, params.count,
+          krowkee::bench::time_trials(params.trials, params.count, [&]() {
+            hash.hash_many(items.data(), out.data(), items.size());
+            krowkee::bench::keep(out);
+          }));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Insertion
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Insert rate into a single sketch, and the bytes held by a sketch once the
+ * stream is inserted and compacted.
+ */
+template <typename SketchType>
+void bench_insert(reporter_t &rep, const parameters_t &params,
+                  const std::uint64_t range_size) {
+  typedef SketchType              ls_t;
+  typedef typename ls_t::sf_t     sf_t;
+  typedef typename ls_t::sf_ptr_t sf_ptr_t;
+
+  const sf_ptr_t sf_ptr(std::make_shared<sf_t>(range_size, params.seed));
+  const std::vector<std::uint64_t> items(make_items(params.count, params.seed));
+  std::unique_ptr<ls_t>            ls;
+
+  const online_statistics stats(krowkee::bench::time_trials(
+      params.trials, params.count, [&]() { ls.reset(new ls_t(sf_ptr)); },
+      [&]() {
+        for (const std::uint64_t item : items) {
+          ls->insert(item);
+        }
+      }));
+
+  ls.reset();
+  const std::size_t start(live_bytes);
+  ls.reset(new ls_t(sf_ptr));
+  for (const std::uint64_t item : items) {
+    ls->insert(item);
+  }
+  ls->compactify();
+  rep.add("insert", ls_t::full_name(), range_size, params.count, stats,
+          live_bytes - start);
+}
+
+/**
+ * Insert rate of the batch kernel, and its ratio to that of inserting the same
+ * items one at a time.
+ */
+template <typename SketchType>
+void bench_insert_batch(reporter_t &rep, const parameters_t &params,
+                        const std::uint64_t range_size) {
+  typedef SketchType              ls_t;
+  typedef typename ls_t::sf_t     sf_t;
+  typedef typename ls_t::sf_ptr_t sf_ptr_t;
+
+  const sf_ptr_t sf_ptr(std::make_shared<sf_t>(range_size, params.seed));
+  const std::vector<std::uint64_t> items(make_items(params.count, params.seed));
+  std::unique_ptr<ls_t>            ls;
+
+  const online_statistics batch(krowkee::bench::time_trials(
+      params.trials, params.count, [&]() { ls.reset(new ls_t(sf_ptr)); },
+      [&]() { ls->insert_batch(items); }));
+  rep.add("insert_batch", ls_t::full_name(), range_size, params.count, batch);
+
+  // the batch kernel exists to beat the per-item calls it replaces
+  const online_statistics single(krowkee::bench::time_trials(
+      params.trials, params.count, [&]() { ls.reset(new ls_t(sf_ptr)); },
+      [&]() {
+        for (const std::uint64_t item : items) {
+          ls->insert(item);
+        }
+      }));
+  std::cerr << "insert_batch / insert " << ls_t::full_name() << " ["
+            << range_size << "]: " << batch.mean() / single.mean()
+            << std::endl;
+  if (batch.mean() > single.mean()) {
+    std::cerr << "warning: insert_batch is slower than insert!" << std::endl;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Compaction and Merges
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Cost per register of compacting, and of merging, sketches holding `size`
+ * nonzero registers.
+ */
+template <typename SketchType>
+void bench_compactify_merge(reporter_t &rep, const parameters_t &params,
+                            const std::uint64_t size) {
+  typedef SketchType              ls_t;
+  typedef typename ls_t::sf_t     sf_t;
+  typedef typename ls_t::sf_ptr_t sf_ptr_t;
+
+  // wide enough that the sketches stay sparse and few items share a
+  // register, and with compaction deferred to the timed call
+  const std::uint64_t range_size(std::uint64_t(1) << 20);
+  const std::size_t   compaction_threshold(size + 1);
+  const std::size_t   promotion_threshold(range_size);
+  const sf_ptr_t sf_ptr(std::make_shared<sf_t>(range_size, params.seed));
+  const std::vector<std::uint64_t> items(make_items(2 * size, params.seed));
+  std::unique_ptr<ls_t> lhs;
+  std::unique_ptr<ls_t> rhs;
+
+  auto fill = [&](const std::size_t offset) {
+    std::unique_ptr<ls_t> ls(
+        new ls_t(sf_ptr, compaction_threshold, promotion_threshold));
+    for (std::size_t i(0); i < size; ls->insert(items[offset + i++])) {
+    }
+    return ls;
+  };
+
+  rep.add("compactify", ls_t::full_name(), size, size,
+          krowkee::bench::time_trials(
+              params.trials, size, [&]() { lhs = fill(0); },
+              [&]() { lhs->compactify(); }));
+
+  // half of the registers of `rhs` are shared with `lhs`
+  rhs = fill(size / 2);
+  rhs->compactify();
+  rep.add("merge", ls_t::full_name(), size, size,
+          krowkee::bench::time_trials(
+              params.trials, size,
+              [&]() {
+                lhs = fill(0);
+                lhs->compactify();
+              },
+              [&]() { *lhs += *rhs; }));
+}
+
+/**
+ * Cost per register of merging dense sketches of `range_size` registers.
+ */
+template <typename SketchType>
+void bench_dense_merge(reporter_t &rep, const parameters_t &params,
+                       const std::uint64_t range_size) {
+  typedef SketchType              ls_t;
+  typedef typename ls_t::sf_t     sf_t;
+  typedef typename ls_t::sf_ptr_t sf_ptr_t;
+
+  const sf_ptr_t sf_ptr(std::make_shared<sf_t>(range_size, params.seed));
+  ls_t           lhs(sf_ptr);
+  ls_t           rhs(sf_ptr);
+  for (std::uint64_t i(0); i < range_size; ++i) {
+    lhs.insert(i);
+    rhs.insert(i + range_size);
+  }
+  const std::uint64_t repeats(
+      std::max(params.count / range_size, std::uint64_t(1)));
+  rep.add("merge", ls_t::full_name(), range_size, repeats * range_size,
+          krowkee::bench::time_trials(params.trials, repeats * range_size,
+                                      [&]() {
+                                        for (std::uint64_t i(0); i < repeats;
+                                             ++i) {
+                                          lhs += rhs;
+                                        }
+                                      }));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// FWHT
+////////////////////////////////////////////////////////////////////////////////
+
+void bench_fwht(reporter_t &rep, const parameters_t &params,
+                const std::uint64_t range_size) {
+  typedef krowkee::sketch::LocalFWHT<std::int32_t> ls_t;
+  typedef ls_t::sf_t                               sf_t;
+  typedef ls_t::sf_ptr_t                           sf_ptr_t;
+
+  const std::uint64_t domain_size(1024);
+  const std::uint64_t count(std::max(params.count / 16, std::uint64_t(1)));
+  const sf_ptr_t      sf_ptr(
+      std::make_shared<sf_t>(range_size, params.seed, domain_size));
+  std::vector<std::uint64_t> items(make_items(count, params.seed));
+  for (std::uint64_t &item : items) {
+    item %= domain_size;
+  }
+  std::unique_ptr<ls_t> ls;
+
+  rep.add("insert", ls_t::full_name(), range_size, count,
+          krowkee::bench::time_trials(
+              params.trials, count, [&]() { ls.reset(new ls_t(sf_ptr)); },
+              [&]() {
+                for (const std::uint64_t item : items) {
+                  ls->insert(item);
+                }
+              }));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Serialization
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Time and bytes of packing and unpacking a sketch of `range_size` registers
+ * holding the whole stream.
+ */
+template <typename SketchType>
+void bench_serialize(reporter_t &rep, const parameters_t &params,
+                     const std::uint64_t range_size) {
+  typedef SketchType              ls_t;
+  typedef typename ls_t::sf_t     sf_t;
+  typedef typename ls_t::sf_ptr_t sf_ptr_t;
+
+  const sf_ptr_t sf_ptr(std::make_shared<sf_t>(range_size, params.seed));
+  ls_t           ls(sf_ptr);
+  for (const std::uint64_t item : make_items(params.count, params.seed)) {
+    ls.insert(item);
+  }
+  ls.compactify();
+  const std::uint64_t repeats(64);
+
+  krowkee::util::wire_writer writer;
+  ls.pack(writer);
+  const krowkee::util::wire_bytes_t bytes(writer.release());
+  rep.add("wire_pack", ls_t::full_name(), range_size, repeats,
+          krowkee::bench::time_trials(params.trials, repeats,
+                                      [&]() {
+                                        for (std::uint64_t i(0); i < repeats;
+                                             ++i) {
+                                          krowkee::util::wire_writer w;
+                                          ls.pack(w);
+                                          krowkee::bench::keep(w);
+                                        }
+                                      }),
+          bytes.size());
+  rep.add("wire_unpack", ls_t::full_name(), range_size, repeats,
+          krowkee::bench::time_trials(params.trials, repeats,
+                                      [&]() {
+                                        for (std::uint64_t i(0); i < repeats;
+                                             ++i) {
+                                          krowkee::util::wire_reader r(bytes);
+                                          ls_t copy(sf_ptr);
+                                          copy.unpack(r);
+                                          krowkee::bench::keep(copy);
+                                        }
+                                      }),
+          bytes.size());
+
+#if __has_include(<cereal/archives/binary.hpp>)
+  std::size_t cereal_bytes(0);
+  rep.add("cereal_save", ls_t::full_name(), range_size, repeats,
+          krowkee::bench::time_trials(params.trials, repeats,
+                                      [&]() {
+                                        for (std::uint64_t i(0); i < repeats;
+                                             ++i) {
+                                          std::stringstream ss;
+                                          {
+                                            cereal::BinaryOutputArchive oar(
+                                                ss);
+                                            oar(ls);
+                                          }
+                                          cereal_bytes = ss.str().size();
+                                        }
+                                      }),
+          cereal_bytes);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Driver
+////////////////////////////////////////////////////////////////////////////////
+
+template <template <typename, typename> class ContainerType>
+using cst_t = krowkee::sketch::LocalCountSketch<ContainerType, std::int32_t>;
+
+void run_all(reporter_t &rep, const parameters_t &params) {
+  bench_hash<krowkee::hash::WangHash>(rep, params);
+  bench_hash<krowkee::hash::MulShift>(rep, params);
+  bench_hash<krowkee::hash::MulAddShift>(rep, params);
+
+  for (const std::uint64_t range_size : {1024, 16384}) {
+    bench_insert<cst_t<krowkee::sketch::Dense>>(rep, params, range_size);
+    bench_insert<cst_t<krowkee::sketch::MapSparse32>>(rep, params, range_size);
+#if __has_include(<boost/container/flat_map.hpp>)
+    bench_insert<cst_t<krowkee::sketch::FlatMapSparse32>>(rep, params,
+                                                          range_size);
+#endif
+    bench_insert<cst_t<krowkee::sketch::MapPromotable32>>(rep, params,
+                                                          range_size);
+    bench_insert_batch<cst_t<krowkee::sketch::Dense>>(rep, params, range_size);
+  }
+
+  for (const std::uint64_t size : {64, 1024, 16384}) {
+    bench_compactify_merge<cst_t<krowkee::sketch::MapSparse32>>(rep, params,
+                                                                size);
+#if __has_include(<boost/container/flat_map.hpp>)
+    bench_compactify_merge<cst_t<krowkee::sketch::FlatMapSparse32>>(
+        rep, params, size);
+#endif
+    bench_compactify_merge<cst_t<krowkee::sketch::MapPromotable32>>(
+        rep, params, size);
+    bench_dense_merge<cst_t<krowkee::sketch::Dense>>(rep, params, size);
+  }
+
+  for (const std::uint64_t range_size : {16, 64, 256, 1024}) {
+    bench_fwht(rep, params, range_size);
+  }
+
+  for (const std::uint64_t range_size : {1024, 16384}) {
+    bench_serialize<cst_t<krowkee::sketch::Dense>>(rep, params, range_size);
+    bench_serialize<cst_t<krowkee::sketch::MapSparse32>>(rep, params,
+                                                         range_size);
+    bench_serialize<cst_t<krowkee::sketch::MapPromotable32>>(rep, params,
+                                                             range_size);
+  }
+}
+
+void print_help(char *exe_name) {
+  std::cout << "\nusage:  " << exe_name << "\n"
+            << "\t-c, --count <int>              - items per stream\n"
+            << "\t-t, --trials <int>             - timed trials per "
+               "measurement\n"
+            << "\t-s, --seed <int>               - random seed\n"
+            << "\t-o, --output <path>            - JSON output file "
+               "(default stdout)\n"
+            << "\t-h, --help                     - print this help message\n"
+            << std::endl;
+}
+
+void parse_args(int argc, char **argv, parameters_t &params) {
+  int c;
+
+  while (1) {
+    int                  option_index(0);
+    static struct option long_options[] = {
+        {"count", required_argument, NULL, 'c'},
+        {"trials", required_argument, NULL, 't'},
+        {"seed", required_argument, NULL, 's'},
+        {"output", required_argument, NULL, 'o'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+
+    c = getopt_long(argc, argv, "c:t:s:o:h", long_options, &option_index);
+    if (c == -1) {
+      break;
+    }
+
+    switch (c) {
+      case 'h':
+        print_help(argv[0]);
+        exit(-1);
+        break;
+      case 'c':
+        params.count = std::atoll(optarg);
+        break;
+      case 't':
+        params.trials = std::atoll(optarg);
+        break;
+      case 's':
+        params.seed = std::atoll(optarg);
+        break;
+      case 'o':
+        params.output = optarg;
+        break;
+      default:
+        print_help(argv[0]);
+        exit(-1);
+        break;
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  parameters_t params{std::uint64_t(1) << 16, 5, krowkee::hash::default_seed,
+                      ""};
+  parse_args(argc, argv, params);
+
+  reporter_t rep("sketch_bench");
+  run_all(rep, params);
+
+  const std::vector<std::pair<std::string, std::uint64_t>> fields{
+      {"count", params.count},
+      {"trials", params.trials},
+      {"seed", params.seed}};
+  if (params.output.empty() == true) {
+    rep.write(std::cout, fields);
+  } else {
+    std::ofstream ofs(params.output);
+    rep.write(ofs, fields);
+  }
+  return 0;
+}
@@ -0,0 +1,164 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_CONTAINER_BITMAP_HPP
+#define _KROWKEE_CONTAINER_BITMAP_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace krowkee {
+namespace container {
+
+/**
+ * Word-packed bitmap.
+ *
+ * Stores one bit per slot in 64-bit words. Unlike `std::vector<bool>`, bits are
+ * addressed directly rather than through proxy references, and scans for the
+ * next set or unset bit skip a whole word at a time.
+ *
+ * Bits beyond `size()` in the last word are always zero.
+ *
+ * CURRENTLY NOT PORTABLE. Uses `__builtin_ctzll` and `__builtin_popcountll`.
+ */
+class bitmap {
+ public:
+  typedef std::uint64_t word_t;
+
+  static constexpr std::size_t word_bits = 64;
+
+ private:
+  std::vector<word_t> _words;
+  std::size_t         _size;
+
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  // Constructors
+  //////////////////////////////////////////////////////////////////////////////
+
+  bitmap() : _size(0) {}
+
+  explicit bitmap(const std::size_t size)
+      : _words(word_count(size), 0), _size(size) {}
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Sizing
+  //////////////////////////////////////////////////////////////////////////////
+
+  inline void reserve(const std::size_t size) {
+    _words.reserve(word_count(size));
+  }
+
+  /**
+   * Resize to `size` bits. Any new bits are unset.
+   */
+  inline void resize(const std::size_t size) {
+    _words.resize(word_count(size), 0);
+    _size = size;
+    _clear_tail();
+  }
+
+  /**
+   * Resize to `size` bits, all of which are unset.
+   */
+  inline void assign(const std::size_t size) {
+    _words.assign(word_count(size), 0);
+    _size = size;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Bit Access
+  //////////////////////////////////////////////////////////////////////////////
+
+  inline bool test(const std::size_t pos) const {
+    return (_words[pos / word_bits] >> (pos % word_bits)) & word_t(1);
+  }
+
+  inline void set(const std::size_t pos) {
+    _words[pos / word_bits] |= word_t(1) << (pos % word_bits);
+  }
+
+  inline void unset(const std::size_t pos) {
+    _words[pos / word_bits] &= ~(word_t(1) << (pos % word_bits));
+  }
+
+  inline bool operator[](const std::size_t pos) const { return test(pos); }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Scans
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Return the position of the first bit at or after `pos` whose value is
+   * `value`, or `size()` if there is none.
+   */
+  inline std::size_t find_next(const std::size_t pos, const bool value) const {
+    if (pos >= _size) {
+      return _size;
+    }
+    const word_t flip(value ? word_t(0) : ~word_t(0));
+    std::size_t  w(pos / word_bits);
+    word_t       word((_words[w] ^ flip) & (~word_t(0) << (pos % word_bits)));
+    while (word == 0) {
+      if (++w == _words.size()) {
+        return _size;
+      }
+      word = _words[w] ^ flip;
+    }
+    return std::min(w * word_bits + __builtin_ctzll(word), _size);
+  }
+
+  inline std::size_t count() const {
+    std::size_t ret(0);
+    for (const word_t word : _words) {
+      ret += __builtin_popcountll(word);
+    }
+    return ret;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Getters
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr std::size_t size() const { return _size; }
+
+  static constexpr std::size_t word_count(const std::size_t size) {
+    return (size + word_bits - 1) / word_bits;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Equality operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  friend bool operator==(const bitmap &lhs, const bitmap &rhs) {
+    return lhs._size == rhs._size && lhs._words == rhs._words;
+  }
+  friend bool operator!=(const bitmap &lhs, const bitmap &rhs) {
+    return !operator==(lhs, rhs);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Swaps
+  //////////////////////////////////////////////////////////////////////////////
+
+  friend void swap(bitmap &lhs, bitmap &rhs) noexcept {
+    std::swap(lhs._words, rhs._words);
+    std::swap(lhs._size, rhs._size);
+  }
+
+ private:
+  inline void _clear_tail() {
+    const std::size_t tail(_size % word_bits);
+    if (tail != 0) {
+      _words.back() &= (word_t(1) << tail) - 1;
+    }
+  }
+};
+
+}  // namespace container
+}  // namespace krowkee
+
+#endif
@@ -6,7 +6,12 @@
 #ifndef _KROWKEE_CONTAINER_COMPACTING_MAP_HPP
 #define _KROWKEE_CONTAINER_COMPACTING_MAP_HPP
 
+#include <krowkee/container/bitmap.hpp>
+#include <krowkee/container/staging_buffer.hpp>
+
 #include <krowkee/hash/util.hpp>
+#include <krowkee/util/counters.hpp>
+#include <krowkee/util/wire.hpp>
 
 #if __has_include(<cereal/types/map.hpp>)
 #include <cereal/types/map.hpp>
@@ -28,43 +33,67 @@ namespace container {
 // template <typename KeyType, typename ValueType>
 // using pair_vector_t = std::vector<std::pair<const KeyType, ValueType>>;
 
+/**
+ * Return the first element of the sorted range `[first, last)` whose key is not
+ * less than `key`.
+ *
+ * Probes `first + 1`, `first + 2`, `first + 4`, ... before binary searching the
+ * last bracket, so that the cost is logarithmic in the distance to the result
+ * rather than in the length of the range.
+ */
+template <typename RandomIt, typename KeyType>
+RandomIt gallop_lower_bound(RandomIt first, const RandomIt last,
+                            const KeyType &key) {
+  typedef typename std::iterator_traits<RandomIt>::difference_type diff_t;
+  const diff_t length(last - first);
+  diff_t       lo(0);
+  diff_t       hi(1);
+  while (hi < length && (first + hi)->first < key) {
+    lo = hi;
+    hi *= 2;
+  }
+  return std::lower_bound(first + lo, first + std::min(hi, length), key,
+                          [](const auto &pair, const KeyType &key) {
+                            return pair.first < key;
+                          });
+}
+
 /**
  * Merge sorted key-value data structures, applying a binary operator to the
- * values of ties.
+ * values of ties. Ties whose merged value is zero are dropped.
+ *
+ * Runs of keys present on only one side are found by galloping and written out
+ * with a single `std::copy`, so merging a short range into a long one costs
+ * logarithmic time per element of the short range, plus the bulk copies.
  *
- * @note[bwp] This is fucking awful. Need to move this logic inside of
- * compacting_map and clean it up. Invocations of std::copy are slow; see if
- * there is a better way to do this.
+ * @return the output iterator past the last element written.
  */
 template <typename MergeOp, typename LhsIt, typename RhsIt, typename OutIt>
-void merge_and_compact(LhsIt lhs_itr, const LhsIt lhs_end, RhsIt rhs_itr,
-                       const RhsIt rhs_end, OutIt new_itr, MergeOp merge_op) {
-  for (; lhs_itr != lhs_end; ++new_itr) {
-    if (rhs_itr == rhs_end) {
-      std::copy(lhs_itr, lhs_end, new_itr);
-      break;
-    }
-    if (rhs_itr->first < lhs_itr->first) {
-      std::copy(rhs_itr, rhs_itr + 1, new_itr);
-      ++rhs_itr;
-    } else if (rhs_itr->first > lhs_itr->first) {
-      std::copy(lhs_itr, lhs_itr + 1, new_itr);
-      ++lhs_itr;
+OutIt merge_and_compact(LhsIt lhs_itr, const LhsIt lhs_end, RhsIt rhs_itr,
+                        const RhsIt rhs_end, OutIt new_itr, MergeOp merge_op) {
+  while (lhs_itr != lhs_end && rhs_itr != rhs_end) {
+    if (lhs_itr->first < rhs_itr->first) {
+      const LhsIt run_end(
+          gallop_lower_bound(lhs_itr + 1, lhs_end, rhs_itr->first));
+      new_itr = std::copy(lhs_itr, run_end, new_itr);
+      lhs_itr = run_end;
+    } else if (rhs_itr->first < lhs_itr->first) {
+      const RhsIt run_end(
+          gallop_lower_bound(rhs_itr + 1, rhs_end, lhs_itr->first));
+      new_itr = std::copy(rhs_itr, run_end, new_itr);
+      rhs_itr = run_end;
     } else {  // if the indices are equal, perform the merge!
-              /**
-               * @note[bwp] wow this is wildly unsafe. Need a better
-               * implementation.
-               */
       auto ret = merge_op(lhs_itr->second, rhs_itr->second);
       if (ret != 0) {
-        lhs_itr->second = ret;
-        std::copy(lhs_itr, lhs_itr + 1, new_itr);
+        *new_itr = std::make_pair(lhs_itr->first, ret);
+        ++new_itr;
       }
       ++lhs_itr;
       ++rhs_itr;
     }
   }
-  std::copy(rhs_itr, rhs_end, new_itr);
+  new_itr = std::copy(lhs_itr, lhs_end, new_itr);
+  return std::copy(rhs_itr, rhs_end, new_itr);
 }
 
 /**
@@ -86,6 +115,10 @@ void merge_and_compact(LhsIt lhs_itr, const LhsIt lhs_end, RhsIt rhs_itr,
  * when member function `compactify` is called. Care must be taken to avoid
  * interacting with the map when in an uncompacted state.
  *
+ * MapType may be a krowkee::container::staging_buffer, in which case pending
+ * inserts are appended to a preallocated vector and sorted as a batch during
+ * compaction, and no insert allocates.
+ *
  * References:
  *
  * [0]
@@ -112,12 +145,18 @@ class compacting_map {
   typedef typename vec_t::const_iterator              const_iterator;
   typedef compacting_map<KeyType, ValueType, MapType> cm_t;
 
+  /**
+   * `merge` works in place when the right hand side has at most this many
+   * times fewer elements than the left hand side.
+   */
+  static constexpr std::size_t in_place_merge_ratio = 8;
+
  protected:
-  std::vector<bool> _erased;
-  vec_t             _archive_map;
-  map_t             _dynamic_map;
-  std::size_t       _compaction_threshold;
-  int               _erased_count;
+  bitmap      _erased;
+  vec_t       _archive_map;
+  map_t       _dynamic_map;
+  std::size_t _compaction_threshold;
+  int         _erased_count;
 
   struct compare_first_f {
     bool operator()(const pair_t &lhs, const pair_t &rhs) const {
@@ -142,18 +181,28 @@ class compacting_map {
       : _compaction_threshold(compaction_threshold), _erased_count(0) {
     _archive_map.reserve(_compaction_threshold);
     _erased.reserve(_compaction_threshold);
+    if constexpr (is_staging_buffer<map_t>::value) {
+      _dynamic_map.reserve(_compaction_threshold);
+    }
   }
 
   compacting_map(const cm_t &rhs)
-      : _compaction_threshold(rhs._compaction_threshold),
-        _erased_count(rhs._erased_count),
-        _erased(rhs._erased),
+      : _erased(rhs._erased),
         _archive_map(rhs._archive_map),
-        _dynamic_map(rhs._dynamic_map) {}
-
-  compacting_map() {}
-
-  // compacting_map(cm_t &&rhs) : cm_t() { std::swap(*this, rhs); }
+        _dynamic_map(rhs._dynamic_map),
+        _compaction_threshold(rhs._compaction_threshold),
+        _erased_count(rhs._erased_count) {}
+
+  compacting_map() : _compaction_threshold(0), _erased_count(0) {}
+
+  compacting_map(cm_t &&rhs) noexcept
+      : _erased(std::move(rhs._erased)),
+        _archive_map(std::move(rhs._archive_map)),
+        _dynamic_map(std::move(rhs._dynamic_map)),
+        _compaction_threshold(rhs._compaction_threshold),
+        _erased_count(rhs._erased_count) {
+    rhs._erased_count = 0;
+  }
 
   //////////////////////////////////////////////////////////////////////////////
   // Cereal Archives
@@ -172,12 +221,46 @@ class compacting_map {
   template <class Archive>
   void load(Archive &archive) {
     archive(_compaction_threshold, _archive_map);
-    _erased.resize(_archive_map.size());
-    std::fill(std::begin(_erased), std::end(_erased), false);
+    _erased.assign(_archive_map.size());
     _erased_count = 0;
+    if constexpr (is_staging_buffer<map_t>::value) {
+      _dynamic_map.reserve(_compaction_threshold);
+    }
   }
 #endif
 
+  //////////////////////////////////////////////////////////////////////////////
+  // Wire Format
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Write the archive as index deltas and values.
+   *
+   * @throw std::logic_error if invoked on uncompacted maps.
+   */
+  void pack(krowkee::util::wire_writer &writer) const {
+    if (is_compact() != true) {
+      throw std::logic_error("Incorrectly trying to pack a non-compact map!");
+    }
+    writer.put_sorted_pairs(std::cbegin(_archive_map), std::cend(_archive_map),
+                            _archive_map.size());
+  }
+
+  /**
+   * Replace the contents with packed registers, keeping the compaction
+   * threshold.
+   */
+  void unpack(krowkee::util::wire_reader &reader) {
+    _archive_map.clear();
+    _dynamic_map.clear();
+    reader.get_sorted_pairs<KeyType, ValueType>(
+        [&](const KeyType key, const ValueType val) {
+          _archive_map.emplace_back(key, val);
+        });
+    _erased.assign(_archive_map.size());
+    _erased_count = 0;
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   // Getters
   //////////////////////////////////////////////////////////////////////////////
@@ -196,11 +279,12 @@ class compacting_map {
 
   inline std::size_t erased_count() const { return _erased_count; }
 
-  inline std::size_t erased_count_manual() const {
-    std::size_t erased_count(
-        std::count(std::begin(_erased), std::end(_erased), true));
-    return erased_count;
-  }
+  /**
+   * Estimated bytes per stored register once compacted.
+   */
+  static constexpr std::size_t entry_bytes() { return sizeof(pair_t); }
+
+  inline std::size_t erased_count_manual() const { return _erased.count(); }
 
   static inline std::string name() { return "compacting_map"; }
 
@@ -218,31 +302,40 @@ class compacting_map {
   /**
    * Sort _dynamic_map into _archive_map, clearing deleted items along the way.
    *
-   * @note[bwp] right now this does two copies, which is suboptimal. Should look
-   * into ways to improve performance.
+   * Works in place in `_archive_map`. If there are erased entries, the live
+   * entries are first shifted down over them run by run. The archive
+   * is then grown once to its final size and the dynamic entries are merged in
+   * from the back, so that every archive entry is moved at most twice and no
+   * temporary buffers are allocated. Keys are never stored in both the archive
+   * and the dynamic map, so there are no ties to resolve.
    */
   void compactify() {
     if (is_compact()) {
       return;
     }
-    // copy nondeleted elements
-    vec_t tmp1;
-    tmp1.reserve(_archive_map.size());
-    for (std::size_t i(0); i < _archive_map.size(); ++i) {
-      if (_erased[i] == false) {
-        tmp1.push_back(_archive_map[i]);
+    KROWKEE_COUNT_TIME(compaction_ns);
+    KROWKEE_COUNT(compactions, 1);
+    const std::size_t live(_shift_out_erased());
+    if constexpr (is_staging_buffer<map_t>::value) {
+      _dynamic_map.sort();
+    }
+    // merge dynamic elements from the back
+    std::size_t out(live + _dynamic_map.size());
+    _archive_map.resize(out);
+    std::size_t axv(live);
+    for (auto dyn_itr(_dynamic_map.rbegin()); dyn_itr != _dynamic_map.rend();) {
+      --out;
+      if (axv > 0 && dyn_itr->first < _archive_map[axv - 1].first) {
+        _archive_map[out] = std::move(_archive_map[--axv]);
+      } else {
+        _archive_map[out].first  = dyn_itr->first;
+        _archive_map[out].second = dyn_itr->second;
+        ++dyn_itr;
       }
     }
-    // perform union
-    vec_t tmp2;
-    tmp2.reserve(tmp2.size() + _dynamic_map.size());
-    std::set_union(std::begin(tmp1), std::end(tmp1), std::begin(_dynamic_map),
-                   std::end(_dynamic_map), std::back_inserter(tmp2),
-                   compare_first);
+    KROWKEE_COUNT(compaction_moves, live - axv + _dynamic_map.size());
     _dynamic_map.clear();
-    std::swap(_archive_map, tmp2);
-    _erased.resize(_archive_map.size());
-    std::fill(std::begin(_erased), std::end(_erased), false);
+    _erased.assign(_archive_map.size());
     _erased_count = 0;
   }
 
@@ -291,8 +384,8 @@ class compacting_map {
     if (axv_code == archive_code_t::present) {
       return axv_iter->second;
     } else if (axv_code == archive_code_t::deleted) {
-      axv_iter->second                             = 0;
-      _erased[axv_iter - std::begin(_archive_map)] = false;
+      axv_iter->second = 0;
+      _erased.unset(axv_iter - std::begin(_archive_map));
       --_erased_count;
       return axv_iter->second;
     } else if (axv_code == archive_code_t::absent) {
@@ -380,8 +473,7 @@ class compacting_map {
    * Erases a given key, if found.
    *
    * Erases they key directly if found in the dynamic map. Instead sets the
-   * corresponding element of the _erased vector to true if found in the
-   * archive map.
+   * corresponding bit of the _erased bitmap if found in the archive map.
    */
   std::size_t erase(const KeyType &key) {
     std::size_t erase_count(_dynamic_map.erase(key));
@@ -392,7 +484,7 @@ class compacting_map {
 
     auto [axv_lb, axv_code] = archive_find(key);
     if (axv_code == archive_code_t::present) {
-      _erased[axv_lb - std::begin(_archive_map)] = true;
+      _erased.set(axv_lb - std::begin(_archive_map));
       ++_erased_count;
       return 1;
     }
@@ -408,7 +500,7 @@ class compacting_map {
    */
   std::size_t erase(const vec_iter_t &iter) {
     if (iter >= std::begin(_archive_map) && iter < std::end(_archive_map)) {
-      _erased[iter - std::begin(_archive_map)] = true;
+      _erased.set(iter - std::begin(_archive_map));
       ++_erased_count;
       return 1;
     } else {
@@ -489,8 +581,7 @@ class compacting_map {
            _archive_map.size() == rhs._archive_map.size() &&
            std::equal(std::cbegin(_dynamic_map), std::cend(_dynamic_map),
                       std::cbegin(rhs._dynamic_map)) &&
-           std::equal(std::cbegin(_erased), std::cend(_erased),
-                      std::cbegin(rhs._erased)) &&
+           _erased == rhs._erased &&
            std::equal(std::cbegin(_archive_map), std::cend(_archive_map),
                       std::cbegin(rhs._archive_map));
   }
@@ -511,7 +602,7 @@ class compacting_map {
    *
    * @note[bwp]: Is this safe? Should we be checking for compatibility?
    */
-  friend void swap(cm_t &lhs, cm_t &rhs) {
+  friend void swap(cm_t &lhs, cm_t &rhs) noexcept {
     std::swap(lhs._compaction_threshold, rhs._compaction_threshold);
     std::swap(lhs._erased_count, rhs._erased_count);
     std::swap(lhs._dynamic_map, rhs._dynamic_map);
@@ -527,8 +618,8 @@ class compacting_map {
    *
    * https://stackoverflow.com/questions/3279543/what-is-the-copy-and-swap-idiom
    */
-  cm_t &operator=(cm_t rhs) {
-    std::swap(*this, rhs);
+  cm_t &operator=(cm_t rhs) noexcept {
+    swap(*this, rhs);
     return *this;
   }
 
@@ -541,6 +632,10 @@ class compacting_map {
    *
    * @param rhs the other compacting_map.
    *
+   * If `rhs` holds at most `1 / in_place_merge_ratio` as many elements as
+   * `this`, its elements are merged directly into the archive vector.
+   * Otherwise both archives are merged into a fresh vector.
+   *
    * @throw std::logic_error if invoked on uncompacted maps.
    */
   template <typename MergeOp>
@@ -553,14 +648,19 @@ class compacting_map {
       throw std::logic_error(
           "Bad attempt to merge on uncompacted right hand side!");
     }
+    if (rhs._archive_map.size() * in_place_merge_ratio <=
+        _archive_map.size()) {
+      _merge_in_place(rhs, merge_op);
+      return;
+    }
     vec_t tmp;
     tmp.reserve(_archive_map.size() + rhs._archive_map.size());
-    merge_and_compact(std::begin(_archive_map), std::end(_archive_map),
+    merge_and_compact(std::cbegin(_archive_map), std::cend(_archive_map),
                       std::cbegin(rhs._archive_map),
                       std::cend(rhs._archive_map), std::back_inserter(tmp),
                       merge_op);
     std::swap(_archive_map, tmp);
-    _erased.resize(_archive_map.size());
+    _erased.assign(_archive_map.size());
   }
 
   //////////////////////////////////////////////////////////////////////////////
@@ -592,6 +692,88 @@ class compacting_map {
   }
 
  private:
+  /**
+   * Move runs of live archive elements down over erased slots, without
+   * resizing the archive.
+   *
+   * @return the number of live elements, which now occupy the front of the
+   *     archive.
+   */
+  inline std::size_t _shift_out_erased() {
+    if (_erased_count == 0) {
+      return _archive_map.size();
+    }
+    KROWKEE_COUNT(tombstones, _erased_count);
+    std::size_t live(_erased.find_next(0, true));
+    std::size_t run_begin(live);
+    while (run_begin != _erased.size()) {
+      run_begin = _erased.find_next(run_begin, false);
+      const std::size_t run_end(_erased.find_next(run_begin, true));
+      std::move(std::begin(_archive_map) + run_begin,
+                std::begin(_archive_map) + run_end,
+                std::begin(_archive_map) + live);
+      KROWKEE_COUNT(compaction_moves, run_end - run_begin);
+      live += run_end - run_begin;
+      run_begin = run_end;
+    }
+    return live;
+  }
+
+  /**
+   * Merge a (much smaller) compact map directly into the archive vector.
+   *
+   * First counts the keys of `rhs` missing from `this` by galloping through
+   * the archive, then grows the archive once and merges from the back, moving
+   * each block of archive elements between consecutive `rhs` keys with a
+   * single `std::move_backward`. Ties whose merged value is zero are marked
+   * erased and dropped in a final forward pass.
+   */
+  template <typename MergeOp>
+  void _merge_in_place(const cm_t &rhs, MergeOp merge_op) {
+    auto        lb(std::begin(_archive_map));
+    std::size_t insert_count(0);
+    for (const pair_t &pair : rhs._archive_map) {
+      lb = gallop_lower_bound(lb, std::end(_archive_map), pair.first);
+      if (lb == std::end(_archive_map) || lb->first != pair.first) {
+        ++insert_count;
+      }
+    }
+    std::size_t axv(_archive_map.size());
+    std::size_t out(axv + insert_count);
+    _archive_map.resize(out);
+    _erased.assign(out);
+    auto axv_begin(std::begin(_archive_map));
+    for (auto rhs_itr(std::crbegin(rhs._archive_map));
+         rhs_itr != std::crend(rhs._archive_map); ++rhs_itr) {
+      const std::size_t run_begin(
+          std::upper_bound(axv_begin, axv_begin + axv, rhs_itr->first,
+                           compare_first) -
+          axv_begin);
+      std::move_backward(axv_begin + run_begin, axv_begin + axv,
+                         axv_begin + out);
+      out -= axv - run_begin;
+      axv = run_begin;
+      --out;
+      if (axv > 0 && _archive_map[axv - 1].first == rhs_itr->first) {
+        --axv;
+        _archive_map[out].first = rhs_itr->first;
+        _archive_map[out].second =
+            merge_op(_archive_map[axv].second, rhs_itr->second);
+        if (_archive_map[out].second == 0) {
+          _erased.set(out);
+          ++_erased_count;
+        }
+      } else {
+        _archive_map[out] = *rhs_itr;
+      }
+    }
+    if (_erased_count > 0) {
+      _archive_map.resize(_shift_out_erased());
+      _erased.assign(_archive_map.size());
+      _erased_count = 0;
+    }
+  }
+
   enum class archive_code_t : std::uint8_t { present, deleted, absent };
 
   enum class dynamic_code_t : std::uint8_t { success, failure, compaction };
@@ -614,7 +796,7 @@ class compacting_map {
       return {axv_lb, archive_code_t::absent};
     } else {
       int axv_offset = axv_lb - std::begin(_archive_map);
-      if (_erased[axv_offset] == true) {
+      if (_erased.test(axv_offset) == true) {
         return {axv_lb, archive_code_t::deleted};
       } else {
         return {axv_lb, archive_code_t::present};
@@ -635,7 +817,7 @@ class compacting_map {
       return {axv_lb, archive_code_t::absent};
     } else {
       int axv_offset = axv_lb - std::begin(_archive_map);
-      if (_erased[axv_offset] == true) {
+      if (_erased.test(axv_offset) == true) {
         return {axv_lb, archive_code_t::deleted};
       } else {
         return {axv_lb, archive_code_t::present};
@@ -680,9 +862,9 @@ class compacting_map {
     if (axv_code == archive_code_t::present) {
       return false;
     } else if (axv_code == archive_code_t::deleted) {
-      axv_lb->second      = pair.second;
-      int axv_offset      = axv_lb - std::begin(_archive_map);
-      _erased[axv_offset] = false;
+      axv_lb->second = pair.second;
+      int axv_offset = axv_lb - std::begin(_archive_map);
+      _erased.unset(axv_offset);
       --_erased_count;
       return true;
     } else {  // axv_code == archive_code_t::absent
@@ -0,0 +1,553 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_CONTAINER_OPEN_HASH_MAP_HPP
+#define _KROWKEE_CONTAINER_OPEN_HASH_MAP_HPP
+
+#include <krowkee/container/bitmap.hpp>
+
+#include <krowkee/hash/util.hpp>
+#include <krowkee/util/wire.hpp>
+
+#if __has_include(<cereal/types/vector.hpp>)
+#include <cereal/types/utility.hpp>
+#include <cereal/types/vector.hpp>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace krowkee {
+namespace container {
+
+/**
+ * Open-addressing hash map for integer keys.
+ *
+ * Slots live in a single power-of-two sized vector of key-value pairs, with
+ * occupancy tracked in a bitmap, so that no insert allocates a node. Keys are
+ * placed by Fibonacci hashing and collisions are resolved by linear probing.
+ * Erasure uses backward-shift deletion rather than tombstones, so probe
+ * sequences never lengthen under the insert/erase churn of sparse sketch
+ * registers that cross zero. The table doubles once its load exceeds
+ * `max_load_numerator / max_load_denominator`.
+ *
+ * Used as the MapType of Sparse (and thus Promotable), it replaces
+ * compacting_map outright: register updates take expected O(1) time, and the
+ * registers are only sorted when serialized (see `sorted`). Iteration visits
+ * registers in slot order.
+ */
+template <typename KeyType, typename ValueType>
+class open_hash_map {
+ public:
+  typedef std::pair<KeyType, ValueType>       pair_t;
+  typedef pair_t                              value_type;
+  typedef std::vector<pair_t>                 vec_t;
+  typedef open_hash_map<KeyType, ValueType>   map_t;
+  typedef open_hash_map<KeyType, ValueType>   ohm_t;
+
+  static constexpr std::size_t max_load_numerator   = 3;
+  static constexpr std::size_t max_load_denominator = 4;
+  static constexpr std::size_t min_capacity         = 16;
+
+  /**
+   * Forward iterator over occupied slots.
+   */
+  template <bool IsConst>
+  class slot_iterator {
+   public:
+    typedef std::conditional_t<IsConst, const ohm_t, ohm_t>   table_t;
+    typedef std::conditional_t<IsConst, const pair_t, pair_t> slot_t;
+    typedef std::forward_iterator_tag                         iterator_category;
+    typedef pair_t                                            value_type;
+    typedef std::ptrdiff_t                                    difference_type;
+    typedef slot_t                                           *pointer;
+    typedef slot_t                                           &reference;
+
+   private:
+    table_t    *_table;
+    std::size_t _pos;
+
+   public:
+    slot_iterator() : _table(nullptr), _pos(0) {}
+
+    slot_iterator(table_t *table, const std::size_t pos)
+        : _table(table), _pos(table->_occupied.find_next(pos, true)) {}
+
+    template <bool RhsConst, typename = std::enable_if_t<IsConst && !RhsConst>>
+    slot_iterator(const slot_iterator<RhsConst> &rhs)
+        : _table(rhs.table()), _pos(rhs.pos()) {}
+
+    constexpr table_t    *table() const { return _table; }
+    constexpr std::size_t pos() const { return _pos; }
+
+    reference operator*() const { return _table->_slots[_pos]; }
+    pointer   operator->() const { return &_table->_slots[_pos]; }
+
+    slot_iterator &operator++() {
+      _pos = _table->_occupied.find_next(_pos + 1, true);
+      return *this;
+    }
+    slot_iterator operator++(int) {
+      slot_iterator ret(*this);
+      ++(*this);
+      return ret;
+    }
+
+    friend bool operator==(const slot_iterator &lhs, const slot_iterator &rhs) {
+      return lhs._pos == rhs._pos;
+    }
+    friend bool operator!=(const slot_iterator &lhs, const slot_iterator &rhs) {
+      return lhs._pos != rhs._pos;
+    }
+  };
+
+  typedef slot_iterator<false> iterator;
+  typedef slot_iterator<true>  const_iterator;
+  typedef iterator             vec_iter_t;
+  typedef const_iterator       vec_citer_t;
+
+ private:
+  vec_t       _slots;
+  bitmap      _occupied;
+  std::size_t _size;
+  std::size_t _shift;
+  std::size_t _compaction_threshold;
+
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  // Constructors
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * @param compaction_threshold expected number of registers. Sizes the
+   *     initial table; there is no compaction.
+   */
+  open_hash_map(const std::size_t compaction_threshold)
+      : _size(0), _compaction_threshold(compaction_threshold) {
+    _allocate(_capacity_for(compaction_threshold));
+  }
+
+  open_hash_map(const ohm_t &rhs)
+      : _slots(rhs._slots),
+        _occupied(rhs._occupied),
+        _size(rhs._size),
+        _shift(rhs._shift),
+        _compaction_threshold(rhs._compaction_threshold) {}
+
+  open_hash_map(ohm_t &&rhs) noexcept
+      : _slots(std::move(rhs._slots)),
+        _occupied(std::move(rhs._occupied)),
+        _size(rhs._size),
+        _shift(rhs._shift),
+        _compaction_threshold(rhs._compaction_threshold) {
+    rhs._size = 0;
+  }
+
+  open_hash_map() : open_hash_map(0) {}
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Cereal Archives
+  //////////////////////////////////////////////////////////////////////////////
+
+#if __has_include(<cereal/types/vector.hpp>)
+  /**
+   * Archive the registers in key order, so that equal maps produce identical
+   * archives regardless of their insertion history.
+   */
+  template <class Archive>
+  void save(Archive &archive) const {
+    archive(_compaction_threshold, sorted());
+  }
+
+  template <class Archive>
+  void load(Archive &archive) {
+    vec_t pairs;
+    archive(_compaction_threshold, pairs);
+    _size = 0;
+    _allocate(_capacity_for(std::max(pairs.size(), _compaction_threshold)));
+    for (const pair_t &pair : pairs) {
+      (*this)[pair.first] = pair.second;
+    }
+  }
+#endif
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Wire Format
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Write the registers in key order, as index deltas and values.
+   */
+  void pack(krowkee::util::wire_writer &writer) const {
+    const vec_t pairs(sorted());
+    writer.put_sorted_pairs(std::cbegin(pairs), std::cend(pairs),
+                            pairs.size());
+  }
+
+  /**
+   * Replace the contents with packed registers.
+   */
+  void unpack(krowkee::util::wire_reader &reader) {
+    vec_t pairs;
+    reader.get_sorted_pairs<KeyType, ValueType>(
+        [&](const KeyType key, const ValueType val) {
+          pairs.emplace_back(key, val);
+        });
+    _size = 0;
+    _allocate(_capacity_for(std::max(pairs.size(), _compaction_threshold)));
+    for (const pair_t &pair : pairs) {
+      (*this)[pair.first] = pair.second;
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Getters
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr std::size_t size() const { return _size; }
+
+  constexpr bool empty() const { return _size == 0; }
+
+  constexpr std::size_t capacity() const { return _slots.size(); }
+
+  constexpr std::size_t get_compaction_threshold() const {
+    return _compaction_threshold;
+  }
+
+  /**
+   * Estimated bytes per stored register, assuming the table is at its maximum
+   * load.
+   */
+  static constexpr std::size_t entry_bytes() {
+    return (sizeof(pair_t) * max_load_denominator + max_load_numerator - 1) /
+           max_load_numerator;
+  }
+
+  static inline std::string name() { return "open_hash_map"; }
+
+  inline std::string full_name() const {
+    std::stringstream ss;
+    ss << name() << " with capacity " << capacity();
+    return ss.str();
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Compaction
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Hash maps are always compact.
+   */
+  constexpr bool is_compact() const { return true; }
+
+  constexpr void compactify() const {}
+
+  /**
+   * Return the key-value pairs in key order.
+   */
+  vec_t sorted() const {
+    vec_t ret(std::cbegin(*this), std::cend(*this));
+    std::sort(std::begin(ret), std::end(ret),
+              [](const pair_t &lhs, const pair_t &rhs) {
+                return lhs.first < rhs.first;
+              });
+    return ret;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Accessors
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Access an element, inserting a zero value if it is absent.
+   *
+   * Mimicks the behavior of the std::map accessor operator.
+   */
+  ValueType &operator[](const KeyType &key) {
+    std::size_t pos(_home(key));
+    while (_occupied.test(pos) == true) {
+      if (_slots[pos].first == key) {
+        return _slots[pos].second;
+      }
+      pos = _next(pos);
+    }
+    if ((_size + 1) * max_load_denominator >
+        capacity() * max_load_numerator) {
+      _rehash(capacity() * 2);
+      pos = _home(key);
+      while (_occupied.test(pos) == true) {
+        pos = _next(pos);
+      }
+    }
+    _occupied.set(pos);
+    _slots[pos] = pair_t{key, ValueType(0)};
+    ++_size;
+    return _slots[pos].second;
+  }
+
+  /**
+   * Access an element.
+   *
+   * Mimicks the behavior of std::map::at.
+   *
+   * @throws std::out_of_range if the supplied key is not stored.
+   */
+  ValueType &at(const KeyType &key) {
+    const std::size_t pos(_find(key));
+    if (pos == capacity()) {
+      std::stringstream ss;
+      ss << "Key name " << key << " does not exist!";
+      throw std::out_of_range(ss.str());
+    }
+    return _slots[pos].second;
+  }
+
+  const ValueType &at(const KeyType &key) const {
+    return const_cast<ohm_t *>(this)->at(key);
+  }
+
+  /**
+   * Access an element, returning a default if the desired key is not found.
+   */
+  const ValueType &at(const KeyType &key, const ValueType &val) const {
+    const std::size_t pos(_find(key));
+    return (pos == capacity()) ? val : _slots[pos].second;
+  }
+
+  iterator find(const KeyType &key) { return iterator(this, _find(key)); }
+
+  const_iterator find(const KeyType &key) const {
+    return const_iterator(this, _find(key));
+  }
+
+  /**
+   * Insert a key-value pair unless the key is already stored.
+   *
+   * Mimicks the behavior of std::map::insert.
+   */
+  std::pair<iterator, bool> insert(const pair_t &pair) {
+    const std::size_t old_size(_size);
+    ValueType        &val((*this)[pair.first]);
+    if (_size == old_size) {
+      return {find(pair.first), false};
+    }
+    val = pair.second;
+    return {find(pair.first), true};
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Erase
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Erase a key, if found, by shifting the rest of its probe run back.
+   */
+  std::size_t erase(const KeyType &key) {
+    std::size_t hole(_find(key));
+    if (hole == capacity()) {
+      return 0;
+    }
+    const std::size_t mask(capacity() - 1);
+    for (std::size_t pos(_next(hole)); _occupied.test(pos) == true;
+         pos = _next(pos)) {
+      // the entry at `pos` may fill the hole unless its home slot lies
+      // cyclically after the hole
+      const std::size_t home(_home(_slots[pos].first));
+      if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+        _slots[hole] = std::move(_slots[pos]);
+        hole         = pos;
+      }
+    }
+    _occupied.unset(hole);
+    --_size;
+    return 1;
+  }
+
+  void clear() {
+    _occupied.assign(capacity());
+    _size = 0;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Iterators
+  //////////////////////////////////////////////////////////////////////////////
+
+  iterator       begin() { return iterator(this, 0); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator cbegin() const { return begin(); }
+  iterator       end() { return iterator(this, capacity()); }
+  const_iterator end() const { return const_iterator(this, capacity()); }
+  const_iterator cend() const { return end(); }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Merge
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Merge other hash map into `this` using supplied MergeOp to break ties.
+   * Ties whose merged value is zero are erased.
+   */
+  template <typename MergeOp>
+  void merge(const ohm_t &rhs, MergeOp merge_op) {
+    const std::size_t needed(_capacity_for(_size + rhs._size));
+    if (needed > capacity()) {
+      _rehash(needed);
+    }
+    for (const pair_t &pair : rhs) {
+      const std::size_t old_size(_size);
+      ValueType        &val((*this)[pair.first]);
+      if (_size == old_size) {
+        val = merge_op(val, pair.second);
+        if (val == 0) {
+          erase(pair.first);
+        }
+      } else {
+        val = pair.second;
+      }
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Equality operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Maps are equal if they hold the same key-value pairs, in any layout.
+   */
+  bool same_maps(const ohm_t &rhs) const {
+    if (_size != rhs._size) {
+      return false;
+    }
+    for (const pair_t &pair : *this) {
+      const std::size_t pos(rhs._find(pair.first));
+      if (pos == rhs.capacity() || rhs._slots[pos].second != pair.second) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  friend bool operator==(const ohm_t &lhs, const ohm_t &rhs) {
+    return lhs.same_maps(rhs);
+  }
+  friend bool operator!=(const ohm_t &lhs, const ohm_t &rhs) {
+    return !operator==(lhs, rhs);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Swaps
+  //////////////////////////////////////////////////////////////////////////////
+
+  friend void swap(ohm_t &lhs, ohm_t &rhs) noexcept {
+    std::swap(lhs._slots, rhs._slots);
+    swap(lhs._occupied, rhs._occupied);
+    std::swap(lhs._size, rhs._size);
+    std::swap(lhs._shift, rhs._shift);
+    std::swap(lhs._compaction_threshold, rhs._compaction_threshold);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Assignment
+  //////////////////////////////////////////////////////////////////////////////
+  /**
+   * copy-and-swap assignment operator
+   *
+   * https://stackoverflow.com/questions/3279543/what-is-the-copy-and-swap-idiom
+   */
+  ohm_t &operator=(ohm_t rhs) noexcept {
+    swap(*this, rhs);
+    return *this;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // I/O Operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Returns the current state of the data structure to a string.
+   *
+   * @note[bwp]: For debugging only.
+   */
+  std::string print_state() const {
+    std::stringstream ss{};
+    ss << "table (" << _size << "/" << capacity() << "): ";
+    for (const pair_t &pair : sorted()) {
+      ss << "(" << pair.first << "," << pair.second << ") ";
+    }
+    return ss.str();
+  }
+
+ private:
+  /**
+   * Smallest power-of-two capacity holding `count` elements below the maximum
+   * load.
+   */
+  static constexpr std::size_t _capacity_for(const std::size_t count) {
+    std::size_t capacity(min_capacity);
+    while (count * max_load_denominator > capacity * max_load_numerator) {
+      capacity *= 2;
+    }
+    return capacity;
+  }
+
+  inline void _allocate(const std::size_t capacity) {
+    _slots.assign(capacity, pair_t{});
+    _occupied.assign(capacity);
+    _shift = 64 - krowkee::hash::ceil_log2_64(capacity);
+  }
+
+  /**
+   * Fibonacci hashing: the top bits of the key times 2^64 / phi.
+   */
+  inline std::size_t _home(const KeyType &key) const {
+    return std::size_t((std::uint64_t(key) * 0x9e3779b97f4a7c15ull) >> _shift);
+  }
+
+  inline std::size_t _next(const std::size_t pos) const {
+    return (pos + 1) & (capacity() - 1);
+  }
+
+  /**
+   * Return the slot holding `key`, or `capacity()` if it is absent.
+   */
+  inline std::size_t _find(const KeyType &key) const {
+    std::size_t pos(_home(key));
+    while (_occupied.test(pos) == true) {
+      if (_slots[pos].first == key) {
+        return pos;
+      }
+      pos = _next(pos);
+    }
+    return capacity();
+  }
+
+  void _rehash(const std::size_t capacity) {
+    vec_t  old_slots(capacity, pair_t{});
+    bitmap old_occupied(capacity);
+    std::swap(_slots, old_slots);
+    swap(_occupied, old_occupied);
+    _shift = 64 - krowkee::hash::ceil_log2_64(capacity);
+    for (std::size_t pos(old_occupied.find_next(0, true));
+         pos < old_occupied.size();
+         pos = old_occupied.find_next(pos + 1, true)) {
+      std::size_t new_pos(_home(old_slots[pos].first));
+      while (_occupied.test(new_pos) == true) {
+        new_pos = _next(new_pos);
+      }
+      _occupied.set(new_pos);
+      _slots[new_pos] = std::move(old_slots[pos]);
+    }
+  }
+};
+
+}  // namespace container
+}  // namespace krowkee
+
+#endif
@@ -0,0 +1,800 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_CONTAINER_SOA_COMPACTING_MAP_HPP
+#define _KROWKEE_CONTAINER_SOA_COMPACTING_MAP_HPP
+
+#include <krowkee/container/bitmap.hpp>
+#include <krowkee/container/staging_buffer.hpp>
+
+#include <krowkee/hash/util.hpp>
+#include <krowkee/util/counters.hpp>
+#include <krowkee/util/wire.hpp>
+
+#if __has_include(<cereal/types/vector.hpp>)
+#include <cereal/types/vector.hpp>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace krowkee {
+namespace container {
+
+////////////////////////////////////////////////////////////////////////////////
+// Key Array Search
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Below this many keys, `key_lower_bound` switches from bisection to a
+ * counting scan.
+ */
+constexpr std::size_t key_scan_width = 32;
+
+/**
+ * Return the index of the first of the `size` sorted keys at `keys` that is
+ * not less than `key`.
+ *
+ * Bisects branchlessly, prefetching both candidate next probes, until at most
+ * `key_scan_width` candidates remain, then counts the candidates less than
+ * `key`. The counting loop touches only keys, has no data-dependent branches,
+ * and is vectorized by the compiler.
+ *
+ * CURRENTLY NOT PORTABLE. Uses `__builtin_prefetch`.
+ */
+template <typename KeyType>
+inline std::size_t key_lower_bound(const KeyType *keys, std::size_t size,
+                                   const KeyType &key) {
+  const KeyType *base(keys);
+  while (size > key_scan_width) {
+    const std::size_t half(size / 2);
+    // fetch both possible next probes while this one resolves
+    __builtin_prefetch(base + half / 2);
+    __builtin_prefetch(base + half + half / 2);
+    base = (base[half] < key) ? base + half : base;
+    size -= half;
+  }
+  std::size_t offset(0);
+  for (std::size_t i(0); i < size; ++i) {
+    offset += std::size_t(base[i] < key);
+  }
+  return std::size_t(base - keys) + offset;
+}
+
+/**
+ * Key array counterpart of `gallop_lower_bound`.
+ */
+template <typename KeyType>
+inline std::size_t gallop_key_lower_bound(const KeyType    *keys,
+                                          const std::size_t first,
+                                          const std::size_t last,
+                                          const KeyType    &key) {
+  const std::size_t length(last - first);
+  std::size_t       lo(0);
+  std::size_t       hi(1);
+  while (hi < length && keys[first + hi] < key) {
+    lo = hi;
+    hi *= 2;
+  }
+  const std::size_t bound(std::min(hi, length));
+  return first + lo + key_lower_bound(keys + first + lo, bound - lo, key);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Iterator
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Random access iterator over parallel key and value arrays.
+ *
+ * Dereferencing yields a pair of references, `first` to the (const) key and
+ * `second` to the value, so that code written against iterators over
+ * `std::pair<KeyType, ValueType>` works unchanged.
+ */
+template <typename KeyType, typename ValueType, bool IsConst>
+class soa_iterator {
+ public:
+  typedef std::conditional_t<IsConst, const ValueType, ValueType> val_t;
+  typedef std::random_access_iterator_tag     iterator_category;
+  typedef std::pair<KeyType, ValueType>       value_type;
+  typedef std::ptrdiff_t                      difference_type;
+  typedef std::pair<const KeyType &, val_t &> reference;
+
+  struct pointer {
+    reference  ref;
+    reference *operator->() { return &ref; }
+  };
+
+ private:
+  const KeyType *_key;
+  val_t         *_value;
+
+ public:
+  soa_iterator() : _key(nullptr), _value(nullptr) {}
+
+  soa_iterator(const KeyType *key, val_t *value) : _key(key), _value(value) {}
+
+  template <bool RhsConst, typename = std::enable_if_t<IsConst && !RhsConst>>
+  soa_iterator(const soa_iterator<KeyType, ValueType, RhsConst> &rhs)
+      : _key(rhs.key_ptr()), _value(rhs.value_ptr()) {}
+
+  constexpr const KeyType *key_ptr() const { return _key; }
+  constexpr val_t         *value_ptr() const { return _value; }
+
+  reference operator*() const { return reference(*_key, *_value); }
+  pointer   operator->() const { return pointer{**this}; }
+  reference operator[](const difference_type n) const { return *(*this + n); }
+
+  soa_iterator &operator++() {
+    ++_key;
+    ++_value;
+    return *this;
+  }
+  soa_iterator operator++(int) {
+    soa_iterator ret(*this);
+    ++(*this);
+    return ret;
+  }
+  soa_iterator &operator--() {
+    --_key;
+    --_value;
+    return *this;
+  }
+  soa_iterator operator--(int) {
+    soa_iterator ret(*this);
+    --(*this);
+    return ret;
+  }
+  soa_iterator &operator+=(const difference_type n) {
+    _key += n;
+    _value += n;
+    return *this;
+  }
+  soa_iterator &operator-=(const difference_type n) { return *this += -n; }
+
+  friend soa_iterator operator+(soa_iterator iter, const difference_type n) {
+    return iter += n;
+  }
+  friend soa_iterator operator+(const difference_type n, soa_iterator iter) {
+    return iter += n;
+  }
+  friend soa_iterator operator-(soa_iterator iter, const difference_type n) {
+    return iter -= n;
+  }
+  friend difference_type operator-(const soa_iterator &lhs,
+                                   const soa_iterator &rhs) {
+    return lhs._key - rhs._key;
+  }
+
+  friend bool operator==(const soa_iterator &lhs, const soa_iterator &rhs) {
+    return lhs._key == rhs._key;
+  }
+  friend bool operator!=(const soa_iterator &lhs, const soa_iterator &rhs) {
+    return lhs._key != rhs._key;
+  }
+  friend bool operator<(const soa_iterator &lhs, const soa_iterator &rhs) {
+    return lhs._key < rhs._key;
+  }
+  friend bool operator>(const soa_iterator &lhs, const soa_iterator &rhs) {
+    return lhs._key > rhs._key;
+  }
+  friend bool operator<=(const soa_iterator &lhs, const soa_iterator &rhs) {
+    return lhs._key <= rhs._key;
+  }
+  friend bool operator>=(const soa_iterator &lhs, const soa_iterator &rhs) {
+    return lhs._key >= rhs._key;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Structure-of-Arrays Compacting Map
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Structure-of-arrays variant of compacting_map.
+ *
+ * Stores the archive as separate sorted key and value vectors rather than a
+ * vector of pairs. With narrow registers this avoids the padding of
+ * `std::pair<KeyType, ValueType>` (e.g. 8 bytes per `<std::uint32_t,
+ * std::int8_t>` pair, versus 5), and lookups search the dense key array alone
+ * without pulling values through the cache.
+ *
+ * Insertion, erasure and compaction follow compacting_map: new keys are staged
+ * in a small MapType instance, erased archive slots are marked in a bitmap,
+ * and both are folded into the archive by `compactify`. Iteration is only
+ * meaningful on a compacted map.
+ */
+template <typename KeyType, typename ValueType,
+          template <typename, typename> class MapType = std::map>
+class soa_compacting_map {
+ public:
+  typedef std::pair<KeyType, ValueType>                          pair_t;
+  typedef std::vector<KeyType>                                   key_vec_t;
+  typedef std::vector<ValueType>                                 value_vec_t;
+  typedef MapType<KeyType, ValueType>                            map_t;
+  typedef soa_iterator<KeyType, ValueType, false>                iterator;
+  typedef soa_iterator<KeyType, ValueType, true>                 const_iterator;
+  typedef iterator                                               vec_iter_t;
+  typedef const_iterator                                         vec_citer_t;
+  typedef soa_compacting_map<KeyType, ValueType, MapType>        cm_t;
+
+  /**
+   * `merge` works in place when the right hand side has at most this many
+   * times fewer elements than the left hand side.
+   */
+  static constexpr std::size_t in_place_merge_ratio = 8;
+
+ protected:
+  bitmap      _erased;
+  key_vec_t   _keys;
+  value_vec_t _values;
+  map_t       _dynamic_map;
+  std::size_t _compaction_threshold;
+  int         _erased_count;
+
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  // Constructors
+  //////////////////////////////////////////////////////////////////////////////
+
+  soa_compacting_map(std::size_t compaction_threshold)
+      : _compaction_threshold(compaction_threshold), _erased_count(0) {
+    _keys.reserve(_compaction_threshold);
+    _values.reserve(_compaction_threshold);
+    _erased.reserve(_compaction_threshold);
+    if constexpr (is_staging_buffer<map_t>::value) {
+      _dynamic_map.reserve(_compaction_threshold);
+    }
+  }
+
+  soa_compacting_map(const cm_t &rhs)
+      : _erased(rhs._erased),
+        _keys(rhs._keys),
+        _values(rhs._values),
+        _dynamic_map(rhs._dynamic_map),
+        _compaction_threshold(rhs._compaction_threshold),
+        _erased_count(rhs._erased_count) {}
+
+  soa_compacting_map(cm_t &&rhs) noexcept
+      : _erased(std::move(rhs._erased)),
+        _keys(std::move(rhs._keys)),
+        _values(std::move(rhs._values)),
+        _dynamic_map(std::move(rhs._dynamic_map)),
+        _compaction_threshold(rhs._compaction_threshold),
+        _erased_count(rhs._erased_count) {
+    rhs._erased_count = 0;
+  }
+
+  soa_compacting_map() : _compaction_threshold(0), _erased_count(0) {}
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Cereal Archives
+  //////////////////////////////////////////////////////////////////////////////
+
+#if __has_include(<cereal/types/vector.hpp>)
+  template <class Archive>
+  void save(Archive &archive) const {
+    if (is_compact() != true) {
+      throw std::logic_error(
+          "Incorrectly trying to archive a non-compact map!");
+    }
+    archive(_compaction_threshold, _keys, _values);
+  }
+
+  template <class Archive>
+  void load(Archive &archive) {
+    archive(_compaction_threshold, _keys, _values);
+    _erased.assign(_keys.size());
+    _erased_count = 0;
+    if constexpr (is_staging_buffer<map_t>::value) {
+      _dynamic_map.reserve(_compaction_threshold);
+    }
+  }
+#endif
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Wire Format
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Write the archive as index deltas and values.
+   *
+   * @throw std::logic_error if invoked on uncompacted maps.
+   */
+  void pack(krowkee::util::wire_writer &writer) const {
+    if (is_compact() != true) {
+      throw std::logic_error("Incorrectly trying to pack a non-compact map!");
+    }
+    writer.put_varint(_keys.size());
+    std::uint64_t prev(0);
+    for (std::size_t i(0); i < _keys.size(); ++i) {
+      writer.put_varint(std::uint64_t(_keys[i]) - prev);
+      prev = _keys[i];
+    }
+    writer.put_array(_values.data(), _values.size());
+  }
+
+  /**
+   * Replace the contents with packed registers, keeping the compaction
+   * threshold.
+   */
+  void unpack(krowkee::util::wire_reader &reader) {
+    _dynamic_map.clear();
+    _keys.resize(reader.get_varint());
+    std::uint64_t key(0);
+    for (std::size_t i(0); i < _keys.size(); ++i) {
+      key += reader.get_varint();
+      _keys[i] = KeyType(key);
+    }
+    _values = reader.get_array<ValueType>();
+    if (_values.size() != _keys.size()) {
+      throw std::out_of_range("error: mismatched keys and values in wire "
+                              "message!");
+    }
+    _erased.assign(_keys.size());
+    _erased_count = 0;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Getters
+  //////////////////////////////////////////////////////////////////////////////
+
+  inline std::size_t size() const { return _keys.size() + _dynamic_map.size(); }
+
+  inline bool is_compact() const {
+    return _dynamic_map.size() == 0 && _erased_count == 0;
+  }
+
+  constexpr std::size_t get_compaction_threshold() const {
+    return _compaction_threshold;
+  }
+
+  inline std::size_t erased_count() const { return _erased_count; }
+
+  /**
+   * Bytes of archive storage in use, excluding the staging map.
+   */
+  inline std::size_t archive_bytes() const {
+    return _keys.size() * sizeof(KeyType) + _values.size() * sizeof(ValueType);
+  }
+
+  static inline std::string name() { return "soa_compacting_map"; }
+
+  inline std::string full_name() const {
+    std::stringstream ss;
+    ss << name() << " using " << krowkee::hash::type_name<map_t>()
+       << " with threshold " << _compaction_threshold;
+    return ss.str();
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Compaction
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Fold the staging map into the archive arrays, clearing deleted items along
+   * the way.
+   *
+   * Same scheme as compacting_map::compactify, applied to both arrays: live
+   * runs are shifted down over erased slots, then the staged entries are
+   * merged in from the back.
+   */
+  void compactify() {
+    if (is_compact()) {
+      return;
+    }
+    KROWKEE_COUNT_TIME(compaction_ns);
+    KROWKEE_COUNT(compactions, 1);
+    const std::size_t live(_shift_out_erased());
+    if constexpr (is_staging_buffer<map_t>::value) {
+      _dynamic_map.sort();
+    }
+    std::size_t out(live + _dynamic_map.size());
+    _keys.resize(out);
+    _values.resize(out);
+    std::size_t axv(live);
+    for (auto dyn_itr(_dynamic_map.rbegin()); dyn_itr != _dynamic_map.rend();) {
+      --out;
+      if (axv > 0 && dyn_itr->first < _keys[axv - 1]) {
+        --axv;
+        _keys[out]   = _keys[axv];
+        _values[out] = std::move(_values[axv]);
+      } else {
+        _keys[out]   = dyn_itr->first;
+        _values[out] = dyn_itr->second;
+        ++dyn_itr;
+      }
+    }
+    KROWKEE_COUNT(compaction_moves, live - axv + _dynamic_map.size());
+    _dynamic_map.clear();
+    _erased.assign(_keys.size());
+    _erased_count = 0;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Accessors
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Access an element.
+   *
+   * Mimicks the behavior of the std::map accessor operator.
+   */
+  ValueType &operator[](const KeyType &key) {
+    auto dyn_iter(_dynamic_map.find(key));
+    if (dyn_iter != std::end(_dynamic_map)) {
+      return dyn_iter->second;
+    }
+    const std::size_t offset(archive_lower_bound(key));
+    if (offset < _keys.size() && _keys[offset] == key) {
+      if (_erased.test(offset) == true) {
+        _values[offset] = 0;
+        _erased.unset(offset);
+        --_erased_count;
+      }
+      return _values[offset];
+    }
+    auto [new_iter, success] =
+        _dynamic_map.insert(std::make_pair(key, ValueType(0)));
+    if (_dynamic_map.size() == _compaction_threshold) {
+      compactify();
+      return _values[archive_lower_bound(key)];
+    }
+    return new_iter->second;
+  }
+
+  /**
+   * Access an element.
+   *
+   * Mimicks the behavior of std::map::at. Throws an error if the supplied key
+   * is not already stored or is erased.
+   */
+  ValueType &at(const KeyType &key) {
+    auto dyn_iter(_dynamic_map.find(key));
+    if (dyn_iter != std::end(_dynamic_map)) {
+      return dyn_iter->second;
+    }
+    const std::size_t offset(_archive_find(key));
+    if (offset == _keys.size()) {
+      std::stringstream ss;
+      ss << "Key name " << key << " does not exist!";
+      throw std::out_of_range(ss.str());
+    }
+    return _values[offset];
+  }
+
+  /**
+   * Access an element, returning a default if the desired key is not found.
+   */
+  const ValueType &at(const KeyType &key, const ValueType &val) const {
+    auto dyn_iter(_dynamic_map.find(key));
+    if (dyn_iter != std::end(_dynamic_map)) {
+      return dyn_iter->second;
+    }
+    const std::size_t offset(_archive_find(key));
+    return (offset == _keys.size()) ? val : _values[offset];
+  }
+
+  /**
+   * Return the archive index of the first key not less than `key`, ignoring
+   * erasures and the staging map.
+   */
+  inline std::size_t archive_lower_bound(const KeyType &key) const {
+    return key_lower_bound(_keys.data(), _keys.size(), key);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Erase
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Erases a given key, if found.
+   *
+   * Erases they key directly if found in the dynamic map. Instead sets the
+   * corresponding bit of the _erased bitmap if found in the archive.
+   */
+  std::size_t erase(const KeyType &key) {
+    std::size_t erase_count(_dynamic_map.erase(key));
+    if (erase_count > 0) {
+      return erase_count;
+    }
+    const std::size_t offset(_archive_find(key));
+    if (offset == _keys.size()) {
+      return 0;
+    }
+    _erased.set(offset);
+    ++_erased_count;
+    return 1;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Iterators
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Iterators over the archive arrays.
+   *
+   * @note[bwp]: currently not compact safe!
+   */
+  iterator begin() { return iterator(_keys.data(), _values.data()); }
+  const_iterator begin() const {
+    return const_iterator(_keys.data(), _values.data());
+  }
+  const_iterator cbegin() const { return begin(); }
+  iterator       end() {
+    return iterator(_keys.data() + _keys.size(),
+                    _values.data() + _values.size());
+  }
+  const_iterator end() const {
+    return const_iterator(_keys.data() + _keys.size(),
+                          _values.data() + _values.size());
+  }
+  const_iterator cend() const { return end(); }
+
+  /**
+   * The sorted archive keys, for bulk key-only processing.
+   */
+  constexpr const key_vec_t &keys() const { return _keys; }
+
+  /**
+   * The archive values, in the order of `keys()`.
+   */
+  constexpr const value_vec_t &values() const { return _values; }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Equality operators
+  //////////////////////////////////////////////////////////////////////////////
+  bool same_maps(const cm_t &rhs) const {
+    return _compaction_threshold == rhs._compaction_threshold &&
+           _erased_count == rhs._erased_count && _erased == rhs._erased &&
+           _keys == rhs._keys && _values == rhs._values &&
+           _dynamic_map.size() == rhs._dynamic_map.size() &&
+           std::equal(std::cbegin(_dynamic_map), std::cend(_dynamic_map),
+                      std::cbegin(rhs._dynamic_map));
+  }
+
+  friend bool operator==(const cm_t &lhs, const cm_t &rhs) {
+    return lhs.same_maps(rhs);
+  }
+  friend bool operator!=(const cm_t &lhs, const cm_t &rhs) {
+    return !operator==(lhs, rhs);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Swaps
+  //////////////////////////////////////////////////////////////////////////////
+
+  friend void swap(cm_t &lhs, cm_t &rhs) noexcept {
+    std::swap(lhs._compaction_threshold, rhs._compaction_threshold);
+    std::swap(lhs._erased_count, rhs._erased_count);
+    std::swap(lhs._dynamic_map, rhs._dynamic_map);
+    std::swap(lhs._erased, rhs._erased);
+    std::swap(lhs._keys, rhs._keys);
+    std::swap(lhs._values, rhs._values);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Assignment
+  //////////////////////////////////////////////////////////////////////////////
+  /**
+   * copy-and-swap assignment operator
+   *
+   * https://stackoverflow.com/questions/3279543/what-is-the-copy-and-swap-idiom
+   */
+  cm_t &operator=(cm_t rhs) noexcept {
+    swap(*this, rhs);
+    return *this;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Merge
+  //////////////////////////////////////////////////////////////////////////////
+  /**
+   * Merge other map into `this` using supplied MergeOp to break ties. Ties
+   * whose merged value is zero are dropped.
+   *
+   * Runs of keys found on only one side are located by galloping over the key
+   * arrays and copied as blocks. If `rhs` holds at most
+   * `1 / in_place_merge_ratio` as many elements as `this`, the merge happens
+   * in place as in compacting_map::merge.
+   *
+   * @param rhs the other soa_compacting_map.
+   *
+   * @throw std::logic_error if invoked on uncompacted maps.
+   */
+  template <typename MergeOp>
+  void merge(const cm_t &rhs, MergeOp merge_op) {
+    if (is_compact() == false) {
+      throw std::logic_error(
+          "Bad attempt to merge on uncompacted left hand side!");
+    }
+    if (rhs.is_compact() == false) {
+      throw std::logic_error(
+          "Bad attempt to merge on uncompacted right hand side!");
+    }
+    if (rhs._keys.size() * in_place_merge_ratio <= _keys.size()) {
+      _merge_in_place(rhs, merge_op);
+      return;
+    }
+    const KeyType    *lk(_keys.data());
+    const KeyType    *rk(rhs._keys.data());
+    const std::size_t ln(_keys.size());
+    const std::size_t rn(rhs._keys.size());
+    key_vec_t         keys;
+    value_vec_t       values;
+    keys.reserve(ln + rn);
+    values.reserve(ln + rn);
+    auto append = [&](const cm_t &src, const std::size_t first,
+                      const std::size_t last) {
+      keys.insert(std::end(keys), std::cbegin(src._keys) + first,
+                  std::cbegin(src._keys) + last);
+      values.insert(std::end(values), std::cbegin(src._values) + first,
+                    std::cbegin(src._values) + last);
+    };
+    std::size_t li(0);
+    std::size_t ri(0);
+    while (li < ln && ri < rn) {
+      if (lk[li] < rk[ri]) {
+        const std::size_t run_end(
+            gallop_key_lower_bound(lk, li + 1, ln, rk[ri]));
+        append(*this, li, run_end);
+        li = run_end;
+      } else if (rk[ri] < lk[li]) {
+        const std::size_t run_end(
+            gallop_key_lower_bound(rk, ri + 1, rn, lk[li]));
+        append(rhs, ri, run_end);
+        ri = run_end;
+      } else {
+        const ValueType ret(merge_op(_values[li], rhs._values[ri]));
+        if (ret != 0) {
+          keys.push_back(lk[li]);
+          values.push_back(ret);
+        }
+        ++li;
+        ++ri;
+      }
+    }
+    append(*this, li, ln);
+    append(rhs, ri, rn);
+    std::swap(_keys, keys);
+    std::swap(_values, values);
+    _erased.assign(_keys.size());
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // I/O Operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Returns the current state of the data structure to a string.
+   *
+   * @note[bwp]: For debugging only.
+   */
+  std::string print_state() const {
+    std::stringstream ss{};
+    ss << "axv (" << _keys.size() << "): ";
+    for (std::size_t i(0); i < _keys.size(); ++i) {
+      ss << "(" << _keys[i] << "," << _values[i] << ") ";
+    }
+    ss << '\n';
+    ss << "dyn (" << _dynamic_map.size() << "): ";
+    for (auto iter(std::begin(_dynamic_map)); iter != std::end(_dynamic_map);
+         ++iter) {
+      ss << "(" << iter->first << "," << iter->second << ") ";
+    }
+    ss << '\n';
+    ss << "cmp: ";
+    ss << _compaction_threshold;
+    return ss.str();
+  }
+
+ private:
+  /**
+   * Return the archive index of `key`, or `_keys.size()` if it is absent or
+   * erased.
+   */
+  inline std::size_t _archive_find(const KeyType &key) const {
+    const std::size_t offset(archive_lower_bound(key));
+    if (offset < _keys.size() && _keys[offset] == key &&
+        _erased.test(offset) == false) {
+      return offset;
+    }
+    return _keys.size();
+  }
+
+  /**
+   * Move runs of live archive elements down over erased slots, without
+   * resizing the arrays.
+   *
+   * @return the number of live elements.
+   */
+  inline std::size_t _shift_out_erased() {
+    if (_erased_count == 0) {
+      return _keys.size();
+    }
+    KROWKEE_COUNT(tombstones, _erased_count);
+    std::size_t live(_erased.find_next(0, true));
+    std::size_t run_begin(live);
+    while (run_begin != _erased.size()) {
+      run_begin = _erased.find_next(run_begin, false);
+      const std::size_t run_end(_erased.find_next(run_begin, true));
+      std::move(std::begin(_keys) + run_begin, std::begin(_keys) + run_end,
+                std::begin(_keys) + live);
+      std::move(std::begin(_values) + run_begin, std::begin(_values) + run_end,
+                std::begin(_values) + live);
+      KROWKEE_COUNT(compaction_moves, run_end - run_begin);
+      live += run_end - run_begin;
+      run_begin = run_end;
+    }
+    return live;
+  }
+
+  /**
+   * Merge a (much smaller) compact map directly into the archive arrays.
+   *
+   * See compacting_map::_merge_in_place.
+   */
+  template <typename MergeOp>
+  void _merge_in_place(const cm_t &rhs, MergeOp merge_op) {
+    const std::size_t ln(_keys.size());
+    std::size_t       lb(0);
+    std::size_t       insert_count(0);
+    for (const KeyType &key : rhs._keys) {
+      lb = gallop_key_lower_bound(_keys.data(), lb, ln, key);
+      if (lb == ln || _keys[lb] != key) {
+        ++insert_count;
+      }
+    }
+    std::size_t axv(ln);
+    std::size_t out(ln + insert_count);
+    _keys.resize(out);
+    _values.resize(out);
+    _erased.assign(out);
+    for (std::size_t ri(rhs._keys.size()); ri-- > 0;) {
+      const KeyType    &key(rhs._keys[ri]);
+      const std::size_t run_begin(
+          std::upper_bound(std::cbegin(_keys), std::cbegin(_keys) + axv, key) -
+          std::cbegin(_keys));
+      std::move_backward(std::begin(_keys) + run_begin,
+                         std::begin(_keys) + axv, std::begin(_keys) + out);
+      std::move_backward(std::begin(_values) + run_begin,
+                         std::begin(_values) + axv, std::begin(_values) + out);
+      out -= axv - run_begin;
+      axv = run_begin;
+      --out;
+      if (axv > 0 && _keys[axv - 1] == key) {
+        --axv;
+        _keys[out]   = key;
+        _values[out] = merge_op(_values[axv], rhs._values[ri]);
+        if (_values[out] == 0) {
+          _erased.set(out);
+          ++_erased_count;
+        }
+      } else {
+        _keys[out]   = key;
+        _values[out] = rhs._values[ri];
+      }
+    }
+    if (_erased_count > 0) {
+      const std::size_t live(_shift_out_erased());
+      _keys.resize(live);
+      _values.resize(live);
+      _erased.assign(live);
+      _erased_count = 0;
+    }
+  }
+};
+
+}  // namespace container
+}  // namespace krowkee
+
+#endif
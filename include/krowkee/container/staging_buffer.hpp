@@ -0,0 +1,284 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_CONTAINER_STAGING_BUFFER_HPP
+#define _KROWKEE_CONTAINER_STAGING_BUFFER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace krowkee {
+namespace container {
+
+////////////////////////////////////////////////////////////////////////////////
+// Radix Sort
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Below this many elements `sort_by_key` defers to `std::sort`.
+ */
+constexpr std::size_t radix_sort_cutoff = 64;
+
+/**
+ * Sort a vector of key-value pairs by key.
+ *
+ * Integer keys are sorted with an LSD radix sort over bytes. All byte
+ * histograms are gathered in a single pass, and passes in which every key has
+ * the same byte are skipped, so that small keys in wide integer types only pay
+ * for the bytes that vary. Other key types, and short inputs, use `std::sort`.
+ *
+ * @param data the pairs to be sorted.
+ * @param scratch buffer used by the radix sort. Its contents are unspecified
+ *     on return, but its storage is reused across calls.
+ */
+template <typename KeyType, typename ValueType>
+void sort_by_key(std::vector<std::pair<KeyType, ValueType>> &data,
+                 std::vector<std::pair<KeyType, ValueType>> &scratch) {
+  typedef std::pair<KeyType, ValueType> pair_t;
+  if constexpr (std::is_integral_v<KeyType> && !std::is_same_v<KeyType, bool>) {
+    typedef std::make_unsigned_t<KeyType> ukey_t;
+    constexpr std::size_t digit_count(sizeof(KeyType));
+    // map signed keys onto unsigned keys with the same order
+    constexpr ukey_t sign_flip(std::is_signed_v<KeyType>
+                                   ? ukey_t(1) << (8 * digit_count - 1)
+                                   : ukey_t(0));
+    const std::size_t n(data.size());
+    if (n < radix_sort_cutoff) {
+      std::sort(std::begin(data), std::end(data),
+                [](const pair_t &lhs, const pair_t &rhs) {
+                  return lhs.first < rhs.first;
+                });
+      return;
+    }
+    auto digit = [](const KeyType key, const std::size_t d) {
+      return (ukey_t(ukey_t(key) ^ sign_flip) >> (8 * d)) & ukey_t(0xff);
+    };
+    std::array<std::array<std::size_t, 256>, digit_count> counts{};
+    for (const pair_t &pair : data) {
+      for (std::size_t d(0); d < digit_count; ++d) {
+        ++counts[d][digit(pair.first, d)];
+      }
+    }
+    // keep the capacity of both buffers in step, as they trade places
+    scratch.reserve(data.capacity());
+    scratch.resize(n);
+    bool in_data(true);
+    for (std::size_t d(0); d < digit_count; ++d) {
+      std::array<std::size_t, 256> &offsets(counts[d]);
+      if (offsets[digit(data.front().first, d)] == n) {
+        continue;
+      }
+      std::size_t total(0);
+      for (std::size_t &offset : offsets) {
+        const std::size_t count(offset);
+        offset = total;
+        total += count;
+      }
+      const auto &src(in_data ? data : scratch);
+      auto       &dst(in_data ? scratch : data);
+      for (const pair_t &pair : src) {
+        dst[offsets[digit(pair.first, d)]++] = pair;
+      }
+      in_data = !in_data;
+    }
+    if (in_data == false) {
+      std::swap(data, scratch);
+    }
+  } else {
+    std::sort(std::begin(data), std::end(data),
+              [](const pair_t &lhs, const pair_t &rhs) {
+                return lhs.first < rhs.first;
+              });
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Staging Buffer
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Append-only staging area for compacting_map.
+ *
+ * Drop-in replacement for the `MapType` of a compacting_map. New keys are
+ * appended to an unsorted vector whose storage is reserved up front, so that
+ * staging an insert never allocates. Lookups are linear scans over contiguous
+ * memory, which beat node-based maps for the small compaction thresholds
+ * (up to a few hundred) this is intended for. The buffer is sorted as a batch
+ * via `sort()`, which compacting_map calls just before merging the staged keys
+ * into its archive.
+ *
+ * Iteration is in key order only directly after a call to `sort()`.
+ */
+template <typename KeyType, typename ValueType>
+class staging_buffer {
+ public:
+  typedef KeyType                                key_type;
+  typedef ValueType                              mapped_type;
+  typedef std::pair<KeyType, ValueType>          value_type;
+  typedef std::vector<value_type>                vec_t;
+  typedef typename vec_t::iterator               iterator;
+  typedef typename vec_t::const_iterator         const_iterator;
+  typedef typename vec_t::reverse_iterator       reverse_iterator;
+  typedef typename vec_t::const_reverse_iterator const_reverse_iterator;
+  typedef staging_buffer<KeyType, ValueType>     sb_t;
+
+ private:
+  vec_t _buffer;
+  vec_t _scratch;
+
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  // Constructors
+  //////////////////////////////////////////////////////////////////////////////
+
+  staging_buffer() {}
+
+  /**
+   * Copy constructor. Preserves the reserved capacity of `rhs`.
+   */
+  staging_buffer(const sb_t &rhs) {
+    _buffer.reserve(rhs._buffer.capacity());
+    _buffer.assign(std::cbegin(rhs._buffer), std::cend(rhs._buffer));
+  }
+
+  staging_buffer(sb_t &&rhs) noexcept
+      : _buffer(std::move(rhs._buffer)), _scratch(std::move(rhs._scratch)) {}
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Capacity
+  //////////////////////////////////////////////////////////////////////////////
+
+  inline void reserve(const std::size_t capacity) {
+    _buffer.reserve(capacity);
+  }
+
+  inline std::size_t size() const { return _buffer.size(); }
+
+  inline bool empty() const { return _buffer.empty(); }
+
+  inline void clear() { _buffer.clear(); }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Lookup and Modifiers
+  //////////////////////////////////////////////////////////////////////////////
+
+  inline iterator find(const KeyType &key) {
+    return std::find_if(std::begin(_buffer), std::end(_buffer),
+                        [&](const value_type &pair) {
+                          return pair.first == key;
+                        });
+  }
+
+  inline const_iterator find(const KeyType &key) const {
+    return std::find_if(std::cbegin(_buffer), std::cend(_buffer),
+                        [&](const value_type &pair) {
+                          return pair.first == key;
+                        });
+  }
+
+  /**
+   * Append a key-value pair unless the key is already staged.
+   *
+   * Mimicks the behavior of std::map::insert.
+   */
+  inline std::pair<iterator, bool> insert(const value_type &pair) {
+    auto iter(find(pair.first));
+    if (iter != std::end(_buffer)) {
+      return {iter, false};
+    }
+    _buffer.push_back(pair);
+    return {std::end(_buffer) - 1, true};
+  }
+
+  /**
+   * Erase a key by swapping the last staged pair into its slot.
+   */
+  inline std::size_t erase(const KeyType &key) {
+    auto iter(find(key));
+    if (iter == std::end(_buffer)) {
+      return 0;
+    }
+    if (iter != std::end(_buffer) - 1) {
+      *iter = std::move(_buffer.back());
+    }
+    _buffer.pop_back();
+    return 1;
+  }
+
+  /**
+   * Sort the staged pairs by key.
+   */
+  inline void sort() { sort_by_key(_buffer, _scratch); }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Iterators
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr iterator       begin() { return std::begin(_buffer); }
+  constexpr const_iterator begin() const { return std::cbegin(_buffer); }
+  constexpr iterator       end() { return std::end(_buffer); }
+  constexpr const_iterator end() const { return std::cend(_buffer); }
+
+  constexpr reverse_iterator rbegin() { return std::rbegin(_buffer); }
+  constexpr const_reverse_iterator rbegin() const {
+    return std::crbegin(_buffer);
+  }
+  constexpr reverse_iterator       rend() { return std::rend(_buffer); }
+  constexpr const_reverse_iterator rend() const { return std::crend(_buffer); }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Equality operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  friend bool operator==(const sb_t &lhs, const sb_t &rhs) {
+    return lhs._buffer == rhs._buffer;
+  }
+  friend bool operator!=(const sb_t &lhs, const sb_t &rhs) {
+    return !operator==(lhs, rhs);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Swaps
+  //////////////////////////////////////////////////////////////////////////////
+
+  friend void swap(sb_t &lhs, sb_t &rhs) noexcept {
+    std::swap(lhs._buffer, rhs._buffer);
+    std::swap(lhs._scratch, rhs._scratch);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Assignment
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * copy-and-swap assignment operator
+   *
+   * https://stackoverflow.com/questions/3279543/what-is-the-copy-and-swap-idiom
+   */
+  sb_t &operator=(sb_t rhs) noexcept {
+    swap(*this, rhs);
+    return *this;
+  }
+};
+
+/**
+ * Trait identifying staging_buffer map types, which compacting_map must
+ * reserve and sort explicitly.
+ */
+template <typename MapType>
+struct is_staging_buffer : std::false_type {};
+
+template <typename KeyType, typename ValueType>
+struct is_staging_buffer<staging_buffer<KeyType, ValueType>> : std::true_type {
+};
+
+}  // namespace container
+}  // namespace krowkee
+
+#endif
@@ -6,6 +6,7 @@
 #ifndef _KROWKEE_HASH_HPP_
 #define _KROWKEE_HASH_HPP_
 
+#include <krowkee/hash/simd.hpp>
 #include <krowkee/hash/util.hpp>
 // #include "xxhash.h"
 
@@ -91,6 +92,21 @@ struct WangHash : public Base {
     return truncate(wang64(std::uint64_t(x)));
   }
 
+  /**
+   * Hash a block of `n` values, writing `out[i] = (*this)(in[i])`.
+   *
+   * Uses the widest vector instruction set enabled at compile time; see
+   * krowkee::hash::simd.
+   *
+   * @param in pointer to the `n` values to be hashed.
+   * @param out pointer to `n` output slots. May alias `in`.
+   * @param n the number of values.
+   */
+  inline void hash_many(const std::uint64_t *in, std::uint64_t *out,
+                        const std::size_t n) const {
+    simd::wang_many(in, out, n, _m);
+  }
+
   /**
    * Print functor name.
    */
@@ -177,6 +193,21 @@ struct MulShift : public Base {
     return truncate(_a * x);
   }
 
+  /**
+   * Hash a block of `n` values, writing `out[i] = (*this)(in[i])`.
+   *
+   * Uses the widest vector instruction set enabled at compile time; see
+   * krowkee::hash::simd.
+   *
+   * @param in pointer to the `n` values to be hashed.
+   * @param out pointer to `n` output slots. May alias `in`.
+   * @param n the number of values.
+   */
+  inline void hash_many(const std::uint64_t *in, std::uint64_t *out,
+                        const std::size_t n) const {
+    simd::mul_shift_many(in, out, n, _a, _m);
+  }
+
   /**
    * Print functor name.
    */
@@ -260,6 +291,21 @@ struct MulAddShift : public Base {
     return truncate(_a * x + _b);
   }
 
+  /**
+   * Hash a block of `n` values, writing `out[i] = (*this)(in[i])`.
+   *
+   * Uses the widest vector instruction set enabled at compile time; see
+   * krowkee::hash::simd.
+   *
+   * @param in pointer to the `n` values to be hashed.
+   * @param out pointer to `n` output slots. May alias `in`.
+   * @param n the number of values.
+   */
+  inline void hash_many(const std::uint64_t *in, std::uint64_t *out,
+                        const std::size_t n) const {
+    simd::mul_add_shift_many(in, out, n, _a, _b, _m);
+  }
+
   /**
    * Print functor name.
    */
@@ -0,0 +1,252 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_HASH_SIMD_HPP
+#define _KROWKEE_HASH_SIMD_HPP
+
+#include <krowkee/hash/util.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+#if !defined(KROWKEE_DISABLE_SIMD)
+#if defined(__AVX512F__) && defined(__AVX512DQ__)
+#define KROWKEE_HASH_SIMD_AVX512
+#include <immintrin.h>
+#elif defined(__AVX2__)
+#define KROWKEE_HASH_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define KROWKEE_HASH_SIMD_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace krowkee {
+namespace hash {
+namespace simd {
+
+/**
+ * Block hashing kernels backing the `hash_many` members of the hash functors.
+ *
+ * The instruction set is chosen at compile time from the target flags (e.g.
+ * `-mavx2`, `-mavx512f -mavx512dq`, or any AArch64 target). Defining
+ * `KROWKEE_DISABLE_SIMD` forces the scalar loops. Every path is bit-identical
+ * to the scalar path, which is in turn bit-identical to the corresponding
+ * functor's `operator()`.
+ *
+ * AVX2 and NEON lack a 64-bit lane multiply, so those paths assemble the low
+ * 64 bits of each product from 32-bit partial products.
+ */
+
+/**
+ * Name of the instruction set used by the block hashing kernels.
+ */
+constexpr const char *isa_name() {
+#if defined(KROWKEE_HASH_SIMD_AVX512)
+  return "AVX-512";
+#elif defined(KROWKEE_HASH_SIMD_AVX2)
+  return "AVX2";
+#elif defined(KROWKEE_HASH_SIMD_NEON)
+  return "NEON";
+#else
+  return "scalar";
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Vector primitives
+//////////////////////////////////////////////////////////////////////////////
+
+#if defined(KROWKEE_HASH_SIMD_AVX512)
+typedef __m512i vec_t;
+constexpr std::size_t lanes = 8;
+
+inline vec_t load(const std::uint64_t *in) {
+  return _mm512_loadu_si512(in);
+}
+inline void store(std::uint64_t *out, const vec_t v) {
+  _mm512_storeu_si512(out, v);
+}
+inline vec_t splat(const std::uint64_t x) {
+  return _mm512_set1_epi64(std::int64_t(x));
+}
+inline vec_t add(const vec_t a, const vec_t b) {
+  return _mm512_add_epi64(a, b);
+}
+inline vec_t bxor(const vec_t a, const vec_t b) {
+  return _mm512_xor_si512(a, b);
+}
+inline vec_t bnot(const vec_t a) {
+  return _mm512_xor_si512(a, _mm512_set1_epi64(-1));
+}
+inline vec_t mullo(const vec_t a, const vec_t b) {
+  return _mm512_mullo_epi64(a, b);
+}
+template <int Shift>
+inline vec_t shl(const vec_t a) {
+  return _mm512_slli_epi64(a, Shift);
+}
+template <int Shift>
+inline vec_t shr(const vec_t a) {
+  return _mm512_srli_epi64(a, Shift);
+}
+inline vec_t shr(const vec_t a, const std::uint64_t shift) {
+  return _mm512_srl_epi64(a, _mm_cvtsi64_si128(std::int64_t(shift)));
+}
+#elif defined(KROWKEE_HASH_SIMD_AVX2)
+typedef __m256i vec_t;
+constexpr std::size_t lanes = 4;
+
+inline vec_t load(const std::uint64_t *in) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in));
+}
+inline void store(std::uint64_t *out, const vec_t v) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), v);
+}
+inline vec_t splat(const std::uint64_t x) {
+  return _mm256_set1_epi64x(std::int64_t(x));
+}
+inline vec_t add(const vec_t a, const vec_t b) {
+  return _mm256_add_epi64(a, b);
+}
+inline vec_t bxor(const vec_t a, const vec_t b) {
+  return _mm256_xor_si256(a, b);
+}
+inline vec_t bnot(const vec_t a) {
+  return _mm256_xor_si256(a, _mm256_set1_epi64x(-1));
+}
+inline vec_t mullo(const vec_t a, const vec_t b) {
+  const vec_t lo_lo(_mm256_mul_epu32(a, b));
+  const vec_t lo_hi(_mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+  const vec_t hi_lo(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b));
+  return _mm256_add_epi64(
+      lo_lo, _mm256_slli_epi64(_mm256_add_epi64(lo_hi, hi_lo), 32));
+}
+template <int Shift>
+inline vec_t shl(const vec_t a) {
+  return _mm256_slli_epi64(a, Shift);
+}
+template <int Shift>
+inline vec_t shr(const vec_t a) {
+  return _mm256_srli_epi64(a, Shift);
+}
+inline vec_t shr(const vec_t a, const std::uint64_t shift) {
+  return _mm256_srl_epi64(a, _mm_cvtsi64_si128(std::int64_t(shift)));
+}
+#elif defined(KROWKEE_HASH_SIMD_NEON)
+typedef uint64x2_t vec_t;
+constexpr std::size_t lanes = 2;
+
+inline vec_t load(const std::uint64_t *in) { return vld1q_u64(in); }
+inline void store(std::uint64_t *out, const vec_t v) { vst1q_u64(out, v); }
+inline vec_t splat(const std::uint64_t x) { return vdupq_n_u64(x); }
+inline vec_t add(const vec_t a, const vec_t b) { return vaddq_u64(a, b); }
+inline vec_t bxor(const vec_t a, const vec_t b) { return veorq_u64(a, b); }
+inline vec_t bnot(const vec_t a) {
+  return vreinterpretq_u64_u32(vmvnq_u32(vreinterpretq_u32_u64(a)));
+}
+inline vec_t mullo(const vec_t a, const vec_t b) {
+  const uint32x2_t a_lo(vmovn_u64(a));
+  const uint32x2_t a_hi(vshrn_n_u64(a, 32));
+  const uint32x2_t b_lo(vmovn_u64(b));
+  const uint32x2_t b_hi(vshrn_n_u64(b, 32));
+  const uint32x2_t cross(
+      vadd_u32(vmul_u32(a_lo, b_hi), vmul_u32(a_hi, b_lo)));
+  return vaddq_u64(vmull_u32(a_lo, b_lo), vshlq_n_u64(vmovl_u32(cross), 32));
+}
+template <int Shift>
+inline vec_t shl(const vec_t a) {
+  return vshlq_n_u64(a, Shift);
+}
+template <int Shift>
+inline vec_t shr(const vec_t a) {
+  return vshrq_n_u64(a, Shift);
+}
+inline vec_t shr(const vec_t a, const std::uint64_t shift) {
+  return vshlq_u64(a, vdupq_n_s64(-std::int64_t(shift)));
+}
+#endif
+
+#if defined(KROWKEE_HASH_SIMD_AVX512) || defined(KROWKEE_HASH_SIMD_AVX2) || \
+    defined(KROWKEE_HASH_SIMD_NEON)
+#define KROWKEE_HASH_SIMD
+
+/**
+ * Lane-wise krowkee::hash::wang64.
+ */
+inline vec_t wang64(const vec_t x) {
+  vec_t y(add(bnot(x), shl<21>(x)));
+  y = bxor(y, shr<24>(y));
+  y = add(add(y, shl<3>(y)), shl<8>(y));
+  y = bxor(y, shr<14>(y));
+  y = add(add(y, shl<2>(y)), shl<4>(y));
+  y = bxor(y, shr<28>(y));
+  return add(y, shl<31>(y));
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+// Block kernels
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Compute `out[i] = (a * in[i]) >> m` for `i` in `[0, n)`.
+ */
+inline void mul_shift_many(const std::uint64_t *in, std::uint64_t *out,
+                           const std::size_t n, const std::uint64_t a,
+                           const std::uint64_t m) {
+  std::size_t i(0);
+#if defined(KROWKEE_HASH_SIMD)
+  const vec_t va(splat(a));
+  for (; i + lanes <= n; i += lanes) {
+    store(out + i, shr(mullo(va, load(in + i)), m));
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] = (a * in[i]) >> m;
+  }
+}
+
+/**
+ * Compute `out[i] = (a * in[i] + b) >> m` for `i` in `[0, n)`.
+ */
+inline void mul_add_shift_many(const std::uint64_t *in, std::uint64_t *out,
+                               const std::size_t n, const std::uint64_t a,
+                               const std::uint64_t b, const std::uint64_t m) {
+  std::size_t i(0);
+#if defined(KROWKEE_HASH_SIMD)
+  const vec_t va(splat(a));
+  const vec_t vb(splat(b));
+  for (; i + lanes <= n; i += lanes) {
+    store(out + i, shr(add(mullo(va, load(in + i)), vb), m));
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] = (a * in[i] + b) >> m;
+  }
+}
+
+/**
+ * Compute `out[i] = wang64(in[i]) >> m` for `i` in `[0, n)`.
+ */
+inline void wang_many(const std::uint64_t *in, std::uint64_t *out,
+                      const std::size_t n, const std::uint64_t m) {
+  std::size_t i(0);
+#if defined(KROWKEE_HASH_SIMD)
+  for (; i + lanes <= n; i += lanes) {
+    store(out + i, shr(simd::wang64(load(in + i)), m));
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] = krowkee::hash::wang64(in[i]) >> m;
+  }
+}
+
+}  // namespace simd
+}  // namespace hash
+}  // namespace krowkee
+
+#endif
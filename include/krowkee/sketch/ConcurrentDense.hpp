@@ -0,0 +1,488 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_SKETCH_CONCURRENTDENSE_HPP
+#define _KROWKEE_SKETCH_CONCURRENTDENSE_HPP
+
+#if __has_include(<cereal/types/vector.hpp>)
+#include <cereal/types/vector.hpp>
+#endif
+
+#include <krowkee/sketch/Dense.hpp>
+#include <krowkee/util/parallel.hpp>
+#include <krowkee/util/wire.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace krowkee {
+namespace sketch {
+
+/**
+ * Dense Sketch Supporting Concurrent Updates
+ *
+ * A drop-in replacement for Dense whose registers may be updated by several
+ * threads at once, so that a single sketch can be fed from a parallel loop
+ * without external locks. Register updates are relaxed atomic adds, so the
+ * merge operation must be `std::plus`.
+ *
+ * Small sketches, whose few registers would be contended by every thread,
+ * keep one replica of the registers per hardware thread. Each thread adds
+ * into its own replica, and the replicas are summed with Dense::merge
+ * whenever the registers are read as a whole. Larger sketches, whose updates
+ * rarely collide, keep a single set of registers.
+ *
+ * Reading registers, merging into `this`, and compaction are not meant to
+ * race with updates; call them once the parallel loop completes.
+ */
+template <typename RegType, typename MergeOp>
+class ConcurrentDense {
+ public:
+  typedef std::atomic<RegType>             atomic_t;
+  typedef Dense<RegType, MergeOp>          dense_t;
+  typedef ConcurrentDense<RegType, MergeOp> cd_t;
+
+  static_assert(std::is_same_v<MergeOp, std::plus<RegType>>,
+                "ConcurrentDense requires additive merges");
+
+  /// sketches of at most this many register bytes keep per-thread replicas
+  static constexpr std::size_t replica_max_bytes = std::size_t(1) << 15;
+  /// replica strides are rounded up to whole cache lines
+  static constexpr std::size_t cache_line_size = 64;
+
+  /**
+   * Reference to one register of the calling thread's replica.
+   *
+   * Sketch functors update a register as `reg = MergeOp()(reg, delta)`. The
+   * reference reads the register once, and applies the assignment as an
+   * atomic add of the difference, so that concurrent updates are not lost.
+   */
+  class reference {
+    atomic_t *_reg;
+    RegType   _observed;
+
+   public:
+    reference(atomic_t &reg)
+        : _reg(&reg), _observed(reg.load(std::memory_order_relaxed)) {}
+
+    operator RegType() const { return _observed; }
+
+    reference &operator=(const RegType val) {
+      _add(*_reg, RegType(val - _observed));
+      _observed = val;
+      return *this;
+    }
+
+    reference &operator=(const reference &rhs) {
+      return operator=(RegType(rhs));
+    }
+
+    reference &operator+=(const RegType val) {
+      return operator=(RegType(_observed + val));
+    }
+  };
+
+ private:
+  /// selects the constructor taking an explicit number of replicas
+  struct replicas_tag {};
+
+  std::size_t                 _size;
+  std::size_t                 _num_replicas;
+  std::size_t                 _stride;  /// registers between replicas
+  std::unique_ptr<atomic_t[]> _registers;
+
+ public:
+  /**
+   * @param range_size the number of registers.
+   *
+   * Additional (ignored) parameters are accepted so that ConcurrentDense
+   * constructs like the other containers.
+   */
+  template <typename... Args>
+  ConcurrentDense(const std::uint64_t range_size, const Args &...)
+      : ConcurrentDense(replicas_tag{}, range_size,
+                        default_replicas(range_size)) {}
+
+  ConcurrentDense(const cd_t &rhs)
+      : ConcurrentDense(replicas_tag{}, rhs._size, rhs._num_replicas) {
+    for (std::size_t i(0); i < _num_replicas * _stride; ++i) {
+      _registers[i].store(rhs._registers[i].load(std::memory_order_relaxed),
+                          std::memory_order_relaxed);
+    }
+  }
+
+  ConcurrentDense(cd_t &&rhs) noexcept
+      : _size(rhs._size),
+        _num_replicas(rhs._num_replicas),
+        _stride(rhs._stride),
+        _registers(std::move(rhs._registers)) {
+    rhs._size         = 0;
+    rhs._num_replicas = 0;
+    rhs._stride       = 0;
+  }
+
+  ConcurrentDense() : _size(0), _num_replicas(0), _stride(0) {}
+
+  /**
+   * Construct with an explicit number of register replicas.
+   *
+   * @param range_size the number of registers.
+   * @param num_replicas the number of replicas. `0` means one per hardware
+   *     thread.
+   */
+  static cd_t with_replicas(const std::uint64_t range_size,
+                            const std::size_t   num_replicas) {
+    return cd_t(replicas_tag{}, range_size,
+                krowkee::util::resolve_num_threads(num_replicas));
+  }
+
+  /**
+   * The number of replicas kept by sketches of `range_size` registers.
+   */
+  static std::size_t default_replicas(const std::uint64_t range_size) {
+    return (range_size * sizeof(RegType) <= replica_max_bytes)
+               ? krowkee::util::resolve_num_threads(0)
+               : 1;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Cereal Archives
+  //////////////////////////////////////////////////////////////////////////////
+
+#if __has_include(<cereal/types/vector.hpp>)
+  template <class Archive>
+  void save(Archive &archive) const {
+    archive(get_registers());
+  }
+
+  template <class Archive>
+  void load(Archive &archive) {
+    std::vector<RegType> registers;
+    archive(registers);
+    _assign(registers);
+  }
+#endif
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Wire Format
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Write the summed registers in the same layout as Dense.
+   */
+  void pack(krowkee::util::wire_writer &writer) const {
+    const std::vector<RegType> registers(get_registers());
+    writer.put_array(registers.data(), registers.size());
+  }
+
+  void unpack(krowkee::util::wire_reader &reader) {
+    _assign(reader.get_array<RegType>());
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Compactify
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Sum the replicas into the first, so that later reads need not.
+   */
+  void compactify() {
+    if (_num_replicas > 1) {
+      _assign(get_registers());
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Erase
+  //////////////////////////////////////////////////////////////////////////////
+
+  inline void erase(const std::uint64_t) {}
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Merge operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Merge other registers into `this`.
+   *
+   * @throws std::invalid_argument if the register sizes do not match.
+   */
+  inline void merge(const cd_t &rhs) {
+    if (size() != rhs.size()) {
+      std::stringstream ss;
+      ss << "error: attempting to merge embedding 1 of dimension " << size()
+         << " with embedding 2 of dimension " << rhs.size();
+      throw std::invalid_argument(ss.str());
+    }
+    const std::vector<RegType> registers(rhs.get_registers());
+    for (std::size_t i(0); i < _size; ++i) {
+      _add(_registers[i], registers[i]);
+    }
+  }
+
+  /**
+   * Merge other registers into `this` with `op` in place of MergeOp, e.g.
+   * `std::minus` to remove the registers of a linear sketch. The change to
+   * each merged register is added to the first replica, so that this must
+   * not race with updates.
+   *
+   * @throws std::invalid_argument if the register sizes do not match.
+   */
+  template <typename Op>
+  void merge_with(const cd_t &rhs, const Op op) {
+    if (size() != rhs.size()) {
+      std::stringstream ss;
+      ss << "error: attempting to merge embedding 1 of dimension " << size()
+         << " with embedding 2 of dimension " << rhs.size();
+      throw std::invalid_argument(ss.str());
+    }
+    const std::vector<RegType> current(get_registers());
+    const std::vector<RegType> registers(rhs.get_registers());
+    for (std::size_t i(0); i < _size; ++i) {
+      _add(_registers[i], RegType(op(current[i], registers[i]) - current[i]));
+    }
+  }
+
+  cd_t &operator+=(const cd_t &rhs) {
+    merge(rhs);
+    return *this;
+  }
+
+  inline friend cd_t operator+(cd_t lhs, const cd_t &rhs) {
+    lhs += rhs;
+    return lhs;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Register Access
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Reference to a register of the calling thread's replica. Safe to update
+   * concurrently.
+   */
+  inline reference operator[](const std::uint64_t index) {
+    return reference(_slot(index));
+  }
+
+  inline RegType operator[](const std::uint64_t index) const {
+    return get(index);
+  }
+
+  /**
+   * Read a register, summed over the replicas.
+   */
+  inline RegType get(const std::uint64_t index) const {
+    RegType ret(0);
+    for (std::size_t replica(0); replica < _num_replicas; ++replica) {
+      ret += _registers[replica * _stride + index].load(
+          std::memory_order_relaxed);
+    }
+    return ret;
+  }
+
+  /**
+   * Sum the replicas into a Dense.
+   */
+  dense_t to_dense() const {
+    dense_t ret(_size);
+    if (_num_replicas == 0) {
+      return ret;
+    }
+    _load(0, ret);
+    dense_t replica(_size);
+    for (std::size_t i(1); i < _num_replicas; ++i) {
+      _load(i, replica);
+      ret.merge(replica);
+    }
+    return ret;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Getters
+  //////////////////////////////////////////////////////////////////////////////
+
+  static inline std::string name() { return "ConcurrentDense"; }
+
+  static inline std::string full_name() { return name(); }
+
+  constexpr bool is_sparse() const { return false; }
+
+  constexpr std::size_t size() const { return _size; }
+
+  constexpr std::size_t reg_size() const { return sizeof(RegType); }
+
+  constexpr std::size_t get_compaction_threshold() const { return 0; }
+
+  constexpr std::size_t num_replicas() const { return _num_replicas; }
+
+  const std::vector<RegType> get_registers() const {
+    return to_dense().get_registers();
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Equality operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Registers are equal if their sums over the replicas are, regardless of
+   * how they are replicated.
+   */
+  bool same_registers(const cd_t &rhs) const {
+    if (_size != rhs._size) {
+      return false;
+    }
+    for (std::size_t i(0); i < _size; ++i) {
+      if (get(i) != rhs.get(i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  friend bool operator==(const cd_t &lhs, const cd_t &rhs) {
+    return lhs.same_registers(rhs);
+  }
+  friend bool operator!=(const cd_t &lhs, const cd_t &rhs) {
+    return !operator==(lhs, rhs);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Swaps
+  //////////////////////////////////////////////////////////////////////////////
+
+  friend void swap(cd_t &lhs, cd_t &rhs) noexcept {
+    std::swap(lhs._size, rhs._size);
+    std::swap(lhs._num_replicas, rhs._num_replicas);
+    std::swap(lhs._stride, rhs._stride);
+    std::swap(lhs._registers, rhs._registers);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Assignment
+  //////////////////////////////////////////////////////////////////////////////
+  /**
+   * copy-and-swap assignment operator
+   *
+   * https://stackoverflow.com/questions/3279543/what-is-the-copy-and-swap-idiom
+   */
+  cd_t &operator=(cd_t rhs) noexcept {
+    swap(*this, rhs);
+    return *this;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // I/O Operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  friend std::ostream &operator<<(std::ostream &os, const cd_t &sk) {
+    os << sk.to_dense();
+    return os;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Accumulation
+  //////////////////////////////////////////////////////////////////////////////
+
+  template <typename RetType>
+  friend RetType accumulate(const cd_t &sk, const RetType init) {
+    return accumulate(sk.to_dense(), init);
+  }
+
+  template <typename Func>
+  friend void for_each(const cd_t &sk, const Func &func) {
+    for_each(sk.to_dense(), func);
+  }
+
+ private:
+  ConcurrentDense(replicas_tag, const std::uint64_t range_size,
+                  const std::size_t num_replicas)
+      : _size(range_size),
+        _num_replicas(num_replicas),
+        _stride(_stride_for(range_size, num_replicas)),
+        _registers(new atomic_t[num_replicas * _stride]) {
+    for (std::size_t i(0); i < _num_replicas * _stride; ++i) {
+      _registers[i].store(RegType(0), std::memory_order_relaxed);
+    }
+  }
+
+  static std::size_t _stride_for(const std::size_t range_size,
+                                 const std::size_t num_replicas) {
+    if (num_replicas <= 1) {
+      return range_size;
+    }
+    const std::size_t line(
+        std::max(cache_line_size / sizeof(RegType), std::size_t(1)));
+    return (range_size + line - 1) / line * line;
+  }
+
+  /**
+   * A small integer unique to the calling thread.
+   */
+  static std::size_t _thread_id() {
+    static std::atomic<std::size_t> next_id(0);
+    thread_local const std::size_t  id(next_id.fetch_add(1));
+    return id;
+  }
+
+  /**
+   * The register `index` of the calling thread's replica. Threads beyond the
+   * number of replicas share them, which atomic adds keep correct.
+   */
+  inline atomic_t &_slot(const std::uint64_t index) {
+    const std::size_t replica(
+        (_num_replicas > 1) ? _thread_id() % _num_replicas : 0);
+    return _registers[replica * _stride + index];
+  }
+
+  static inline void _add(atomic_t &reg, const RegType delta) {
+    if constexpr (std::is_integral_v<RegType>) {
+      reg.fetch_add(delta, std::memory_order_relaxed);
+    } else {
+      RegType expected(reg.load(std::memory_order_relaxed));
+      while (reg.compare_exchange_weak(expected, expected + delta,
+                                       std::memory_order_relaxed) == false) {
+      }
+    }
+  }
+
+  void _load(const std::size_t replica, dense_t &dense) const {
+    for (std::size_t i(0); i < _size; ++i) {
+      dense[i] =
+          _registers[replica * _stride + i].load(std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Replace the registers with `registers`, held in the first replica.
+   *
+   * @throws std::out_of_range if `registers` is not of size `size()`.
+   */
+  void _assign(const std::vector<RegType> &registers) {
+    if (registers.size() != _size) {
+      std::stringstream ss;
+      ss << "error: attempting to assign " << registers.size()
+         << " registers to a ConcurrentDense of " << _size << "!";
+      throw std::out_of_range(ss.str());
+    }
+    for (std::size_t i(0); i < _num_replicas * _stride; ++i) {
+      _registers[i].store(i < _size ? registers[i] : RegType(0),
+                          std::memory_order_relaxed);
+    }
+  }
+};
+
+}  // namespace sketch
+}  // namespace krowkee
+
+#endif
@@ -10,8 +10,14 @@
 #include <cereal/types/vector.hpp>
 #endif
 
+#include <krowkee/sketch/merge_kernels.hpp>
+#include <krowkee/util/parallel.hpp>
+#include <krowkee/util/wire.hpp>
+
 #include <algorithm>
+#include <numeric>
 #include <sstream>
+#include <utility>
 #include <vector>
 
 namespace krowkee {
@@ -34,6 +40,11 @@ class Dense {
   typedef std::vector<RegType>    col_t;
   typedef Dense<RegType, MergeOp> dense_t;
 
+  /// registers per tile of `merge_many`, sized to keep a tile of `this` in L1
+  static constexpr std::size_t merge_block_size = 4096 / sizeof(RegType);
+  /// minimum number of registers merged per thread
+  static constexpr std::size_t parallel_merge_grain = std::size_t(1) << 16;
+
  protected:
   col_t _registers;
 
@@ -49,8 +60,8 @@ class Dense {
   // default constructor
   Dense() {}
 
-  // // move constructor
-  // Dense(dense_t &&rhs) : dense_t() { std::swap(*this, rhs); }
+  // move constructor
+  Dense(dense_t &&rhs) noexcept : _registers(std::move(rhs._registers)) {}
 
   //////////////////////////////////////////////////////////////////////////////
   // Cereal Archives
@@ -63,6 +74,18 @@ class Dense {
   }
 #endif
 
+  //////////////////////////////////////////////////////////////////////////////
+  // Wire Format
+  //////////////////////////////////////////////////////////////////////////////
+
+  void pack(krowkee::util::wire_writer &writer) const {
+    writer.put_array(_registers.data(), _registers.size());
+  }
+
+  void unpack(krowkee::util::wire_reader &reader) {
+    _registers = reader.get_array<RegType>();
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   // Compactify
   //////////////////////////////////////////////////////////////////////////////
@@ -85,21 +108,82 @@ class Dense {
    * MergeOp determines how register lists are combined .For linear sketches,
    * merge amounts to the element-wise addition of register arrays.
    *
+   * `std::plus` and `saturating_plus` use vectorized kernels; see
+   * krowkee::sketch::simd.
+   *
    * @param rhs the other Dense. Care must be taken to ensure that
    *     one does not merge sketches of different types.
+   * @param num_threads the number of threads across which to split the
+   *     register range. `0` means one per hardware thread. Ranges shorter than
+   *     `parallel_merge_grain` registers per thread are merged serially.
    *
    * @throws std::invalid_argument if the register sizes do not match.
    */
-  inline void merge(const dense_t &rhs) {
-    if (size() != rhs.size()) {
-      std::stringstream ss;
-      ss << "error: attempting to merge embedding 1 of dimension " << size()
-         << " with embedding 2 of dimension " << rhs.size();
-      throw std::invalid_argument(ss.str());
+  inline void merge(const dense_t &rhs, const std::size_t num_threads = 1) {
+    _check_size(rhs);
+    RegType       *lhs_data(_registers.data());
+    const RegType *rhs_data(rhs._registers.data());
+    krowkee::util::parallel_for(
+        0, size(), num_threads,
+        [lhs_data, rhs_data](const std::size_t begin, const std::size_t end) {
+          merge_registers<RegType, MergeOp>(lhs_data + begin, rhs_data + begin,
+                                            end - begin);
+        },
+        parallel_merge_grain);
+  }
+
+  /**
+   * Merge other Dense registers into `this` with `Op` in place of MergeOp,
+   * e.g. `std::minus` to remove the registers of a linear sketch.
+   *
+   * @throws std::invalid_argument if the register sizes do not match.
+   */
+  template <typename Op>
+  inline void merge_with(const dense_t &rhs, Op) {
+    _check_size(rhs);
+    merge_registers<RegType, Op>(_registers.data(), rhs._registers.data(),
+                                 size());
+  }
+
+  /**
+   * Merge several other Dense registers into `this` in one pass.
+   *
+   * Works through the registers in tiles of `merge_block_size`, merging every
+   * source into a tile while it is resident in cache, so that the registers of
+   * `this` are read and written once rather than once per source.
+   *
+   * @param sketches pointers to the `count` sketches to merge.
+   * @param count the number of sketches.
+   * @param num_threads the number of threads across which to split the
+   *     register range. `0` means one per hardware thread.
+   *
+   * @throws std::invalid_argument if any register sizes do not match.
+   */
+  void merge_many(const dense_t *const *sketches, const std::size_t count,
+                  const std::size_t num_threads = 1) {
+    for (std::size_t i(0); i < count; ++i) {
+      _check_size(*sketches[i]);
     }
-    std::transform(std::begin(_registers), std::end(_registers),
-                   std::begin(rhs._registers), std::begin(_registers),
-                   MergeOp());
+    RegType *lhs_data(_registers.data());
+    krowkee::util::parallel_for(
+        0, size(), num_threads,
+        [lhs_data, sketches, count](const std::size_t begin,
+                                    const std::size_t end) {
+          for (std::size_t tile(begin); tile < end; tile += merge_block_size) {
+            const std::size_t tile_size(std::min(merge_block_size, end - tile));
+            for (std::size_t i(0); i < count; ++i) {
+              merge_registers<RegType, MergeOp>(
+                  lhs_data + tile, sketches[i]->_registers.data() + tile,
+                  tile_size);
+            }
+          }
+        },
+        parallel_merge_grain);
+  }
+
+  inline void merge_many(const std::vector<const dense_t *> &sketches,
+                         const std::size_t num_threads = 1) {
+    merge_many(sketches.data(), sketches.size(), num_threads);
   }
 
   /**
@@ -139,13 +223,20 @@ class Dense {
   }
 
   constexpr const RegType &operator[](const std::uint64_t index) const {
-    return _registers.get(index);
+    return _registers[index];
   }
 
   RegType &operator[](const std::uint64_t index) {
     return _registers.at(index);
   }
 
+  /**
+   * Read a register without modifying the container.
+   */
+  constexpr RegType get(const std::uint64_t index) const {
+    return _registers[index];
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   // Getters
   //////////////////////////////////////////////////////////////////////////////
@@ -183,10 +274,22 @@ class Dense {
   //////////////////////////////////////////////////////////////////////////////
   // Swaps
   //////////////////////////////////////////////////////////////////////////////
-  friend void swap(dense_t &lhs, dense_t &rhs) {
+  friend void swap(dense_t &lhs, dense_t &rhs) noexcept {
     std::swap(lhs._registers, rhs._registers);
   }
 
+ private:
+  inline void _check_size(const dense_t &rhs) const {
+    if (size() != rhs.size()) {
+      std::stringstream ss;
+      ss << "error: attempting to merge embedding 1 of dimension " << size()
+         << " with embedding 2 of dimension " << rhs.size();
+      throw std::invalid_argument(ss.str());
+    }
+  }
+
+ public:
+
   //////////////////////////////////////////////////////////////////////////////
   // Assignment
   //////////////////////////////////////////////////////////////////////////////
@@ -195,8 +298,8 @@ class Dense {
    *
    * https://stackoverflow.com/questions/3279543/what-is-the-copy-and-swap-idiom
    */
-  dense_t &operator=(dense_t rhs) {
-    std::swap(*this, rhs);
+  dense_t &operator=(dense_t rhs) noexcept {
+    swap(*this, rhs);
     return *this;
   }
 
@@ -0,0 +1,282 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_SKETCH_FIXEDDENSE_HPP
+#define _KROWKEE_SKETCH_FIXEDDENSE_HPP
+
+#if __has_include(<cereal/types/array.hpp>)
+#include <cereal/types/array.hpp>
+#endif
+
+#include <krowkee/sketch/merge_kernels.hpp>
+#include <krowkee/util/wire.hpp>
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace krowkee {
+namespace sketch {
+
+/**
+ * Dense Sketch with a Compile-Time Range
+ *
+ * Holds its `RangeSize` registers inline in a `std::array`, so that a sketch
+ * container never allocates, merges are loops of constant trip count that the
+ * compiler can unroll and vectorize, and the container is trivially copyable
+ * and may be written and read as raw bytes. Otherwise a drop-in replacement
+ * for Dense.
+ *
+ * Sketch presets take a two-parameter container template; bind the range with
+ * `krowkee::sketch::fixed_range<RangeSize>::Dense`.
+ */
+template <typename RegType, typename MergeOp, std::size_t RangeSize>
+class FixedDense {
+ public:
+  typedef std::array<RegType, RangeSize>          col_t;
+  typedef FixedDense<RegType, MergeOp, RangeSize> dense_t;
+
+  static_assert(RangeSize > 0, "FixedDense requires at least one register");
+
+ protected:
+  col_t _registers;
+
+ public:
+  /**
+   * @param range_size the number of registers. Must equal `RangeSize`; it is
+   *     accepted so that FixedDense constructs like the other containers.
+   *
+   * @throws std::invalid_argument if `range_size != RangeSize`.
+   */
+  template <typename... Args>
+  FixedDense(const std::uint64_t range_size, const Args &...)
+      : _registers{} {
+    if (range_size != RangeSize) {
+      std::stringstream ss;
+      ss << "error: attempting to construct a FixedDense of " << RangeSize
+         << " registers with range size " << range_size << "!";
+      throw std::invalid_argument(ss.str());
+    }
+  }
+
+  FixedDense() : _registers{} {}
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Cereal Archives
+  //////////////////////////////////////////////////////////////////////////////
+
+#if __has_include(<cereal/types/array.hpp>)
+  template <class Archive>
+  void serialize(Archive &archive) {
+    archive(_registers);
+  }
+#endif
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Wire Format
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Write the registers in the same layout as Dense.
+   */
+  void pack(krowkee::util::wire_writer &writer) const {
+    writer.put_array(_registers.data(), RangeSize);
+  }
+
+  /**
+   * @throws std::out_of_range if the message holds other than `RangeSize`
+   *     registers.
+   */
+  void unpack(krowkee::util::wire_reader &reader) {
+    const std::vector<RegType> registers(reader.get_array<RegType>(RangeSize));
+    if (registers.size() != RangeSize) {
+      std::stringstream ss;
+      ss << "error: attempting to unpack " << registers.size()
+         << " registers into a FixedDense of " << RangeSize << "!";
+      throw std::out_of_range(ss.str());
+    }
+    std::copy(std::begin(registers), std::end(registers),
+              std::begin(_registers));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Compactify
+  //////////////////////////////////////////////////////////////////////////////
+
+  void compactify() {}
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Erase
+  //////////////////////////////////////////////////////////////////////////////
+
+  inline void erase(const std::uint64_t) {}
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Merge operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Merge other FixedDense registers into `this`. Sizes agree by
+   * construction, so no check is needed.
+   */
+  inline void merge(const dense_t &rhs) {
+    merge_registers<RegType, MergeOp>(_registers.data(), rhs._registers.data(),
+                                      RangeSize);
+  }
+
+  /**
+   * As `merge`, with `Op` in place of MergeOp, e.g. `std::minus` to remove
+   * the registers of a linear sketch.
+   */
+  template <typename Op>
+  inline void merge_with(const dense_t &rhs, Op) {
+    merge_registers<RegType, Op>(_registers.data(), rhs._registers.data(),
+                                 RangeSize);
+  }
+
+  /**
+   * Merge several other FixedDense registers into `this`.
+   *
+   * @param sketches pointers to the `count` sketches to merge.
+   * @param count the number of sketches.
+   */
+  void merge_many(const dense_t *const *sketches, const std::size_t count) {
+    for (std::size_t i(0); i < count; ++i) {
+      merge(*sketches[i]);
+    }
+  }
+
+  inline void merge_many(const std::vector<const dense_t *> &sketches) {
+    merge_many(sketches.data(), sketches.size());
+  }
+
+  dense_t &operator+=(const dense_t &rhs) {
+    merge(rhs);
+    return *this;
+  }
+
+  inline friend dense_t operator+(dense_t lhs, const dense_t &rhs) {
+    lhs += rhs;
+    return lhs;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Register iterators
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr typename col_t::iterator begin() { return std::begin(_registers); }
+  constexpr typename col_t::const_iterator begin() const {
+    return std::cbegin(_registers);
+  }
+  constexpr typename col_t::const_iterator cbegin() const {
+    return std::cbegin(_registers);
+  }
+  constexpr typename col_t::iterator end() { return std::end(_registers); }
+  constexpr typename col_t::const_iterator end() const {
+    return std::cend(_registers);
+  }
+  constexpr typename col_t::const_iterator cend() {
+    return std::cend(_registers);
+  }
+
+  constexpr const RegType &operator[](const std::uint64_t index) const {
+    return _registers[index];
+  }
+
+  constexpr RegType &operator[](const std::uint64_t index) {
+    return _registers[index];
+  }
+
+  /**
+   * Read a register without modifying the container.
+   */
+  constexpr RegType get(const std::uint64_t index) const {
+    return _registers[index];
+  }
+
+  constexpr const RegType *data() const { return _registers.data(); }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Getters
+  //////////////////////////////////////////////////////////////////////////////
+
+  static inline std::string name() { return "FixedDense"; }
+
+  static inline std::string full_name() {
+    std::stringstream ss;
+    ss << name() << " of " << RangeSize << " registers";
+    return ss.str();
+  }
+
+  constexpr bool is_sparse() const { return false; }
+
+  static constexpr std::size_t size() { return RangeSize; }
+
+  constexpr std::size_t reg_size() const { return sizeof(RegType); }
+
+  constexpr std::size_t get_compaction_threshold() const { return 0; }
+
+  const std::vector<RegType> get_registers() const {
+    return std::vector<RegType>(std::begin(_registers), std::end(_registers));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Equality operators
+  //////////////////////////////////////////////////////////////////////////////
+  constexpr bool same_registers(const dense_t &rhs) const {
+    return _registers == rhs._registers;
+  }
+
+  friend constexpr bool operator==(const dense_t &lhs, const dense_t &rhs) {
+    return lhs.same_registers(rhs);
+  }
+  friend constexpr bool operator!=(const dense_t &lhs, const dense_t &rhs) {
+    return !operator==(lhs, rhs);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Swaps
+  //////////////////////////////////////////////////////////////////////////////
+  friend void swap(dense_t &lhs, dense_t &rhs) {
+    std::swap(lhs._registers, rhs._registers);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // I/O Operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  friend std::ostream &operator<<(std::ostream &os, const dense_t &sk) {
+    for (std::size_t idx(0); idx < RangeSize; ++idx) {
+      if (idx != 0) {
+        os << " ";
+      }
+      os << "(" << idx << "," << std::int64_t(sk._registers[idx]) << ")";
+    }
+    return os;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Accumulation
+  //////////////////////////////////////////////////////////////////////////////
+
+  template <typename RetType>
+  friend RetType accumulate(const dense_t &sk, const RetType init) {
+    return std::accumulate(std::cbegin(sk), std::cend(sk), init);
+  }
+
+  template <typename Func>
+  friend void for_each(const dense_t &sk, const Func &func) {
+    std::for_each(std::cbegin(sk._registers), std::cend(sk._registers), func);
+  }
+};
+
+}  // namespace sketch
+}  // namespace krowkee
+
+#endif
@@ -8,42 +8,106 @@
 
 #include <krowkee/sketch/Dense.hpp>
 #include <krowkee/sketch/Sparse.hpp>
+#include <krowkee/sketch/WideningDense.hpp>
+#include <krowkee/sketch/promotion_policy.hpp>
 
-#if __has_include(<cereal/types/memory.hpp>)
-#include <cereal/types/memory.hpp>
-#endif
+#include <krowkee/util/counters.hpp>
 
-#include <memory>
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
 
 namespace krowkee {
 namespace sketch {
 
 enum class promotable_mode_t : std::uint8_t { sparse, dense };
 
+/**
+ * Writable reference to a Promotable register whose dense container hands out
+ * proxy references, e.g. WideningDense. Refers either to a sparse register or
+ * to a dense proxy.
+ */
+template <typename RegType, typename DenseReference>
+class promotable_reference {
+  RegType                      *_sparse;
+  std::optional<DenseReference> _dense;
+
+ public:
+  promotable_reference(RegType &reg) : _sparse(&reg) {}
+  promotable_reference(const DenseReference &ref)
+      : _sparse(nullptr), _dense(ref) {}
+
+  operator RegType() const {
+    return (_sparse != nullptr) ? *_sparse : RegType(*_dense);
+  }
+
+  promotable_reference &operator=(const RegType val) {
+    if (_sparse != nullptr) {
+      *_sparse = val;
+    } else {
+      *_dense = val;
+    }
+    return *this;
+  }
+  promotable_reference &operator=(const promotable_reference &rhs) {
+    return operator=(RegType(rhs));
+  }
+};
+
 /**
  * Sketch Dense/Sparse union data structure
  *
  * Provides a unified interface to the Sparse and Dense containers, allowing for
  * seamless "promotion" of a Sparse representation to a Dense one.
+ *
+ * The active container is stored inline in a `std::variant`, so a Promotable
+ * performs no allocation of its own, copies with a single container copy, and
+ * reaches its registers without an extra indirection. Promotion replaces the
+ * sparse alternative with the dense one in the same storage.
+ *
+ * When to promote, and whether to demote a mostly-zero dense container back to
+ * sparse, is decided by a `promotion_policy`. Its thresholds are resolved into
+ * register counts once, at construction, so that the hot path only compares
+ * sizes. The dense nonzero count that demotion compares against is maintained
+ * by sparse merges and only rescanned after the dense registers are written
+ * directly, so that merging a stream of sparse messages into a dense sketch
+ * does not pay a full scan per message.
+ *
+ * `DenseType` selects the dense container. Use the `Promotable` and
+ * `WideningPromotable` classes below rather than this template directly, as
+ * the sketch functors expect containers with four template parameters.
  */
 template <typename RegType, typename MergeOp,
-          template <typename, typename> class MapType, typename KeyType>
-class Promotable {
+          template <typename, typename> class MapType, typename KeyType,
+          template <typename, typename> class DenseType>
+class BasicPromotable {
  public:
-  typedef krowkee::sketch::Dense<RegType, MergeOp> dense_t;
-  typedef std::unique_ptr<dense_t>                 dense_ptr_t;
+  typedef DenseType<RegType, MergeOp>                                 dense_t;
   typedef krowkee::sketch::Sparse<RegType, MergeOp, MapType, KeyType> sparse_t;
   typedef typename sparse_t::map_t                                    map_t;
-  typedef std::unique_ptr<sparse_t>                      sparse_ptr_t;
-  typedef Promotable<RegType, MergeOp, MapType, KeyType> promotable_t;
+  typedef std::variant<sparse_t, dense_t> registers_t;
+  typedef BasicPromotable<RegType, MergeOp, MapType, KeyType, DenseType>
+      promotable_t;
+  typedef decltype(std::declval<dense_t &>()[0]) dense_reference_t;
+  typedef std::conditional_t<
+      std::is_lvalue_reference_v<dense_reference_t>, RegType &,
+      promotable_reference<RegType, dense_reference_t>>
+      reference;
 
  private:
-  dense_ptr_t       _dense_ptr;
-  sparse_ptr_t      _sparse_ptr;
-  std::size_t       _range_size;
-  std::size_t       _compaction_threshold;
-  std::size_t       _promotion_threshold;
-  promotable_mode_t _mode;
+  registers_t      _registers;
+  std::size_t      _range_size;
+  std::size_t      _compaction_threshold;
+  promotion_policy _policy;
+  std::size_t      _promotion_threshold;
+  std::size_t      _demotion_threshold;
+  std::size_t      _dense_nonzeros;
+
+  static constexpr std::size_t _nonzeros_unknown =
+      std::numeric_limits<std::size_t>::max();
 
  public:
   /**
@@ -52,81 +116,117 @@ class Promotable {
    * @param range_size size argument for constructing dense container.
    * @param compaction_threshold size argument for constructing sparse
    *     container.
-   * @param mode indicates whether to create a sparse or a dense container.
+   * @param policy decides when to promote and demote. A plain register count
+   *     promotes at that size.
    */
-  Promotable(const std::size_t range_size,
-             const std::size_t compaction_threshold,
-             const std::size_t promotion_threshold)
-      : _range_size(range_size),
+  BasicPromotable(const std::size_t       range_size,
+                  const std::size_t       compaction_threshold,
+                  const promotion_policy &policy)
+      : _registers(std::in_place_type<sparse_t>, range_size,
+                   compaction_threshold),
+        _range_size(range_size),
         _compaction_threshold(compaction_threshold),
-        _promotion_threshold(promotion_threshold),
-        _mode(promotable_mode_t::sparse),
-        _sparse_ptr(
-            std::make_unique<sparse_t>(range_size, compaction_threshold)) {}
+        _policy(policy),
+        _dense_nonzeros(_nonzeros_unknown) {
+    _resolve_thresholds();
+  }
 
   /**
    * Copy constructor.
    *
-   * Must explicitly copy contents of rhs's container, not just copy the
-   * pointer.
-   *
    * @param rhs container to be copied.
    */
-  Promotable(const promotable_t &rhs)
-      : _range_size(rhs._range_size),
+  BasicPromotable(const promotable_t &rhs)
+      : _registers(rhs._registers),
+        _range_size(rhs._range_size),
         _compaction_threshold(rhs._compaction_threshold),
+        _policy(rhs._policy),
         _promotion_threshold(rhs._promotion_threshold),
-        _mode(rhs._mode) {
-    if (_mode == promotable_mode_t::sparse) {
-      sparse_ptr_t sparse_ptr(std::make_unique<sparse_t>(*rhs._sparse_ptr));
-      std::swap(sparse_ptr, _sparse_ptr);
-    } else {
-      dense_ptr_t dense_ptr(std::make_unique<dense_t>(*rhs._dense_ptr));
-      std::swap(dense_ptr, _dense_ptr);
-    }
-  }
+        _demotion_threshold(rhs._demotion_threshold),
+        _dense_nonzeros(rhs._dense_nonzeros) {}
 
   /**
    * default constructor (only use for move constructor!)
    */
-  Promotable()
-      : _mode(promotable_mode_t::sparse), _sparse_ptr(), _dense_ptr() {}
-
-  // /**
-  //  * move constructor
-  //  *
-  //  * @param rhs r-value promotable_t to be destructively copied.
-  //  */
-  // Promotable(promotable_t &&rhs) noexcept : Promotable() {
-  //   std::swap(*this, rhs);
-  // }
+  BasicPromotable()
+      : _range_size(0),
+        _compaction_threshold(0),
+        _policy(std::size_t(0)),
+        _promotion_threshold(0),
+        _demotion_threshold(0),
+        _dense_nonzeros(_nonzeros_unknown) {}
+
+  /**
+   * move constructor
+   *
+   * @param rhs r-value promotable_t to be destructively copied.
+   */
+  BasicPromotable(promotable_t &&rhs) noexcept
+      : _registers(std::move(rhs._registers)),
+        _range_size(rhs._range_size),
+        _compaction_threshold(rhs._compaction_threshold),
+        _policy(rhs._policy),
+        _promotion_threshold(rhs._promotion_threshold),
+        _demotion_threshold(rhs._demotion_threshold),
+        _dense_nonzeros(rhs._dense_nonzeros) {}
 
   //////////////////////////////////////////////////////////////////////////////
   // Cereal Archives
   //////////////////////////////////////////////////////////////////////////////
 
-#if __has_include(<cereal/types/memory.hpp>)
+#if __has_include(<cereal/cereal.hpp>)
   template <class Archive>
   void save(Archive &oarchive) const {
-    oarchive(_range_size, _compaction_threshold, _promotion_threshold, _mode);
-    if (_mode == promotable_mode_t::sparse) {
-      oarchive(_sparse_ptr);
+    const promotable_mode_t mode(get_mode());
+    oarchive(_range_size, _compaction_threshold, _policy, mode);
+    if (mode == promotable_mode_t::sparse) {
+      oarchive(_sparse());
     } else {
-      oarchive(_dense_ptr);
+      oarchive(_dense());
     }
   }
 
   template <class Archive>
   void load(Archive &iarchive) {
-    iarchive(_range_size, _compaction_threshold, _promotion_threshold, _mode);
-    if (_mode == promotable_mode_t::sparse) {
-      iarchive(_sparse_ptr);
+    promotable_mode_t mode;
+    iarchive(_range_size, _compaction_threshold, _policy, mode);
+    _resolve_thresholds();
+    _dense_nonzeros = _nonzeros_unknown;
+    if (mode == promotable_mode_t::sparse) {
+      iarchive(_registers.template emplace<sparse_t>());
     } else {
-      iarchive(_dense_ptr);
+      iarchive(_registers.template emplace<dense_t>());
     }
   }
 #endif
 
+  //////////////////////////////////////////////////////////////////////////////
+  // Wire Format
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Write the mode followed by the registers of that mode.
+   */
+  void pack(krowkee::util::wire_writer &writer) const {
+    const promotable_mode_t mode(get_mode());
+    writer.put_varint(mode == promotable_mode_t::sparse ? 0 : 1);
+    if (mode == promotable_mode_t::sparse) {
+      _sparse().pack(writer);
+    } else {
+      _dense().pack(writer);
+    }
+  }
+
+  void unpack(krowkee::util::wire_reader &reader) {
+    _dense_nonzeros = _nonzeros_unknown;
+    if (reader.get_varint() == 0) {
+      _registers.template emplace<sparse_t>(_range_size, _compaction_threshold)
+          .unpack(reader);
+    } else {
+      _registers.template emplace<dense_t>(_range_size).unpack(reader);
+    }
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   // Swaps
   //////////////////////////////////////////////////////////////////////////////
@@ -134,16 +234,14 @@ class Promotable {
   /**
    * Swap boilerplate.
    */
-  friend void swap(promotable_t &lhs, promotable_t &rhs) {
+  friend void swap(promotable_t &lhs, promotable_t &rhs) noexcept {
     std::swap(lhs._range_size, rhs._range_size);
     std::swap(lhs._compaction_threshold, rhs._compaction_threshold);
+    std::swap(lhs._policy, rhs._policy);
     std::swap(lhs._promotion_threshold, rhs._promotion_threshold);
-    std::swap(lhs._mode, rhs._mode);
-    if (lhs._mode == promotable_mode_t::sparse) {
-      std::swap(lhs._sparse_ptr, rhs._sparse_ptr);
-    } else {
-      std::swap(lhs._dense_ptr, rhs._dense_ptr);
-    }
+    std::swap(lhs._demotion_threshold, rhs._demotion_threshold);
+    std::swap(lhs._dense_nonzeros, rhs._dense_nonzeros);
+    lhs._registers.swap(rhs._registers);
   }
 
   //////////////////////////////////////////////////////////////////////////////
@@ -155,8 +253,8 @@ class Promotable {
    *
    * https://stackoverflow.com/questions/3279543/what-is-the-copy-and-swap-idiom
    */
-  promotable_t &operator=(promotable_t rhs) {
-    std::swap(*this, rhs);
+  promotable_t &operator=(promotable_t rhs) noexcept {
+    swap(*this, rhs);
     return *this;
   }
 
@@ -164,7 +262,13 @@ class Promotable {
   // Getters
   //////////////////////////////////////////////////////////////////////////////
 
-  static inline std::string name() { return "Promotable"; }
+  static inline std::string name() {
+    if constexpr (std::is_same_v<dense_t, Dense<RegType, MergeOp>>) {
+      return "Promotable";
+    } else {
+      return "WideningPromotable";
+    }
+  }
 
   static inline std::string full_name() {
     std::stringstream ss;
@@ -173,24 +277,22 @@ class Promotable {
   }
 
   constexpr std::size_t size() const {
-    if (_mode == promotable_mode_t::sparse) {
-      return _sparse_ptr->size();
+    if (is_sparse()) {
+      return _sparse().size();
     } else {
-      return _dense_ptr->size();
+      return _dense().size();
     }
   }
 
   constexpr bool is_compact() const {
-    if (_mode == promotable_mode_t::sparse) {
-      return _sparse_ptr->is_compact();
+    if (is_sparse()) {
+      return _sparse().is_compact();
     } else {
       return true;
     }
   }
 
-  constexpr bool is_sparse() const {
-    return (_mode == promotable_mode_t::sparse) ? true : false;
-  }
+  constexpr bool is_sparse() const { return _registers.index() == 0; }
 
   constexpr std::size_t reg_size() const { return sizeof(RegType); }
 
@@ -204,7 +306,17 @@ class Promotable {
     return _promotion_threshold;
   }
 
-  constexpr promotable_mode_t get_mode() const { return _mode; }
+  constexpr std::size_t get_demotion_threshold() const {
+    return _demotion_threshold;
+  }
+
+  constexpr const promotion_policy &get_promotion_policy() const {
+    return _policy;
+  }
+
+  constexpr promotable_mode_t get_mode() const {
+    return is_sparse() ? promotable_mode_t::sparse : promotable_mode_t::dense;
+  }
 
   //////////////////////////////////////////////////////////////////////////////
   // Equality operators
@@ -213,7 +325,7 @@ class Promotable {
   constexpr bool same_parameters(const promotable_t &rhs) const {
     return _range_size == rhs._range_size &&
            _compaction_threshold == rhs._compaction_threshold &&
-           _promotion_threshold == rhs._promotion_threshold;
+           _policy == rhs._policy;
   }
 
   /**
@@ -222,14 +334,10 @@ class Promotable {
    */
   friend constexpr bool operator==(const promotable_t &lhs,
                                    const promotable_t &rhs) {
-    if (lhs.same_parameters(rhs) == false || lhs._mode != rhs._mode) {
+    if (lhs.same_parameters(rhs) == false) {
       return false;
     }
-    if (lhs._mode == promotable_mode_t::sparse) {
-      return *lhs._sparse_ptr == *rhs._sparse_ptr;
-    } else {
-      return *lhs._dense_ptr == *rhs._dense_ptr;
-    }
+    return lhs._registers == rhs._registers;
   }
   friend constexpr bool operator!=(const promotable_t &lhs,
                                    const promotable_t &rhs) {
@@ -240,9 +348,17 @@ class Promotable {
   // Compaction
   //////////////////////////////////////////////////////////////////////////////
 
+  /**
+   * Compact sparse registers. Dense registers are instead checked for demotion,
+   * so that erasures which leave the sketch mostly zeros are reclaimed here.
+   * This rescans the dense registers only if they were written since the last
+   * check.
+   */
   void compactify() {
-    if (_mode == promotable_mode_t::sparse) {
-      _sparse_ptr->compactify();
+    if (is_sparse()) {
+      _sparse().compactify();
+    } else {
+      _demote_if_sparse();
     }
   }
 
@@ -251,10 +367,8 @@ class Promotable {
   //////////////////////////////////////////////////////////////////////////////
 
   inline void erase(const std::uint64_t index) {
-    if (_mode == promotable_mode_t::sparse) {
-      _sparse_ptr->erase(index);
-    } else {
-      _dense_ptr->erase(index);
+    if (is_sparse()) {
+      _sparse().erase(index);
     }
   }
 
@@ -263,45 +377,46 @@ class Promotable {
   //////////////////////////////////////////////////////////////////////////////
 
   constexpr auto begin() {
-    if (_mode == promotable_mode_t::sparse) {
-      return std::begin(*_sparse_ptr);
+    if (is_sparse()) {
+      return std::begin(_sparse());
     } else {
-      return std::begin(*_dense_ptr);
+      _dense_nonzeros = _nonzeros_unknown;
+      return std::begin(_dense());
     }
   }
   constexpr auto begin() const {
-    if (_mode == promotable_mode_t::sparse) {
-      return std::cbegin(*_sparse_ptr);
+    if (is_sparse()) {
+      return std::cbegin(_sparse());
     } else {
-      return std::cbegin(*_dense_ptr);
+      return std::cbegin(_dense());
     }
   }
   constexpr auto cbegin() const {
-    if (_mode == promotable_mode_t::sparse) {
-      return std::cbegin(*_sparse_ptr);
+    if (is_sparse()) {
+      return std::cbegin(_sparse());
     } else {
-      return std::cbegin(*_dense_ptr);
+      return std::cbegin(_dense());
     }
   }
   constexpr auto end() {
-    if (_mode == promotable_mode_t::sparse) {
-      return std::end(*_sparse_ptr);
+    if (is_sparse()) {
+      return std::end(_sparse());
     } else {
-      return std::end(*_dense_ptr);
+      return std::end(_dense());
     }
   }
   constexpr auto end() const {
-    if (_mode == promotable_mode_t::sparse) {
-      return std::cend(*_sparse_ptr);
+    if (is_sparse()) {
+      return std::cend(_sparse());
     } else {
-      return std::cend(*_dense_ptr);
+      return std::cend(_dense());
     }
   }
   constexpr auto cend() const {
-    if (_mode == promotable_mode_t::sparse) {
-      return std::cend(*_sparse_ptr);
+    if (is_sparse()) {
+      return std::cend(_sparse());
     } else {
-      return std::cend(*_dense_ptr);
+      return std::cend(_dense());
     }
   }
 
@@ -309,16 +424,31 @@ class Promotable {
   // Accessors
   //////////////////////////////////////////////////////////////////////////////
 
-  RegType &operator[](const std::uint64_t index) {
-    if (_mode == promotable_mode_t::sparse) {
-      if (size() == _promotion_threshold) {
-        compactify();
-        promote();
-        return (*_dense_ptr)[index];
-      }
-      return (*_sparse_ptr)[index];
+  reference operator[](const std::uint64_t index) {
+    if (dense_t *dense = std::get_if<dense_t>(&_registers)) {
+      KROWKEE_COUNT(dense_accesses, 1);
+      _dense_nonzeros = _nonzeros_unknown;
+      return (*dense)[index];
+    }
+    if (size() == _promotion_threshold) {
+      compactify();
+      promote();
+      _dense_nonzeros = _nonzeros_unknown;
+      KROWKEE_COUNT(dense_accesses, 1);
+      return _dense()[index];
+    }
+    KROWKEE_COUNT(sparse_accesses, 1);
+    return _sparse()[index];
+  }
+
+  /**
+   * Read a register without modifying the container or triggering promotion.
+   */
+  inline RegType get(const std::uint64_t index) const {
+    if (is_sparse()) {
+      return _sparse().get(index);
     } else {
-      return (*_dense_ptr)[index];
+      return _dense().get(index);
     }
   }
 
@@ -338,34 +468,74 @@ class Promotable {
       throw std::invalid_argument(
           "containers do not have congruent parameters!");
     }
-    if (_mode == rhs._mode) {
-      if (_mode == promotable_mode_t::sparse) {
-        // sparse_t tmp(*rhs._sparse_ptr);
-        // *_sparse_ptr += tmp;
-        *_sparse_ptr += *rhs._sparse_ptr;
+    if (is_sparse() == rhs.is_sparse()) {
+      if (is_sparse()) {
+        _sparse() += rhs._sparse();
         if (size() >= _promotion_threshold) {
           promote();
         }
       } else {
-        *_dense_ptr += *rhs._dense_ptr;
+        _dense() += rhs._dense();
+        _dense_nonzeros = _nonzeros_unknown;
+        _demote_if_sparse();
       }
     } else {
-      if (_mode == promotable_mode_t::sparse) {
-        // we are sparse; promote to dense and add rhs._dense_ptr
+      if (is_sparse()) {
+        // we are sparse; promote to dense and add rhs's dense registers
         // This will be slow; try to avoid it.
         promote();
-        *_dense_ptr += *rhs._dense_ptr;
+        _dense() += rhs._dense();
+        _dense_nonzeros = _nonzeros_unknown;
       } else {
-        // we are dense; add rhs._sparse_ptr
+        // we are dense; add rhs's sparse registers
         merge_from_sparse(rhs);
       }
+      _demote_if_sparse();
     }
     return *this;
   }
 
+  /**
+   * Merge other promotable_t into `this` with `op` in place of MergeOp, e.g.
+   * `std::minus` to remove the registers of a linear sketch. Sparse
+   * registers merged to zero are dropped, and a dense result demotes as
+   * after `+=`.
+   *
+   * @throws std::invalid_argument if the parameters do not agree.
+   * @throws std::logic_error if either side is sparse and uncompacted.
+   */
+  template <typename Op>
+  promotable_t &merge_with(const promotable_t &rhs, const Op op) {
+    if (same_parameters(rhs) == false) {
+      throw std::invalid_argument(
+          "containers do not have congruent parameters!");
+    }
+    if (is_sparse() && rhs.is_sparse()) {
+      _sparse().merge_with(rhs._sparse(), op);
+      if (size() >= _promotion_threshold) {
+        promote();
+      }
+      return *this;
+    }
+    if (is_sparse()) {
+      promote();
+    }
+    if (rhs.is_sparse()) {
+      if (rhs.is_compact() == false) {
+        throw std::logic_error("Attempt to dense merge a non-compact rhs!");
+      }
+      _merge_into_dense(rhs._sparse(), op);
+    } else {
+      _dense().merge_with(rhs._dense(), op);
+      _dense_nonzeros = _nonzeros_unknown;
+    }
+    _demote_if_sparse();
+    return *this;
+  }
+
   inline friend promotable_t operator+(const promotable_t &lhs,
                                        const promotable_t &rhs) {
-    if (rhs._mode == promotable_mode_t::dense) {
+    if (rhs.is_sparse() == false) {
       promotable_t ret(rhs);
       ret += lhs;
       return ret;
@@ -378,53 +548,79 @@ class Promotable {
   /**
    * Promote sparse container into a dense container.
    *
-   * Initializes dense pointer while releasing sparse pointer.
+   * The sparse registers are moved out of the variant, which then holds the
+   * dense registers in the same storage.
    *
    * @throws std::logic_error if the container is not in sparse mode.
    * @throws std::logic_error if the sparse container is not compacted.
    */
   void promote() {
-    if (_mode != promotable_mode_t::sparse) {
+    if (is_sparse() == false) {
       throw std::logic_error("Attempt to promote non-sparse container!");
     }
-    if (_sparse_ptr->is_compact() == false) {
+    if (_sparse().is_compact() == false) {
       throw std::logic_error("Attempt to promote uncompacted container!");
     }
+    KROWKEE_COUNT_TIME(promotion_ns);
+    KROWKEE_COUNT(promotions, 1);
+
+    sparse_t sparse;
+    swap(sparse, _sparse());
+    _registers.template emplace<dense_t>(_range_size);
+    _dense_nonzeros = 0;
+    _merge_into_dense(sparse);
+  }
 
-    _dense_ptr = std::make_unique<dense_t>(_range_size);
-    merge_from_sparse(*this);
-    _sparse_ptr.reset();
-    _mode = promotable_mode_t::dense;
+  /**
+   * Demote dense container into a sparse container holding its nonzero
+   * registers.
+   *
+   * @throws std::logic_error if the container is not in dense mode.
+   */
+  void demote() {
+    if (is_sparse() == true) {
+      throw std::logic_error("Attempt to demote non-dense container!");
+    }
+    KROWKEE_COUNT_TIME(promotion_ns);
+    KROWKEE_COUNT(demotions, 1);
+
+    dense_t dense;
+    swap(dense, _dense());
+    sparse_t &sparse(_registers.template emplace<sparse_t>(
+        _range_size, _compaction_threshold));
+    std::uint64_t index(0);
+    for (const RegType reg : dense) {
+      if (reg != 0) {
+        sparse[index] = reg;
+      }
+      ++index;
+    }
+    sparse.compactify();
   }
 
   /**
    * Incorporate the information in a sparse container into a dense container.
    *
-   * Initializes dense pointer while releasing sparse pointer.
-   *
    * @throws std::logic_error if the rhs container is not in sparse mode.
    */
   void merge_from_sparse(const promotable_t &rhs) {
-    if (rhs._mode != promotable_mode_t::sparse) {
+    if (rhs.is_sparse() == false) {
       throw std::logic_error("Attempt to dense merge a non-sparse rhs!");
     }
     if (rhs.is_compact() == false) {
       throw std::logic_error("Attempt to dense merge a non-compact rhs!");
     }
-    for_each(*rhs._sparse_ptr, [&](const auto &p) {
-      RegType &val((*_dense_ptr)[p.first]);
-      val = MergeOp()(val, p.second);
-    });
+    _merge_into_dense(rhs._sparse());
   }
 
   //////////////////////////////////////////////////////////////////////////////
   // I/O Operators
   //////////////////////////////////////////////////////////////////////////////
   friend std::ostream &operator<<(std::ostream &os, const promotable_t &con) {
-    if (con._mode == promotable_mode_t::sparse) {
-      os << *con._sparse_ptr;
+    if (con.is_sparse()) {
+      os << con._sparse();
     } else {
-      os << *con._dense_ptr;
+      os << con._dense();
     }
     return os;
   }
@@ -435,12 +631,124 @@ class Promotable {
 
   template <typename RetType>
   friend RetType accumulate(const promotable_t &con, const RetType init) {
-    if (con._mode == promotable_mode_t::sparse) {
-      return accumulate(*con._sparse_ptr, init);
+    if (con.is_sparse()) {
+      return accumulate(con._sparse(), init);
     } else {
-      return accumulate(*con._dense_ptr, init);
+      return accumulate(con._dense(), init);
     }
   }
+
+  /**
+   * Apply `func` to the registers of the active container, which are
+   * `(index, value)` pairs in sparse mode and values in dense mode.
+   */
+  template <typename Func>
+  friend void for_each(const promotable_t &con, const Func &func) {
+    if (con.is_sparse()) {
+      for_each(con._sparse(), func);
+    } else {
+      for_each(con._dense(), func);
+    }
+  }
+
+ private:
+  constexpr sparse_t &_sparse() { return *std::get_if<sparse_t>(&_registers); }
+  constexpr const sparse_t &_sparse() const {
+    return *std::get_if<sparse_t>(&_registers);
+  }
+  constexpr dense_t &_dense() { return *std::get_if<dense_t>(&_registers); }
+  constexpr const dense_t &_dense() const {
+    return *std::get_if<dense_t>(&_registers);
+  }
+
+  inline void _resolve_thresholds() {
+    _promotion_threshold = _policy.promotion_size(_range_size, sizeof(RegType),
+                                                  sparse_t::entry_bytes());
+    _demotion_threshold  = _policy.demotion_size(_range_size, sizeof(RegType),
+                                                 sparse_t::entry_bytes());
+  }
+
+  /**
+   * Demote if fewer than `_demotion_threshold` dense registers are nonzero,
+   * recounting them only if they were written since the last count.
+   */
+  inline void _demote_if_sparse() {
+    if (_demotion_threshold == 0) {
+      return;
+    }
+    if (_dense_nonzeros == _nonzeros_unknown) {
+      const dense_t &dense(_dense());
+      _dense_nonzeros = std::count_if(
+          std::cbegin(dense), std::cend(dense),
+          [](const RegType reg) { return reg != 0; });
+    }
+    if (_dense_nonzeros < _demotion_threshold) {
+      demote();
+    }
+  }
+
+  /**
+   * Merge sparse registers into the dense registers, keeping a known nonzero
+   * count up to date.
+   */
+  template <typename Op = MergeOp>
+  inline void _merge_into_dense(const sparse_t &sparse, const Op op = Op()) {
+    dense_t &dense(_dense());
+    if (_dense_nonzeros == _nonzeros_unknown) {
+      for_each(sparse, [&](const auto &p) {
+        auto &&val(dense[p.first]);
+        val = op(val, p.second);
+      });
+      return;
+    }
+    std::size_t nonzeros(_dense_nonzeros);
+    for_each(sparse, [&](const auto &p) {
+      auto &&val(dense[p.first]);
+      const RegType old_val(val);
+      const RegType new_val(op(old_val, p.second));
+      val = new_val;
+      nonzeros += std::size_t(new_val != 0) - std::size_t(old_val != 0);
+    });
+    _dense_nonzeros = nonzeros;
+  }
+};
+
+/**
+ * Promotable container with Dense registers.
+ */
+template <typename RegType, typename MergeOp,
+          template <typename, typename> class MapType, typename KeyType>
+class Promotable
+    : public BasicPromotable<RegType, MergeOp, MapType, KeyType, Dense> {
+ public:
+  typedef BasicPromotable<RegType, MergeOp, MapType, KeyType, Dense> base_t;
+
+  using base_t::base_t;
+
+  Promotable() : base_t() {}
+  Promotable(const base_t &rhs) : base_t(rhs) {}
+  Promotable(base_t &&rhs) noexcept : base_t(std::move(rhs)) {}
+};
+
+/**
+ * Promotable container that promotes to WideningDense, so that a promoted
+ * sketch of small counts keeps its registers packed at the narrowest width
+ * that holds them.
+ */
+template <typename RegType, typename MergeOp,
+          template <typename, typename> class MapType, typename KeyType>
+class WideningPromotable
+    : public BasicPromotable<RegType, MergeOp, MapType, KeyType,
+                             WideningDense> {
+ public:
+  typedef BasicPromotable<RegType, MergeOp, MapType, KeyType, WideningDense>
+      base_t;
+
+  using base_t::base_t;
+
+  WideningPromotable() : base_t() {}
+  WideningPromotable(const base_t &rhs) : base_t(rhs) {}
+  WideningPromotable(base_t &&rhs) noexcept : base_t(std::move(rhs)) {}
 };
 
 }  // namespace sketch
@@ -6,10 +6,17 @@
 #ifndef _KROWKEE_SKETCH_SKETCH_HPP
 #define _KROWKEE_SKETCH_SKETCH_HPP
 
+#include <krowkee/sketch/promotion_policy.hpp>
+#include <krowkee/util/counters.hpp>
+#include <krowkee/util/wire.hpp>
+
 #if __has_include(<cereal/types/memory.hpp>)
 #include <cereal/types/memory.hpp>
 #endif
 
+#include <sstream>
+#include <vector>
+
 namespace krowkee {
 namespace sketch {
 
@@ -44,10 +51,14 @@ class Sketch {
    *
    * @param sf_ptr std::shared_ptr pointing to the desired linear sketch
    *     functor.
+   * @param compaction_threshold the size at which compacting maps compact.
+   *     Only used by sparse containers.
+   * @param promotion when to promote a sparse container to a dense one. Only
+   *     used by Promotable containers.
    */
   Sketch(const sf_ptr_t &sf_ptr, const std::size_t compaction_threshold = 100,
-         const std::size_t promotion_threshold = 4096)
-      : _con(sf_ptr->range_size(), compaction_threshold, promotion_threshold),
+         const promotion_policy &promotion = 4096)
+      : _con(sf_ptr->range_size(), compaction_threshold, promotion),
         _sf_ptr(sf_ptr) {}
 
   /**
@@ -70,12 +81,13 @@ class Sketch {
 
   // sf_ptr_t _make_default_ptr() { return sf_ptr_t(); }
 
-  // /**
-  //  * move constructor
-  //  *
-  //  * @param rhs krowkee::sketch::Sketch to be destructively copied.
-  //  */
-  // Sketch(sk_t &&rhs) noexcept : Sketch() { std::swap(*this, rhs); }
+  /**
+   * move constructor
+   *
+   * @param rhs krowkee::sketch::Sketch to be destructively copied.
+   */
+  Sketch(sk_t &&rhs) noexcept
+      : _sf_ptr(std::move(rhs._sf_ptr)), _con(std::move(rhs._con)) {}
 
   //////////////////////////////////////////////////////////////////////////////
   // Cereal Archives
@@ -88,8 +100,24 @@ class Sketch {
   }
 #endif
 
+  //////////////////////////////////////////////////////////////////////////////
+  // Wire Format
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Write the registers only. The sketch functor handle is not packed, as
+   * every rank already holds it.
+   */
+  void pack(krowkee::util::wire_writer &writer) const { _con.pack(writer); }
+
+  /**
+   * Replace the registers with packed ones, keeping the sketch functor.
+   */
+  void unpack(krowkee::util::wire_reader &reader) { _con.unpack(reader); }
+
   // For testing purposes. Might want to get rid of this.
   const container_t &get_container() { return _con; }
+  const container_t &get_container() const { return _con; }
 
   //////////////////////////////////////////////////////////////////////////////
   // Insertion
@@ -107,9 +135,74 @@ class Sketch {
    */
   template <typename... ItemArgs>
   inline void insert(const ItemArgs &...args) {
+    KROWKEE_COUNT(sketch_inserts, 1);
     (*_sf_ptr)(_con, args...);
   }
 
+  /**
+   * Insert a block of items into registers using the sketch functor's batch
+   * kernel.
+   *
+   * Equivalent to calling `insert(items[i], multiplicities[i])` for each `i`
+   * in order, but avoids re-entering the functor call chain per item.
+   *
+   * @param items pointer to the `count` items to be inserted.
+   * @param multiplicities pointer to the `count` multiplicities of `items`, or
+   *     `nullptr` if every multiplicity is `1`.
+   * @param count the number of items.
+   */
+  inline void insert_batch(const std::uint64_t *items,
+                           const RegType       *multiplicities,
+                           const std::size_t    count) {
+    KROWKEE_COUNT(sketch_inserts, count);
+    _sf_ptr->apply_batch(_con, items, multiplicities, count);
+  }
+
+  /**
+   * Insert a block of items, each with multiplicity `1`.
+   *
+   * @param items the items to be inserted.
+   */
+  inline void insert_batch(const std::vector<std::uint64_t> &items) {
+    insert_batch(items.data(), nullptr, items.size());
+  }
+
+  /**
+   * Insert a block of items with the corresponding multiplicities.
+   *
+   * @param items the items to be inserted.
+   * @param multiplicities the multiplicities of `items`.
+   *
+   * @throws std::invalid_argument if `items` and `multiplicities` differ in
+   *     length.
+   */
+  inline void insert_batch(const std::vector<std::uint64_t> &items,
+                           const std::vector<RegType>       &multiplicities) {
+    if (items.size() != multiplicities.size()) {
+      std::stringstream ss;
+      ss << "error: attempting to batch insert " << items.size()
+         << " items with " << multiplicities.size() << " multiplicities";
+      throw std::invalid_argument(ss.str());
+    }
+    insert_batch(items.data(), multiplicities.data(), items.size());
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Point Query
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Estimate the total multiplicity inserted for `item`.
+   *
+   * Only available for sketch functors that support point queries, such as
+   * CountSketch.
+   *
+   * @param item the item to be queried.
+   */
+  inline RegType point_query(const std::uint64_t item) const {
+    return _sf_ptr->point_query(_con, item);
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   // Compactify
   //////////////////////////////////////////////////////////////////////////////
@@ -136,10 +229,53 @@ class Sketch {
          << *(_sf_ptr) << ") and (" << *(rhs._sf_ptr) << ")";
       throw std::invalid_argument(ss.str());
     }
+    KROWKEE_COUNT_TIME(sketch_merge_ns);
+    KROWKEE_COUNT(sketch_merges, 1);
     _con += rhs._con;
     return *this;
   }
 
+  /**
+   * Merge other Sketch registers into `this` with `op` in place of MergeOp.
+   *
+   * For linear sketches, `std::minus` removes the contribution of a
+   * sub-stream, such as an expired bucket of a
+   * krowkee::stream::BoundedWindowedSummary. Sparse registers must be
+   * compacted first.
+   *
+   * @throws std::invalid_argument if the `SketchFunc`s do not agree.
+   */
+  template <typename Op>
+  sk_t &merge_with(const sk_t &rhs, const Op op) {
+    if (!same_functors(rhs)) {
+      std::stringstream ss;
+      ss << "error: attempting to merge linear sketch objects with different "
+            "hash functors : ("
+         << *(_sf_ptr) << ") and (" << *(rhs._sf_ptr) << ")";
+      throw std::invalid_argument(ss.str());
+    }
+    KROWKEE_COUNT_TIME(sketch_merge_ns);
+    KROWKEE_COUNT(sketch_merges, 1);
+    _con.merge_with(rhs._con, op);
+    return *this;
+  }
+
+  /**
+   * Merge `value` into the register at `index`, bypassing the sketch functor.
+   * Used to merge registers that are stored outside of a Sketch, such as those
+   * of a krowkee::stream::MultiView.
+   *
+   * @param index the register index. Must be less than `range_size()`.
+   * @param value the register value to merge.
+   */
+  inline void merge_register(const std::uint64_t index, const RegType value) {
+    auto &&reg = _con[index];
+    reg        = MergeOp<RegType>()(reg, value);
+    if (reg == 0) {
+      _con.erase(index);
+    }
+  }
+
   inline friend sk_t operator+(const sk_t &lhs, const sk_t &rhs) {
     sk_t ret(lhs);
     ret += rhs;
@@ -185,6 +321,8 @@ class Sketch {
 
   constexpr std::size_t range_size() const { return _sf_ptr->range_size(); }
 
+  constexpr const sf_ptr_t &get_sf_ptr() const { return _sf_ptr; }
+
   constexpr std::size_t get_compaction_threshold() const {
     return _con.get_compaction_threshold();
   }
@@ -215,7 +353,7 @@ class Sketch {
    * For some reason, calling std::swap on the container here causes a "no
    * matching function compiler error". Peculiar.
    */
-  friend void swap(sk_t &lhs, sk_t &rhs) {
+  friend void swap(sk_t &lhs, sk_t &rhs) noexcept {
     std::swap(lhs._sf_ptr, rhs._sf_ptr);
     swap(lhs._con, rhs._con);
   }
@@ -228,8 +366,8 @@ class Sketch {
    *
    * https://stackoverflow.com/questions/3279543/what-is-the-copy-and-swap-idiom
    */
-  sk_t &operator=(sk_t rhs) {
-    std::swap(*this, rhs);
+  sk_t &operator=(sk_t rhs) noexcept {
+    swap(*this, rhs);
     return *this;
   }
 
@@ -0,0 +1,288 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_SKETCH_SOASPARSE_HPP
+#define _KROWKEE_SKETCH_SOASPARSE_HPP
+
+#include <krowkee/container/soa_compacting_map.hpp>
+
+#include <krowkee/sketch/registers.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace krowkee {
+namespace sketch {
+
+/**
+ * Structure-of-Arrays Sparse Sketch
+ *
+ * Drop-in alternative to Sparse that stores its index-value pairs as separate
+ * sorted index and register arrays (see
+ * krowkee::container::soa_compacting_map). Narrow registers are stored without
+ * padding, and register lookups search the index array alone.
+ */
+template <typename RegType, typename MergeOp,
+          template <typename, typename> class MapType, typename KeyType>
+class SoASparse {
+ public:
+  typedef krowkee::container::soa_compacting_map<KeyType, RegType, MapType>
+                                                        col_t;
+  typedef typename col_t::vec_iter_t                    vec_iter_t;
+  typedef typename col_t::vec_citer_t                   vec_citer_t;
+  typedef typename col_t::pair_t                        pair_t;
+  typedef typename col_t::map_t                         map_t;
+  typedef SoASparse<RegType, MergeOp, MapType, KeyType> sparse_t;
+
+ protected:
+  col_t _registers;
+
+ public:
+  template <typename... Args>
+  SoASparse(const std::uint64_t, const std::size_t compaction_threshold,
+            const Args &...)
+      : _registers(compaction_threshold) {}
+
+  /**
+   * Copy constructor.
+   */
+  SoASparse(const sparse_t &rhs) : _registers(rhs._registers) {}
+
+  // default constructor
+  SoASparse() {}
+
+  // move constructor
+  SoASparse(sparse_t &&rhs) noexcept : _registers(std::move(rhs._registers)) {}
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Cereal Archives
+  //////////////////////////////////////////////////////////////////////////////
+
+  template <class Archive>
+  void serialize(Archive &archive) {
+    archive(_registers);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Wire Format
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * @throw std::logic_error if invoked on uncompacted sketch.
+   */
+  void pack(krowkee::util::wire_writer &writer) const {
+    _registers.pack(writer);
+  }
+
+  void unpack(krowkee::util::wire_reader &reader) {
+    _registers.unpack(reader);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Compaction
+  //////////////////////////////////////////////////////////////////////////////
+
+  inline bool is_compact() const { return _registers.is_compact(); }
+
+  void compactify() { _registers.compactify(); }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Erase
+  //////////////////////////////////////////////////////////////////////////////
+
+  inline void erase(const std::uint64_t index) { _registers.erase(index); }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Merge operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Merge other SoASparse registers into `this`.
+   *
+   * MergeOp determines how register lists are combined .For linear
+   * sketches, merge amounts to the element-wise addition of register
+   * arrays.
+   *
+   * @param rhs the other SoASparse. Care must be taken to ensure that
+   *     one does not merge sketches of different types.
+   *
+   * @throw std::logic_error if invoked on uncompacted sketches.
+   */
+  inline void merge(const sparse_t &rhs) {
+    _registers.merge(rhs._registers, MergeOp());
+  }
+
+  /**
+   * Merge other SoASparse registers into `this` with `op` in place of MergeOp,
+   * e.g. `std::minus` to remove the registers of a linear sketch. Registers
+   * merged to zero are dropped.
+   *
+   * @throw std::logic_error if invoked on uncompacted sketches.
+   */
+  template <typename Op>
+  void merge_with(const sparse_t &rhs, const Op op) {
+    merge_sparse_with<RegType>(_registers, rhs._registers, op);
+  }
+
+  /**
+   * Operator overload for convenience for embeddings without additional
+   * consistency checks.
+   *
+   * @param rhs the other SoASparse. Care must be taken to ensure that
+   *     one does not merge subspace embeddings of different types.
+   */
+  sparse_t &operator+=(const sparse_t &rhs) {
+    merge(rhs);
+    return *this;
+  }
+
+  inline friend sparse_t operator+(sparse_t lhs, const sparse_t &rhs) {
+    lhs += rhs;
+    return lhs;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Register iterators
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr auto begin() { return std::begin(_registers); }
+  constexpr auto begin() const { return std::cbegin(_registers); }
+  constexpr auto cbegin() const { return std::cbegin(_registers); }
+  constexpr auto end() { return std::end(_registers); }
+  constexpr auto end() const { return std::cend(_registers); }
+  constexpr auto cend() { return std::cend(_registers); }
+
+  constexpr const RegType &operator[](const std::uint64_t index) const {
+    return _registers.at(index);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Accessors
+  //////////////////////////////////////////////////////////////////////////////
+
+  RegType &operator[](const std::uint64_t index) { return _registers[index]; }
+
+  RegType &at(const std::uint64_t index) { return _registers.at(index); }
+
+  /**
+   * Read a register without modifying the container. Registers that are not
+   * stored are zero.
+   */
+  inline RegType get(const std::uint64_t index) const {
+    return _registers.at(index, RegType(0));
+  }
+
+  RegType &at(const std::uint64_t index, const RegType def) {
+    return _registers.at(index, def);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Getters
+  //////////////////////////////////////////////////////////////////////////////
+
+  static inline std::string name() { return "SoASparse"; }
+
+  static inline std::string full_name() {
+    std::stringstream ss;
+    ss << name() << " using " << krowkee::hash::type_name<map_t>();
+    return ss.str();
+  }
+
+  constexpr bool is_sparse() const { return true; }
+
+  constexpr std::size_t size() const { return _registers.size(); }
+
+  /**
+   * Bytes used by the compacted index and register arrays.
+   */
+  inline std::size_t archive_bytes() const {
+    return _registers.archive_bytes();
+  }
+
+  constexpr std::size_t reg_size() const { return sizeof(RegType); }
+
+  constexpr std::size_t get_compaction_threshold() const {
+    return _registers.get_compaction_threshold();
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Equality operators
+  //////////////////////////////////////////////////////////////////////////////
+  constexpr bool same_registers(const sparse_t &rhs) const {
+    return _registers == rhs._registers;
+  }
+
+  friend constexpr bool operator==(const sparse_t &lhs, const sparse_t &rhs) {
+    return lhs.same_registers(rhs);
+  }
+  friend constexpr bool operator!=(const sparse_t &lhs, const sparse_t &rhs) {
+    return !operator==(lhs, rhs);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Swaps
+  //////////////////////////////////////////////////////////////////////////////
+  /**
+   * Swap boilerplate.
+   */
+  friend void swap(sparse_t &lhs, sparse_t &rhs) noexcept {
+    swap(lhs._registers, rhs._registers);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Assignment
+  //////////////////////////////////////////////////////////////////////////////
+  /**
+   * copy-and-swap assignment operator
+   *
+   * https://stackoverflow.com/questions/3279543/what-is-the-copy-and-swap-idiom
+   */
+  sparse_t &operator=(sparse_t rhs) noexcept {
+    swap(*this, rhs);
+    return *this;
+  }
+  //////////////////////////////////////////////////////////////////////////////
+  // I/O Operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Read (compacted) state out to ostream.
+   *
+   * @throw std::logic_error if invoked on uncompacted sketch.
+   */
+  friend std::ostream &operator<<(std::ostream &os, const sparse_t &sk) {
+    if (sk.is_compact() == false) {
+      throw std::logic_error("Bad attempt to write uncompacted map!");
+    }
+    for_each(sk, [&](const auto &p) {
+      os << "(" << std::int64_t(p.first) << "," << int(p.second) << ") ";
+    });
+    return os;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Accumulation
+  //////////////////////////////////////////////////////////////////////////////
+
+  template <typename RetType>
+  friend RetType accumulate(const sparse_t &sk, const RetType init) {
+    return std::accumulate(std::cbegin(sk._registers), std::cend(sk._registers),
+                           init, [](const RetType val, const pair_t &itr) {
+                             return RetType(val + itr.second);
+                           });
+  }
+
+  template <typename Func>
+  friend void for_each(const sparse_t &sk, const Func &func) {
+    std::for_each(std::cbegin(sk._registers), std::cend(sk._registers), func);
+  }
+};
+
+}  // namespace sketch
+}  // namespace krowkee
+
+#endif
\ No newline at end of file
@@ -7,14 +7,35 @@
 #define _KROWKEE_SKETCH_SPARSE_HPP
 
 #include <krowkee/container/compacting_map.hpp>
+#include <krowkee/container/open_hash_map.hpp>
+
+#include <krowkee/sketch/registers.hpp>
 
 #include <algorithm>
 #include <sstream>
+#include <utility>
 #include <vector>
 
 namespace krowkee {
 namespace sketch {
 
+/**
+ * Register column used by Sparse for a given MapType.
+ *
+ * Ordered map types stage updates in a compacting_map. An open_hash_map
+ * MapType holds the registers directly, as it needs no compaction.
+ */
+template <typename KeyType, typename RegType,
+          template <typename, typename> class MapType>
+struct sparse_column {
+  typedef krowkee::container::compacting_map<KeyType, RegType, MapType> type;
+};
+
+template <typename KeyType, typename RegType>
+struct sparse_column<KeyType, RegType, krowkee::container::open_hash_map> {
+  typedef krowkee::container::open_hash_map<KeyType, RegType> type;
+};
+
 /**
  * General Sparse Sketch
  *
@@ -28,7 +49,7 @@ template <typename RegType, typename MergeOp,
           template <typename, typename> class MapType, typename KeyType>
 class Sparse {
  public:
-  typedef krowkee::container::compacting_map<KeyType, RegType, MapType> col_t;
+  typedef typename sparse_column<KeyType, RegType, MapType>::type col_t;
   typedef typename col_t::vec_iter_t                 vec_iter_t;
   typedef typename col_t::vec_citer_t                vec_citer_t;
   typedef typename col_t::pair_t                     pair_t;
@@ -52,8 +73,8 @@ class Sparse {
   // default constructor
   Sparse() {}
 
-  // // move constructor
-  // Sparse(sparse_t &&rhs) : sparse_t() { std::swap(*this, rhs); }
+  // move constructor
+  Sparse(sparse_t &&rhs) noexcept : _registers(std::move(rhs._registers)) {}
 
   //////////////////////////////////////////////////////////////////////////////
   // Cereal Archives
@@ -64,6 +85,21 @@ class Sparse {
     archive(_registers);
   }
 
+  //////////////////////////////////////////////////////////////////////////////
+  // Wire Format
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * @throw std::logic_error if invoked on uncompacted sketch.
+   */
+  void pack(krowkee::util::wire_writer &writer) const {
+    _registers.pack(writer);
+  }
+
+  void unpack(krowkee::util::wire_reader &reader) {
+    _registers.unpack(reader);
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   // Compaction
   //////////////////////////////////////////////////////////////////////////////
@@ -98,6 +134,18 @@ class Sparse {
     _registers.merge(rhs._registers, MergeOp());
   }
 
+  /**
+   * Merge other Sparse registers into `this` with `op` in place of MergeOp,
+   * e.g. `std::minus` to remove the registers of a linear sketch. Registers
+   * merged to zero are dropped.
+   *
+   * @throw std::logic_error if invoked on uncompacted sketches.
+   */
+  template <typename Op>
+  void merge_with(const sparse_t &rhs, const Op op) {
+    merge_sparse_with<RegType>(_registers, rhs._registers, op);
+  }
+
   /**
    * Operator overload for convenience for embeddings without additional
    * consistency checks.
@@ -127,7 +175,7 @@ class Sparse {
   constexpr auto cend() { return std::cend(_registers); }
 
   constexpr const RegType &operator[](const std::uint64_t index) const {
-    return _registers.get(index);
+    return _registers.at(index);
   }
 
   //////////////////////////////////////////////////////////////////////////////
@@ -138,6 +186,14 @@ class Sparse {
 
   RegType &at(const std::uint64_t index) { return _registers.at(index); }
 
+  /**
+   * Read a register without modifying the container. Registers that are not
+   * stored are zero.
+   */
+  inline RegType get(const std::uint64_t index) const {
+    return _registers.at(index, RegType(0));
+  }
+
   RegType &at(const std::uint64_t index, const RegType def) {
     return _registers.at(index, def);
   }
@@ -160,6 +216,11 @@ class Sparse {
 
   constexpr std::size_t reg_size() const { return sizeof(RegType); }
 
+  /**
+   * Estimated bytes per stored register, including its key.
+   */
+  static constexpr std::size_t entry_bytes() { return col_t::entry_bytes(); }
+
   constexpr std::size_t get_compaction_threshold() const {
     return _registers.get_compaction_threshold();
   }
@@ -189,7 +250,7 @@ class Sparse {
    * For some reason, calling std::swap on the registers here causes a segfault
    * in Distributed::data_t::swap, but not Sketch::swap. Peculiar.
    */
-  friend void swap(sparse_t &lhs, sparse_t &rhs) {
+  friend void swap(sparse_t &lhs, sparse_t &rhs) noexcept {
     swap(lhs._registers, rhs._registers);
   }
 
@@ -201,8 +262,8 @@ class Sparse {
    *
    * https://stackoverflow.com/questions/3279543/what-is-the-copy-and-swap-idiom
    */
-  sparse_t &operator=(sparse_t rhs) {
-    std::swap(*this, rhs);
+  sparse_t &operator=(sparse_t rhs) noexcept {
+    swap(*this, rhs);
     return *this;
   }
   //////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,510 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_SKETCH_WIDENINGDENSE_HPP
+#define _KROWKEE_SKETCH_WIDENINGDENSE_HPP
+
+#if __has_include(<cereal/types/vector.hpp>)
+#include <cereal/types/vector.hpp>
+#endif
+
+#include <krowkee/util/wire.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace krowkee {
+namespace sketch {
+
+/**
+ * Dense Sketch with Bit-Packed, Widening Registers
+ *
+ * Stores a fixed-size register array like Dense, but packs the registers into
+ * 64-bit words at the narrowest width in {4, 8, 16, 32, 64} bits that holds
+ * every register value, starting at 4 bits. When an update or merge produces a
+ * value that does not fit, every register is repacked at the next sufficient
+ * width, up to the full width of `RegType`. Sketches of many small counts
+ * therefore use a fraction of the memory of `Dense<RegType, MergeOp>` while
+ * holding exactly the same register values: registers never saturate or wrap
+ * below the width of `RegType`, where `MergeOp` applies as usual (e.g.
+ * `saturating_plus` to clamp rather than wrap).
+ *
+ * Registers are read by value and written through proxy references, so
+ * `operator[]` does not return `RegType &`. Holds only integer registers.
+ */
+template <typename RegType, typename MergeOp>
+class WideningDense {
+  static_assert(std::is_integral_v<RegType> && !std::is_same_v<RegType, bool>,
+                "WideningDense requires integer registers");
+
+ public:
+  typedef std::uint64_t                   word_t;
+  typedef std::vector<word_t>             col_t;
+  typedef WideningDense<RegType, MergeOp> wd_t;
+
+  static constexpr std::size_t word_bits = 64;
+  static constexpr std::size_t min_bits  = 4;
+  static constexpr std::size_t max_bits  = 8 * sizeof(RegType);
+
+  /**
+   * Proxy reference to a packed register.
+   */
+  class reference {
+    wd_t       *_con;
+    std::size_t _index;
+
+   public:
+    reference(wd_t *con, const std::size_t index) : _con(con), _index(index) {}
+
+    operator RegType() const { return _con->get(_index); }
+
+    reference &operator=(const RegType val) {
+      _con->_set(_index, val);
+      return *this;
+    }
+    reference &operator=(const reference &rhs) {
+      return operator=(RegType(rhs));
+    }
+    reference &operator+=(const RegType val) {
+      return operator=(RegType(RegType(*this) + val));
+    }
+    reference &operator-=(const RegType val) {
+      return operator=(RegType(RegType(*this) - val));
+    }
+  };
+
+  /**
+   * Random access iterator reading registers by value.
+   */
+  class const_iterator {
+    const wd_t *_con;
+    std::size_t _index;
+
+   public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef RegType                         value_type;
+    typedef std::ptrdiff_t                  difference_type;
+    typedef const RegType                  *pointer;
+    typedef RegType                         reference;
+
+    const_iterator() : _con(nullptr), _index(0) {}
+    const_iterator(const wd_t *con, const std::size_t index)
+        : _con(con), _index(index) {}
+
+    RegType operator*() const { return _con->get(_index); }
+    RegType operator[](const difference_type n) const {
+      return _con->get(_index + n);
+    }
+
+    const_iterator &operator++() {
+      ++_index;
+      return *this;
+    }
+    const_iterator operator++(int) { return const_iterator(_con, _index++); }
+    const_iterator &operator--() {
+      --_index;
+      return *this;
+    }
+    const_iterator operator--(int) { return const_iterator(_con, _index--); }
+    const_iterator &operator+=(const difference_type n) {
+      _index += n;
+      return *this;
+    }
+    const_iterator &operator-=(const difference_type n) {
+      _index -= n;
+      return *this;
+    }
+    friend const_iterator operator+(const_iterator iter,
+                                    const difference_type n) {
+      return iter += n;
+    }
+    friend const_iterator operator+(const difference_type n,
+                                    const_iterator        iter) {
+      return iter += n;
+    }
+    friend const_iterator operator-(const_iterator iter,
+                                    const difference_type n) {
+      return iter -= n;
+    }
+    friend difference_type operator-(const const_iterator &lhs,
+                                     const const_iterator &rhs) {
+      return difference_type(lhs._index) - difference_type(rhs._index);
+    }
+
+    friend bool operator==(const const_iterator &lhs,
+                           const const_iterator &rhs) {
+      return lhs._index == rhs._index;
+    }
+    friend bool operator!=(const const_iterator &lhs,
+                           const const_iterator &rhs) {
+      return lhs._index != rhs._index;
+    }
+    friend bool operator<(const const_iterator &lhs,
+                          const const_iterator &rhs) {
+      return lhs._index < rhs._index;
+    }
+    friend bool operator>(const const_iterator &lhs,
+                          const const_iterator &rhs) {
+      return lhs._index > rhs._index;
+    }
+    friend bool operator<=(const const_iterator &lhs,
+                           const const_iterator &rhs) {
+      return lhs._index <= rhs._index;
+    }
+    friend bool operator>=(const const_iterator &lhs,
+                           const const_iterator &rhs) {
+      return lhs._index >= rhs._index;
+    }
+  };
+
+  typedef const_iterator iterator;
+
+ protected:
+  col_t       _words;
+  std::size_t _size;
+  std::size_t _bits;
+
+ public:
+  template <typename... Args>
+  WideningDense(const std::uint64_t range_size, const Args &...)
+      : _words(_word_count(range_size, min_bits), 0),
+        _size(range_size),
+        _bits(min_bits) {}
+
+  // copy constructor
+  WideningDense(const wd_t &rhs)
+      : _words(rhs._words), _size(rhs._size), _bits(rhs._bits) {}
+
+  // default constructor
+  WideningDense() : _size(0), _bits(min_bits) {}
+
+  // move constructor
+  WideningDense(wd_t &&rhs) noexcept
+      : _words(std::move(rhs._words)), _size(rhs._size), _bits(rhs._bits) {}
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Cereal Archives
+  //////////////////////////////////////////////////////////////////////////////
+
+#if __has_include(<cereal/types/vector.hpp>)
+  template <class Archive>
+  void serialize(Archive &archive) {
+    archive(_size, _bits, _words);
+  }
+#endif
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Wire Format
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Write the register width and the unpacked register values, which the
+   * wire format bit-packs at their actual width.
+   */
+  void pack(krowkee::util::wire_writer &writer) const {
+    writer.put_varint(_bits);
+    const std::vector<RegType> values(get_registers());
+    writer.put_array(values.data(), values.size());
+  }
+
+  /**
+   * @throws std::out_of_range if the register width is not a power of two
+   *     between `min_bits` and `max_bits`.
+   */
+  void unpack(krowkee::util::wire_reader &reader) {
+    const std::size_t bits(reader.get_varint());
+    if (bits < min_bits || bits > max_bits || (bits & (bits - 1)) != 0) {
+      std::stringstream ss;
+      ss << "error: attempting to unpack " << bits
+         << " bit registers into a WideningDense!";
+      throw std::out_of_range(ss.str());
+    }
+    const std::vector<RegType> values(reader.get_array<RegType>());
+    _size = values.size();
+    _bits = bits;
+    _words.assign(_word_count(_size, _bits), 0);
+    for (std::size_t i(0); i < _size; ++i) {
+      if (values[i] != 0) {
+        _set(i, values[i]);
+      }
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Compactify
+  //////////////////////////////////////////////////////////////////////////////
+
+  void compactify() {}
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Erase
+  //////////////////////////////////////////////////////////////////////////////
+
+  inline void erase(const std::uint64_t) {}
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Merge operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Merge other WideningDense registers into `this`.
+   *
+   * Widens `this` to at least the width of `rhs` first, and further if any
+   * merged register requires it.
+   *
+   * @param rhs the other WideningDense. Care must be taken to ensure that
+   *     one does not merge sketches of different types.
+   *
+   * @throws std::invalid_argument if the register sizes do not match.
+   */
+  inline void merge(const wd_t &rhs) { merge_with(rhs, MergeOp()); }
+
+  /**
+   * As `merge`, with `op` in place of MergeOp, e.g. `std::minus` to remove
+   * the registers of a linear sketch.
+   */
+  template <typename Op>
+  void merge_with(const wd_t &rhs, const Op op) {
+    if (size() != rhs.size()) {
+      std::stringstream ss;
+      ss << "error: attempting to merge embedding 1 of dimension " << size()
+         << " with embedding 2 of dimension " << rhs.size();
+      throw std::invalid_argument(ss.str());
+    }
+    if (rhs._bits > _bits) {
+      _widen(rhs._bits);
+    }
+    for (std::size_t i(0); i < _size; ++i) {
+      const RegType rhs_reg(rhs.get(i));
+      if (rhs_reg != 0) {
+        _set(i, op(get(i), rhs_reg));
+      }
+    }
+  }
+
+  wd_t &operator+=(const wd_t &rhs) {
+    merge(rhs);
+    return *this;
+  }
+
+  inline friend wd_t operator+(wd_t lhs, const wd_t &rhs) {
+    lhs += rhs;
+    return lhs;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Register iterators
+  //////////////////////////////////////////////////////////////////////////////
+
+  inline const_iterator begin() const { return const_iterator(this, 0); }
+  inline const_iterator cbegin() const { return begin(); }
+  inline const_iterator end() const { return const_iterator(this, _size); }
+  inline const_iterator cend() const { return end(); }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Accessors
+  //////////////////////////////////////////////////////////////////////////////
+
+  inline RegType operator[](const std::uint64_t index) const {
+    return get(index);
+  }
+
+  inline reference operator[](const std::uint64_t index) {
+    return reference(this, index);
+  }
+
+  /**
+   * Read a register without modifying the container.
+   */
+  inline RegType get(const std::uint64_t index) const {
+    const std::size_t bit(index * _bits);
+    const word_t      raw((_words[bit / word_bits] >> (bit % word_bits)) &
+                     _mask(_bits));
+    if constexpr (std::is_signed_v<RegType>) {
+      // sign-extend the packed two's complement value
+      const word_t sign(word_t(1) << (_bits - 1));
+      return RegType(std::int64_t((raw ^ sign) - sign));
+    } else {
+      return RegType(raw);
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Getters
+  //////////////////////////////////////////////////////////////////////////////
+
+  static inline std::string name() { return "WideningDense"; }
+
+  static inline std::string full_name() { return name(); }
+
+  constexpr bool is_sparse() const { return false; }
+
+  constexpr std::size_t size() const { return _size; }
+
+  constexpr std::size_t reg_size() const { return sizeof(RegType); }
+
+  constexpr std::size_t get_compaction_threshold() const { return 0; }
+
+  /**
+   * Current width of each packed register in bits.
+   */
+  constexpr std::size_t register_bits() const { return _bits; }
+
+  /**
+   * Bytes of register storage.
+   */
+  inline std::size_t memory_bytes() const {
+    return _words.size() * sizeof(word_t);
+  }
+
+  const std::vector<RegType> get_registers() const {
+    return std::vector<RegType>(begin(), end());
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Equality operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Registers are compared by value, regardless of their packed widths.
+   */
+  inline bool same_registers(const wd_t &rhs) const {
+    if (_bits == rhs._bits) {
+      return _size == rhs._size && _words == rhs._words;
+    }
+    return _size == rhs._size && std::equal(begin(), end(), rhs.begin());
+  }
+
+  friend bool operator==(const wd_t &lhs, const wd_t &rhs) {
+    return lhs.same_registers(rhs);
+  }
+  friend bool operator!=(const wd_t &lhs, const wd_t &rhs) {
+    return !operator==(lhs, rhs);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Swaps
+  //////////////////////////////////////////////////////////////////////////////
+
+  friend void swap(wd_t &lhs, wd_t &rhs) noexcept {
+    std::swap(lhs._words, rhs._words);
+    std::swap(lhs._size, rhs._size);
+    std::swap(lhs._bits, rhs._bits);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Assignment
+  //////////////////////////////////////////////////////////////////////////////
+  /**
+   * copy-and-swap assignment operator
+   *
+   * https://stackoverflow.com/questions/3279543/what-is-the-copy-and-swap-idiom
+   */
+  wd_t &operator=(wd_t rhs) noexcept {
+    swap(*this, rhs);
+    return *this;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // I/O Operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  friend std::ostream &operator<<(std::ostream &os, const wd_t &sk) {
+    int idx = 0;
+    for_each(sk, [&](const auto &p) {
+      if (idx != 0) {
+        os << " ";
+      }
+      os << "(" << idx++ << "," << std::int64_t(p) << ")";
+    });
+    return os;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Accumulation
+  //////////////////////////////////////////////////////////////////////////////
+
+  template <typename RetType>
+  friend RetType accumulate(const wd_t &sk, const RetType init) {
+    return std::accumulate(std::cbegin(sk), std::cend(sk), init);
+  }
+
+  template <typename Func>
+  friend void for_each(const wd_t &sk, const Func &func) {
+    std::for_each(std::cbegin(sk), std::cend(sk), func);
+  }
+
+ private:
+  static constexpr word_t _mask(const std::size_t bits) {
+    return (bits == word_bits) ? ~word_t(0) : (word_t(1) << bits) - 1;
+  }
+
+  static constexpr std::size_t _word_count(const std::size_t size,
+                                           const std::size_t bits) {
+    return (size * bits + word_bits - 1) / word_bits;
+  }
+
+  /**
+   * Narrowest supported width holding `val`, and at least `_bits`.
+   */
+  inline std::size_t _bits_for(const RegType val) const {
+    std::size_t bits(_bits);
+    while (bits < max_bits) {
+      if constexpr (std::is_signed_v<RegType>) {
+        const std::int64_t bound(std::int64_t(1) << (bits - 1));
+        if (std::int64_t(val) >= -bound && std::int64_t(val) < bound) {
+          break;
+        }
+      } else {
+        if (std::uint64_t(val) <= _mask(bits)) {
+          break;
+        }
+      }
+      bits *= 2;
+    }
+    return bits;
+  }
+
+  inline void _set(const std::size_t index, const RegType val) {
+    const std::size_t bits(_bits_for(val));
+    if (bits > _bits) {
+      _widen(bits);
+    }
+    const std::size_t bit(index * _bits);
+    const std::size_t shift(bit % word_bits);
+    word_t           &word(_words[bit / word_bits]);
+    word = (word & ~(_mask(_bits) << shift)) |
+           ((word_t(val) & _mask(_bits)) << shift);
+  }
+
+  /**
+   * Repack every register at `bits` bits.
+   */
+  void _widen(const std::size_t bits) {
+    wd_t wider;
+    wider._size = _size;
+    wider._bits = bits;
+    wider._words.assign(_word_count(_size, bits), 0);
+    for (std::size_t i(0); i < _size; ++i) {
+      const RegType val(get(i));
+      if (val != 0) {
+        wider._set(i, val);
+      }
+    }
+    swap(*this, wider);
+  }
+};
+
+}  // namespace sketch
+}  // namespace krowkee
+
+#endif
@@ -0,0 +1,274 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_SKETCH_HEAVY_HITTERS_HPP
+#define _KROWKEE_SKETCH_HEAVY_HITTERS_HPP
+
+#include <krowkee/util/wire.hpp>
+
+#if __has_include(<cereal/types/utility.hpp>)
+#include <cereal/types/utility.hpp>
+#include <cereal/types/vector.hpp>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace krowkee {
+namespace sketch {
+
+/**
+ * Bounded table of heavy hitter candidates.
+ *
+ * Holds at most `capacity()` items along with their most recent point
+ * estimates, as in Charikar et al.'s top-k algorithm for CountSketch. An item
+ * whose fresh estimate exceeds the smallest tracked estimate displaces that
+ * candidate once the table is full. The caller supplies the estimates, so
+ * that the table can accompany any sketch supporting point queries.
+ *
+ * Candidates are stored in a flat array and found by linear scan, which is
+ * faster than hashing for the small capacities heavy hitter queries use.
+ */
+template <typename RegType>
+class heavy_hitters {
+ public:
+  typedef std::pair<std::uint64_t, RegType> candidate_t;
+  typedef std::vector<candidate_t>          candidates_t;
+
+ private:
+  std::size_t  _capacity;
+  candidates_t _candidates;
+
+ public:
+  /**
+   * @param capacity the maximum number of tracked candidates.
+   *
+   * @throws std::invalid_argument if `capacity` is zero.
+   */
+  heavy_hitters(const std::size_t capacity) : _capacity(capacity) {
+    if (capacity == 0) {
+      throw std::invalid_argument(
+          "error: heavy hitter capacity must be positive!");
+    }
+    _candidates.reserve(capacity);
+  }
+
+  heavy_hitters() : _capacity(0) {}
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Cereal Archives
+  //////////////////////////////////////////////////////////////////////////////
+
+  template <class Archive>
+  void serialize(Archive &archive) {
+    archive(_capacity, _candidates);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Wire Format
+  //////////////////////////////////////////////////////////////////////////////
+
+  void pack(krowkee::util::wire_writer &writer) const {
+    writer.put_varint(_candidates.size());
+    for (const candidate_t &candidate : _candidates) {
+      writer.put(candidate.first);
+      writer.put(candidate.second);
+    }
+  }
+
+  /**
+   * Replace the candidates with packed ones, keeping the capacity.
+   */
+  void unpack(krowkee::util::wire_reader &reader) {
+    const std::size_t size(reader.get_varint());
+    _candidates.resize(size);
+    for (candidate_t &candidate : _candidates) {
+      candidate.first  = reader.get<std::uint64_t>();
+      candidate.second = reader.get<RegType>();
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Updates
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Record the current point estimate of `item`.
+   *
+   * A tracked item takes the new estimate. Otherwise the item is added if
+   * there is room, or replaces the smallest candidate if `estimate` exceeds
+   * it. A default-constructed table has no room and ignores updates.
+   *
+   * @param item the item just inserted.
+   * @param estimate its point estimate after the insertion.
+   */
+  void update(const std::uint64_t item, const RegType estimate) {
+    if (_capacity == 0) {
+      return;
+    }
+    std::size_t min_pos(0);
+    for (std::size_t i(0); i < _candidates.size(); ++i) {
+      if (_candidates[i].first == item) {
+        _candidates[i].second = estimate;
+        return;
+      }
+      if (_candidates[i].second < _candidates[min_pos].second) {
+        min_pos = i;
+      }
+    }
+    if (_candidates.size() < _capacity) {
+      _candidates.emplace_back(item, estimate);
+    } else if (_candidates[min_pos].second < estimate) {
+      _candidates[min_pos] = {item, estimate};
+    }
+  }
+
+  /**
+   * Add the candidates of `rhs` and re-estimate all of them.
+   *
+   * After a sketch merge the stored estimates of both sides are stale, so
+   * every candidate is re-estimated against the merged registers and the
+   * best `capacity()` are kept.
+   *
+   * @param rhs the other table.
+   * @param estimate functor returning the point estimate of an item in the
+   *     merged sketch.
+   */
+  template <typename EstimateFunc>
+  void merge(const heavy_hitters &rhs, const EstimateFunc &estimate) {
+    for (const candidate_t &candidate : rhs._candidates) {
+      _add(candidate.first);
+    }
+    refresh(estimate);
+  }
+
+  /**
+   * As `merge(rhs, estimate)`, for candidate items gathered elsewhere.
+   */
+  template <typename EstimateFunc>
+  void merge(const std::vector<std::uint64_t> &items,
+             const EstimateFunc               &estimate) {
+    for (const std::uint64_t item : items) {
+      _add(item);
+    }
+    refresh(estimate);
+  }
+
+  /**
+   * The tracked items, in ascending order.
+   */
+  std::vector<std::uint64_t> items() const {
+    std::vector<std::uint64_t> ret;
+    ret.reserve(_candidates.size());
+    for (const candidate_t &candidate : _candidates) {
+      ret.push_back(candidate.first);
+    }
+    std::sort(std::begin(ret), std::end(ret));
+    return ret;
+  }
+
+  /**
+   * Re-estimate every candidate, keeping the best `capacity()`.
+   */
+  template <typename EstimateFunc>
+  void refresh(const EstimateFunc &estimate) {
+    for (candidate_t &candidate : _candidates) {
+      candidate.second = estimate(candidate.first);
+    }
+    if (_candidates.size() > _capacity) {
+      std::nth_element(std::begin(_candidates),
+                       std::begin(_candidates) + _capacity,
+                       std::end(_candidates), _better);
+      _candidates.resize(_capacity);
+    }
+  }
+
+  void clear() { _candidates.clear(); }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Queries
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * The `k` candidates with the largest estimates, largest first. Ties are
+   * broken by item.
+   */
+  candidates_t top(const std::size_t k) const {
+    candidates_t      ret(_candidates);
+    const std::size_t keep(std::min(k, ret.size()));
+    std::partial_sort(std::begin(ret), std::begin(ret) + keep, std::end(ret),
+                      _better);
+    ret.resize(keep);
+    return ret;
+  }
+
+  /**
+   * All candidates, largest estimate first.
+   */
+  candidates_t top() const { return top(_candidates.size()); }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Getters
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr std::size_t size() const { return _candidates.size(); }
+
+  constexpr std::size_t capacity() const { return _capacity; }
+
+  constexpr const candidates_t &candidates() const { return _candidates; }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Equality operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Tables are equal if they track the same candidates and estimates,
+   * regardless of order.
+   */
+  friend bool operator==(const heavy_hitters &lhs, const heavy_hitters &rhs) {
+    return lhs._capacity == rhs._capacity && lhs.top() == rhs.top();
+  }
+  friend bool operator!=(const heavy_hitters &lhs, const heavy_hitters &rhs) {
+    return !operator==(lhs, rhs);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // I/O Operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  friend std::ostream &operator<<(std::ostream        &os,
+                                  const heavy_hitters &table) {
+    for (const candidate_t &candidate : table.top()) {
+      os << "(" << candidate.first << ": " << std::int64_t(candidate.second)
+         << ") ";
+    }
+    return os;
+  }
+
+ private:
+  inline void _add(const std::uint64_t item) {
+    if (std::none_of(
+            std::begin(_candidates), std::end(_candidates),
+            [item](const candidate_t &lhs) { return lhs.first == item; })) {
+      _candidates.emplace_back(item, RegType(0));
+    }
+  }
+
+  static inline bool _better(const candidate_t &lhs, const candidate_t &rhs) {
+    if (lhs.second != rhs.second) {
+      return lhs.second > rhs.second;
+    }
+    return lhs.first < rhs.first;
+  }
+};
+
+}  // namespace sketch
+}  // namespace krowkee
+
+#endif
@@ -10,13 +10,22 @@
 
 #include <krowkee/transform/CountSketch.hpp>
 #include <krowkee/transform/FWHT.hpp>
+#include <krowkee/transform/FixedCountSketch.hpp>
+#include <krowkee/transform/MultiRowCountSketch.hpp>
 
+#include <krowkee/sketch/ConcurrentDense.hpp>
 #include <krowkee/sketch/Dense.hpp>
+#include <krowkee/sketch/FixedDense.hpp>
 #include <krowkee/sketch/Promotable.hpp>
+#include <krowkee/sketch/SoASparse.hpp>
 #include <krowkee/sketch/Sparse.hpp>
+#include <krowkee/sketch/WideningDense.hpp>
 
 #include <krowkee/sketch/Sketch.hpp>
 
+#include <krowkee/container/open_hash_map.hpp>
+#include <krowkee/container/staging_buffer.hpp>
+
 #if __has_include(<ygm/comm.hpp>)
 #include <ygm/detail/ygm_ptr.hpp>
 #endif
@@ -35,6 +44,20 @@
 namespace krowkee {
 namespace sketch {
 
+/**
+ * Binds a compile-time range size to the fixed-range container and sketch
+ * functor, so that they fit the template parameters of Sketch.
+ */
+template <std::size_t RangeSize>
+struct fixed_range {
+  template <typename RegType, typename MergeOp>
+  using Dense = FixedDense<RegType, MergeOp, RangeSize>;
+
+  template <typename RegType, typename... Args>
+  using CountSketchFunctor =
+      krowkee::transform::FixedCountSketchFunctor<RegType, RangeSize>;
+};
+
 template <template <typename, typename...> class SketchFunc,
           template <typename, typename> class ContainerType,
           template <typename> class MergeOp, typename RegType, typename... Args>
@@ -50,6 +73,20 @@ template <typename RegType>
 using LocalFWHT = LocalSketch<krowkee::transform::FWHTFunctor,
                               krowkee::sketch::Dense, std::plus, RegType>;
 
+template <template <typename, typename> class ContainerType, typename RegType>
+using LocalMultiRowCountSketch =
+    LocalSketch<krowkee::transform::MultiRowCountSketchFunctor, ContainerType,
+                std::plus, RegType>;
+
+/**
+ * CountSketch with `RangeSize` registers fixed at compile time, held inline
+ * in each sketch.
+ */
+template <typename RegType, std::size_t RangeSize>
+using LocalFixedCountSketch =
+    LocalSketch<fixed_range<RangeSize>::template CountSketchFunctor,
+                fixed_range<RangeSize>::template Dense, std::plus, RegType>;
+
 }  // namespace sketch
 }  // namespace krowkee
 
@@ -73,6 +110,17 @@ using CommunicableFWHT =
     CommunicableSketch<krowkee::transform::FWHTFunctor, krowkee::sketch::Dense,
                        std::plus, RegType>;
 
+template <template <typename, typename> class ContainerType, typename RegType>
+using CommunicableMultiRowCountSketch =
+    CommunicableSketch<krowkee::transform::MultiRowCountSketchFunctor,
+                       ContainerType, std::plus, RegType>;
+
+template <typename RegType, std::size_t RangeSize>
+using CommunicableFixedCountSketch =
+    CommunicableSketch<fixed_range<RangeSize>::template CountSketchFunctor,
+                       fixed_range<RangeSize>::template Dense, std::plus,
+                       RegType>;
+
 }  // namespace sketch
 }  // namespace krowkee
 #endif
@@ -90,6 +138,33 @@ using MapSparse = Sparse<RegType, MergeOp, std::map, KeyType>;
 template <typename RegType, typename MergeOp>
 using MapSparse32 = MapSparse<RegType, MergeOp, std::uint32_t>;
 
+template <typename RegType, typename MergeOp, typename KeyType>
+using StagingSparse =
+    Sparse<RegType, MergeOp, krowkee::container::staging_buffer, KeyType>;
+
+template <typename RegType, typename MergeOp>
+using StagingSparse32 = StagingSparse<RegType, MergeOp, std::uint32_t>;
+
+template <typename RegType, typename MergeOp, typename KeyType>
+using HashSparse =
+    Sparse<RegType, MergeOp, krowkee::container::open_hash_map, KeyType>;
+
+template <typename RegType, typename MergeOp>
+using HashSparse32 = HashSparse<RegType, MergeOp, std::uint32_t>;
+
+template <typename RegType, typename MergeOp, typename KeyType>
+using MapSoASparse = SoASparse<RegType, MergeOp, std::map, KeyType>;
+
+template <typename RegType, typename MergeOp>
+using MapSoASparse32 = MapSoASparse<RegType, MergeOp, std::uint32_t>;
+
+template <typename RegType, typename MergeOp, typename KeyType>
+using StagingSoASparse =
+    SoASparse<RegType, MergeOp, krowkee::container::staging_buffer, KeyType>;
+
+template <typename RegType, typename MergeOp>
+using StagingSoASparse32 = StagingSoASparse<RegType, MergeOp, std::uint32_t>;
+
 #if __has_include(<boost/container/flat_map.hpp>)
 template <typename RegType, typename MergeOp, typename KeyType>
 using FlatMapSparse =
@@ -97,6 +172,13 @@ using FlatMapSparse =
 
 template <typename RegType, typename MergeOp>
 using FlatMapSparse32 = FlatMapSparse<RegType, MergeOp, std::uint32_t>;
+
+template <typename RegType, typename MergeOp, typename KeyType>
+using FlatMapSoASparse =
+    SoASparse<RegType, MergeOp, boost::container::flat_map, KeyType>;
+
+template <typename RegType, typename MergeOp>
+using FlatMapSoASparse32 = FlatMapSoASparse<RegType, MergeOp, std::uint32_t>;
 #endif
 
 }  // namespace sketch
@@ -115,6 +197,37 @@ using MapPromotable = Promotable<RegType, MergeOp, std::map, KeyType>;
 template <typename RegType, typename MergeOp>
 using MapPromotable32 = MapPromotable<RegType, MergeOp, std::uint32_t>;
 
+template <typename RegType, typename MergeOp, typename KeyType>
+using StagingPromotable =
+    Promotable<RegType, MergeOp, krowkee::container::staging_buffer, KeyType>;
+
+template <typename RegType, typename MergeOp>
+using StagingPromotable32 = StagingPromotable<RegType, MergeOp, std::uint32_t>;
+
+template <typename RegType, typename MergeOp, typename KeyType>
+using HashPromotable =
+    Promotable<RegType, MergeOp, krowkee::container::open_hash_map, KeyType>;
+
+template <typename RegType, typename MergeOp>
+using HashPromotable32 = HashPromotable<RegType, MergeOp, std::uint32_t>;
+
+template <typename RegType, typename MergeOp, typename KeyType>
+using MapWideningPromotable =
+    WideningPromotable<RegType, MergeOp, std::map, KeyType>;
+
+template <typename RegType, typename MergeOp>
+using MapWideningPromotable32 =
+    MapWideningPromotable<RegType, MergeOp, std::uint32_t>;
+
+template <typename RegType, typename MergeOp, typename KeyType>
+using HashWideningPromotable =
+    WideningPromotable<RegType, MergeOp, krowkee::container::open_hash_map,
+                       KeyType>;
+
+template <typename RegType, typename MergeOp>
+using HashWideningPromotable32 =
+    HashWideningPromotable<RegType, MergeOp, std::uint32_t>;
+
 #if __has_include(<boost/container/flat_map.hpp>)
 template <typename RegType, typename MergeOp, typename KeyType>
 using FlatMapPromotable =
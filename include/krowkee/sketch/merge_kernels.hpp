@@ -0,0 +1,286 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_SKETCH_MERGE_KERNELS_HPP
+#define _KROWKEE_SKETCH_MERGE_KERNELS_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <type_traits>
+
+#if !defined(KROWKEE_DISABLE_SIMD)
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+#define KROWKEE_MERGE_SIMD_AVX512
+#include <immintrin.h>
+#elif defined(__AVX2__)
+#define KROWKEE_MERGE_SIMD_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace krowkee {
+namespace sketch {
+
+////////////////////////////////////////////////////////////////////////////////
+// Saturating Addition
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Add two registers, clamping integer results to the range of `T`.
+ *
+ * Floating point registers add normally.
+ *
+ * CURRENTLY NOT PORTABLE. Uses `__builtin_add_overflow`.
+ */
+template <typename T>
+constexpr T saturating_add(const T lhs, const T rhs) {
+  if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>) {
+    T ret(0);
+    if (__builtin_add_overflow(lhs, rhs, &ret)) {
+      if constexpr (std::is_signed_v<T>) {
+        if (rhs < 0) {
+          return std::numeric_limits<T>::min();
+        }
+      }
+      return std::numeric_limits<T>::max();
+    }
+    return ret;
+  } else {
+    return lhs + rhs;
+  }
+}
+
+/**
+ * Merge operator for registers that must not wrap, e.g. narrow counters.
+ *
+ * A drop-in replacement for `std::plus` as the `MergeOp` of a sketch.
+ */
+template <typename T>
+struct saturating_plus {
+  constexpr T operator()(const T lhs, const T rhs) const {
+    return saturating_add(lhs, rhs);
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Register Block Kernels
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Block kernels backing Dense merges.
+ *
+ * The instruction set is chosen at compile time from the target flags (e.g.
+ * `-mavx2`, or `-mavx512f -mavx512bw`). Defining `KROWKEE_DISABLE_SIMD` forces
+ * the scalar loops. Every path is bit-identical to applying `std::plus` or
+ * `saturating_plus` element-wise.
+ *
+ * Wrapping addition is vectorized for all integer and floating point register
+ * types. Saturating addition is vectorized for 8- and 16-bit integers, which
+ * have native saturating instructions and are where saturation matters; wider
+ * integers use the scalar loop.
+ */
+namespace simd {
+
+/**
+ * Name of the instruction set used by the merge kernels.
+ */
+constexpr const char *isa_name() {
+#if defined(KROWKEE_MERGE_SIMD_AVX512)
+  return "AVX-512";
+#elif defined(KROWKEE_MERGE_SIMD_AVX2)
+  return "AVX2";
+#else
+  return "scalar";
+#endif
+}
+
+#if defined(KROWKEE_MERGE_SIMD_AVX512)
+typedef __m512i ivec_t;
+constexpr std::size_t vec_bytes = 64;
+
+inline ivec_t load(const void *in) { return _mm512_loadu_si512(in); }
+inline void   store(void *out, const ivec_t v) { _mm512_storeu_si512(out, v); }
+
+template <std::size_t Width>
+inline ivec_t add(const ivec_t a, const ivec_t b) {
+  if constexpr (Width == 1) {
+    return _mm512_add_epi8(a, b);
+  } else if constexpr (Width == 2) {
+    return _mm512_add_epi16(a, b);
+  } else if constexpr (Width == 4) {
+    return _mm512_add_epi32(a, b);
+  } else {
+    return _mm512_add_epi64(a, b);
+  }
+}
+
+template <typename T>
+inline ivec_t adds(const ivec_t a, const ivec_t b) {
+  if constexpr (std::is_same_v<T, std::int8_t>) {
+    return _mm512_adds_epi8(a, b);
+  } else if constexpr (std::is_same_v<T, std::uint8_t>) {
+    return _mm512_adds_epu8(a, b);
+  } else if constexpr (std::is_same_v<T, std::int16_t>) {
+    return _mm512_adds_epi16(a, b);
+  } else {
+    return _mm512_adds_epu16(a, b);
+  }
+}
+
+inline void add_block(float *lhs, const float *rhs) {
+  _mm512_storeu_ps(lhs, _mm512_add_ps(_mm512_loadu_ps(lhs),
+                                      _mm512_loadu_ps(rhs)));
+}
+inline void add_block(double *lhs, const double *rhs) {
+  _mm512_storeu_pd(lhs, _mm512_add_pd(_mm512_loadu_pd(lhs),
+                                      _mm512_loadu_pd(rhs)));
+}
+#elif defined(KROWKEE_MERGE_SIMD_AVX2)
+typedef __m256i ivec_t;
+constexpr std::size_t vec_bytes = 32;
+
+inline ivec_t load(const void *in) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in));
+}
+inline void store(void *out, const ivec_t v) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), v);
+}
+
+template <std::size_t Width>
+inline ivec_t add(const ivec_t a, const ivec_t b) {
+  if constexpr (Width == 1) {
+    return _mm256_add_epi8(a, b);
+  } else if constexpr (Width == 2) {
+    return _mm256_add_epi16(a, b);
+  } else if constexpr (Width == 4) {
+    return _mm256_add_epi32(a, b);
+  } else {
+    return _mm256_add_epi64(a, b);
+  }
+}
+
+template <typename T>
+inline ivec_t adds(const ivec_t a, const ivec_t b) {
+  if constexpr (std::is_same_v<T, std::int8_t>) {
+    return _mm256_adds_epi8(a, b);
+  } else if constexpr (std::is_same_v<T, std::uint8_t>) {
+    return _mm256_adds_epu8(a, b);
+  } else if constexpr (std::is_same_v<T, std::int16_t>) {
+    return _mm256_adds_epi16(a, b);
+  } else {
+    return _mm256_adds_epu16(a, b);
+  }
+}
+
+inline void add_block(float *lhs, const float *rhs) {
+  _mm256_storeu_ps(lhs, _mm256_add_ps(_mm256_loadu_ps(lhs),
+                                      _mm256_loadu_ps(rhs)));
+}
+inline void add_block(double *lhs, const double *rhs) {
+  _mm256_storeu_pd(lhs, _mm256_add_pd(_mm256_loadu_pd(lhs),
+                                      _mm256_loadu_pd(rhs)));
+}
+#endif
+
+#if defined(KROWKEE_MERGE_SIMD_AVX512) || defined(KROWKEE_MERGE_SIMD_AVX2)
+#define KROWKEE_MERGE_SIMD
+#endif
+
+/**
+ * Whether `add_many` uses vector instructions for `T`.
+ */
+template <typename T>
+constexpr bool has_vector_add() {
+#if defined(KROWKEE_MERGE_SIMD)
+  return std::is_same_v<T, float> || std::is_same_v<T, double> ||
+         (std::is_integral_v<T> && !std::is_same_v<T, bool>);
+#else
+  return false;
+#endif
+}
+
+/**
+ * Whether `saturating_add_many` uses vector instructions for `T`.
+ */
+template <typename T>
+constexpr bool has_vector_saturating_add() {
+#if defined(KROWKEE_MERGE_SIMD)
+  return std::is_same_v<T, std::int8_t> || std::is_same_v<T, std::uint8_t> ||
+         std::is_same_v<T, std::int16_t> || std::is_same_v<T, std::uint16_t>;
+#else
+  return false;
+#endif
+}
+
+/**
+ * Compute `lhs[i] = lhs[i] + rhs[i]` for `i` in `[0, n)`, wrapping on integer
+ * overflow as `std::plus` does.
+ */
+template <typename T>
+inline void add_many(T *lhs, const T *rhs, const std::size_t n) {
+  std::size_t i(0);
+#if defined(KROWKEE_MERGE_SIMD)
+  if constexpr (has_vector_add<T>()) {
+    constexpr std::size_t lanes(vec_bytes / sizeof(T));
+    for (; i + lanes <= n; i += lanes) {
+      if constexpr (std::is_floating_point_v<T>) {
+        add_block(lhs + i, rhs + i);
+      } else {
+        store(lhs + i, add<sizeof(T)>(load(lhs + i), load(rhs + i)));
+      }
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    lhs[i] = std::plus<T>()(lhs[i], rhs[i]);
+  }
+}
+
+/**
+ * Compute `lhs[i] = saturating_add(lhs[i], rhs[i])` for `i` in `[0, n)`.
+ */
+template <typename T>
+inline void saturating_add_many(T *lhs, const T *rhs, const std::size_t n) {
+  std::size_t i(0);
+#if defined(KROWKEE_MERGE_SIMD)
+  if constexpr (has_vector_saturating_add<T>()) {
+    constexpr std::size_t lanes(vec_bytes / sizeof(T));
+    for (; i + lanes <= n; i += lanes) {
+      store(lhs + i, adds<T>(load(lhs + i), load(rhs + i)));
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    lhs[i] = saturating_add(lhs[i], rhs[i]);
+  }
+}
+
+}  // namespace simd
+
+/**
+ * Compute `lhs[i] = MergeOp()(lhs[i], rhs[i])` for `i` in `[0, n)`.
+ *
+ * Dispatches `std::plus` and `saturating_plus` to the vectorized kernels and
+ * applies any other MergeOp element-wise.
+ */
+template <typename RegType, typename MergeOp>
+inline void merge_registers(RegType *lhs, const RegType *rhs,
+                            const std::size_t n) {
+  if constexpr (std::is_same_v<MergeOp, std::plus<RegType>>) {
+    simd::add_many(lhs, rhs, n);
+  } else if constexpr (std::is_same_v<MergeOp, saturating_plus<RegType>>) {
+    simd::saturating_add_many(lhs, rhs, n);
+  } else {
+    std::transform(lhs, lhs + n, rhs, lhs, MergeOp());
+  }
+}
+
+}  // namespace sketch
+}  // namespace krowkee
+
+#endif
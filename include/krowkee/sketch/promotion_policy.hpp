@@ -0,0 +1,165 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_SKETCH_PROMOTION_POLICY_HPP
+#define _KROWKEE_SKETCH_PROMOTION_POLICY_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+
+namespace krowkee {
+namespace sketch {
+
+/**
+ * Decides when a Promotable container switches between Sparse and Dense.
+ *
+ * A policy either promotes at a fixed number of sparse registers, or compares
+ * the estimated footprint of the sparse registers against that of the dense
+ * register array. In the latter case a sketch is promoted once
+ *
+ *     size * entry_bytes > promotion_factor * range_size * reg_bytes,
+ *
+ * and a dense sketch is demoted back to sparse once its nonzero registers
+ * would fit in less than `demotion_factor` times the dense footprint. Keeping
+ * `demotion_factor` below `promotion_factor` prevents a sketch near the
+ * boundary from flapping between modes.
+ *
+ * Policies are implicitly constructible from a register count, so that the
+ * fixed-count thresholds used throughout the library keep their meaning.
+ */
+class promotion_policy {
+  std::size_t _threshold;
+  double      _promotion_factor;
+  double      _demotion_factor;
+
+  promotion_policy(const double promotion_factor, const double demotion_factor)
+      : _threshold(0),
+        _promotion_factor(promotion_factor),
+        _demotion_factor(demotion_factor) {}
+
+ public:
+  /**
+   * Promote at a fixed number of sparse registers, and never demote.
+   *
+   * @param threshold the number of sparse registers at which to promote.
+   */
+  promotion_policy(const std::size_t threshold)
+      : _threshold(threshold), _promotion_factor(0), _demotion_factor(0) {}
+
+  promotion_policy() : promotion_policy(std::size_t(4096)) {}
+
+  /**
+   * Promote and demote based on the estimated register memory.
+   *
+   * @param promotion_factor promote when the sparse bytes exceed this multiple
+   *     of the dense bytes.
+   * @param demotion_factor demote when the nonzero registers of a dense sketch
+   *     would fit in less than this multiple of the dense bytes as a sparse
+   *     sketch. Zero disables demotion.
+   *
+   * @throws std::invalid_argument if `promotion_factor` is not positive, or if
+   *     `demotion_factor` is negative or not less than `promotion_factor`.
+   */
+  static promotion_policy by_memory(const double promotion_factor = 1.0,
+                                    const double demotion_factor  = 0.25) {
+    if (promotion_factor <= 0 || demotion_factor < 0 ||
+        demotion_factor >= promotion_factor) {
+      std::stringstream ss;
+      ss << "error: invalid promotion factors (" << promotion_factor << ", "
+         << demotion_factor << "); require 0 <= demotion < promotion.";
+      throw std::invalid_argument(ss.str());
+    }
+    return promotion_policy(promotion_factor, demotion_factor);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Cereal Archives
+  //////////////////////////////////////////////////////////////////////////////
+
+  template <class Archive>
+  void serialize(Archive &archive) {
+    archive(_threshold, _promotion_factor, _demotion_factor);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Thresholds
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr bool is_fixed() const { return _promotion_factor == 0; }
+
+  /**
+   * Number of sparse registers at which to promote.
+   *
+   * @param range_size the number of dense registers.
+   * @param reg_bytes the size of a dense register.
+   * @param entry_bytes the estimated size of a sparse register, including its
+   *     key and any container overhead.
+   */
+  constexpr std::size_t promotion_size(const std::size_t range_size,
+                                       const std::size_t reg_bytes,
+                                       const std::size_t entry_bytes) const {
+    if (is_fixed()) {
+      return _threshold;
+    }
+    return std::max(std::size_t(1),
+                    std::size_t(_promotion_factor * range_size * reg_bytes /
+                                entry_bytes));
+  }
+
+  /**
+   * Number of nonzero dense registers below which to demote. Zero if the
+   * policy never demotes.
+   */
+  constexpr std::size_t demotion_size(const std::size_t range_size,
+                                      const std::size_t reg_bytes,
+                                      const std::size_t entry_bytes) const {
+    return std::size_t(_demotion_factor * range_size * reg_bytes /
+                       entry_bytes);
+  }
+
+  constexpr std::size_t get_threshold() const { return _threshold; }
+
+  constexpr double get_promotion_factor() const { return _promotion_factor; }
+
+  constexpr double get_demotion_factor() const { return _demotion_factor; }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Equality operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  friend constexpr bool operator==(const promotion_policy &lhs,
+                                   const promotion_policy &rhs) {
+    return lhs._threshold == rhs._threshold &&
+           lhs._promotion_factor == rhs._promotion_factor &&
+           lhs._demotion_factor == rhs._demotion_factor;
+  }
+  friend constexpr bool operator!=(const promotion_policy &lhs,
+                                   const promotion_policy &rhs) {
+    return !operator==(lhs, rhs);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // I/O Operators
+  //////////////////////////////////////////////////////////////////////////////
+
+  friend std::ostream &operator<<(std::ostream &os,
+                                  const promotion_policy &policy) {
+    if (policy.is_fixed()) {
+      os << "promote at " << policy._threshold << " registers";
+    } else {
+      os << "promote at " << policy._promotion_factor
+         << "x dense bytes, demote at " << policy._demotion_factor
+         << "x dense bytes";
+    }
+    return os;
+  }
+};
+
+}  // namespace sketch
+}  // namespace krowkee
+
+#endif
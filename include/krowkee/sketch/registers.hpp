@@ -0,0 +1,118 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_SKETCH_REGISTERS_HPP
+#define _KROWKEE_SKETCH_REGISTERS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace krowkee {
+namespace sketch {
+
+/**
+ * Detects containers that track compaction, i.e. the sparse containers and
+ * the promotable containers.
+ */
+template <typename T, typename = void>
+struct has_is_compact : std::false_type {};
+
+template <typename T>
+struct has_is_compact<
+    T, std::void_t<decltype(std::declval<const T &>().is_compact())>>
+    : std::true_type {};
+
+/**
+ * Copy the registers of a sketch container in index order.
+ *
+ * Dense registers are copied in full into `values`, leaving `indices`
+ * empty. Sparse registers are copied as sorted index and value columns.
+ * Containers whose iteration order is not index order, such as those using
+ * `open_hash_map`, are sorted.
+ *
+ * @param con the container.
+ * @param indices cleared, then filled with the indices of sparse registers.
+ * @param values cleared, then filled with the register values.
+ *
+ * @return whether the registers are sparse.
+ *
+ * @throws std::logic_error if `con` is sparse and not compact.
+ */
+template <typename ContainerType, typename ValueType>
+bool copy_registers(const ContainerType        &con,
+                    std::vector<std::uint64_t> &indices,
+                    std::vector<ValueType>     &values) {
+  if constexpr (has_is_compact<ContainerType>::value) {
+    if (con.is_sparse() && con.is_compact() == false) {
+      throw std::logic_error(
+          "error: attempting to copy the registers of an uncompacted sketch!");
+    }
+  }
+  indices.clear();
+  values.clear();
+  for_each(con, [&](const auto &reg) {
+    if constexpr (std::is_arithmetic_v<std::decay_t<decltype(reg)>>) {
+      values.push_back(ValueType(reg));
+    } else {
+      indices.push_back(reg.first);
+      values.push_back(ValueType(reg.second));
+    }
+  });
+  if (con.is_sparse() == false ||
+      std::is_sorted(std::begin(indices), std::end(indices))) {
+    return con.is_sparse();
+  }
+  std::vector<std::pair<std::uint64_t, ValueType>> pairs(indices.size());
+  for (std::size_t i(0); i < indices.size(); ++i) {
+    pairs[i] = {indices[i], values[i]};
+  }
+  std::sort(std::begin(pairs), std::end(pairs));
+  for (std::size_t i(0); i < pairs.size(); ++i) {
+    indices[i] = pairs[i].first;
+    values[i]  = pairs[i].second;
+  }
+  return true;
+}
+
+/**
+ * Merge the sparse register map `rhs` into `lhs` with `op`, dropping
+ * registers merged to zero. Used by the `merge_with` of the sparse
+ * containers.
+ *
+ * The maps copy the registers found only in `rhs`, which is only right if
+ * `op(0, value) == value`; the others are fixed up afterwards.
+ *
+ * @throw std::logic_error if either map is uncompacted.
+ */
+template <typename RegType, typename MapType, typename Op>
+void merge_sparse_with(MapType &lhs, const MapType &rhs, const Op op) {
+  std::vector<std::pair<std::uint64_t, RegType>> unmatched;
+  std::for_each(std::cbegin(rhs), std::cend(rhs), [&](const auto &p) {
+    const RegType val(op(RegType(0), p.second));
+    if (val != p.second && std::as_const(lhs).at(p.first, RegType(0)) == 0) {
+      unmatched.emplace_back(p.first, val);
+    }
+  });
+  lhs.merge(rhs, op);
+  if (unmatched.empty() == false) {
+    for (const auto &[index, val] : unmatched) {
+      if (val == 0) {
+        lhs.erase(index);
+      } else {
+        lhs[index] = val;
+      }
+    }
+    lhs.compactify();
+  }
+}
+
+}  // namespace sketch
+}  // namespace krowkee
+
+#endif
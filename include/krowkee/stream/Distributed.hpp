@@ -7,12 +7,29 @@
 #define _KROWKEE_STREAM_DISTRIBUTED_HPP
 
 #include <krowkee/hash/util.hpp>
+#include <krowkee/sketch/Dense.hpp>
+#include <krowkee/sketch/merge_kernels.hpp>
+#include <krowkee/sketch/promotion_policy.hpp>
+#include <krowkee/stream/Multi.hpp>
+#include <krowkee/stream/Similarity.hpp>
+#include <krowkee/util/counters.hpp>
+#include <krowkee/util/parallel.hpp>
+#include <krowkee/util/wire.hpp>
 
 #include <ygm/detail/ygm_ptr.hpp>
 
 #include <ygm/container/map.hpp>
 
+#include <algorithm>
+#include <map>
+#include <set>
 #include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace krowkee {
 namespace stream {
@@ -21,6 +38,33 @@ namespace stream {
  * Distributedple Sketch
  *
  * Holds the core-local rows of a sketch along with an associated transform.
+ *
+ * Updates sent with `buffered_update` are held in a client-side buffer that
+ * pre-aggregates the multiplicities of repeated `(key, item)` pairs, which is
+ * valid for linear sketches. Each flush sends a single visitor per key
+ * carrying all of its buffered items. The buffer is flushed once it holds
+ * `flush_threshold` distinct updates, by `flush()`, and by the collective
+ * operations `barrier()`, `compactify()` and `for_all()`.
+ *
+ * Updates sent with `combined_update` are instead sketched into a rank-local
+ * Multi, so that a flush sends one compacted sketch per key, which the owner
+ * merges with `+=`. A key costs one message per rank per flush regardless of
+ * how many updates it received. The combiner is flushed once it holds
+ * `combiner_threshold` keys, and along with the update buffer.
+ *
+ * `reduce_all` and `all_reduce` merge sketches across every rank into one
+ * global sketch in a logarithmic number of rounds, rather than funneling
+ * whole sketches through a single rank.
+ *
+ * Sketches sent between ranks by the combiner, directed merges and
+ * reductions travel in the compact wire format of krowkee::util::wire_writer,
+ * without their functor handles, and are unpacked by the receiver with its
+ * own construction parameters.
+ *
+ * As with Multi, each rank may checkpoint the sketches it owns with
+ * `snapshot`, and then only those changed since with `delta_snapshot`, if
+ * `track_deltas` is on. `restore` merges snapshots back in on any number of
+ * ranks.
  */
 template <
     template <typename, template <typename> class> class DataType,
@@ -47,13 +91,33 @@ class Distributed {
 
   typedef ygm::container::map<KeyType, data_t> sk_map_t;
   typedef std::pair<KeyType, data_t>           sk_pair_t;
+  typedef krowkee::sketch::promotion_policy    promotion_policy_t;
+
+  typedef std::unordered_map<std::uint64_t, RegType> item_buffer_t;
+  typedef std::map<KeyType, item_buffer_t>           update_buffer_t;
+  typedef Multi<DataType, SketchType, SketchFunc, ContainerType, MergeOp,
+                KeyType, RegType, ygm::ygm_ptr, Args...>
+      combiner_t;
+  typedef krowkee::util::wire_bytes_t packed_t;
 
  private:
-  std::size_t _compaction_threshold;
-  std::size_t _promotion_threshold;
-  sf_ptr_t    _sf_ptr;  /// pointer to the shared sketch functor
-  sk_map_t    _sk_map;  /// map of indices to data
-  dsk_ptr_t   _pthis;
+  std::size_t          _compaction_threshold;
+  promotion_policy_t   _promotion;
+  sf_ptr_t             _sf_ptr;  /// pointer to the shared sketch functor
+  sk_map_t             _sk_map;  /// map of indices to data
+  dsk_ptr_t            _pthis;
+  ygm::comm           *_comm;
+  update_buffer_t      _buffer;  /// pre-aggregated updates awaiting a flush
+  std::size_t          _buffer_size;         /// distinct buffered updates
+  std::size_t          _flush_threshold;     /// buffer size triggering a flush
+  combiner_t           _combiner;            /// rank-local sketches to flush
+  std::size_t          _combiner_threshold;  /// combiner keys triggering flush
+  data_t               _reduce_partial;      /// scratch sketch for reductions
+  std::vector<RegType> _reduce_registers;    /// scratch registers for reduction
+  std::vector<typename Similarity<KeyType>::matches_t>
+             _similarity_matches;  /// per-query matches gathered on rank 0
+  combiner_t _delta;         /// updates to owned keys since the last snapshot
+  bool       _track_deltas;  /// whether updates are added to `_delta`
 
  public:
   /**
@@ -62,28 +126,46 @@ class Distributed {
    * @param sf_ptr the sketch functor.
    * @param compaction_threshold the size at which compacting maps compact. Only
    *        used by Sparse and Promotable (in sparse mode) sketches.
-   * @param promotion_threshold the size at which to promote a sparse sketch to
-   *        a dense sketch. Only used by Promotable sketches.
+   * @param promotion when to promote a sparse sketch to a dense sketch, either
+   *        as a register count or a krowkee::sketch::promotion_policy. Only
+   *        used by Promotable sketches.
+   * @param flush_threshold the number of distinct buffered updates at which
+   *        `buffered_update` flushes the buffer.
    */
   Distributed(ygm::comm &comm, const sf_ptr_t &sf_ptr,
-              const std::size_t compaction_threshold = 128,
-              const std::size_t promotion_threshold  = 4096)
+              const std::size_t         compaction_threshold = 128,
+              const promotion_policy_t &promotion            = 4096,
+              const std::size_t         flush_threshold      = 1 << 16)
       : _compaction_threshold(compaction_threshold),
-        _promotion_threshold(promotion_threshold),
-        _sk_map(comm,
-                data_t{sf_ptr, compaction_threshold, promotion_threshold}),
+        _promotion(promotion),
+        _sk_map(comm, data_t{sf_ptr, compaction_threshold, promotion}),
         _sf_ptr(sf_ptr),
-        _pthis(this) {}
+        _pthis(this),
+        _comm(&comm),
+        _buffer_size(0),
+        _flush_threshold(flush_threshold),
+        _combiner(sf_ptr, compaction_threshold, promotion),
+        _combiner_threshold(1 << 10),
+        _delta(sf_ptr, compaction_threshold, promotion),
+        _track_deltas(false) {}
 
   /**
    * Copy constructor.
    */
   Distributed(const dsk_t &rhs)
       : _compaction_threshold(rhs._compaction_threshold),
-        _promotion_threshold(rhs._promotion_threshold),
+        _promotion(rhs._promotion),
         _sf_ptr(rhs._sf_ptr),
         _sk_map(rhs._sk_map),
-        _pthis(this) {}
+        _pthis(this),
+        _comm(rhs._comm),
+        _buffer(rhs._buffer),
+        _buffer_size(rhs._buffer_size),
+        _flush_threshold(rhs._flush_threshold),
+        _combiner(rhs._combiner),
+        _combiner_threshold(rhs._combiner_threshold),
+        _delta(rhs._delta),
+        _track_deltas(rhs._track_deltas) {}
 
   static inline std::string name() {
     std::stringstream ss;
@@ -105,6 +187,29 @@ class Distributed {
     _sk_map.async_insert(key, data);
   }
 
+  /**
+   * Merge `data` into the sketch of `key`, constructing it at its owner if
+   * necessary, as Multi::emplace.
+   *
+   * Only the registers are sent, and the owner merges the unpacked message in
+   * place, so that no sketch is copied on either side. Pass an rvalue to
+   * avoid copying `data` into the argument.
+   *
+   * @param key the row identifier.
+   * @param data a sketch constructed with the parameters of `this`.
+   */
+  inline void async_emplace(const KeyType &key, data_t data) {
+    auto merge_visitor = [](auto &kv_pair, dsk_ptr_t pthis,
+                            const packed_t &bytes) {
+      pthis->_merge_packed(kv_pair, bytes);
+    };
+    data.compactify();
+    const packed_t bytes(pack(data));
+    KROWKEE_COUNT(merge_messages, 1);
+    KROWKEE_COUNT(merge_bytes, bytes.size());
+    _sk_map.async_visit(key, merge_visitor, _pthis, bytes);
+  }
+
   template <typename... ItemArgs>
   inline void async_update(const KeyType &key, const ItemArgs &...args) {
     auto update_visitor = [](auto &kv_pair, const ItemArgs &...args) {
@@ -112,39 +217,203 @@ class Distributed {
       kv_pair.second.update(args...);
       // std::cout << "updated d1 value: " << kv_pair.second.sk << std::endl;
     };
+    KROWKEE_COUNT(update_messages, 1);
+    KROWKEE_COUNT(update_bytes, (sizeof(KeyType) + ... + sizeof(ItemArgs)));
+    if (_track_deltas == true) {
+      auto tracked_visitor = [](auto &kv_pair, dsk_ptr_t pthis,
+                                const ItemArgs &...args) {
+        kv_pair.second.update(args...);
+        pthis->_delta.insert(kv_pair.first, args...);
+      };
+      _sk_map.async_visit(key, tracked_visitor, _pthis, args...);
+      return;
+    }
     _sk_map.async_visit(key, update_visitor, args...);
   }
 
+  /**
+   * Buffer an update, summing its multiplicity into any buffered update of
+   * the same item to the same key.
+   *
+   * Flushes the buffer once it holds `flush_threshold` distinct updates.
+   *
+   * @param key the row identifier.
+   * @param item the item to be inserted.
+   * @param multiplicity the number of insert repetitions. Default is `1`.
+   */
+  inline void buffered_update(const KeyType &key, const std::uint64_t item,
+                              const RegType multiplicity = 1) {
+    item_buffer_t &items(_buffer[key]);
+    const auto [itr, inserted] = items.try_emplace(item, multiplicity);
+    if (inserted == true) {
+      ++_buffer_size;
+    } else {
+      itr->second += multiplicity;
+    }
+    if (_buffer_size >= _flush_threshold) {
+      flush();
+    }
+  }
+
+  /**
+   * Sketch an update into the rank-local combiner.
+   *
+   * Flushes the combiner once it holds `combiner_threshold` keys.
+   *
+   * @param key the row identifier.
+   * @param args the stream object to be inserted, as for `async_update`.
+   */
+  template <typename... ItemArgs>
+  inline void combined_update(const KeyType &key, const ItemArgs &...args) {
+    _combiner.insert(key, args...);
+    if (_combiner.size() >= _combiner_threshold) {
+      flush_combiner();
+    }
+  }
+
+  /**
+   * Send the compacted combiner sketches to their owners, which merge them
+   * into their sketches with `+=`.
+   */
+  void flush_combiner() {
+    auto merge_visitor = [](auto &kv_pair, dsk_ptr_t pthis,
+                            const packed_t &bytes) {
+      pthis->_merge_packed(kv_pair, bytes);
+    };
+    _combiner.compactify();
+    for (const auto &[key, data] : _combiner) {
+      const packed_t bytes(pack(data));
+      KROWKEE_COUNT(merge_messages, 1);
+      KROWKEE_COUNT(merge_bytes, bytes.size());
+      _sk_map.async_visit(key, merge_visitor, _pthis, bytes);
+    }
+    _combiner.clear();
+  }
+
+  /**
+   * Send the buffered updates, one visitor per key, and flush the combiner.
+   *
+   * Items whose buffered multiplicities cancel are dropped, but their key is
+   * still visited so that it exists as it would have unbuffered.
+   */
+  void flush() {
+    flush_combiner();
+    auto batch_visitor = [](auto &kv_pair,
+                            const std::vector<std::uint64_t> &items,
+                            const std::vector<RegType>       &multiplicities) {
+      for (std::size_t i(0); i < items.size(); ++i) {
+        kv_pair.second.update(items[i], multiplicities[i]);
+      }
+    };
+    auto tracked_visitor = [](auto &kv_pair, dsk_ptr_t pthis,
+                              const std::vector<std::uint64_t> &items,
+                              const std::vector<RegType> &multiplicities) {
+      data_t &delta(pthis->_delta[kv_pair.first]);
+      for (std::size_t i(0); i < items.size(); ++i) {
+        kv_pair.second.update(items[i], multiplicities[i]);
+        delta.update(items[i], multiplicities[i]);
+      }
+    };
+    std::vector<std::uint64_t> items;
+    std::vector<RegType>       multiplicities;
+    for (const auto &[key, item_buffer] : _buffer) {
+      items.clear();
+      multiplicities.clear();
+      for (const auto &[item, multiplicity] : item_buffer) {
+        if (multiplicity != 0) {
+          items.push_back(item);
+          multiplicities.push_back(multiplicity);
+        }
+      }
+      KROWKEE_COUNT(batch_messages, 1);
+      KROWKEE_COUNT(batch_bytes, items.size() * sizeof(std::uint64_t) +
+                                     multiplicities.size() * sizeof(RegType));
+      if (_track_deltas == true) {
+        _sk_map.async_visit(key, tracked_visitor, _pthis, items,
+                            multiplicities);
+      } else {
+        _sk_map.async_visit(key, batch_visitor, items, multiplicities);
+      }
+    }
+    _buffer.clear();
+    _buffer_size = 0;
+  }
+
+  /**
+   * Flush the buffered updates and wait for all ranks to finish processing
+   * messages.
+   */
+  void barrier() {
+    flush();
+    _comm->barrier();
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   // Directed Merges
   //////////////////////////////////////////////////////////////////////////////
 
   inline void async_merge(const KeyType &fwd_key, const KeyType &rec_key) {
-    auto forward_visitor = [](auto pmap, auto &kv_pair, KeyType receiver_key) {
-      auto receive_visitor = [](auto &kv_pair, data_t data) {
-        kv_pair.second += data;
+    auto forward_visitor = [](auto pmap, auto &kv_pair, dsk_ptr_t pthis,
+                              KeyType receiver_key) {
+      auto receive_visitor = [](auto &kv_pair, dsk_ptr_t pthis,
+                                const packed_t &bytes) {
+        pthis->_merge_packed(kv_pair, bytes);
       };
-      pmap->async_visit(receiver_key, receive_visitor, kv_pair.second);
+      kv_pair.second.compactify();
+      const packed_t bytes(dsk_t::pack(kv_pair.second));
+      KROWKEE_COUNT(merge_messages, 1);
+      KROWKEE_COUNT(merge_bytes, bytes.size());
+      pmap->async_visit(receiver_key, receive_visitor, pthis, bytes);
     };
-    _sk_map.async_visit(fwd_key, forward_visitor, rec_key);
+    _sk_map.async_visit(fwd_key, forward_visitor, _pthis, rec_key);
   }
 
   inline void async_merge(dsk_t &rhs, const KeyType &rhs_key,
                           const KeyType &lhs_key) {
     auto rhs_visitor = [](auto &kv_pair, dsk_ptr_t lhs_ptr, KeyType lhs_key) {
-      auto lhs_visitor = [](auto &kv_pair, data_t data) {
-        kv_pair.second += data;
+      auto lhs_visitor = [](auto &kv_pair, dsk_ptr_t lhs_ptr,
+                            const packed_t &bytes) {
+        lhs_ptr->_merge_packed(kv_pair, bytes);
       };
-      lhs_ptr->ygm_map().async_visit(lhs_key, lhs_visitor, kv_pair.second);
+      kv_pair.second.compactify();
+      const packed_t bytes(dsk_t::pack(kv_pair.second));
+      KROWKEE_COUNT(merge_messages, 1);
+      KROWKEE_COUNT(merge_bytes, bytes.size());
+      lhs_ptr->ygm_map().async_visit(lhs_key, lhs_visitor, lhs_ptr, bytes);
     };
     rhs._sk_map.async_visit(rhs_key, rhs_visitor, _pthis, lhs_key);
   }
 
+  //////////////////////////////////////////////////////////////////////////////
+  // Wire Format
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Pack the registers of `data` for a message. Sparse sketches must be
+   * compacted.
+   */
+  static packed_t pack(const data_t &data) {
+    krowkee::util::wire_writer writer;
+    data.pack(writer);
+    return writer.release();
+  }
+
+  /**
+   * Unpack a message into a sketch with this Distributed's parameters.
+   */
+  data_t unpack(const packed_t &bytes) const {
+    data_t                     data(_sf_ptr, _compaction_threshold, _promotion);
+    krowkee::util::wire_reader reader(bytes);
+    data.unpack(reader);
+    return data;
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   // Compaction
   //////////////////////////////////////////////////////////////////////////////
 
   void compactify(const KeyType &key) {
+    flush();
     auto compaction_visitor = [](auto &kv_pair) {
       kv_pair.second.compactify();
     };
@@ -152,18 +421,273 @@ class Distributed {
   }
 
   void compactify() {
+    flush();
     auto compaction_visitor = [](auto &kv_pair) {
       kv_pair.second.compactify();
     };
     _sk_map.for_all(compaction_visitor);
   }
 
+  /**
+   * As `compactify()`, compacting the sketches held by each rank from the
+   * threads of `policy`, largest sketch first.
+   */
+  void compactify(const krowkee::util::parallel_policy &policy) {
+    flush();
+    std::vector<data_t *>    sketches;
+    std::vector<std::size_t> weights;
+    _sk_map.for_all([&](auto &kv_pair) {
+      sketches.push_back(&kv_pair.second);
+      weights.push_back(kv_pair.second.sk.size());
+    });
+    krowkee::util::parallel_for_weighted(
+        weights, policy.num_threads,
+        [&](const std::size_t i) { sketches[i]->compactify(); });
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Windows
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Move the window of every sketch forward by `steps` buckets, as
+   * Multi::advance. Collective.
+   *
+   * Every update sent before the call lands in the old buckets, and every
+   * update sent after it in the new ones.
+   */
+  void advance(const std::size_t steps = 1) {
+    flush();
+    _sk_map.for_all([steps](auto &kv_pair) { kv_pair.second.advance(steps); });
+    // keep ranks that finish first from updating buckets not yet advanced
+    _comm->barrier();
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Collective Reductions
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Merge the sketches of `keys` across all ranks into a single sketch held
+   * by rank 0. Collective; every rank must pass the same keys.
+   *
+   * Each rank first merges the sketches among `keys` that it owns. Dense
+   * sketches are then combined with a recursive-halving reduce-scatter over
+   * register ranges followed by a gather of the reduced ranges, so that no
+   * rank sends or receives much more than one sketch worth of registers.
+   * Other sketches are combined along a binomial tree in `ceil(log2(P))`
+   * rounds.
+   *
+   * @param keys the rows to merge. Rows that do not exist are ignored.
+   * @return the merged sketch on rank 0, and an empty sketch on other ranks.
+   */
+  data_t reduce_all(const std::vector<KeyType> &keys) {
+    return _reduce(&keys, false);
+  }
+
+  /**
+   * Merge every sketch across all ranks into a single sketch held by rank 0.
+   * Collective.
+   */
+  data_t reduce_all() { return _reduce(nullptr, false); }
+
+  /**
+   * As `reduce_all(keys)`, but every rank receives the merged sketch. Dense
+   * sketches follow the reduce-scatter with a recursive-doubling allgather;
+   * other sketches are broadcast back down the reduction tree.
+   */
+  data_t all_reduce(const std::vector<KeyType> &keys) {
+    return _reduce(&keys, true);
+  }
+
+  /**
+   * Merge every sketch across all ranks, returning the result on every rank.
+   * Collective.
+   */
+  data_t all_reduce() { return _reduce(nullptr, true); }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Similarity Queries
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Find the `k` sketches most similar to each of `queries` across all ranks.
+   * Collective; every rank must pass the same arguments.
+   *
+   * Each query sketch is assembled with `all_reduce`, scored against the
+   * locally owned sketches by a rank-local krowkee::stream::Similarity, and
+   * the per-rank candidates are merged on rank 0.
+   *
+   * @param queries the keys of the query sketches. A query is never returned
+   *     among its own matches.
+   * @param k the number of matches per query.
+   * @param metric the similarity measure.
+   * @param num_threads the number of threads used by the local queries.
+   *
+   * @return the matches of each query on rank 0, best first, and nothing on
+   *     other ranks.
+   */
+  std::vector<typename Similarity<KeyType>::matches_t> top_k(
+      const std::vector<KeyType> &queries, const std::size_t k,
+      const similarity_t metric      = similarity_t::cosine,
+      const std::size_t  num_threads = 0) {
+    typedef Similarity<KeyType>       sim_t;
+    typedef typename sim_t::matches_t   matches_t;
+
+    compactify();
+    barrier();
+    sim_t local(_sf_ptr->range_size(), num_threads);
+    _sk_map.for_all(
+        [&](auto &kv_pair) { local.insert(kv_pair.first, kv_pair.second.sk); });
+
+    auto gather_handler = [](auto pcomm, dsk_ptr_t pthis, std::size_t query,
+                             const std::vector<KeyType> &keys,
+                             const std::vector<double>  &scores) {
+      matches_t &matches(pthis->_similarity_matches[query]);
+      for (std::size_t i(0); i < keys.size(); ++i) {
+        matches.emplace_back(keys[i], scores[i]);
+      }
+    };
+
+    if (_comm->rank() == 0) {
+      _similarity_matches.assign(queries.size(), matches_t());
+    }
+    for (std::size_t i(0); i < queries.size(); ++i) {
+      const data_t         query(all_reduce({queries[i]}));
+      const matches_t      matches(local.top_k_of(query.sk, k, metric,
+                                                  &queries[i]));
+      std::vector<KeyType> keys;
+      std::vector<double>  scores;
+      for (const auto &match : matches) {
+        keys.push_back(match.first);
+        scores.push_back(match.second);
+      }
+      _comm->async(0, gather_handler, _pthis, i, keys, scores);
+    }
+    _comm->barrier();
+
+    std::vector<matches_t> ret;
+    if (_comm->rank() == 0) {
+      for (matches_t &matches : _similarity_matches) {
+        ret.push_back(sim_t::select(std::move(matches), k, metric));
+      }
+      _similarity_matches.clear();
+    }
+    return ret;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Delta Snapshots
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Start or stop tracking changes, discarding those already tracked.
+   * Collective.
+   *
+   * While tracking, the owner of a key applies each update and merge it
+   * receives a second time to the key's delta sketch. Values replaced with
+   * `async_insert` are not tracked.
+   */
+  void track_deltas(const bool track = true) {
+    barrier();
+    _track_deltas = track;
+    _delta.clear();
+  }
+
+  constexpr bool tracking_deltas() const { return _track_deltas; }
+
+  /**
+   * The number of keys owned by this rank changed since the last snapshot.
+   */
+  std::size_t local_dirty_size() const { return _delta.size(); }
+
+  /**
+   * Write the sketches owned by this rank, as Multi::snapshot, and start a
+   * new epoch of tracked changes. Collective.
+   */
+  packed_t snapshot() {
+    barrier();
+    // The barrier of for_all may deliver updates from ranks that have already
+    // passed it, so keys are counted as they are written.
+    krowkee::util::wire_writer body;
+    std::size_t                size(0);
+    _sk_map.for_all([&](auto &kv_pair) {
+      kv_pair.second.compactify();
+      body.put_key(kv_pair.first);
+      kv_pair.second.pack(body);
+      ++size;
+    });
+    _delta.clear();
+    krowkee::util::wire_writer writer;
+    writer.put_varint(size);
+    writer.put_raw(body.bytes().data(), body.size());
+    return writer.release();
+  }
+
+  /**
+   * Write the changes to the keys owned by this rank since the last snapshot,
+   * as Multi::delta_snapshot, and start a new epoch. Collective.
+   *
+   * @throws std::logic_error if changes are not being tracked.
+   */
+  packed_t delta_snapshot() {
+    if (_track_deltas == false) {
+      throw std::logic_error(
+          "error: attempting to write a delta snapshot without tracking "
+          "deltas!");
+    }
+    barrier();
+    krowkee::util::wire_writer writer;
+    _delta.snapshot(writer);
+    _delta.clear();
+    return writer.release();
+  }
+
+  /**
+   * Merge the snapshots concatenated in `bytes` into the sketches of their
+   * keys, wherever those are owned. Collective; each rank may pass any
+   * snapshots, including none.
+   *
+   * @throws std::out_of_range if a snapshot is truncated or malformed.
+   */
+  void restore(const packed_t &bytes) {
+    krowkee::util::wire_reader reader(bytes);
+    while (reader.empty() == false) {
+      const std::size_t size(reader.get_varint());
+      for (std::size_t i(0); i < size; ++i) {
+        const KeyType key(reader.get_key<KeyType>());
+        data_t        data(_sf_ptr, _compaction_threshold, _promotion);
+        data.unpack(reader);
+        async_emplace(key, std::move(data));
+      }
+    }
+    barrier();
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Instrumentation
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Sum the instrumentation counters of every rank. Collective.
+   *
+   * Flushes and waits first, so that buffered updates and the merges they
+   * trigger are counted. The counters are per process rather than per
+   * Distributed, and are all zero unless built with `KROWKEE_ENABLE_COUNTERS`.
+   */
+  krowkee::util::counter_snapshot all_reduce_counters() {
+    barrier();
+    return krowkee::util::all_reduce_counters(
+        *_comm, krowkee::util::snapshot_counters());
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   // For All
   //////////////////////////////////////////////////////////////////////////////
 
   template <typename Func>
   void for_all(Func func) {
+    flush();
     _sk_map.for_all(func);
   }
 
@@ -176,15 +700,256 @@ class Distributed {
 
   sk_map_t &ygm_map() { return _sk_map; }
 
+  constexpr std::size_t buffer_size() const { return _buffer_size; }
+
+  constexpr std::size_t get_flush_threshold() const { return _flush_threshold; }
+
+  void set_flush_threshold(const std::size_t flush_threshold) {
+    _flush_threshold = flush_threshold;
+    if (_buffer_size >= _flush_threshold) {
+      flush();
+    }
+  }
+
+  std::size_t combiner_size() const { return _combiner.size(); }
+
+  constexpr std::size_t get_combiner_threshold() const {
+    return _combiner_threshold;
+  }
+
+  void set_combiner_threshold(const std::size_t combiner_threshold) {
+    _combiner_threshold = combiner_threshold;
+    if (_combiner.size() >= _combiner_threshold) {
+      flush_combiner();
+    }
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   // Equality check
   //////////////////////////////////////////////////////////////////////////////
 
   constexpr bool params_agree(const dsk_t &rhs) const {
     return *_sf_ptr == *rhs._sf_ptr &&
-           _promotion_threshold == rhs._promotion_threshold &&
+           _promotion == rhs._promotion &&
            _compaction_threshold == rhs._compaction_threshold;
   }
+
+ private:
+  /**
+   * Merge a packed sketch into that of `kv_pair`, and into its delta if
+   * tracking.
+   */
+  template <typename PairType>
+  void _merge_packed(PairType &kv_pair, const packed_t &bytes) {
+    data_t data(unpack(bytes));
+    kv_pair.second.compactify();
+    kv_pair.second += data;
+    if (_track_deltas == true) {
+      data_t &delta(_delta[kv_pair.first]);
+      delta.compactify();
+      delta += data;
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Reduction Helpers
+  //////////////////////////////////////////////////////////////////////////////
+
+  static constexpr bool _is_dense =
+      std::is_same_v<typename sk_t::container_t,
+                     krowkee::sketch::Dense<RegType, MergeOp<RegType>>>;
+
+  data_t _reduce(const std::vector<KeyType> *keys, const bool to_all) {
+    barrier();
+    _reduce_partial = _local_partial(keys);
+    if constexpr (_is_dense) {
+      _reduce_registers.assign(std::begin(_reduce_partial.sk),
+                               std::end(_reduce_partial.sk));
+    }
+    // Every rank's scratch state must be set before any partial arrives.
+    _comm->barrier();
+    if constexpr (_is_dense) {
+      _dense_reduce(to_all);
+    } else {
+      _tree_reduce();
+      if (to_all == true) {
+        _tree_broadcast();
+      }
+    }
+    data_t ret(_sf_ptr, _compaction_threshold, _promotion);
+    if (to_all == true || _comm->rank() == 0) {
+      std::swap(ret, _reduce_partial);
+    }
+    _reduce_partial = data_t();
+    return ret;
+  }
+
+  /**
+   * Merge the locally owned sketches among `keys`, or all of them if `keys`
+   * is `nullptr`.
+   */
+  data_t _local_partial(const std::vector<KeyType> *keys) {
+    std::set<KeyType> key_set;
+    if (keys != nullptr) {
+      key_set.insert(std::begin(*keys), std::end(*keys));
+    }
+    data_t partial(_sf_ptr, _compaction_threshold, _promotion);
+    _sk_map.for_all([&](auto &kv_pair) {
+      if (keys == nullptr || key_set.count(kv_pair.first) > 0) {
+        kv_pair.second.compactify();
+        partial += kv_pair.second;
+        partial.compactify();
+      }
+    });
+    return partial;
+  }
+
+  /**
+   * Binomial tree reduction of `_reduce_partial` onto rank 0.
+   */
+  void _tree_reduce() {
+    auto merge_handler = [](auto pcomm, dsk_ptr_t pthis,
+                            const packed_t &bytes) {
+      pthis->_reduce_partial.compactify();
+      pthis->_reduce_partial += pthis->unpack(bytes);
+    };
+    const int rank(_comm->rank());
+    for (int step(1); step < _comm->size(); step <<= 1) {
+      if (rank % (2 * step) == step) {
+        _reduce_partial.compactify();
+        const packed_t bytes(pack(_reduce_partial));
+        KROWKEE_COUNT(reduce_messages, 1);
+        KROWKEE_COUNT(reduce_bytes, bytes.size());
+        _comm->async(rank - step, merge_handler, _pthis, bytes);
+      }
+      _comm->barrier();
+    }
+  }
+
+  /**
+   * Binomial tree broadcast of `_reduce_partial` from rank 0.
+   */
+  void _tree_broadcast() {
+    auto assign_handler = [](auto pcomm, dsk_ptr_t pthis,
+                             const packed_t &bytes) {
+      pthis->_reduce_partial = pthis->unpack(bytes);
+    };
+    const int rank(_comm->rank());
+    const int nranks(_comm->size());
+    int       step(1);
+    while (step < nranks) {
+      step <<= 1;
+    }
+    for (step >>= 1; step > 0; step >>= 1) {
+      if (rank % (2 * step) == 0 && rank + step < nranks) {
+        _reduce_partial.compactify();
+        const packed_t bytes(pack(_reduce_partial));
+        KROWKEE_COUNT(reduce_messages, 1);
+        KROWKEE_COUNT(reduce_bytes, bytes.size());
+        _comm->async(rank + step, assign_handler, _pthis, bytes);
+      }
+      _comm->barrier();
+    }
+  }
+
+  /**
+   * Reduce `_reduce_registers` across ranks and copy the result into
+   * `_reduce_partial`.
+   *
+   * Ranks beyond the largest power of two `p2` first fold their registers
+   * into rank `rank - p2`. The remaining ranks then halve their register
+   * range each round, sending the half they drop to the partner that keeps
+   * it, until each owns a fully reduced `1 / p2` of the registers. Those
+   * ranges are gathered on rank 0 or, for `to_all`, exchanged back up the
+   * same rounds and forwarded to the folded ranks.
+   *
+   * Non-register state is then combined by the data type's
+   * `all_reduce_metadata`, which may consult the reduced registers.
+   */
+  void _dense_reduce(const bool to_all) {
+    auto merge_handler = [](auto pcomm, dsk_ptr_t pthis, std::size_t offset,
+                            const packed_t &bytes) {
+      krowkee::util::wire_reader reader(bytes);
+      const std::vector<RegType> registers(
+          reader.get_array<RegType>(pthis->_reduce_registers.size() - offset));
+      krowkee::sketch::merge_registers<RegType, MergeOp<RegType>>(
+          pthis->_reduce_registers.data() + offset, registers.data(),
+          registers.size());
+    };
+    auto assign_handler = [](auto pcomm, dsk_ptr_t pthis, std::size_t offset,
+                             const packed_t &bytes) {
+      krowkee::util::wire_reader reader(bytes);
+      const std::vector<RegType> registers(
+          reader.get_array<RegType>(pthis->_reduce_registers.size() - offset));
+      std::copy(std::begin(registers), std::end(registers),
+                std::begin(pthis->_reduce_registers) + offset);
+    };
+    auto send = [&](const int dest, auto handler, const std::size_t lo,
+                    const std::size_t hi) {
+      krowkee::util::wire_writer writer;
+      writer.put_array(_reduce_registers.data() + lo, hi - lo);
+      const packed_t bytes(writer.release());
+      KROWKEE_COUNT(reduce_messages, 1);
+      KROWKEE_COUNT(reduce_bytes, bytes.size());
+      _comm->async(dest, handler, _pthis, lo, bytes);
+    };
+
+    const int rank(_comm->rank());
+    const int nranks(_comm->size());
+    int       p2(1);
+    while (2 * p2 <= nranks) {
+      p2 <<= 1;
+    }
+    const std::size_t n(_reduce_registers.size());
+
+    if (rank >= p2) {
+      send(rank - p2, merge_handler, 0, n);
+    }
+    _comm->barrier();
+
+    std::vector<std::pair<std::size_t, std::size_t>> ranges;
+    std::size_t                                      lo(0);
+    std::size_t                                      hi(n);
+    for (int mask(p2 >> 1); mask > 0; mask >>= 1) {
+      if (rank < p2) {
+        ranges.emplace_back(lo, hi);
+        const std::size_t mid(lo + (hi - lo) / 2);
+        if ((rank & mask) == 0) {
+          send(rank ^ mask, merge_handler, mid, hi);
+          hi = mid;
+        } else {
+          send(rank ^ mask, merge_handler, lo, mid);
+          lo = mid;
+        }
+      }
+      _comm->barrier();
+    }
+
+    if (to_all == true) {
+      for (int mask(1); mask < p2; mask <<= 1) {
+        if (rank < p2) {
+          send(rank ^ mask, assign_handler, lo, hi);
+          std::tie(lo, hi) = ranges.back();
+          ranges.pop_back();
+        }
+        _comm->barrier();
+      }
+      if (rank < nranks - p2) {
+        send(rank + p2, assign_handler, 0, n);
+      }
+      _comm->barrier();
+    } else {
+      if (rank > 0 && rank < p2) {
+        send(0, assign_handler, lo, hi);
+      }
+      _comm->barrier();
+    }
+
+    std::copy(std::begin(_reduce_registers), std::end(_reduce_registers),
+              std::begin(_reduce_partial.sk));
+    _reduce_registers.clear();
+    _reduce_partial.all_reduce_metadata(*_comm);
+  }
 };
 
 }  // namespace stream
@@ -0,0 +1,464 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_STREAM_INGEST_HPP
+#define _KROWKEE_STREAM_INGEST_HPP
+
+#include <krowkee/util/parallel.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace krowkee {
+namespace stream {
+
+/**
+ * Layouts of the `(key, item[, multiplicity])` files read by Ingester.
+ *
+ * `text` files hold one tuple per line, with fields separated by spaces, tabs
+ * or commas. Blank lines and lines beginning with `#` are skipped. `binary`
+ * files hold back-to-back records of a `KeyType` key, a `std::uint64_t` item
+ * and, if present, a `RegType` multiplicity, without padding and in native
+ * byte order.
+ */
+enum class ingest_format_t { text, binary };
+
+/**
+ * A block of parsed `(key, item[, multiplicity])` tuples, in file order.
+ * `multiplicities` is empty if the file holds none.
+ */
+template <typename KeyType, typename RegType>
+struct ingest_batch {
+  std::vector<KeyType>       keys;
+  std::vector<std::uint64_t> items;
+  std::vector<RegType>       multiplicities;
+
+  constexpr std::size_t size() const { return keys.size(); }
+
+  /**
+   * The multiplicities in the form taken by `insert_batch`.
+   */
+  constexpr const RegType *multiplicity_ptr() const {
+    return multiplicities.empty() ? nullptr : multiplicities.data();
+  }
+
+  void clear() {
+    keys.clear();
+    items.clear();
+    multiplicities.clear();
+  }
+};
+
+/**
+ * Streaming reader of `(key, item[, multiplicity])` files.
+ *
+ * The file is memory mapped and cut into chunks of about `chunk_bytes`
+ * bytes, split on record boundaries. Chunks are parsed in waves of one chunk
+ * per worker thread. While the calling thread hands the batches of one wave
+ * to a sink in file order, the workers parse the next wave, so that reading
+ * (by page faults on the mapping), parsing and sketching overlap. Sinks are
+ * only ever called from the calling thread, and so need not be thread safe.
+ *
+ * A file may also be read in `num_parts` disjoint parts, such as one per
+ * rank, of which an Ingester reads the part `part`. Every record belongs to
+ * exactly one part.
+ *
+ * @tparam KeyType the integral row identifier type.
+ * @tparam RegType the multiplicity type.
+ */
+template <typename KeyType, typename RegType>
+class Ingester {
+ public:
+  typedef ingest_batch<KeyType, RegType> batch_t;
+
+  static_assert(std::is_integral_v<KeyType>,
+                "Ingester only reads integral keys");
+
+  /// size of a binary record
+  static constexpr std::size_t binary_record_bytes(
+      const bool with_multiplicity) {
+    return sizeof(KeyType) + sizeof(std::uint64_t) +
+           (with_multiplicity ? sizeof(RegType) : 0);
+  }
+
+ private:
+  ingest_format_t _format;
+  bool            _with_multiplicity;
+  std::size_t     _num_threads;
+  std::size_t     _chunk_bytes;
+  const char     *_data;   /// the mapped file
+  std::size_t     _size;   /// the file size
+  std::size_t     _begin;  /// first byte of this part
+  std::size_t     _end;    /// one past the last byte of this part
+
+ public:
+  /**
+   * Map the file at `path`.
+   *
+   * @param path the input file.
+   * @param format the file layout.
+   * @param with_multiplicity whether each tuple holds a multiplicity.
+   * @param num_threads the number of parsing threads. `0` means one per
+   *     hardware thread.
+   * @param chunk_bytes the approximate number of bytes parsed per batch.
+   * @param part the part of the file to read.
+   * @param num_parts the number of parts the file is divided into.
+   *
+   * @throws std::runtime_error if the file cannot be mapped.
+   * @throws std::invalid_argument if `part` is not less than `num_parts` or
+   *     a binary file does not hold whole records.
+   */
+  Ingester(const std::string &path, const ingest_format_t format,
+           const bool with_multiplicity = false,
+           const std::size_t num_threads = 0,
+           const std::size_t chunk_bytes = 1 << 22, const std::size_t part = 0,
+           const std::size_t num_parts = 1)
+      : _format(format),
+        _with_multiplicity(with_multiplicity),
+        _num_threads(krowkee::util::resolve_num_threads(num_threads)),
+        _chunk_bytes(std::max(chunk_bytes, std::size_t(1))),
+        _data(nullptr),
+        _size(0) {
+    if (part >= num_parts) {
+      std::stringstream ss;
+      ss << "error: attempting to read part " << part << " of " << num_parts
+         << "!";
+      throw std::invalid_argument(ss.str());
+    }
+    _map(path);
+    if (_format == ingest_format_t::binary &&
+        _size % binary_record_bytes(_with_multiplicity) != 0) {
+      _unmap();
+      std::stringstream ss;
+      ss << "error: " << path << " does not hold whole "
+         << binary_record_bytes(_with_multiplicity) << " byte records!";
+      throw std::invalid_argument(ss.str());
+    }
+    _begin = _boundary(std::uint64_t(_size) * part / num_parts);
+    _end   = _boundary(std::uint64_t(_size) * (part + 1) / num_parts);
+  }
+
+  Ingester(const Ingester &)            = delete;
+  Ingester &operator=(const Ingester &) = delete;
+
+  ~Ingester() { _unmap(); }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Ingestion
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Parse this part of the file and call `func(batch)` on each batch, in file
+   * order, from the calling thread.
+   *
+   * @return the number of tuples read.
+   *
+   * @throws std::invalid_argument if a text record is malformed.
+   */
+  template <typename Func>
+  std::uint64_t for_each_batch(const Func &func) const {
+    std::vector<std::pair<std::size_t, std::size_t>> chunks(_chunks());
+    const std::size_t    wave_size(_num_threads);
+    std::vector<batch_t> current(wave_size);
+    std::vector<batch_t> next(wave_size);
+    std::uint64_t        count(0);
+    _parse_wave(chunks, 0, current);
+    for (std::size_t wave(0); wave < chunks.size(); wave += wave_size) {
+      const std::size_t  next_wave(wave + wave_size);
+      std::exception_ptr error;
+      std::thread        parser;
+      if (next_wave < chunks.size()) {
+        parser = std::thread([&]() {
+          try {
+            _parse_wave(chunks, next_wave, next);
+          } catch (...) {
+            error = std::current_exception();
+          }
+        });
+      }
+      try {
+        const std::size_t wave_end(std::min(next_wave, chunks.size()));
+        for (std::size_t i(0); i < wave_end - wave; ++i) {
+          count += current[i].size();
+          func(current[i]);
+        }
+      } catch (...) {
+        if (parser.joinable()) {
+          parser.join();
+        }
+        throw;
+      }
+      if (parser.joinable()) {
+        parser.join();
+      }
+      if (error) {
+        std::rethrow_exception(error);
+      }
+      std::swap(current, next);
+    }
+    return count;
+  }
+
+  /**
+   * Insert this part of the file into `sink` with its batched insert path.
+   *
+   * Sinks with a `buffered_update(key, item, multiplicity)` method, such as
+   * krowkee::stream::Distributed, receive the tuples one at a time through
+   * it. Other sinks, such as krowkee::stream::Multi and
+   * krowkee::stream::ShardedMulti, receive each batch through
+   * `insert_batch(keys, items, multiplicities, count)`.
+   *
+   * @return the number of tuples read.
+   */
+  template <typename SinkType>
+  std::uint64_t ingest(SinkType &sink) const {
+    return for_each_batch([&](const batch_t &batch) {
+      if constexpr (_has_buffered_update<SinkType>::value) {
+        for (std::size_t i(0); i < batch.size(); ++i) {
+          sink.buffered_update(
+              batch.keys[i], batch.items[i],
+              _with_multiplicity ? batch.multiplicities[i] : RegType(1));
+        }
+      } else {
+        sink.insert_batch(batch.keys.data(), batch.items.data(),
+                          batch.multiplicity_ptr(), batch.size());
+      }
+    });
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Getters
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr std::size_t file_size() const { return _size; }
+
+  /**
+   * The number of bytes in this part of the file.
+   */
+  constexpr std::size_t part_size() const { return _end - _begin; }
+
+  constexpr std::size_t num_threads() const { return _num_threads; }
+
+ private:
+  template <typename T, typename = void>
+  struct _has_buffered_update : std::false_type {};
+
+  template <typename T>
+  struct _has_buffered_update<
+      T, std::void_t<decltype(std::declval<T &>().buffered_update(
+             std::declval<KeyType>(), std::uint64_t(0), RegType(1)))>>
+      : std::true_type {};
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Mapping
+  //////////////////////////////////////////////////////////////////////////////
+
+  void _map(const std::string &path) {
+    const int fd(::open(path.c_str(), O_RDONLY));
+    if (fd < 0) {
+      _throw_errno("open", path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      _throw_errno("fstat", path);
+    }
+    _size = st.st_size;
+    if (_size > 0) {
+      void *addr(::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0));
+      if (addr == MAP_FAILED) {
+        ::close(fd);
+        _throw_errno("mmap", path);
+      }
+      ::madvise(addr, _size, MADV_SEQUENTIAL);
+      _data = static_cast<const char *>(addr);
+    }
+    ::close(fd);
+  }
+
+  void _unmap() {
+    if (_data != nullptr) {
+      ::munmap(const_cast<char *>(_data), _size);
+      _data = nullptr;
+    }
+  }
+
+  [[noreturn]] static void _throw_errno(const char        *call,
+                                        const std::string &path) {
+    std::stringstream ss;
+    ss << "error: " << call << " failed on " << path << ": "
+       << std::strerror(errno);
+    throw std::runtime_error(ss.str());
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Chunking
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * The first record boundary at or after `pos`. A text record begins at the
+   * start of the file or after a newline.
+   */
+  std::size_t _boundary(const std::size_t pos) const {
+    if (_format == ingest_format_t::binary) {
+      const std::size_t record(binary_record_bytes(_with_multiplicity));
+      return std::min((pos + record - 1) / record * record, _size);
+    }
+    if (pos == 0 || pos >= _size) {
+      return std::min(pos, _size);
+    }
+    const void *newline(std::memchr(_data + pos - 1, '\n', _size - pos + 1));
+    return (newline == nullptr)
+               ? _size
+               : static_cast<const char *>(newline) - _data + 1;
+  }
+
+  std::vector<std::pair<std::size_t, std::size_t>> _chunks() const {
+    std::vector<std::pair<std::size_t, std::size_t>> ret;
+    for (std::size_t begin(_begin); begin < _end;) {
+      const std::size_t end(
+          std::min(_boundary(std::min(begin + _chunk_bytes, _end)), _end));
+      ret.emplace_back(begin, end);
+      begin = end;
+    }
+    return ret;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Parsing
+  //////////////////////////////////////////////////////////////////////////////
+
+  void _parse_wave(
+      const std::vector<std::pair<std::size_t, std::size_t>> &chunks,
+      const std::size_t first, std::vector<batch_t> &batches) const {
+    const std::size_t last(std::min(first + batches.size(), chunks.size()));
+    krowkee::util::parallel_for(
+        first, last, _num_threads,
+        [&](const std::size_t begin, const std::size_t end) {
+          for (std::size_t chunk(begin); chunk < end; ++chunk) {
+            batch_t &batch(batches[chunk - first]);
+            batch.clear();
+            if (_format == ingest_format_t::binary) {
+              _parse_binary(chunks[chunk].first, chunks[chunk].second, batch);
+            } else {
+              _parse_text(chunks[chunk].first, chunks[chunk].second, batch);
+            }
+          }
+        });
+  }
+
+  void _parse_binary(const std::size_t begin, const std::size_t end,
+                     batch_t &batch) const {
+    const std::size_t record(binary_record_bytes(_with_multiplicity));
+    const std::size_t count((end - begin) / record);
+    batch.keys.resize(count);
+    batch.items.resize(count);
+    if (_with_multiplicity) {
+      batch.multiplicities.resize(count);
+    }
+    const char *pos(_data + begin);
+    for (std::size_t i(0); i < count; ++i, pos += record) {
+      std::memcpy(&batch.keys[i], pos, sizeof(KeyType));
+      std::memcpy(&batch.items[i], pos + sizeof(KeyType),
+                  sizeof(std::uint64_t));
+      if (_with_multiplicity) {
+        std::memcpy(&batch.multiplicities[i],
+                    pos + sizeof(KeyType) + sizeof(std::uint64_t),
+                    sizeof(RegType));
+      }
+    }
+  }
+
+  void _parse_text(const std::size_t begin, const std::size_t end,
+                   batch_t &batch) const {
+    const std::size_t expected((end - begin) / 8);
+    batch.keys.reserve(expected);
+    batch.items.reserve(expected);
+    if (_with_multiplicity) {
+      batch.multiplicities.reserve(expected);
+    }
+    const char *pos(_data + begin);
+    const char *last(_data + end);
+    while (pos < last) {
+      pos = _skip_blanks(pos, last);
+      if (pos == last) {
+        break;
+      }
+      if (*pos == '\n') {
+        ++pos;
+        continue;
+      }
+      if (*pos == '#') {
+        pos = _line_end(pos, last);
+        continue;
+      }
+      batch.keys.push_back(_parse_field<KeyType>(pos, last));
+      batch.items.push_back(_parse_field<std::uint64_t>(pos, last));
+      if (_with_multiplicity) {
+        batch.multiplicities.push_back(_parse_field<RegType>(pos, last));
+      }
+      pos = _skip_blanks(pos, last);
+      if (pos < last && *pos != '\n') {
+        _throw_malformed(pos);
+      }
+    }
+  }
+
+  static inline bool _is_blank(const char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == ',';
+  }
+
+  static inline const char *_skip_blanks(const char *pos, const char *last) {
+    while (pos < last && _is_blank(*pos)) {
+      ++pos;
+    }
+    return pos;
+  }
+
+  static inline const char *_line_end(const char *pos, const char *last) {
+    const void *newline(std::memchr(pos, '\n', last - pos));
+    return (newline == nullptr) ? last : static_cast<const char *>(newline);
+  }
+
+  template <typename T>
+  inline T _parse_field(const char *&pos, const char *last) const {
+    pos = _skip_blanks(pos, last);
+    T val;
+    const auto [ptr, ec] = std::from_chars(pos, last, val);
+    if (ec != std::errc() ||
+        (ptr < last && _is_blank(*ptr) == false && *ptr != '\n')) {
+      _throw_malformed(pos);
+    }
+    pos = ptr;
+    return val;
+  }
+
+  [[noreturn]] void _throw_malformed(const char *pos) const {
+    std::stringstream ss;
+    ss << "error: malformed ingest record at byte " << pos - _data << "!";
+    throw std::invalid_argument(ss.str());
+  }
+};
+
+}  // namespace stream
+}  // namespace krowkee
+
+#endif
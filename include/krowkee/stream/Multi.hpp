@@ -7,9 +7,16 @@
 #define _KROWKEE_STREAM_MULTI_HPP
 
 #include <krowkee/hash/util.hpp>
+#include <krowkee/sketch/promotion_policy.hpp>
+#include <krowkee/util/parallel.hpp>
+#include <krowkee/util/wire.hpp>
 
+#include <algorithm>
 #include <map>
 #include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 namespace krowkee {
 namespace stream {
@@ -18,6 +25,12 @@ namespace stream {
  * Multiple Sketch
  *
  * Holds the core-local rows of a sketch along with an associated transform.
+ *
+ * Checkpoints may be written incrementally. While `track_deltas` is on, each
+ * update is also applied to a per-key delta sketch, and `delta_snapshot`
+ * writes only the keys changed since the previous snapshot. A `snapshot`
+ * followed by its deltas, each merged back in with `restore`, reproduces the
+ * sketches, since linear sketches merge by addition.
  */
 template <
     template <typename, template <typename> class> class DataType,
@@ -41,14 +54,17 @@ class Multi {
                 KeyType, RegType, PtrType, Args...>
       msk_t;
 
-  typedef std::map<KeyType, data_t>  sk_map_t;
-  typedef std::pair<KeyType, data_t> sk_pair_t;
+  typedef std::map<KeyType, data_t>        sk_map_t;
+  typedef std::pair<KeyType, data_t>       sk_pair_t;
+  typedef krowkee::sketch::promotion_policy promotion_policy_t;
 
  private:
-  sf_ptr_t    _sf_ptr;  /// pointer to the shared sketch functor
-  sk_map_t    _sk_map;  /// map of indices to data
-  std::size_t _compaction_threshold;
-  std::size_t _promotion_threshold;
+  sf_ptr_t           _sf_ptr;  /// pointer to the shared sketch functor
+  sk_map_t           _sk_map;  /// map of indices to data
+  std::size_t        _compaction_threshold;
+  promotion_policy_t _promotion;
+  sk_map_t           _delta;         /// updates since the last snapshot
+  bool               _track_deltas;  /// whether updates are added to `_delta`
 
  public:
   /**
@@ -57,14 +73,16 @@ class Multi {
    * @param sf_ptr the sketch functor.
    * @param compaction_threshold the size at which compacting maps compact. Only
    *        used by Sparse and Promotable (in sparse mode) sketches.
-   * @param promotion_threshold the size at which to promote a sparse sketch to
-   *        a dense sketch. Only used by Promotable sketches.
+   * @param promotion when to promote a sparse sketch to a dense sketch, either
+   *        as a register count or a krowkee::sketch::promotion_policy. Only
+   *        used by Promotable sketches.
    */
   Multi(const sf_ptr_t &sf_ptr, const std::size_t compaction_threshold = 128,
-        const std::size_t promotion_threshold = 4096)
+        const promotion_policy_t &promotion = 4096)
       : _sf_ptr(sf_ptr),
         _compaction_threshold(compaction_threshold),
-        _promotion_threshold(promotion_threshold) {}
+        _promotion(promotion),
+        _track_deltas(false) {}
 
   /**
    * Copy constructor.
@@ -73,7 +91,37 @@ class Multi {
       : _sf_ptr(rhs._sf_ptr),
         _sk_map(rhs._sk_map),
         _compaction_threshold(rhs._compaction_threshold),
-        _promotion_threshold(rhs._promotion_threshold) {}
+        _promotion(rhs._promotion),
+        _delta(rhs._delta),
+        _track_deltas(rhs._track_deltas) {}
+
+  /**
+   * Move constructor.
+   */
+  Multi(msk_t &&rhs) noexcept
+      : _sf_ptr(std::move(rhs._sf_ptr)),
+        _sk_map(std::move(rhs._sk_map)),
+        _compaction_threshold(rhs._compaction_threshold),
+        _promotion(rhs._promotion),
+        _delta(std::move(rhs._delta)),
+        _track_deltas(rhs._track_deltas) {}
+
+  friend void swap(msk_t &lhs, msk_t &rhs) noexcept {
+    std::swap(lhs._sf_ptr, rhs._sf_ptr);
+    std::swap(lhs._sk_map, rhs._sk_map);
+    std::swap(lhs._compaction_threshold, rhs._compaction_threshold);
+    std::swap(lhs._promotion, rhs._promotion);
+    std::swap(lhs._delta, rhs._delta);
+    std::swap(lhs._track_deltas, rhs._track_deltas);
+  }
+
+  /**
+   * copy-and-swap assignment operator
+   */
+  msk_t &operator=(msk_t rhs) noexcept {
+    swap(*this, rhs);
+    return *this;
+  }
 
   static inline std::string name() {
     std::stringstream ss;
@@ -95,7 +143,8 @@ class Multi {
    * Insert item into the specified sketch registers.
    *
    * Inserts `x` into the sketch specified by `id`. Creates a new sketch for
-   * `id` if one does not already exist.
+   * `id` in place if one does not already exist, so that each insertion costs
+   * a single map lookup.
    *
    * @tparam ItemArgs... types of parameters of the stream object to be
    *     inserted. Will be used to construct a krowkee::stream::Element object.
@@ -107,14 +156,171 @@ class Multi {
    */
   template <typename... ItemArgs>
   inline void insert(const KeyType &key, const ItemArgs &...args) {
-    auto itr(_sk_map.find(key));
-    if (itr != std::end(_sk_map)) {
-      itr->second.update(args...);
-    } else {
-      data_t data{_sf_ptr, _compaction_threshold, _promotion_threshold,
-                  args...};
-      _sk_map[key] = data;
+    _emplace(key).update(args...);
+    if (_track_deltas == true) {
+      _emplace_delta(key).update(args...);
+    }
+  }
+
+  /**
+   * Insert a batch of `(key, item, multiplicity)` tuples in order.
+   *
+   * Consecutive tuples with the same key share a single map lookup, so
+   * batches grouped by key, such as sorted edge lists, are cheapest.
+   *
+   * @param keys pointer to the `count` row identifiers.
+   * @param items pointer to the `count` items to be inserted.
+   * @param multiplicities pointer to the `count` multiplicities of `items`,
+   *     or `nullptr` if every multiplicity is `1`.
+   * @param count the number of tuples.
+   */
+  void insert_batch(const KeyType *keys, const std::uint64_t *items,
+                    const RegType *multiplicities, const std::size_t count) {
+    for (std::size_t begin(0); begin < count;) {
+      std::size_t end(begin + 1);
+      while (end < count && keys[end] == keys[begin]) {
+        ++end;
+      }
+      _update_range(_emplace(keys[begin]), items, multiplicities, begin, end);
+      if (_track_deltas == true) {
+        _update_range(_emplace_delta(keys[begin]), items, multiplicities,
+                      begin, end);
+      }
+      begin = end;
+    }
+  }
+
+  /**
+   * Move `data` in as the sketch of `key`, or merge it into the existing
+   * sketch of `key` if there is one.
+   *
+   * @param key the row identifier.
+   * @param data a sketch constructed with the parameters of `this`.
+   *
+   * @return the sketch of `key`.
+   */
+  data_t &emplace(const KeyType &key, data_t &&data) {
+    if (_track_deltas == true) {
+      _merge_delta(key, data);
+    }
+    return _emplace(key, std::move(data));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Merge
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Merge the sketches of another Multi into `this`.
+   *
+   * Sketches whose keys are only present in `rhs` are copied, while those
+   * present in both are merged. As with sketch merges, sparse sketches must
+   * be compacted first.
+   *
+   * @param rhs the other Multi.
+   *
+   * @throws std::invalid_argument if the sketch functors or construction
+   *     parameters disagree.
+   */
+  void merge(const msk_t &rhs) {
+    if (_params_agree(rhs) == false) {
+      throw std::invalid_argument(
+          "error: attempting to merge Multi sketches with different "
+          "parameters!");
+    }
+    for (const auto &pair : rhs._sk_map) {
+      auto [itr, inserted] = _sk_map.try_emplace(pair.first, pair.second);
+      if (inserted == false) {
+        itr->second += pair.second;
+      }
+      if (_track_deltas == true) {
+        _merge_delta(pair.first, pair.second);
+      }
+    }
+  }
+
+  /**
+   * As `merge(rhs)`, moving rather than copying the sketches whose keys are
+   * only present in `rhs`.
+   */
+  void merge(msk_t &&rhs) {
+    if (_params_agree(rhs) == false) {
+      throw std::invalid_argument(
+          "error: attempting to merge Multi sketches with different "
+          "parameters!");
+    }
+    if (_track_deltas == true) {
+      for (const auto &pair : rhs._sk_map) {
+        _merge_delta(pair.first, pair.second);
+      }
+    }
+    if (_sk_map.empty() == true) {
+      _sk_map.swap(rhs._sk_map);
+      return;
+    }
+    for (auto &pair : rhs._sk_map) {
+      _emplace(pair.first, std::move(pair.second));
     }
+    rhs._sk_map.clear();
+  }
+
+  /**
+   * As `merge(rhs)`, copying and merging the sketches from the threads of
+   * `policy`.
+   *
+   * Sketches missing from `this` are first constructed empty, so that the
+   * map is only modified on the calling thread. The copies and merges are
+   * then scheduled largest sketch first, so that a few huge sketches do not
+   * stall the rest.
+   *
+   * @param rhs the other Multi.
+   * @param policy the threads to use.
+   *
+   * @throws std::invalid_argument if the sketch functors or construction
+   *     parameters disagree.
+   */
+  void merge(const msk_t &rhs, const krowkee::util::parallel_policy &policy) {
+    if (_params_agree(rhs) == false) {
+      throw std::invalid_argument(
+          "error: attempting to merge Multi sketches with different "
+          "parameters!");
+    }
+    std::vector<std::pair<data_t *, const data_t *>> tasks;
+    std::vector<bool>                                 copies;
+    std::vector<std::size_t>                          weights;
+    tasks.reserve(rhs.size());
+    copies.reserve(rhs.size());
+    weights.reserve(rhs.size());
+    for (const auto &pair : rhs._sk_map) {
+      auto [itr, inserted] = _sk_map.try_emplace(
+          pair.first, _sf_ptr, _compaction_threshold, _promotion);
+      tasks.emplace_back(&itr->second, &pair.second);
+      copies.push_back(inserted);
+      weights.push_back(_cost(pair.second));
+    }
+    krowkee::util::parallel_for_weighted(
+        weights, policy.num_threads, [&](const std::size_t i) {
+          if (copies[i] == true) {
+            *tasks[i].first = *tasks[i].second;
+          } else {
+            *tasks[i].first += *tasks[i].second;
+          }
+        });
+    if (_track_deltas == true) {
+      for (const auto &pair : rhs._sk_map) {
+        _merge_delta(pair.first, pair.second);
+      }
+    }
+  }
+
+  msk_t &operator+=(const msk_t &rhs) {
+    merge(rhs);
+    return *this;
+  }
+
+  msk_t &operator+=(msk_t &&rhs) {
+    merge(std::move(rhs));
+    return *this;
   }
 
   //////////////////////////////////////////////////////////////////////////////
@@ -137,21 +343,124 @@ class Multi {
                   [](auto &p) { p.second.compactify(); });
   }
 
+  /**
+   * As `compactify()`, compacting the sketches from the threads of `policy`,
+   * largest sketch first.
+   */
+  void compactify(const krowkee::util::parallel_policy &policy) {
+    std::vector<data_t *>    sketches;
+    std::vector<std::size_t> weights;
+    sketches.reserve(size());
+    weights.reserve(size());
+    for (auto &pair : _sk_map) {
+      sketches.push_back(&pair.second);
+      weights.push_back(_cost(pair.second));
+    }
+    krowkee::util::parallel_for_weighted(
+        weights, policy.num_threads,
+        [&](const std::size_t i) { sketches[i]->compactify(); });
+  }
+
+  /**
+   * Remove every sketch.
+   */
+  void clear() { _sk_map.clear(); }
+
   //////////////////////////////////////////////////////////////////////////////
-  // Sketch Access
+  // Windows
   //////////////////////////////////////////////////////////////////////////////
 
-  data_t &operator[](const KeyType key) {
-    auto itr(_sk_map.find(key));
-    if (itr != std::end(_sk_map)) {
-      return itr->second;
-    } else {
-      data_t data{_sf_ptr, _compaction_threshold, _promotion_threshold};
-      _sk_map[key] = data;
-      return _sk_map[key];
+  /**
+   * Move the window of every sketch forward by `steps` buckets. Requires a
+   * windowed DataType such as krowkee::stream::BoundedWindowedSummary.
+   *
+   * Expired buckets are not tracked by delta snapshots, so that a full
+   * `snapshot` should follow.
+   */
+  void advance(const std::size_t steps = 1) {
+    for (auto &pair : _sk_map) {
+      pair.second.advance(steps);
     }
   }
 
+  //////////////////////////////////////////////////////////////////////////////
+  // Delta Snapshots
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Start or stop tracking changes, discarding those already tracked.
+   *
+   * While tracking, updates made through `insert`, `insert_batch`, `emplace`
+   * and `merge` are applied a second time to the delta sketch of their key,
+   * so that tracking doubles their cost. Changes made through `operator[]`,
+   * `at`, iterators or `clear` are not tracked, and should be followed by a
+   * full `snapshot`.
+   */
+  void track_deltas(const bool track = true) {
+    _track_deltas = track;
+    _delta.clear();
+  }
+
+  constexpr bool tracking_deltas() const { return _track_deltas; }
+
+  /**
+   * The number of keys changed since the last snapshot.
+   */
+  std::size_t dirty_size() const { return _delta.size(); }
+
+  /**
+   * Write every sketch, compacting them first, and start a new epoch of
+   * tracked changes.
+   */
+  void snapshot(krowkee::util::wire_writer &writer) {
+    compactify();
+    _write(writer, _sk_map);
+    _delta.clear();
+  }
+
+  /**
+   * Write the changes made since the last snapshot, and start a new epoch.
+   *
+   * Each changed key is written with the sketch of its updates since the
+   * last snapshot. The deltas of Dense sketches are mostly zeros, and are
+   * written as their nonzero register ranges.
+   *
+   * @throws std::logic_error if changes are not being tracked.
+   */
+  void delta_snapshot(krowkee::util::wire_writer &writer) {
+    if (_track_deltas == false) {
+      throw std::logic_error(
+          "error: attempting to write a delta snapshot without tracking "
+          "deltas!");
+    }
+    for (auto &pair : _delta) {
+      pair.second.compactify();
+    }
+    _write(writer, _delta);
+    _delta.clear();
+  }
+
+  /**
+   * Merge a snapshot or delta snapshot into `this` with `emplace`.
+   *
+   * @throws std::out_of_range if the snapshot is truncated or malformed.
+   */
+  void restore(krowkee::util::wire_reader &reader) {
+    const std::size_t size(reader.get_varint());
+    for (std::size_t i(0); i < size; ++i) {
+      const KeyType key(reader.get_key<KeyType>());
+      data_t        data(_sf_ptr, _compaction_threshold, _promotion);
+      data.unpack(reader);
+      emplace(key, std::move(data));
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Sketch Access
+  //////////////////////////////////////////////////////////////////////////////
+
+  data_t &operator[](const KeyType key) { return _emplace(key); }
+
   data_t &at(const KeyType key) {
     auto itr(_sk_map.find(key));
     if (itr != std::end(_sk_map)) {
@@ -199,13 +508,23 @@ class Multi {
 
   constexpr std::size_t size() const { return _sk_map.size(); }
 
+  constexpr const sf_ptr_t &get_sf_ptr() const { return _sf_ptr; }
+
+  constexpr std::size_t get_compaction_threshold() const {
+    return _compaction_threshold;
+  }
+
+  constexpr const promotion_policy_t &get_promotion_policy() const {
+    return _promotion;
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   // Equality check
   //////////////////////////////////////////////////////////////////////////////
 
   constexpr bool _params_agree(const msk_t &other) const {
     return _sf_ptr == other._sf_ptr &&
-           _promotion_threshold == other._promotion_threshold &&
+           _promotion == other._promotion &&
            _compaction_threshold == other._compaction_threshold;
   }
 
@@ -228,6 +547,74 @@ class Multi {
   friend constexpr bool operator!=(const msk_t &lhs, const msk_t &rhs) {
     return !(lhs == rhs);
   }
+
+ private:
+  /**
+   * Find the sketch for `key`, constructing an empty one if necessary.
+   */
+  inline data_t &_emplace(const KeyType &key) {
+    return _sk_map
+        .try_emplace(key, _sf_ptr, _compaction_threshold, _promotion)
+        .first->second;
+  }
+
+  /**
+   * As `emplace(key, data)`, without adding `data` to the delta.
+   */
+  data_t &_emplace(const KeyType &key, data_t &&data) {
+    auto [itr, inserted] = _sk_map.try_emplace(key, std::move(data));
+    if (inserted == false) {
+      itr->second += data;
+    }
+    return itr->second;
+  }
+
+  /**
+   * Find the delta sketch for `key`, constructing an empty one if necessary.
+   */
+  inline data_t &_emplace_delta(const KeyType &key) {
+    return _delta.try_emplace(key, _sf_ptr, _compaction_threshold, _promotion)
+        .first->second;
+  }
+
+  /**
+   * Add `data` to the delta sketch of `key`.
+   */
+  void _merge_delta(const KeyType &key, const data_t &data) {
+    auto [itr, inserted] = _delta.try_emplace(key, data);
+    if (inserted == false) {
+      itr->second.compactify();
+      itr->second += data;
+    }
+  }
+
+  void _update_range(data_t &data, const std::uint64_t *items,
+                     const RegType *multiplicities, const std::size_t begin,
+                     const std::size_t end) {
+    for (std::size_t i(begin); i < end; ++i) {
+      if (multiplicities == nullptr) {
+        data.update(items[i]);
+      } else {
+        data.update(items[i], multiplicities[i]);
+      }
+    }
+  }
+
+  static void _write(krowkee::util::wire_writer &writer,
+                     const sk_map_t             &sk_map) {
+    writer.put_varint(sk_map.size());
+    for (const auto &[key, data] : sk_map) {
+      writer.put_key(key);
+      data.pack(writer);
+    }
+  }
+
+  /**
+   * Estimated cost of compacting, copying or merging `data`.
+   */
+  static inline std::size_t _cost(const data_t &data) {
+    return data.sk.size();
+  }
 };
 
 }  // namespace stream
@@ -0,0 +1,758 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_STREAM_MULTIVIEW_HPP
+#define _KROWKEE_STREAM_MULTIVIEW_HPP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <krowkee/sketch/promotion_policy.hpp>
+#include <krowkee/sketch/registers.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace krowkee {
+namespace stream {
+
+/**
+ * Fixed header of a Multi sketch file.
+ *
+ * A Multi file is columnar and is laid out for memory mapping. Every section
+ * begins on an 8 byte boundary and holds values in native byte order:
+ *
+ *     header | functor name | keys | offsets | blob
+ *
+ * `keys` holds the `num_keys` sorted keys, `offsets` holds `num_keys + 1`
+ * 64 bit offsets into `blob`, and the registers of the sketch of `keys[i]` are
+ * the blob record `[offsets[i], offsets[i + 1])`. A record is an optional 64
+ * bit count (if `has_count`), a 64 bit word holding the number of stored
+ * registers with `dense_record` set for dense records, and then either the
+ * `range_size` registers of a dense record or the sorted register indices of
+ * a sparse record followed by its register values.
+ */
+struct multi_file_header {
+  static constexpr char          file_magic[8]   = {'K', 'R', 'K', 'M',
+                                                    'U', 'L', 'T', 'I'};
+  static constexpr std::uint32_t file_version    = 1;
+  static constexpr std::uint32_t byte_order_mark = 0x01020304;
+  /// flags the register count word of dense records
+  static constexpr std::uint64_t dense_record = std::uint64_t(1) << 63;
+
+  char          magic[8];
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint32_t key_bytes;    /// size of a key
+  std::uint32_t reg_bytes;    /// size of a register
+  std::uint32_t index_bytes;  /// size of a sparse register index
+  std::uint32_t has_count;    /// whether records begin with a count
+  std::uint64_t range_size;   /// sketch functor range size
+  std::uint64_t seed;         /// sketch functor seed
+  std::uint64_t num_keys;
+  std::uint64_t name_offset;  /// sketch functor `full_name()`
+  std::uint64_t name_bytes;
+  std::uint64_t keys_offset;
+  std::uint64_t offsets_offset;
+  std::uint64_t blob_offset;
+  std::uint64_t file_size;
+
+  /**
+   * Read the header of the Multi file at `path`, e.g. to construct the sketch
+   * functor needed to open it.
+   *
+   * @throws std::runtime_error if the file cannot be read.
+   * @throws std::invalid_argument if the file is not a Multi file.
+   */
+  static multi_file_header read(const std::string &path) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) {
+      std::stringstream ss;
+      ss << "error: could not open Multi file " << path << "!";
+      throw std::runtime_error(ss.str());
+    }
+    multi_file_header header;
+    if (!ifs.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+      std::stringstream ss;
+      ss << "error: " << path << " is too short to be a Multi file!";
+      throw std::invalid_argument(ss.str());
+    }
+    header.check(path);
+    return header;
+  }
+
+  /**
+   * Read the sketch functor name of the Multi file at `path`.
+   */
+  static std::string read_name(const std::string &path) {
+    const multi_file_header header(read(path));
+    std::ifstream           ifs(path, std::ios::binary);
+    std::string             name(header.name_bytes, '\0');
+    ifs.seekg(header.name_offset);
+    if (!ifs.read(name.data(), name.size())) {
+      std::stringstream ss;
+      ss << "error: truncated Multi file " << path << "!";
+      throw std::invalid_argument(ss.str());
+    }
+    return name;
+  }
+
+  /**
+   * @throws std::invalid_argument if the magic, version or byte order of
+   *     `this` is not that of a Multi file written by this build.
+   */
+  void check(const std::string &path) const {
+    std::stringstream ss;
+    if (std::memcmp(magic, file_magic, sizeof(magic)) != 0) {
+      ss << "error: " << path << " is not a Multi file!";
+    } else if (version != file_version) {
+      ss << "error: " << path << " has Multi file version " << version
+         << ", expected " << file_version << "!";
+    } else if (byte_order != byte_order_mark) {
+      ss << "error: " << path << " was written with a different byte order!";
+    } else {
+      return;
+    }
+    throw std::invalid_argument(ss.str());
+  }
+};
+
+/**
+ * Read-only, memory mapped view of a Multi sketch file.
+ *
+ * `write` stores the sketches of a Multi in the columnar format described by
+ * krowkee::stream::multi_file_header. A MultiView maps such a file and
+ * answers register reads, point queries and merges directly from the mapped
+ * pages, so that opening a file of many sketches costs a single `mmap` rather
+ * than deserializing every sketch. Keys are found by binary search of the key
+ * column, and the pages of a sketch are only read when it is accessed.
+ *
+ * Keys and registers must be trivially copyable, and files are only portable
+ * between machines of the same byte order.
+ *
+ * @tparam MultiType the krowkee::stream::Multi type that the view stands in
+ *     for.
+ */
+template <typename MultiType>
+class MultiView {
+ public:
+  typedef MultiType                          msk_t;
+  typedef typename msk_t::sf_t               sf_t;
+  typedef typename msk_t::sf_ptr_t           sf_ptr_t;
+  typedef typename msk_t::data_t             data_t;
+  typedef typename msk_t::sk_t               sk_t;
+  typedef typename sk_t::reg_t               reg_t;
+  typedef typename msk_t::sk_map_t::key_type key_t;
+  typedef MultiView<MultiType>               mv_t;
+  typedef multi_file_header                  header_t;
+  typedef krowkee::sketch::promotion_policy  promotion_policy_t;
+
+  static_assert(std::is_trivially_copyable_v<key_t>,
+                "MultiView keys must be trivially copyable");
+  static_assert(std::is_trivially_copyable_v<reg_t>,
+                "MultiView registers must be trivially copyable");
+
+  /**
+   * The registers of one sketch of the file.
+   */
+  class sketch_view {
+    const void   *_indices;  /// sorted indices, or nullptr if dense
+    const reg_t  *_values;
+    std::uint64_t _size;
+    std::uint64_t _count;
+    std::uint32_t _index_bytes;
+
+   public:
+    sketch_view(const void *indices, const reg_t *values,
+                const std::uint64_t size, const std::uint64_t count,
+                const std::uint32_t index_bytes)
+        : _indices(indices),
+          _values(values),
+          _size(size),
+          _count(count),
+          _index_bytes(index_bytes) {}
+
+    /**
+     * Read a register. Registers that are not stored are zero.
+     */
+    inline reg_t get(const std::uint64_t index) const {
+      if (is_sparse() == false) {
+        return _values[index];
+      }
+      const std::uint64_t pos((_index_bytes == 4)
+                                  ? _find(static_cast<const std::uint32_t *>(
+                                              _indices),
+                                          index)
+                                  : _find(static_cast<const std::uint64_t *>(
+                                              _indices),
+                                          index));
+      return (pos < _size) ? _values[pos] : reg_t(0);
+    }
+
+    constexpr bool is_sparse() const { return _indices != nullptr; }
+
+    /**
+     * The number of stored registers.
+     */
+    constexpr std::uint64_t size() const { return _size; }
+
+    /**
+     * The stored count of a CountingSummary, or zero.
+     */
+    constexpr std::uint64_t count() const { return _count; }
+
+    /**
+     * Call `func(index, value)` on every nonzero register in index order.
+     */
+    template <typename Func>
+    friend void for_each(const sketch_view &view, const Func &func) {
+      if (view.is_sparse() == false) {
+        for (std::uint64_t i(0); i < view._size; ++i) {
+          if (view._values[i] != reg_t(0)) {
+            func(i, view._values[i]);
+          }
+        }
+      } else if (view._index_bytes == 4) {
+        view._for_each(static_cast<const std::uint32_t *>(view._indices),
+                       func);
+      } else {
+        view._for_each(static_cast<const std::uint64_t *>(view._indices),
+                       func);
+      }
+    }
+
+   private:
+    template <typename IndexType>
+    inline std::uint64_t _find(const IndexType *indices,
+                               const std::uint64_t index) const {
+      const IndexType *itr(
+          std::lower_bound(indices, indices + _size, IndexType(index)));
+      return (itr != indices + _size && *itr == index) ? itr - indices : _size;
+    }
+
+    template <typename IndexType, typename Func>
+    inline void _for_each(const IndexType *indices, const Func &func) const {
+      for (std::uint64_t i(0); i < _size; ++i) {
+        func(std::uint64_t(indices[i]), _values[i]);
+      }
+    }
+  };
+
+ private:
+  sf_ptr_t             _sf_ptr;  /// pointer to the shared sketch functor
+  header_t             _header;
+  const std::uint8_t  *_data;    /// the mapped file
+  const key_t         *_keys;
+  const std::uint64_t *_offsets;
+  const std::uint8_t  *_blob;
+
+ public:
+  /**
+   * Map the Multi file at `path`.
+   *
+   * @param path the file, written by `write`.
+   * @param sf_ptr the sketch functor. Must agree with the one the file was
+   *     written with.
+   *
+   * @throws std::runtime_error if the file cannot be mapped.
+   * @throws std::invalid_argument if the file is not a Multi file of this
+   *     type, or if its sketch functor parameters disagree with `sf_ptr`.
+   */
+  MultiView(const std::string &path, const sf_ptr_t &sf_ptr)
+      : _sf_ptr(sf_ptr), _data(nullptr) {
+    const int fd(::open(path.c_str(), O_RDONLY));
+    if (fd < 0) {
+      _throw_errno("open", path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || std::size_t(st.st_size) < sizeof(header_t)) {
+      ::close(fd);
+      std::stringstream ss;
+      ss << "error: " << path << " is too short to be a Multi file!";
+      throw std::invalid_argument(ss.str());
+    }
+    void *addr(::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+      _throw_errno("mmap", path);
+    }
+    _data = static_cast<const std::uint8_t *>(addr);
+    std::memcpy(&_header, _data, sizeof(header_t));
+    try {
+      _check(path, st.st_size);
+    } catch (...) {
+      ::munmap(const_cast<std::uint8_t *>(_data), st.st_size);
+      throw;
+    }
+    _keys    = reinterpret_cast<const key_t *>(_data + _header.keys_offset);
+    _offsets = reinterpret_cast<const std::uint64_t *>(_data +
+                                                       _header.offsets_offset);
+    _blob    = _data + _header.blob_offset;
+  }
+
+  MultiView(const mv_t &)       = delete;
+  mv_t &operator=(const mv_t &) = delete;
+
+  MultiView(mv_t &&rhs) noexcept
+      : _sf_ptr(rhs._sf_ptr),
+        _header(rhs._header),
+        _data(rhs._data),
+        _keys(rhs._keys),
+        _offsets(rhs._offsets),
+        _blob(rhs._blob) {
+    rhs._data = nullptr;
+  }
+
+  ~MultiView() {
+    if (_data != nullptr) {
+      ::munmap(const_cast<std::uint8_t *>(_data), _header.file_size);
+    }
+  }
+
+  static inline std::string name() {
+    std::stringstream ss;
+    ss << "Multi View " << sk_t::name();
+    return ss.str();
+  }
+
+  static inline std::string full_name() {
+    std::stringstream ss;
+    ss << "Multi View " << sk_t::full_name();
+    return ss.str();
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // File Output
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Write the sketches of `multi` to a Multi file at `path`.
+   *
+   * Each sketch is stored in whichever of the dense or sparse record layouts
+   * is smaller. As with merges, sparse sketches must be compacted first.
+   *
+   * @throws std::runtime_error if the file cannot be written.
+   * @throws std::logic_error if a sparse sketch is not compact.
+   */
+  static void write(const std::string &path, const msk_t &multi) {
+    const sf_t       &sf(*multi.get_sf_ptr());
+    const std::string name(sf_t::full_name());
+
+    header_t header;
+    std::memcpy(header.magic, header_t::file_magic, sizeof(header.magic));
+    header.version     = header_t::file_version;
+    header.byte_order  = header_t::byte_order_mark;
+    header.key_bytes   = sizeof(key_t);
+    header.reg_bytes   = sizeof(reg_t);
+    header.index_bytes = (sf.range_size() <= (std::uint64_t(1) << 32)) ? 4 : 8;
+    header.has_count   = _has_count;
+    header.range_size  = sf.range_size();
+    header.seed        = sf.seed();
+    header.num_keys    = multi.size();
+    header.name_offset = sizeof(header_t);
+    header.name_bytes  = name.size();
+    header.keys_offset = _align(header.name_offset + header.name_bytes);
+    header.offsets_offset =
+        _align(header.keys_offset + header.num_keys * sizeof(key_t));
+    header.blob_offset =
+        header.offsets_offset + (header.num_keys + 1) * sizeof(std::uint64_t);
+
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+      std::stringstream ss;
+      ss << "error: could not open " << path << " for writing!";
+      throw std::runtime_error(ss.str());
+    }
+    _put(ofs, header);
+    ofs.write(name.data(), name.size());
+    _pad(ofs, header.name_offset + header.name_bytes);
+    for (const auto &pair : multi) {
+      _put(ofs, pair.first);
+    }
+    _pad(ofs, header.keys_offset + header.num_keys * sizeof(key_t));
+
+    // The offsets are only known once the records are written, so they are
+    // filled in afterwards.
+    std::vector<std::uint64_t> offsets;
+    offsets.reserve(header.num_keys + 1);
+    ofs.seekp(header.blob_offset);
+    std::uint64_t              pos(0);
+    std::vector<std::uint64_t> indices;
+    std::vector<reg_t>         values;
+    for (const auto &pair : multi) {
+      offsets.push_back(pos);
+      pos += _put_record(ofs, pair.second, header, indices, values);
+    }
+    offsets.push_back(pos);
+    header.file_size = header.blob_offset + pos;
+
+    ofs.seekp(header.offsets_offset);
+    ofs.write(reinterpret_cast<const char *>(offsets.data()),
+              offsets.size() * sizeof(std::uint64_t));
+    ofs.seekp(0);
+    _put(ofs, header);
+    if (!ofs.flush()) {
+      std::stringstream ss;
+      ss << "error: failed to write Multi file " << path << "!";
+      throw std::runtime_error(ss.str());
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Sketch Access
+  //////////////////////////////////////////////////////////////////////////////
+
+  bool contains(const key_t &key) const { return _find(key) < size(); }
+
+  /**
+   * @throws std::invalid_argument if `key` is not in the file.
+   */
+  sketch_view at(const key_t &key) const {
+    const std::uint64_t slot(_find(key));
+    if (slot == size()) {
+      std::stringstream ss;
+      ss << "error: key " << key << " does not exist!";
+      throw std::invalid_argument(ss.str());
+    }
+    return _record(slot);
+  }
+
+  /**
+   * Estimate the total multiplicity inserted for `item` into the sketch of
+   * `key`. Only available for sketch functors that support point queries.
+   */
+  inline reg_t point_query(const key_t &key, const std::uint64_t item) const {
+    return _sf_ptr->point_query(at(key), item);
+  }
+
+  /**
+   * Construct a sketch holding the registers of `key`.
+   */
+  data_t materialize(const key_t &key, const std::size_t compaction_threshold,
+                     const promotion_policy_t &promotion) const {
+    data_t ret(_sf_ptr, compaction_threshold, promotion);
+    merge_into(key, ret);
+    ret.compactify();
+    return ret;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Merge
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Merge the registers of `key` into `dst` without materializing them.
+   *
+   * Sparse sketches are left uncompacted.
+   *
+   * @throws std::invalid_argument if `key` is not in the file or the sketch
+   *     functor of `dst` disagrees with the file.
+   */
+  void merge_into(const key_t &key, data_t &dst) const {
+    _check_functor(*dst.sk.get_sf_ptr());
+    _merge(at(key), dst);
+  }
+
+  /**
+   * Merge every sketch of the file into `dst`, creating sketches for keys
+   * that `dst` does not hold.
+   *
+   * @throws std::invalid_argument if the sketch functor of `dst` disagrees
+   *     with the file.
+   */
+  void merge_into(msk_t &dst) const {
+    _check_functor(*dst.get_sf_ptr());
+    for (std::uint64_t slot(0); slot < size(); ++slot) {
+      _merge(_record(slot), dst[_keys[slot]]);
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Getters
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr std::size_t size() const { return _header.num_keys; }
+
+  constexpr const header_t &header() const { return _header; }
+
+  constexpr const sf_ptr_t &get_sf_ptr() const { return _sf_ptr; }
+
+  /**
+   * The sorted keys of the file.
+   */
+  constexpr const key_t *keys_begin() const { return _keys; }
+  constexpr const key_t *keys_end() const { return _keys + size(); }
+
+ private:
+  template <typename T, typename = void>
+  struct _has_count_member : std::false_type {};
+
+  template <typename T>
+  struct _has_count_member<T, std::void_t<decltype(std::declval<T &>().count)>>
+      : std::true_type {};
+
+  /// whether records hold the count of a CountingSummary
+  static constexpr bool _has_count = _has_count_member<data_t>::value;
+
+  template <typename T, typename = void>
+  struct _has_statistics_member : std::false_type {};
+
+  template <typename T>
+  struct _has_statistics_member<
+      T, std::void_t<decltype(std::declval<T &>().invalidate_statistics())>>
+      : std::true_type {};
+
+  /// whether merges must invalidate the cache of a CachedCountingSummary
+  static constexpr bool _has_statistics =
+      _has_statistics_member<data_t>::value;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Reading
+  //////////////////////////////////////////////////////////////////////////////
+
+  inline std::uint64_t _find(const key_t &key) const {
+    const key_t *itr(std::lower_bound(_keys, _keys + size(), key));
+    return (itr != _keys + size() && *itr == key) ? itr - _keys : size();
+  }
+
+  sketch_view _record(const std::uint64_t slot) const {
+    const std::uint8_t *pos(_blob + _offsets[slot]);
+    std::uint64_t       count(0);
+    if (_header.has_count) {
+      std::memcpy(&count, pos, sizeof(count));
+      pos += sizeof(count);
+    }
+    std::uint64_t word;
+    std::memcpy(&word, pos, sizeof(word));
+    pos += sizeof(word);
+    if (word & header_t::dense_record) {
+      return sketch_view(nullptr, reinterpret_cast<const reg_t *>(pos),
+                         word & ~header_t::dense_record, count, 0);
+    }
+    const reg_t *values(reinterpret_cast<const reg_t *>(
+        pos + _align(word * _header.index_bytes)));
+    return sketch_view(pos, values, word, count, _header.index_bytes);
+  }
+
+  static void _merge(const sketch_view &view, data_t &dst) {
+    for_each(view, [&](const std::uint64_t index, const reg_t value) {
+      dst.sk.merge_register(index, value);
+    });
+    if constexpr (_has_count) {
+      dst.count += view.count();
+    }
+    if constexpr (_has_statistics) {
+      dst.invalidate_statistics();
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Validation
+  //////////////////////////////////////////////////////////////////////////////
+
+  void _check(const std::string &path, const std::uint64_t file_size) const {
+    _header.check(path);
+    std::stringstream ss;
+    if (_header.key_bytes != sizeof(key_t) ||
+        _header.reg_bytes != sizeof(reg_t) ||
+        bool(_header.has_count) != _has_count) {
+      ss << "error: " << path << " holds " << _header.key_bytes
+         << " byte keys and " << _header.reg_bytes
+         << " byte registers, which do not match " << full_name() << "!";
+    } else if (_header.file_size != file_size ||
+               _header.num_keys > file_size / sizeof(std::uint64_t) ||
+               _header.name_offset + _header.name_bytes > file_size ||
+               _header.keys_offset + _header.num_keys * sizeof(key_t) >
+                   file_size ||
+               _header.blob_offset > file_size ||
+               _header.offsets_offset +
+                       (_header.num_keys + 1) * sizeof(std::uint64_t) >
+                   _header.blob_offset) {
+      ss << "error: truncated Multi file " << path << "!";
+    } else if (_stored_blob_size() != file_size - _header.blob_offset) {
+      ss << "error: corrupt offsets in Multi file " << path << "!";
+    } else if (_records_fit() == false) {
+      ss << "error: corrupt records in Multi file " << path << "!";
+    } else if (std::string(
+                   reinterpret_cast<const char *>(_data + _header.name_offset),
+                   _header.name_bytes) != sf_t::full_name()) {
+      ss << "error: " << path << " was not written with a "
+         << sf_t::full_name() << "!";
+    } else {
+      try {
+        _check_functor(*_sf_ptr);
+      } catch (const std::invalid_argument &e) {
+        ss << e.what();
+      }
+    }
+    if (ss.str().empty() == false) {
+      throw std::invalid_argument(ss.str());
+    }
+  }
+
+  /**
+   * The blob size recorded by the last offset.
+   */
+  inline std::uint64_t _stored_blob_size() const {
+    return _load(_header.offsets_offset +
+                 _header.num_keys * sizeof(std::uint64_t));
+  }
+
+  /**
+   * Whether the offsets are non-decreasing and every record decodes to a size
+   * that fits before the next offset, so that `_record` and `sketch_view`
+   * never read past the mapping. Dense records must hold `range_size`
+   * registers, as `sketch_view::get` does not bound its index.
+   */
+  bool _records_fit() const {
+    if (_header.index_bytes != 4 && _header.index_bytes != 8) {
+      return false;
+    }
+    const std::uint64_t blob_size(_header.file_size - _header.blob_offset);
+    const std::uint64_t head((_header.has_count ? 2 : 1) *
+                             sizeof(std::uint64_t));
+    std::uint64_t       begin(_load(_header.offsets_offset));
+    for (std::uint64_t slot(1); slot <= _header.num_keys; ++slot) {
+      const std::uint64_t end(
+          _load(_header.offsets_offset + slot * sizeof(std::uint64_t)));
+      if (end < begin || end > blob_size || end - begin < head) {
+        return false;
+      }
+      const std::uint64_t word(_load(_header.blob_offset + begin + head -
+                                     sizeof(std::uint64_t)));
+      const bool          dense(word & header_t::dense_record);
+      const std::uint64_t size(word & ~header_t::dense_record);
+      const std::uint64_t room(end - begin - head);
+      const std::uint64_t stride(_header.reg_bytes +
+                                 (dense ? 0 : _header.index_bytes));
+      if ((dense ? size != _header.range_size : size > _header.range_size) ||
+          size > room / stride) {
+        return false;
+      }
+      const std::uint64_t body(
+          _align(size * _header.reg_bytes) +
+          (dense ? 0 : _align(size * _header.index_bytes)));
+      if (body > room) {
+        return false;
+      }
+      begin = end;
+    }
+    return true;
+  }
+
+  /**
+   * Read the 64 bit word at byte `pos` of the mapped file.
+   */
+  inline std::uint64_t _load(const std::uint64_t pos) const {
+    std::uint64_t ret;
+    std::memcpy(&ret, _data + pos, sizeof(ret));
+    return ret;
+  }
+
+  void _check_functor(const sf_t &sf) const {
+    if (sf.range_size() != _header.range_size || sf.seed() != _header.seed) {
+      std::stringstream ss;
+      ss << "error: Multi file has range size " << _header.range_size
+         << " and seed " << _header.seed << ", but the sketch functor has ("
+         << sf << ")!";
+      throw std::invalid_argument(ss.str());
+    }
+  }
+
+  [[noreturn]] static void _throw_errno(const char        *call,
+                                        const std::string &path) {
+    std::stringstream ss;
+    ss << "error: " << call << " failed on " << path << ": "
+       << std::strerror(errno);
+    throw std::runtime_error(ss.str());
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Writing
+  //////////////////////////////////////////////////////////////////////////////
+
+  static constexpr std::uint64_t _align(const std::uint64_t pos) {
+    return (pos + 7) & ~std::uint64_t(7);
+  }
+
+  template <typename T>
+  static inline void _put(std::ofstream &ofs, const T &val) {
+    ofs.write(reinterpret_cast<const char *>(&val), sizeof(T));
+  }
+
+  static inline void _pad(std::ofstream &ofs, const std::uint64_t pos) {
+    static constexpr char zeros[8] = {};
+    ofs.write(zeros, _align(pos) - pos);
+  }
+
+  template <typename IndexType>
+  static void _put_indices(std::ofstream                    &ofs,
+                           const std::vector<std::uint64_t> &indices) {
+    for (const std::uint64_t index : indices) {
+      _put(ofs, IndexType(index));
+    }
+  }
+
+  /**
+   * Write the record of `data` and return its size. `indices` and `values`
+   * are scratch space shared across records.
+   */
+  static std::uint64_t _put_record(std::ofstream &ofs, const data_t &data,
+                                   const header_t             &header,
+                                   std::vector<std::uint64_t> &indices,
+                                   std::vector<reg_t>         &values) {
+    bool dense(krowkee::sketch::copy_registers(data.sk.get_container(),
+                                               indices, values) == false);
+    if (dense == false) {
+      dense = indices.size() * (header.index_bytes + header.reg_bytes) >=
+              header.range_size * header.reg_bytes;
+      if (dense) {
+        std::vector<reg_t> registers(header.range_size, reg_t(0));
+        for (std::size_t i(0); i < indices.size(); ++i) {
+          registers[indices[i]] = values[i];
+        }
+        std::swap(registers, values);
+      }
+    }
+
+    std::uint64_t size(0);
+    if constexpr (_has_count) {
+      _put(ofs, std::uint64_t(data.count));
+      size += sizeof(std::uint64_t);
+    }
+    _put(ofs, values.size() | (dense ? header_t::dense_record : 0));
+    size += sizeof(std::uint64_t);
+    if (dense == false) {
+      if (header.index_bytes == 4) {
+        _put_indices<std::uint32_t>(ofs, indices);
+      } else {
+        _put_indices<std::uint64_t>(ofs, indices);
+      }
+      _pad(ofs, indices.size() * header.index_bytes);
+      size += _align(indices.size() * header.index_bytes);
+    }
+    ofs.write(reinterpret_cast<const char *>(values.data()),
+              values.size() * sizeof(reg_t));
+    _pad(ofs, values.size() * sizeof(reg_t));
+    size += _align(values.size() * sizeof(reg_t));
+    return size;
+  }
+};
+
+}  // namespace stream
+}  // namespace krowkee
+
+#endif
@@ -0,0 +1,313 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_STREAM_POOLEDMULTI_HPP
+#define _KROWKEE_STREAM_POOLEDMULTI_HPP
+
+#include <krowkee/container/open_hash_map.hpp>
+#include <krowkee/sketch/promotion_policy.hpp>
+
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace krowkee {
+namespace stream {
+
+/**
+ * Pooled Multiple Sketch
+ *
+ * Holds the same core-local rows as Multi, but stores the sketches
+ * contiguously in a single pool, in insertion order, and indexes them with a
+ * flat hash map from key to pool slot. Integral keys use the open addressing
+ * `open_hash_map`; other keys use `std::unordered_map`. A Multi holding many
+ * keys therefore performs a handful of large allocations for its index and
+ * sketch objects rather than one tree node per key, and iterates its
+ * sketches in memory order.
+ *
+ * The pool holds each sketch object, but Dense and Sparse sketches still
+ * allocate their registers. Sketches over `krowkee::sketch::FixedDense` hold
+ * their registers inline, so that the registers of every key live in the pool
+ * itself; see `PooledMultiLocalFixedCountSketch`. A reserved pool of such
+ * sketches then ingests any number of keys without further allocation.
+ *
+ * `reserve` sizes the pool and index up front. Growing the pool past its
+ * capacity relocates the sketches, so references returned by the accessors
+ * are invalidated by insertions of new keys.
+ */
+template <
+    template <typename, template <typename> class> class DataType,
+    template <template <typename, typename...> class,
+              template <typename, typename> class, template <typename> class,
+              typename, template <typename> class, typename...>
+    class SketchType,
+    template <typename, typename...> class SketchFunc,
+    template <typename, typename> class ContainerType,
+    template <typename> class MergeOp, typename KeyType, typename RegType,
+    template <typename> class PtrType, typename... Args>
+class PooledMulti {
+ public:
+  typedef SketchFunc<RegType, Args...> sf_t;
+  typedef PtrType<sf_t>                sf_ptr_t;
+  typedef SketchType<SketchFunc, ContainerType, MergeOp, RegType, PtrType,
+                     Args...>
+                                  sk_t;
+  typedef DataType<sk_t, PtrType> data_t;
+  typedef PooledMulti<DataType, SketchType, SketchFunc, ContainerType, MergeOp,
+                      KeyType, RegType, PtrType, Args...>
+      msk_t;
+
+  typedef std::pair<KeyType, data_t> sk_pair_t;
+  typedef std::vector<sk_pair_t>     pool_t;
+  typedef std::conditional_t<
+      std::is_integral_v<KeyType>,
+      krowkee::container::open_hash_map<KeyType, std::size_t>,
+      std::unordered_map<KeyType, std::size_t>>
+                                            index_t;
+  typedef krowkee::sketch::promotion_policy promotion_policy_t;
+
+ private:
+  sf_ptr_t           _sf_ptr;  /// pointer to the shared sketch functor
+  pool_t             _pool;    /// keys and data in insertion order
+  index_t            _index;   /// map of keys to pool slots
+  std::size_t        _compaction_threshold;
+  promotion_policy_t _promotion;
+
+ public:
+  /**
+   * Initialize hash functors and an empty pool.
+   *
+   * @param sf_ptr the sketch functor.
+   * @param compaction_threshold the size at which compacting maps compact. Only
+   *        used by Sparse and Promotable (in sparse mode) sketches.
+   * @param promotion when to promote a sparse sketch to a dense sketch. Only
+   *        used by Promotable sketches.
+   * @param expected_keys the number of keys to reserve space for.
+   */
+  PooledMulti(const sf_ptr_t           &sf_ptr,
+              const std::size_t         compaction_threshold = 128,
+              const promotion_policy_t &promotion            = 4096,
+              const std::size_t         expected_keys        = 0)
+      : _sf_ptr(sf_ptr),
+        _compaction_threshold(compaction_threshold),
+        _promotion(promotion) {
+    reserve(expected_keys);
+  }
+
+  /**
+   * Copy constructor.
+   */
+  PooledMulti(const msk_t &rhs)
+      : _sf_ptr(rhs._sf_ptr),
+        _pool(rhs._pool),
+        _index(rhs._index),
+        _compaction_threshold(rhs._compaction_threshold),
+        _promotion(rhs._promotion) {}
+
+  static inline std::string name() {
+    std::stringstream ss;
+    ss << "Pooled Multi " << sk_t::name();
+    return ss.str();
+  }
+
+  static inline std::string full_name() {
+    std::stringstream ss;
+    ss << "Pooled Multi " << sk_t::full_name();
+    return ss.str();
+  }
+
+  /**
+   * Reserve pool and index space for `num_keys` keys.
+   */
+  void reserve(const std::size_t num_keys) {
+    _pool.reserve(num_keys);
+    if constexpr (std::is_integral_v<KeyType>) {
+      if (num_keys > _index.size()) {
+        index_t index(num_keys);
+        for (const auto &pair : _index) {
+          index.insert(pair);
+        }
+        std::swap(_index, index);
+      }
+    } else {
+      _index.reserve(num_keys);
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Sketch Insertion
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Insert item into the specified sketch registers.
+   *
+   * Inserts `x` into the sketch specified by `id`. Appends a new sketch to the
+   * pool for `id` if one does not already exist.
+   *
+   * @param key the row identifier.
+   * @param x the object to be inserted.
+   * @param multiplicity the number of insert repetitions to perform. Can be
+   *     negative. Default is `1`.
+   */
+  template <typename... ItemArgs>
+  inline void insert(const KeyType &key, const ItemArgs &...args) {
+    _emplace(key).update(args...);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Merge
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Merge the sketches of another PooledMulti into `this`. Sparse sketches
+   * must be compacted first.
+   *
+   * @throws std::invalid_argument if the sketch functors or construction
+   *     parameters disagree.
+   */
+  void merge(const msk_t &rhs) {
+    if (_params_agree(rhs) == false) {
+      throw std::invalid_argument(
+          "error: attempting to merge Multi sketches with different "
+          "parameters!");
+    }
+    if (&rhs == this) {
+      // `_emplace` may not write to the pool that is being read
+      const msk_t copy(rhs);
+      merge(copy);
+      return;
+    }
+    for (const sk_pair_t &pair : rhs._pool) {
+      _emplace(pair.first) += pair.second;
+    }
+  }
+
+  msk_t &operator+=(const msk_t &rhs) {
+    merge(rhs);
+    return *this;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Compaction
+  //////////////////////////////////////////////////////////////////////////////
+
+  void compactify(const KeyType key) { at(key).compactify(); }
+
+  void compactify() {
+    for (sk_pair_t &pair : _pool) {
+      pair.second.compactify();
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Sketch Access
+  //////////////////////////////////////////////////////////////////////////////
+
+  data_t &operator[](const KeyType key) { return _emplace(key); }
+
+  data_t &at(const KeyType key) {
+    return const_cast<data_t &>(static_cast<const msk_t *>(this)->at(key));
+  }
+
+  const data_t &at(const KeyType key) const {
+    const std::size_t slot(_find(key));
+    if (slot == _pool.size()) {
+      std::stringstream ss;
+      ss << "error: key " << key << " does not exist!";
+      throw std::invalid_argument(ss.str());
+    }
+    return _pool[slot].second;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Register iterators
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr typename pool_t::iterator begin() { return std::begin(_pool); }
+  constexpr typename pool_t::const_iterator begin() const {
+    return std::cbegin(_pool);
+  }
+  constexpr typename pool_t::const_iterator cbegin() const {
+    return std::cbegin(_pool);
+  }
+  constexpr typename pool_t::iterator end() { return std::end(_pool); }
+  constexpr typename pool_t::const_iterator end() const {
+    return std::cend(_pool);
+  }
+  constexpr typename pool_t::const_iterator cend() const {
+    return std::cend(_pool);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Getters
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr std::size_t size() const { return _pool.size(); }
+
+  constexpr std::size_t capacity() const { return _pool.capacity(); }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Equality check
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr bool _params_agree(const msk_t &other) const {
+    return _sf_ptr == other._sf_ptr && _promotion == other._promotion &&
+           _compaction_threshold == other._compaction_threshold;
+  }
+
+  /**
+   * Sketches are matched by key, regardless of their pool order.
+   */
+  bool _data_agree(const msk_t &other) const {
+    for (const sk_pair_t &pair : _pool) {
+      const std::size_t slot(other._find(pair.first));
+      if (slot == other._pool.size() ||
+          pair.second != other._pool[slot].second) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  friend bool operator==(const msk_t &lhs, const msk_t &rhs) {
+    return lhs._params_agree(rhs) && lhs.size() == rhs.size() &&
+           lhs._data_agree(rhs);
+  }
+
+  friend bool operator!=(const msk_t &lhs, const msk_t &rhs) {
+    return !(lhs == rhs);
+  }
+
+ private:
+  /**
+   * Return the pool slot of `key`, or `size()` if it is absent.
+   */
+  inline std::size_t _find(const KeyType &key) const {
+    const auto itr(_index.find(key));
+    return (itr == std::end(_index)) ? _pool.size() : itr->second;
+  }
+
+  /**
+   * Find the sketch for `key`, appending an empty one if necessary.
+   */
+  inline data_t &_emplace(const KeyType &key) {
+    const std::size_t old_size(_index.size());
+    std::size_t      &slot(_index[key]);
+    if (_index.size() != old_size) {
+      slot = _pool.size();
+      _pool.emplace_back(
+          key, data_t(_sf_ptr, _compaction_threshold, _promotion));
+    }
+    return _pool[slot].second;
+  }
+};
+
+}  // namespace stream
+}  // namespace krowkee
+
+#endif
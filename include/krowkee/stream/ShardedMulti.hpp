@@ -0,0 +1,285 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_STREAM_SHARDEDMULTI_HPP
+#define _KROWKEE_STREAM_SHARDEDMULTI_HPP
+
+#include <krowkee/hash/util.hpp>
+#include <krowkee/stream/Multi.hpp>
+#include <krowkee/util/parallel.hpp>
+
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace krowkee {
+namespace stream {
+
+/**
+ * Sharded Multiple Sketch
+ *
+ * Splits the sketches of a Multi across independent shards, each a Multi
+ * owning the keys that hash to it. Batches of `(key, item, multiplicity)`
+ * tuples are ingested by routing each tuple to its shard and then applying
+ * the shards' tuples from separate threads. A shard is only ever touched by
+ * one thread, so ingestion takes no locks.
+ *
+ * All shards share the sketch functor, which is only read during insertion.
+ * Since the shards hold disjoint keys, collapsing them into a single Multi
+ * only moves sketches, and never merges two sketches.
+ */
+template <
+    template <typename, template <typename> class> class DataType,
+    template <template <typename, typename...> class,
+              template <typename, typename> class, template <typename> class,
+              typename, template <typename> class, typename...>
+    class SketchType,
+    template <typename, typename...> class SketchFunc,
+    template <typename, typename> class ContainerType,
+    template <typename> class MergeOp, typename KeyType, typename RegType,
+    template <typename> class PtrType, typename... Args>
+class ShardedMulti {
+ public:
+  typedef Multi<DataType, SketchType, SketchFunc, ContainerType, MergeOp,
+                KeyType, RegType, PtrType, Args...>
+                                             msk_t;
+  typedef typename msk_t::sf_t               sf_t;
+  typedef typename msk_t::sf_ptr_t           sf_ptr_t;
+  typedef typename msk_t::sk_t               sk_t;
+  typedef typename msk_t::data_t             data_t;
+  typedef typename msk_t::promotion_policy_t promotion_policy_t;
+  typedef ShardedMulti<DataType, SketchType, SketchFunc, ContainerType, MergeOp,
+                       KeyType, RegType, PtrType, Args...>
+      smsk_t;
+
+ private:
+  std::vector<msk_t> _shards;
+
+ public:
+  /**
+   * Create `num_shards` empty shards.
+   *
+   * @param sf_ptr the sketch functor shared by every sketch.
+   * @param num_shards the number of shards. `0` means one per hardware
+   *     thread. Ingestion uses at most this many threads.
+   * @param compaction_threshold the size at which compacting maps compact.
+   * @param promotion when to promote a sparse sketch to a dense sketch.
+   */
+  ShardedMulti(const sf_ptr_t &sf_ptr, const std::size_t num_shards = 0,
+               const std::size_t         compaction_threshold = 128,
+               const promotion_policy_t &promotion            = 4096)
+      : _shards(krowkee::util::resolve_num_threads(num_shards),
+                msk_t(sf_ptr, compaction_threshold, promotion)) {}
+
+  /**
+   * Copy constructor.
+   */
+  ShardedMulti(const smsk_t &rhs) : _shards(rhs._shards) {}
+
+  static inline std::string name() {
+    std::stringstream ss;
+    ss << "Sharded " << msk_t::name();
+    return ss.str();
+  }
+
+  static inline std::string full_name() {
+    std::stringstream ss;
+    ss << "Sharded " << msk_t::full_name();
+    return ss.str();
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Sketch Insertion
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Insert item into the specified sketch registers from the calling thread.
+   *
+   * @param key the row identifier.
+   * @param args the stream object to be inserted, as for Multi::insert.
+   */
+  template <typename... ItemArgs>
+  inline void insert(const KeyType &key, const ItemArgs &...args) {
+    _shards[shard_of(key)].insert(key, args...);
+  }
+
+  /**
+   * Insert a batch of `(key, item, multiplicity)` tuples from up to
+   * `num_threads` threads.
+   *
+   * The tuples are first bucketed by shard with a counting sort, then each
+   * thread applies the tuples of a contiguous range of shards in their
+   * original order. Results are therefore identical to inserting the tuples
+   * serially.
+   *
+   * @param keys pointer to the `count` row identifiers.
+   * @param items pointer to the `count` items to be inserted.
+   * @param multiplicities pointer to the `count` multiplicities of `items`,
+   *     or `nullptr` if every multiplicity is `1`.
+   * @param count the number of tuples.
+   * @param num_threads the maximum number of threads. `0` means one per
+   *     hardware thread.
+   */
+  void insert_batch(const KeyType *keys, const std::uint64_t *items,
+                    const RegType *multiplicities, const std::size_t count,
+                    const std::size_t num_threads = 0) {
+    const std::size_t        shard_count(num_shards());
+    std::vector<std::size_t> shard_ids(count);
+    std::vector<std::size_t> offsets(shard_count + 1, 0);
+    for (std::size_t i(0); i < count; ++i) {
+      shard_ids[i] = shard_of(keys[i]);
+      ++offsets[shard_ids[i] + 1];
+    }
+    for (std::size_t shard(0); shard < shard_count; ++shard) {
+      offsets[shard + 1] += offsets[shard];
+    }
+    std::vector<std::size_t> order(count);
+    {
+      std::vector<std::size_t> cursors(std::begin(offsets),
+                                       std::end(offsets) - 1);
+      for (std::size_t i(0); i < count; ++i) {
+        order[cursors[shard_ids[i]]++] = i;
+      }
+    }
+    krowkee::util::parallel_for(
+        0, shard_count, num_threads,
+        [&](const std::size_t begin, const std::size_t end) {
+          for (std::size_t shard(begin); shard < end; ++shard) {
+            msk_t &msk(_shards[shard]);
+            for (std::size_t j(offsets[shard]); j < offsets[shard + 1]; ++j) {
+              const std::size_t i(order[j]);
+              if (multiplicities == nullptr) {
+                msk.insert(keys[i], items[i]);
+              } else {
+                msk.insert(keys[i], items[i], multiplicities[i]);
+              }
+            }
+          }
+        });
+  }
+
+  /**
+   * Insert a batch of `(key, item)` pairs, each with multiplicity `1`.
+   *
+   * @throws std::invalid_argument if `keys` and `items` differ in length.
+   */
+  void insert_batch(const std::vector<KeyType>       &keys,
+                    const std::vector<std::uint64_t> &items,
+                    const std::size_t                 num_threads = 0) {
+    _check_lengths(keys.size(), items.size());
+    insert_batch(keys.data(), items.data(), nullptr, keys.size(),
+                 num_threads);
+  }
+
+  /**
+   * Insert a batch of `(key, item, multiplicity)` tuples.
+   *
+   * @throws std::invalid_argument if the vectors differ in length.
+   */
+  void insert_batch(const std::vector<KeyType>       &keys,
+                    const std::vector<std::uint64_t> &items,
+                    const std::vector<RegType>       &multiplicities,
+                    const std::size_t                 num_threads = 0) {
+    _check_lengths(keys.size(), items.size());
+    _check_lengths(keys.size(), multiplicities.size());
+    insert_batch(keys.data(), items.data(), multiplicities.data(), keys.size(),
+                 num_threads);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Compaction
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Compact every sketch, one thread per range of shards.
+   */
+  void compactify(const std::size_t num_threads = 0) {
+    krowkee::util::parallel_for(
+        0, num_shards(), num_threads,
+        [&](const std::size_t begin, const std::size_t end) {
+          for (std::size_t shard(begin); shard < end; ++shard) {
+            _shards[shard].compactify();
+          }
+        });
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Merge
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Merge every shard into `msk`.
+   *
+   * @throws std::invalid_argument if `msk` has different parameters.
+   */
+  void merge_into(msk_t &msk) const {
+    for (const msk_t &shard : _shards) {
+      msk.merge(shard);
+    }
+  }
+
+  /**
+   * Collapse the shards into a single Multi.
+   */
+  msk_t merged() const {
+    const msk_t &first(_shards.front());
+    msk_t        ret(first.get_sf_ptr(), first.get_compaction_threshold(),
+                     first.get_promotion_policy());
+    merge_into(ret);
+    return ret;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Sketch Access
+  //////////////////////////////////////////////////////////////////////////////
+
+  data_t &operator[](const KeyType key) { return _shards[shard_of(key)][key]; }
+
+  data_t &at(const KeyType key) { return _shards[shard_of(key)].at(key); }
+
+  msk_t &shard(const std::size_t index) { return _shards.at(index); }
+
+  const msk_t &shard(const std::size_t index) const {
+    return _shards.at(index);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Getters
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Shard holding the sketch for `key`.
+   */
+  inline std::size_t shard_of(const KeyType &key) const {
+    return krowkee::hash::wang64(std::hash<KeyType>()(key)) % _shards.size();
+  }
+
+  constexpr std::size_t num_shards() const { return _shards.size(); }
+
+  std::size_t size() const {
+    std::size_t ret(0);
+    for (const msk_t &shard : _shards) {
+      ret += shard.size();
+    }
+    return ret;
+  }
+
+ private:
+  static inline void _check_lengths(const std::size_t lhs,
+                                    const std::size_t rhs) {
+    if (lhs != rhs) {
+      std::stringstream ss;
+      ss << "error: attempting to batch insert " << lhs << " keys with " << rhs
+         << " items or multiplicities";
+      throw std::invalid_argument(ss.str());
+    }
+  }
+};
+
+}  // namespace stream
+}  // namespace krowkee
+
+#endif
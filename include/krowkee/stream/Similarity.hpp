@@ -0,0 +1,582 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_STREAM_SIMILARITY_HPP
+#define _KROWKEE_STREAM_SIMILARITY_HPP
+
+#include <krowkee/sketch/registers.hpp>
+#include <krowkee/util/parallel.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace krowkee {
+namespace stream {
+
+/**
+ * Similarity measures between sketches. Linear sketches approximately
+ * preserve inner products, and hence cosine similarities and Euclidean
+ * distances, of the vectors they summarize.
+ */
+enum class similarity_t { inner_product, cosine, euclidean };
+
+/**
+ * Similarity query engine over a collection of sketches.
+ *
+ * Holds a snapshot of the registers of each inserted sketch, converted to
+ * `double`. Sketches with many nonzero registers are stored as rows of a
+ * dense matrix, and the others as sorted sparse rows. Dense-dense inner
+ * products are computed by a cache-tiled, multithreaded matrix product
+ * kernel, while products involving sparse rows merge their sorted indices or
+ * gather from the dense row.
+ *
+ * Every sketch must share a sketch functor, or the results are meaningless.
+ * Sparse sketches must be compacted before insertion.
+ *
+ * @tparam KeyType the row identifier type.
+ */
+template <typename KeyType>
+class Similarity {
+ public:
+  typedef std::pair<KeyType, double> match_t;
+  typedef std::vector<match_t>       matches_t;
+  typedef Similarity<KeyType>        sim_t;
+
+  /// rows of each tile of the dense kernel
+  static constexpr std::size_t block_rows = 32;
+  /// registers of each tile of the dense kernel
+  static constexpr std::size_t block_depth = 256;
+
+ private:
+  std::size_t                              _range_size;
+  std::size_t                              _num_threads;
+  std::vector<KeyType>                     _keys;   /// keys in slot order
+  std::unordered_map<KeyType, std::size_t> _slots;  /// map of keys to slots
+  std::vector<std::uint8_t>                _is_sparse;
+  std::vector<std::size_t>                 _rows;   /// dense or sparse row
+  std::vector<double>                      _norms;  /// squared L2 norms
+  std::vector<std::size_t>                 _dense_slots;
+  std::vector<double>                      _dense;  /// row-major dense rows
+  std::vector<std::size_t>                 _sparse_slots;
+  std::vector<std::size_t>                 _sparse_offsets;
+  std::vector<std::uint64_t>               _sparse_indices;
+  std::vector<double>                      _sparse_values;
+
+ public:
+  /**
+   * Create an empty engine.
+   *
+   * @param range_size the range size of the sketches to be inserted.
+   * @param num_threads the number of threads used by queries. `0` means one
+   *     per hardware thread.
+   */
+  Similarity(const std::size_t range_size, const std::size_t num_threads = 0)
+      : _range_size(range_size),
+        _num_threads(krowkee::util::resolve_num_threads(num_threads)),
+        _sparse_offsets(1, 0) {}
+
+  /**
+   * Snapshot every sketch of a Multi.
+   *
+   * @param multi the Multi. Sparse sketches must be compacted.
+   * @param num_threads the number of threads used by queries.
+   */
+  template <typename MultiType,
+            typename = std::enable_if_t<!std::is_integral_v<MultiType>>>
+  Similarity(const MultiType &multi, const std::size_t num_threads = 0)
+      : Similarity(multi.get_sf_ptr()->range_size(), num_threads) {
+    for (const auto &pair : multi) {
+      insert(pair.first, pair.second.sk);
+    }
+  }
+
+  static inline std::string name() { return "Similarity"; }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Insertion
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Snapshot the registers of `sk` as the row of `key`.
+   *
+   * @throws std::invalid_argument if `key` is already present or `sk` has a
+   *     different range size.
+   * @throws std::logic_error if `sk` is sparse and not compact.
+   */
+  template <typename SketchType>
+  void insert(const KeyType &key, const SketchType &sk) {
+    if (sk.range_size() != _range_size) {
+      std::stringstream ss;
+      ss << "error: attempting to insert a sketch of range size "
+         << sk.range_size() << " into a Similarity of range size "
+         << _range_size << "!";
+      throw std::invalid_argument(ss.str());
+    }
+    if (_slots.count(key) > 0) {
+      std::stringstream ss;
+      ss << "error: key " << key << " is already present!";
+      throw std::invalid_argument(ss.str());
+    }
+    std::vector<std::uint64_t> indices;
+    std::vector<double>        values;
+    const bool                 sparse(
+        krowkee::sketch::copy_registers(sk.get_container(), indices, values) &&
+        4 * indices.size() < _range_size);
+    const std::size_t slot(_keys.size());
+    _slots.emplace(key, slot);
+    _keys.push_back(key);
+    _is_sparse.push_back(sparse);
+    double norm(0);
+    for (const double val : values) {
+      norm += val * val;
+    }
+    _norms.push_back(norm);
+    if (sparse) {
+      _rows.push_back(_sparse_slots.size());
+      _sparse_slots.push_back(slot);
+      _sparse_indices.insert(std::end(_sparse_indices), std::begin(indices),
+                             std::end(indices));
+      _sparse_values.insert(std::end(_sparse_values), std::begin(values),
+                            std::end(values));
+      _sparse_offsets.push_back(_sparse_indices.size());
+    } else {
+      _rows.push_back(_dense_slots.size());
+      _dense_slots.push_back(slot);
+      _dense.resize(_dense.size() + _range_size, 0);
+      double *row(_dense.data() + _dense.size() - _range_size);
+      if (indices.empty()) {
+        std::copy(std::begin(values), std::end(values), row);
+      } else {
+        for (std::size_t i(0); i < indices.size(); ++i) {
+          row[indices[i]] = values[i];
+        }
+      }
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Pairwise Queries
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * @throws std::invalid_argument if either key is absent.
+   */
+  double inner_product(const KeyType &lhs, const KeyType &rhs) const {
+    return _dot(_slot(lhs), _slot(rhs));
+  }
+
+  /**
+   * @throws std::invalid_argument if either key is absent.
+   */
+  double similarity(const KeyType &lhs, const KeyType &rhs,
+                    const similarity_t metric) const {
+    const std::size_t lhs_slot(_slot(lhs));
+    const std::size_t rhs_slot(_slot(rhs));
+    return score(_dot(lhs_slot, rhs_slot), _norms[lhs_slot], _norms[rhs_slot],
+                 metric);
+  }
+
+  /**
+   * Compute the similarity of every pair of sketches.
+   *
+   * @return the `size() x size()` row-major similarity matrix, with rows and
+   *     columns in the order of `keys()`.
+   */
+  std::vector<double> all_pairs(
+      const similarity_t metric = similarity_t::inner_product) const {
+    std::vector<double> ret(_gram());
+    const std::size_t   n(size());
+    if (metric != similarity_t::inner_product) {
+      krowkee::util::parallel_for(
+          0, n, _num_threads,
+          [&](const std::size_t begin, const std::size_t end) {
+            for (std::size_t i(begin); i < end; ++i) {
+              for (std::size_t j(0); j < n; ++j) {
+                ret[i * n + j] =
+                    score(ret[i * n + j], _norms[i], _norms[j], metric);
+              }
+            }
+          });
+    }
+    return ret;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Top-k Queries
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Find the `k` sketches most similar to that of `key`, excluding itself.
+   *
+   * @return up to `k` matches, best first. Ties are broken by key.
+   *
+   * @throws std::invalid_argument if `key` is absent.
+   */
+  matches_t top_k(const KeyType &key, const std::size_t k,
+                  const similarity_t metric = similarity_t::cosine) const {
+    const std::size_t   slot(_slot(key));
+    std::vector<double> query(_range_size, 0);
+    _expand(slot, query.data());
+    return _top_k(query, _norms[slot], k, metric, slot);
+  }
+
+  /**
+   * Find the `k` sketches most similar to `sk`, which need not have been
+   * inserted.
+   *
+   * @param sk the query sketch.
+   * @param k the number of matches.
+   * @param metric the similarity measure.
+   * @param exclude a key to leave out of the matches, or `nullptr`.
+   *
+   * @return up to `k` matches, best first. Ties are broken by key.
+   */
+  template <typename SketchType>
+  matches_t top_k_of(const SketchType &sk, const std::size_t k,
+                     const similarity_t metric  = similarity_t::cosine,
+                     const KeyType     *exclude = nullptr) const {
+    std::vector<std::uint64_t> indices;
+    std::vector<double>        values;
+    std::vector<double>        query(_range_size, 0);
+    if (krowkee::sketch::copy_registers(sk.get_container(), indices,
+                                        values)) {
+      for (std::size_t i(0); i < indices.size(); ++i) {
+        query[indices[i]] = values[i];
+      }
+    } else {
+      std::copy(std::begin(values), std::end(values), std::begin(query));
+    }
+    double norm(0);
+    for (const double val : values) {
+      norm += val * val;
+    }
+    std::size_t skip(size());
+    if (exclude != nullptr) {
+      const auto itr(_slots.find(*exclude));
+      if (itr != std::end(_slots)) {
+        skip = itr->second;
+      }
+    }
+    return _top_k(query, norm, k, metric, skip);
+  }
+
+  /**
+   * Find the `k` most similar sketches to every sketch.
+   *
+   * Computes the full similarity matrix, and so needs `size()^2` doubles of
+   * scratch space.
+   *
+   * @return the matches of each key, in the order of `keys()`.
+   */
+  std::vector<matches_t> all_top_k(
+      const std::size_t  k,
+      const similarity_t metric = similarity_t::cosine) const {
+    const std::vector<double> gram(_gram());
+    const std::size_t         n(size());
+    std::vector<matches_t>    ret(n);
+    krowkee::util::parallel_for(
+        0, n, _num_threads,
+        [&](const std::size_t begin, const std::size_t end) {
+          for (std::size_t i(begin); i < end; ++i) {
+            matches_t matches;
+            matches.reserve(n);
+            for (std::size_t j(0); j < n; ++j) {
+              if (j != i) {
+                matches.emplace_back(
+                    _keys[j],
+                    score(gram[i * n + j], _norms[i], _norms[j], metric));
+              }
+            }
+            ret[i] = select(std::move(matches), k, metric);
+          }
+        });
+    return ret;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Scoring
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Convert an inner product and the squared norms of its operands into
+   * `metric`.
+   */
+  static inline double score(const double ip, const double lhs_norm,
+                             const double rhs_norm, const similarity_t metric) {
+    if (metric == similarity_t::cosine) {
+      return (lhs_norm > 0 && rhs_norm > 0)
+                 ? ip / std::sqrt(lhs_norm * rhs_norm)
+                 : 0;
+    } else if (metric == similarity_t::euclidean) {
+      return std::sqrt(std::max(lhs_norm + rhs_norm - 2 * ip, 0.0));
+    }
+    return ip;
+  }
+
+  /**
+   * Whether `lhs` ranks before `rhs`. Euclidean distances rank in ascending
+   * order and the other measures in descending order.
+   */
+  static inline bool better(const match_t &lhs, const match_t &rhs,
+                            const similarity_t metric) {
+    if (lhs.second != rhs.second) {
+      return (metric == similarity_t::euclidean) ? lhs.second < rhs.second
+                                                 : lhs.second > rhs.second;
+    }
+    return lhs.first < rhs.first;
+  }
+
+  /**
+   * Keep the best `k` of `matches`, sorted best first.
+   */
+  static matches_t select(matches_t matches, const std::size_t k,
+                          const similarity_t metric) {
+    const auto cmp([metric](const match_t &lhs, const match_t &rhs) {
+      return better(lhs, rhs, metric);
+    });
+    const std::size_t keep(std::min(k, matches.size()));
+    std::partial_sort(std::begin(matches), std::begin(matches) + keep,
+                      std::end(matches), cmp);
+    matches.resize(keep);
+    return matches;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Getters
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr std::size_t size() const { return _keys.size(); }
+
+  constexpr std::size_t range_size() const { return _range_size; }
+
+  bool contains(const KeyType &key) const { return _slots.count(key) > 0; }
+
+  /**
+   * The keys in slot order, which orders the results of `all_pairs` and
+   * `all_top_k`.
+   */
+  constexpr const std::vector<KeyType> &keys() const { return _keys; }
+
+  /**
+   * The number of sketches stored as dense rows.
+   */
+  constexpr std::size_t num_dense() const { return _dense_slots.size(); }
+
+ private:
+  inline std::size_t _slot(const KeyType &key) const {
+    const auto itr(_slots.find(key));
+    if (itr == std::end(_slots)) {
+      std::stringstream ss;
+      ss << "error: key " << key << " does not exist!";
+      throw std::invalid_argument(ss.str());
+    }
+    return itr->second;
+  }
+
+  inline const double *_dense_row(const std::size_t slot) const {
+    return _dense.data() + _rows[slot] * _range_size;
+  }
+
+  /**
+   * Write the registers of `slot` into the zeroed `range_size` array `out`.
+   */
+  void _expand(const std::size_t slot, double *out) const {
+    if (_is_sparse[slot]) {
+      const std::size_t row(_rows[slot]);
+      for (std::size_t i(_sparse_offsets[row]); i < _sparse_offsets[row + 1];
+           ++i) {
+        out[_sparse_indices[i]] = _sparse_values[i];
+      }
+    } else {
+      std::copy(_dense_row(slot), _dense_row(slot) + _range_size, out);
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Inner Product Kernels
+  //////////////////////////////////////////////////////////////////////////////
+
+  double _dot(const std::size_t lhs, const std::size_t rhs) const {
+    if (_is_sparse[lhs] && _is_sparse[rhs]) {
+      return _sparse_dot(_rows[lhs], _rows[rhs]);
+    } else if (_is_sparse[lhs]) {
+      return _gather_dot(_rows[lhs], _dense_row(rhs));
+    } else if (_is_sparse[rhs]) {
+      return _gather_dot(_rows[rhs], _dense_row(lhs));
+    }
+    return _dense_dot(_dense_row(lhs), _dense_row(rhs));
+  }
+
+  inline double _dense_dot(const double *lhs, const double *rhs) const {
+    double ret(0);
+    for (std::size_t i(0); i < _range_size; ++i) {
+      ret += lhs[i] * rhs[i];
+    }
+    return ret;
+  }
+
+  /**
+   * Inner product of sparse row `row` and the dense array `dense`.
+   */
+  inline double _gather_dot(const std::size_t row, const double *dense) const {
+    double ret(0);
+    for (std::size_t i(_sparse_offsets[row]); i < _sparse_offsets[row + 1];
+         ++i) {
+      ret += _sparse_values[i] * dense[_sparse_indices[i]];
+    }
+    return ret;
+  }
+
+  /**
+   * Inner product of two sparse rows, merging their sorted indices.
+   */
+  inline double _sparse_dot(const std::size_t lhs_row,
+                            const std::size_t rhs_row) const {
+    std::size_t       i(_sparse_offsets[lhs_row]);
+    std::size_t       j(_sparse_offsets[rhs_row]);
+    const std::size_t i_end(_sparse_offsets[lhs_row + 1]);
+    const std::size_t j_end(_sparse_offsets[rhs_row + 1]);
+    double            ret(0);
+    while (i < i_end && j < j_end) {
+      if (_sparse_indices[i] < _sparse_indices[j]) {
+        ++i;
+      } else if (_sparse_indices[j] < _sparse_indices[i]) {
+        ++j;
+      } else {
+        ret += _sparse_values[i++] * _sparse_values[j++];
+      }
+    }
+    return ret;
+  }
+
+  /**
+   * Score every sketch against the dense `query` and select the best `k`,
+   * leaving out `skip`.
+   */
+  matches_t _top_k(const std::vector<double> &query, const double norm,
+                   const std::size_t k, const similarity_t metric,
+                   const std::size_t skip) const {
+    const std::size_t n(size());
+    matches_t         matches(n);
+    krowkee::util::parallel_for(
+        0, n, _num_threads,
+        [&](const std::size_t begin, const std::size_t end) {
+          for (std::size_t slot(begin); slot < end; ++slot) {
+            const double ip(
+                _is_sparse[slot]
+                    ? _gather_dot(_rows[slot], query.data())
+                    : _dense_dot(_dense_row(slot), query.data()));
+            matches[slot] = {_keys[slot],
+                             score(ip, norm, _norms[slot], metric)};
+          }
+        },
+        64);
+    if (skip < n) {
+      matches.erase(std::begin(matches) + skip);
+    }
+    return select(std::move(matches), k, metric);
+  }
+
+  /**
+   * Compute the `size() x size()` matrix of inner products.
+   */
+  std::vector<double> _gram() const {
+    const std::size_t   n(size());
+    std::vector<double> gram(n * n, 0);
+    _dense_gram(gram);
+    krowkee::util::parallel_for(
+        0, _sparse_slots.size(), _num_threads,
+        [&](const std::size_t begin, const std::size_t end) {
+          for (std::size_t row(begin); row < end; ++row) {
+            const std::size_t slot(_sparse_slots[row]);
+            for (std::size_t other(0); other < n; ++other) {
+              // Each sparse pair is computed by its lower slot.
+              if (_is_sparse[other] && other < slot) {
+                continue;
+              }
+              const double ip(_dot(slot, other));
+              gram[slot * n + other] = ip;
+              gram[other * n + slot] = ip;
+            }
+          }
+        });
+    return gram;
+  }
+
+  /**
+   * Fill the dense-dense entries of `gram`.
+   *
+   * The dense rows are cut into blocks of `block_rows` rows, and each thread
+   * computes a share of the upper triangle of block pairs. For each pair, the
+   * registers are traversed in tiles of `block_depth`, packing the tile of
+   * the column block transposed so that the innermost loop runs over
+   * contiguous memory and vectorizes.
+   */
+  void _dense_gram(std::vector<double> &gram) const {
+    const std::size_t n(size());
+    const std::size_t m(_range_size);
+    const std::size_t num_rows(_dense_slots.size());
+    const std::size_t num_blocks((num_rows + block_rows - 1) / block_rows);
+    std::vector<std::pair<std::size_t, std::size_t>> tiles;
+    for (std::size_t bi(0); bi < num_blocks; ++bi) {
+      for (std::size_t bj(bi); bj < num_blocks; ++bj) {
+        tiles.emplace_back(bi, bj);
+      }
+    }
+    krowkee::util::parallel_for(
+        0, tiles.size(), _num_threads,
+        [&](const std::size_t begin, const std::size_t end) {
+          std::vector<double> panel(block_depth * block_rows);
+          std::vector<double> acc(block_rows * block_rows);
+          for (std::size_t tile(begin); tile < end; ++tile) {
+            const std::size_t i0(tiles[tile].first * block_rows);
+            const std::size_t j0(tiles[tile].second * block_rows);
+            const std::size_t height(std::min(block_rows, num_rows - i0));
+            const std::size_t width(std::min(block_rows, num_rows - j0));
+            std::fill(std::begin(acc), std::end(acc), 0);
+            for (std::size_t k0(0); k0 < m; k0 += block_depth) {
+              const std::size_t depth(std::min(block_depth, m - k0));
+              for (std::size_t jj(0); jj < width; ++jj) {
+                const double *row(_dense.data() + (j0 + jj) * m + k0);
+                for (std::size_t kk(0); kk < depth; ++kk) {
+                  panel[kk * block_rows + jj] = row[kk];
+                }
+              }
+              for (std::size_t ii(0); ii < height; ++ii) {
+                const double *row(_dense.data() + (i0 + ii) * m + k0);
+                double       *out(acc.data() + ii * block_rows);
+                for (std::size_t kk(0); kk < depth; ++kk) {
+                  const double  val(row[kk]);
+                  const double *col(panel.data() + kk * block_rows);
+                  for (std::size_t jj(0); jj < width; ++jj) {
+                    out[jj] += val * col[jj];
+                  }
+                }
+              }
+            }
+            for (std::size_t ii(0); ii < height; ++ii) {
+              const std::size_t lhs(_dense_slots[i0 + ii]);
+              for (std::size_t jj(0); jj < width; ++jj) {
+                const std::size_t rhs(_dense_slots[j0 + jj]);
+                gram[lhs * n + rhs] = acc[ii * block_rows + jj];
+                gram[rhs * n + lhs] = acc[ii * block_rows + jj];
+              }
+            }
+          }
+        });
+  }
+};
+
+}  // namespace stream
+}  // namespace krowkee
+
+#endif
@@ -6,7 +6,19 @@
 #ifndef _KROWKEE_STREAM_SUMMARY_HPP
 #define _KROWKEE_STREAM_SUMMARY_HPP
 
+#include <krowkee/sketch/heavy_hitters.hpp>
+#include <krowkee/sketch/promotion_policy.hpp>
 #include <krowkee/stream/Element.hpp>
+#include <krowkee/util/wire.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace krowkee {
 namespace stream {
@@ -29,17 +41,19 @@ struct Summary {
   sk_t sk;
 
   Summary(const sf_ptr_t &ptr, const std::size_t compaction_threshold,
-          const std::size_t promotion_threshold)
-      : sk(ptr, compaction_threshold, promotion_threshold) {}
+          const krowkee::sketch::promotion_policy &promotion)
+      : sk(ptr, compaction_threshold, promotion) {}
 
   template <typename... ItemArgs>
   Summary(const sf_ptr_t &ptr, const std::size_t compaction_threshold,
-          const std::size_t promotion_threshold, const ItemArgs &...args)
-      : sk(ptr, compaction_threshold, promotion_threshold) {
+          const krowkee::sketch::promotion_policy &promotion,
+          const ItemArgs &...args)
+      : sk(ptr, compaction_threshold, promotion) {
     update(args...);
   }
 
   Summary(const data_t &rhs) : sk(rhs.sk) {}
+  Summary(data_t &&rhs) noexcept : sk(std::move(rhs.sk)) {}
   Summary() : sk() {}
 
   template <class Archive>
@@ -59,7 +73,7 @@ struct Summary {
     return ss.str();
   }
 
-  friend void swap(data_t &lhs, data_t &rhs) { swap(lhs.sk, rhs.sk); }
+  friend void swap(data_t &lhs, data_t &rhs) noexcept { swap(lhs.sk, rhs.sk); }
 
   friend constexpr bool operator==(const data_t &lhs, const data_t &rhs) {
     return lhs.sk == rhs.sk;
@@ -69,7 +83,7 @@ struct Summary {
     return !(lhs == rhs);
   }
 
-  data_t &operator=(data_t rhs) {
+  data_t &operator=(data_t rhs) noexcept {
     swap(*this, rhs);
     return *this;
   }
@@ -92,6 +106,21 @@ struct Summary {
 
   void compactify() { sk.compactify(); }
 
+  /**
+   * Sum any non-register state across ranks. Used by collective reductions,
+   * which combine the registers of `sk` separately. Summary holds none.
+   */
+  template <typename Comm>
+  void all_reduce_metadata(Comm &comm) {}
+
+  /**
+   * Write the sketch registers in the compact wire format. See
+   * krowkee::util::wire_writer.
+   */
+  void pack(krowkee::util::wire_writer &writer) const { sk.pack(writer); }
+
+  void unpack(krowkee::util::wire_reader &reader) { sk.unpack(reader); }
+
   friend std::ostream &operator<<(std::ostream &os, const data_t &data) {
     os << data.sk;
     return os;
@@ -115,18 +144,20 @@ struct CountingSummary {
   sk_t          sk;
   std::uint64_t count;
   CountingSummary(const sf_ptr_t &ptr, const std::size_t compaction_threshold,
-                  const std::size_t promotion_threshold)
-      : sk(ptr, compaction_threshold, promotion_threshold), count(0) {}
+                  const krowkee::sketch::promotion_policy &promotion)
+      : sk(ptr, compaction_threshold, promotion), count(0) {}
 
   template <typename... ItemArgs>
   CountingSummary(const sf_ptr_t &ptr, const std::size_t compaction_threshold,
-                  const std::size_t promotion_threshold,
+                  const krowkee::sketch::promotion_policy &promotion,
                   const ItemArgs &...args)
-      : sk(ptr, compaction_threshold, promotion_threshold), count(0) {
+      : sk(ptr, compaction_threshold, promotion), count(0) {
     update(args...);
   }
   /// copy-and-swap boilerplate
   CountingSummary(const data_t &rhs) : sk(rhs.sk), count(rhs.count) {}
+  CountingSummary(data_t &&rhs) noexcept
+      : sk(std::move(rhs.sk)), count(rhs.count) {}
   CountingSummary() : sk() {}
 
   template <class Archive>
@@ -152,7 +183,7 @@ struct CountingSummary {
    * For some reason, calling std::swap on the sketches here causes a
    * segfault. Peculiar.
    */
-  friend void swap(data_t &lhs, data_t &rhs) {
+  friend void swap(data_t &lhs, data_t &rhs) noexcept {
     std::swap(lhs.count, rhs.count);
     swap(lhs.sk, rhs.sk);
   }
@@ -165,7 +196,7 @@ struct CountingSummary {
     return !(lhs == rhs);
   }
 
-  data_t &operator=(data_t rhs) {
+  data_t &operator=(data_t rhs) noexcept {
     swap(*this, rhs);
     return *this;
   }
@@ -193,12 +224,760 @@ struct CountingSummary {
 
   void compactify() { sk.compactify(); }
 
+  template <typename Comm>
+  void all_reduce_metadata(Comm &comm) {
+    count = comm.all_reduce_sum(count);
+  }
+
+  void pack(krowkee::util::wire_writer &writer) const {
+    sk.pack(writer);
+    writer.put(count);
+  }
+
+  void unpack(krowkee::util::wire_reader &reader) {
+    sk.unpack(reader);
+    count = reader.get<std::uint64_t>();
+  }
+
+  friend std::ostream &operator<<(std::ostream &os, const data_t &data) {
+    os << data.sk;
+    return os;
+  }
+};
+
+/**
+ * Stream summary data to be held by a distributed map.
+ *
+ * This class holds a sketch `sk` and a counter `count` like CountingSummary,
+ * and caches the sum of squares and the number of nonzero registers of `sk`,
+ * so that norm and support queries take constant time. When the sketch
+ * functor provides `visit_registers(item, func)`, as the CountSketch functors
+ * do, updates maintain the cache from the registers they touch. Merges
+ * maintain it from the nonzero registers of the other operand. Any other
+ * change, such as an FWHT update, which touches every register anyway, marks
+ * the cache stale, and the next query rescans the registers. Compaction and
+ * promotion move registers without changing them, so they leave the cache
+ * valid.
+ *
+ * Code that writes the registers of `sk` directly must call
+ * `invalidate_statistics()`.
+ */
+template <typename SketchType, template <typename> class PtrType>
+struct CachedCountingSummary {
+  typedef SketchType                                 sk_t;
+  typedef typename sk_t::sf_t                        sf_t;
+  typedef typename sk_t::sf_ptr_t                    sf_ptr_t;
+  typedef typename sk_t::reg_t                       reg_t;
+  typedef CachedCountingSummary<SketchType, PtrType> data_t;
+
+  /// integral squares accumulate in wrapping unsigned arithmetic, so that
+  /// removing a square never underflows
+  typedef std::conditional_t<std::is_integral_v<reg_t>, std::uint64_t, double>
+      square_t;
+
+  sk_t          sk;
+  std::uint64_t count;
+
+  CachedCountingSummary(const sf_ptr_t &ptr,
+                        const std::size_t compaction_threshold,
+                        const krowkee::sketch::promotion_policy &promotion)
+      : sk(ptr, compaction_threshold, promotion),
+        count(0),
+        _sum_of_squares(0),
+        _nonzeros(0),
+        _stale(false) {}
+
+  template <typename... ItemArgs>
+  CachedCountingSummary(const sf_ptr_t &ptr,
+                        const std::size_t compaction_threshold,
+                        const krowkee::sketch::promotion_policy &promotion,
+                        const ItemArgs &...args)
+      : CachedCountingSummary(ptr, compaction_threshold, promotion) {
+    update(args...);
+  }
+  /// copy-and-swap boilerplate
+  CachedCountingSummary(const data_t &rhs)
+      : sk(rhs.sk),
+        count(rhs.count),
+        _sum_of_squares(rhs._sum_of_squares),
+        _nonzeros(rhs._nonzeros),
+        _stale(rhs._stale) {}
+  CachedCountingSummary(data_t &&rhs) noexcept
+      : sk(std::move(rhs.sk)),
+        count(rhs.count),
+        _sum_of_squares(rhs._sum_of_squares),
+        _nonzeros(rhs._nonzeros),
+        _stale(rhs._stale) {}
+  CachedCountingSummary()
+      : sk(), count(0), _sum_of_squares(0), _nonzeros(0), _stale(false) {}
+
+  template <class Archive>
+  void serialize(Archive &archive) {
+    archive(sk, count);
+    _stale = true;
+  }
+
+  static inline std::string name() {
+    std::stringstream ss;
+    ss << "Cached Counting Summary using " << sk_t::name();
+    return ss.str();
+  }
+
+  static inline std::string full_name() {
+    std::stringstream ss;
+    ss << "Cached Counting Summary using " << sk_t::full_name();
+    return ss.str();
+  }
+
+  friend void swap(data_t &lhs, data_t &rhs) noexcept {
+    std::swap(lhs.count, rhs.count);
+    std::swap(lhs._sum_of_squares, rhs._sum_of_squares);
+    std::swap(lhs._nonzeros, rhs._nonzeros);
+    std::swap(lhs._stale, rhs._stale);
+    swap(lhs.sk, rhs.sk);
+  }
+
+  /// the cache is derived from `sk`, so it takes no part in comparisons
+  friend constexpr bool operator==(const data_t &lhs, const data_t &rhs) {
+    return lhs.count == rhs.count && lhs.sk == rhs.sk;
+  }
+
+  friend constexpr bool operator!=(const data_t &lhs, const data_t &rhs) {
+    return !(lhs == rhs);
+  }
+
+  data_t &operator=(data_t rhs) noexcept {
+    swap(*this, rhs);
+    return *this;
+  }
+
+  /**
+   * Merge `rhs`, updating the cache from the registers that are nonzero in
+   * `rhs.sk`, as those are the only ones that a merge changes.
+   */
+  data_t &operator+=(const data_t &rhs) {
+    _tracked(
+        [&](const auto &func) { _for_each_nonzero(rhs.sk, func); },
+        [&]() { sk += rhs.sk; });
+    count += rhs.count;
+    return *this;
+  }
+
+  inline friend data_t operator+(const data_t &lhs, const data_t &rhs) {
+    data_t ret(lhs);
+    ret += rhs;
+    return ret;
+  }
+
+  /// interaction
+  template <typename... ItemArgs>
+  void update(const ItemArgs &...args) {
+    Element<reg_t> element(args...);
+    if constexpr (_has_register_visitor<sf_t>::value) {
+      _tracked(
+          [&](const auto &func) {
+            sk.get_sf_ptr()->visit_registers(element.item, func);
+          },
+          [&]() { sk.insert(args...); });
+    } else {
+      sk.insert(args...);
+      _stale = true;
+    }
+    count += element.multiplicity;
+  }
+
+  void compactify() { sk.compactify(); }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Cached statistics
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * The sum of the squared registers of `sk`. For a CountSketch this is an
+   * unbiased estimate of the second frequency moment of the stream.
+   */
+  square_t sum_of_squares() const {
+    _refresh();
+    return _sum_of_squares;
+  }
+
+  /**
+   * The Euclidean norm of the registers of `sk`.
+   */
+  double l2_norm() const { return std::sqrt(double(sum_of_squares())); }
+
+  /**
+   * The number of nonzero registers of `sk`.
+   */
+  std::uint64_t nonzeros() const {
+    _refresh();
+    return _nonzeros;
+  }
+
+  /**
+   * Rescan the registers of `sk` at the next query.
+   */
+  void invalidate_statistics() { _stale = true; }
+
+  /**
+   * Whether the next query rescans the registers of `sk`.
+   */
+  bool statistics_stale() const { return _stale; }
+
+  /**
+   * Sum the counts across ranks. The reduction has replaced the registers of
+   * `sk`, so the cache is stale.
+   */
+  template <typename Comm>
+  void all_reduce_metadata(Comm &comm) {
+    count  = comm.all_reduce_sum(count);
+    _stale = true;
+  }
+
+  void pack(krowkee::util::wire_writer &writer) const {
+    sk.pack(writer);
+    writer.put(count);
+  }
+
+  void unpack(krowkee::util::wire_reader &reader) {
+    sk.unpack(reader);
+    count  = reader.get<std::uint64_t>();
+    _stale = true;
+  }
+
+  friend std::ostream &operator<<(std::ostream &os, const data_t &data) {
+    os << data.sk;
+    return os;
+  }
+
+ private:
+  template <typename T, typename = void>
+  struct _has_register_visitor : std::false_type {};
+
+  template <typename T>
+  struct _has_register_visitor<
+      T, std::void_t<decltype(std::declval<const T &>().visit_registers(
+             std::uint64_t(0), std::declval<void (*)(std::uint64_t)>()))>>
+      : std::true_type {};
+
+  /**
+   * Call `func(index)` on each nonzero register of `sketch`. Sparse registers
+   * must be compacted, as for merging.
+   */
+  template <typename Func>
+  static void _for_each_nonzero(const sk_t &sketch, const Func &func) {
+    std::uint64_t index(0);
+    for_each(sketch.get_container(), [&](const auto &reg) {
+      if constexpr (std::is_arithmetic_v<std::decay_t<decltype(reg)>>) {
+        if (reg != reg_t(0)) {
+          func(index);
+        }
+        ++index;
+      } else if (reg.second != reg_t(0)) {
+        func(reg.first);
+      }
+    });
+  }
+
+  /**
+   * Perform `change` to the registers of `sk`, moving the cached statistics
+   * of the registers enumerated by `visit` from their values before the
+   * change to those after it. The cache is marked stale in between, so that
+   * it stays stale if `change` throws.
+   */
+  template <typename Visit, typename Change>
+  void _tracked(const Visit &visit, const Change &change) {
+    if (_stale) {
+      change();
+      return;
+    }
+    _stale = true;
+    visit([this](const std::uint64_t index) {
+      const reg_t reg(sk.get_container().get(index));
+      if (reg != reg_t(0)) {
+        _sum_of_squares -= _square(reg);
+        --_nonzeros;
+      }
+    });
+    change();
+    visit([this](const std::uint64_t index) {
+      const reg_t reg(sk.get_container().get(index));
+      if (reg != reg_t(0)) {
+        _sum_of_squares += _square(reg);
+        ++_nonzeros;
+      }
+    });
+    _stale = false;
+  }
+
+  /**
+   * Rescan every register if the cache is stale. Reads the registers by
+   * index, so that uncompacted sparse registers are counted.
+   */
+  void _refresh() const {
+    if (_stale == false) {
+      return;
+    }
+    _sum_of_squares = 0;
+    _nonzeros       = 0;
+    for (std::uint64_t i(0); i < sk.range_size(); ++i) {
+      const reg_t reg(sk.get_container().get(i));
+      if (reg != reg_t(0)) {
+        _sum_of_squares += _square(reg);
+        ++_nonzeros;
+      }
+    }
+    _stale = false;
+  }
+
+  static constexpr square_t _square(const reg_t reg) {
+    return square_t(reg) * square_t(reg);
+  }
+
+  mutable square_t      _sum_of_squares;
+  mutable std::uint64_t _nonzeros;
+  mutable bool          _stale;
+};
+
+/**
+ * Stream summary data to be held by a distributed map.
+ *
+ * This class holds a sketch `sk`, a counter `count`, and a bounded table `hh`
+ * of at most `Capacity` heavy hitter candidates, which every update maintains
+ * from the point estimates of `sk`. Requires a sketch functor supporting
+ * point queries. The median estimates of MultiRowCountSketch keep light items
+ * that share a register with a heavy item out of the table, which a single
+ * row CountSketch cannot. Merges re-estimate the candidates of both operands
+ * against the merged registers, so that the frequent items of a merged stream
+ * are available without a second pass or a scan of the domain.
+ */
+template <typename SketchType, template <typename> class PtrType,
+          std::size_t Capacity>
+struct BoundedHeavyHitterSummary {
+  typedef SketchType                                               sk_t;
+  typedef typename sk_t::sf_t                                      sf_t;
+  typedef typename sk_t::sf_ptr_t                                  sf_ptr_t;
+  typedef typename sk_t::reg_t                                     reg_t;
+  typedef krowkee::sketch::heavy_hitters<reg_t>                    hh_t;
+  typedef BoundedHeavyHitterSummary<SketchType, PtrType, Capacity> data_t;
+
+  static_assert(Capacity > 0, "heavy hitter capacity must be positive");
+
+  sk_t          sk;
+  std::uint64_t count;
+  hh_t          hh;
+
+  BoundedHeavyHitterSummary(const sf_ptr_t &ptr,
+                            const std::size_t compaction_threshold,
+                            const krowkee::sketch::promotion_policy &promotion)
+      : sk(ptr, compaction_threshold, promotion), count(0), hh(Capacity) {}
+
+  template <typename... ItemArgs>
+  BoundedHeavyHitterSummary(const sf_ptr_t &ptr,
+                            const std::size_t compaction_threshold,
+                            const krowkee::sketch::promotion_policy &promotion,
+                            const ItemArgs &...args)
+      : sk(ptr, compaction_threshold, promotion), count(0), hh(Capacity) {
+    update(args...);
+  }
+  /// copy-and-swap boilerplate
+  BoundedHeavyHitterSummary(const data_t &rhs)
+      : sk(rhs.sk), count(rhs.count), hh(rhs.hh) {}
+  BoundedHeavyHitterSummary(data_t &&rhs) noexcept
+      : sk(std::move(rhs.sk)), count(rhs.count), hh(std::move(rhs.hh)) {}
+  BoundedHeavyHitterSummary() : sk(), count(0), hh(Capacity) {}
+
+  template <class Archive>
+  void serialize(Archive &archive) {
+    archive(sk, count, hh);
+  }
+
+  static inline std::string name() {
+    std::stringstream ss;
+    ss << "Heavy Hitter Summary using " << sk_t::name();
+    return ss.str();
+  }
+
+  static inline std::string full_name() {
+    std::stringstream ss;
+    ss << "Heavy Hitter Summary (" << Capacity << " candidates) using "
+       << sk_t::full_name();
+    return ss.str();
+  }
+
+  friend void swap(data_t &lhs, data_t &rhs) noexcept {
+    std::swap(lhs.count, rhs.count);
+    std::swap(lhs.hh, rhs.hh);
+    swap(lhs.sk, rhs.sk);
+  }
+
+  friend bool operator==(const data_t &lhs, const data_t &rhs) {
+    return lhs.count == rhs.count && lhs.hh == rhs.hh && lhs.sk == rhs.sk;
+  }
+
+  friend bool operator!=(const data_t &lhs, const data_t &rhs) {
+    return !(lhs == rhs);
+  }
+
+  data_t &operator=(data_t rhs) noexcept {
+    swap(*this, rhs);
+    return *this;
+  }
+
+  data_t &operator+=(const data_t &rhs) {
+    sk += rhs.sk;
+    count += rhs.count;
+    hh.merge(rhs.hh, _estimator());
+    return *this;
+  }
+
+  inline friend data_t operator+(const data_t &lhs, const data_t &rhs) {
+    data_t ret(lhs);
+    ret += rhs;
+    return ret;
+  }
+
+  /// interaction
+  template <typename... ItemArgs>
+  void update(const ItemArgs &...args) {
+    sk.insert(args...);
+    Element<reg_t> element(args...);
+    count += element.multiplicity;
+    hh.update(element.item, sk.point_query(element.item));
+  }
+
+  /**
+   * The `k` candidates with the largest estimated multiplicities, largest
+   * first.
+   *
+   * The stored estimates date from each candidate's latest update, so the
+   * candidates are re-estimated against the current registers.
+   */
+  typename hh_t::candidates_t heavy_hitters(const std::size_t k) const {
+    hh_t current(hh);
+    current.refresh(_estimator());
+    return current.top(k);
+  }
+
+  void compactify() { sk.compactify(); }
+
+  /**
+   * Sum the counts and pool the candidates of every rank, re-estimating them
+   * against the reduced registers of `sk`.
+   */
+  template <typename Comm>
+  void all_reduce_metadata(Comm &comm) {
+    count = comm.all_reduce_sum(count);
+    const std::vector<std::uint64_t> items(comm.all_reduce(
+        hh.items(), [](const std::vector<std::uint64_t> &lhs,
+                       const std::vector<std::uint64_t> &rhs) {
+          std::vector<std::uint64_t> ret;
+          std::set_union(std::begin(lhs), std::end(lhs), std::begin(rhs),
+                         std::end(rhs), std::back_inserter(ret));
+          return ret;
+        }));
+    hh.merge(items, _estimator());
+  }
+
+  void pack(krowkee::util::wire_writer &writer) const {
+    sk.pack(writer);
+    writer.put(count);
+    hh.pack(writer);
+  }
+
+  void unpack(krowkee::util::wire_reader &reader) {
+    sk.unpack(reader);
+    count = reader.get<std::uint64_t>();
+    hh.unpack(reader);
+  }
+
+  friend std::ostream &operator<<(std::ostream &os, const data_t &data) {
+    os << data.sk;
+    return os;
+  }
+
+ private:
+  inline auto _estimator() const {
+    return [this](const std::uint64_t item) { return sk.point_query(item); };
+  }
+};
+
+/**
+ * Heavy hitter summary tracking 32 candidates. Define an alias of
+ * krowkee::stream::BoundedHeavyHitterSummary for other capacities.
+ */
+template <typename SketchType, template <typename> class PtrType>
+using HeavyHitterSummary = BoundedHeavyHitterSummary<SketchType, PtrType, 32>;
+
+/**
+ * Stream summary data to be held by a distributed map.
+ *
+ * This class holds a sliding window of `NumBuckets` time buckets, each
+ * holding the sketch and count of the updates made while it was the current
+ * bucket. `sk` and `count` hold those of the whole window, so that the
+ * summary is queried as a CountingSummary. `advance` opens a new bucket and
+ * expires the oldest by merging it out of `sk` with `std::minus`, so that
+ * moving the window costs one merge of a bucket rather than sketching the
+ * window's stream again. Requires a linear sketch merged with `std::plus`,
+ * whose registers cancel exactly, e.g. integer CountSketch registers.
+ *
+ * Merges and collective reductions combine the buckets of equal age, so that
+ * a reduced window expires the updates of every rank.
+ */
+template <typename SketchType, template <typename> class PtrType,
+          std::size_t NumBuckets>
+struct BoundedWindowedSummary {
+  typedef SketchType                                              sk_t;
+  typedef typename sk_t::sf_t                                     sf_t;
+  typedef typename sk_t::sf_ptr_t                                 sf_ptr_t;
+  typedef typename sk_t::reg_t                                    reg_t;
+  typedef BoundedWindowedSummary<SketchType, PtrType, NumBuckets> data_t;
+
+  static_assert(NumBuckets > 0, "window must hold at least one bucket");
+
+  static constexpr std::size_t num_buckets = NumBuckets;
+
+  sk_t          sk;
+  std::uint64_t count;
+
+ private:
+  std::vector<sk_t>                     _buckets;    /// ring of buckets
+  std::array<std::uint64_t, NumBuckets> _counts;     /// bucket counts
+  std::size_t                           _head;       /// current bucket index
+  krowkee::sketch::promotion_policy     _promotion;  /// of new buckets
+
+ public:
+  BoundedWindowedSummary(const sf_ptr_t &ptr,
+                         const std::size_t compaction_threshold,
+                         const krowkee::sketch::promotion_policy &promotion)
+      : sk(ptr, compaction_threshold, promotion),
+        count(0),
+        _buckets(NumBuckets, sk),
+        _counts{},
+        _head(0),
+        _promotion(promotion) {}
+
+  template <typename... ItemArgs>
+  BoundedWindowedSummary(const sf_ptr_t &ptr,
+                         const std::size_t compaction_threshold,
+                         const krowkee::sketch::promotion_policy &promotion,
+                         const ItemArgs &...args)
+      : BoundedWindowedSummary(ptr, compaction_threshold, promotion) {
+    update(args...);
+  }
+  /// copy-and-swap boilerplate
+  BoundedWindowedSummary(const data_t &rhs)
+      : sk(rhs.sk),
+        count(rhs.count),
+        _buckets(rhs._buckets),
+        _counts(rhs._counts),
+        _head(rhs._head),
+        _promotion(rhs._promotion) {}
+  BoundedWindowedSummary(data_t &&rhs) noexcept
+      : sk(std::move(rhs.sk)),
+        count(rhs.count),
+        _buckets(std::move(rhs._buckets)),
+        _counts(rhs._counts),
+        _head(rhs._head),
+        _promotion(rhs._promotion) {}
+  BoundedWindowedSummary() : sk(), count(0), _counts{}, _head(0) {}
+
+  template <class Archive>
+  void serialize(Archive &archive) {
+    archive(sk, count, _buckets, _counts, _head, _promotion);
+  }
+
+  static inline std::string name() {
+    std::stringstream ss;
+    ss << "Windowed Summary using " << sk_t::name();
+    return ss.str();
+  }
+
+  static inline std::string full_name() {
+    std::stringstream ss;
+    ss << "Windowed Summary (" << NumBuckets << " buckets) using "
+       << sk_t::full_name();
+    return ss.str();
+  }
+
+  friend void swap(data_t &lhs, data_t &rhs) noexcept {
+    std::swap(lhs.count, rhs.count);
+    std::swap(lhs._buckets, rhs._buckets);
+    std::swap(lhs._counts, rhs._counts);
+    std::swap(lhs._head, rhs._head);
+    std::swap(lhs._promotion, rhs._promotion);
+    swap(lhs.sk, rhs.sk);
+  }
+
+  /**
+   * Summaries are equal if their windows and buckets of every age are.
+   */
+  friend bool operator==(const data_t &lhs, const data_t &rhs) {
+    if (lhs.count != rhs.count || lhs.sk != rhs.sk) {
+      return false;
+    }
+    for (std::size_t age(0); age < NumBuckets; ++age) {
+      if (lhs.bucket_count(age) != rhs.bucket_count(age) ||
+          lhs.bucket(age) != rhs.bucket(age)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  friend bool operator!=(const data_t &lhs, const data_t &rhs) {
+    return !(lhs == rhs);
+  }
+
+  data_t &operator=(data_t rhs) noexcept {
+    swap(*this, rhs);
+    return *this;
+  }
+
+  /**
+   * Merge `rhs` into `this`, combining the buckets of equal age.
+   */
+  data_t &operator+=(const data_t &rhs) {
+    sk += rhs.sk;
+    count += rhs.count;
+    for (std::size_t age(0); age < NumBuckets; ++age) {
+      _buckets[_index(age)] += rhs.bucket(age);
+      _counts[_index(age)] += rhs.bucket_count(age);
+    }
+    return *this;
+  }
+
+  inline friend data_t operator+(const data_t &lhs, const data_t &rhs) {
+    data_t ret(lhs);
+    ret += rhs;
+    return ret;
+  }
+
+  /// interaction
+  template <typename... ItemArgs>
+  void update(const ItemArgs &...args) {
+    sk.insert(args...);
+    _buckets[_head].insert(args...);
+    Element<reg_t> element(args...);
+    count += element.multiplicity;
+    _counts[_head] += element.multiplicity;
+  }
+
+  /**
+   * Move the window forward by `steps` buckets, expiring the `steps` oldest
+   * buckets and leaving an empty current bucket.
+   */
+  void advance(const std::size_t steps = 1) {
+    for (std::size_t step(0); step < std::min(steps, NumBuckets); ++step) {
+      _head = (_head + 1) % NumBuckets;
+      sk_t &expired(_buckets[_head]);
+      sk.compactify();
+      expired.compactify();
+      sk.merge_with(expired, std::minus<reg_t>());
+      count -= _counts[_head];
+      expired = sk_t(sk.get_sf_ptr(), sk.get_compaction_threshold(),
+                     _promotion);
+      _counts[_head] = 0;
+    }
+  }
+
+  /**
+   * The sketch of the bucket opened `age` advances ago; the current bucket
+   * has age 0.
+   */
+  inline const sk_t &bucket(const std::size_t age) const {
+    return _buckets[_index(age)];
+  }
+
+  inline std::uint64_t bucket_count(const std::size_t age) const {
+    return _counts[_index(age)];
+  }
+
+  void compactify() {
+    sk.compactify();
+    for (sk_t &bucket : _buckets) {
+      bucket.compactify();
+    }
+  }
+
+  /**
+   * Sum the counts and the buckets of equal age of every rank. `sk` holds the
+   * reduced window already.
+   */
+  template <typename Comm>
+  void all_reduce_metadata(Comm &comm) {
+    typedef krowkee::util::wire_bytes_t bytes_t;
+    count = comm.all_reduce_sum(count);
+    const bytes_t reduced(comm.all_reduce(
+        _packed_buckets(), [this](const bytes_t &lhs, const bytes_t &rhs) {
+          data_t sum(sk.get_sf_ptr(), sk.get_compaction_threshold(),
+                     _promotion);
+          data_t other(sum);
+          krowkee::util::wire_reader lhs_reader(lhs);
+          krowkee::util::wire_reader rhs_reader(rhs);
+          sum._unpack_buckets(lhs_reader);
+          other._unpack_buckets(rhs_reader);
+          sum += other;
+          return sum._packed_buckets();
+        }));
+    krowkee::util::wire_reader reader(reduced);
+    _unpack_buckets(reader);
+  }
+
+  /**
+   * Write the window followed by the buckets from the current to the oldest.
+   */
+  void pack(krowkee::util::wire_writer &writer) const {
+    sk.pack(writer);
+    writer.put(count);
+    _pack_buckets(writer);
+  }
+
+  void unpack(krowkee::util::wire_reader &reader) {
+    sk.unpack(reader);
+    count = reader.get<std::uint64_t>();
+    _unpack_buckets(reader);
+  }
+
   friend std::ostream &operator<<(std::ostream &os, const data_t &data) {
     os << data.sk;
     return os;
   }
+
+ private:
+  inline std::size_t _index(const std::size_t age) const {
+    return (_head + NumBuckets - age % NumBuckets) % NumBuckets;
+  }
+
+  void _pack_buckets(krowkee::util::wire_writer &writer) const {
+    for (std::size_t age(0); age < NumBuckets; ++age) {
+      bucket(age).pack(writer);
+      writer.put(bucket_count(age));
+    }
+  }
+
+  inline krowkee::util::wire_bytes_t _packed_buckets() const {
+    krowkee::util::wire_writer writer;
+    _pack_buckets(writer);
+    return writer.release();
+  }
+
+  void _unpack_buckets(krowkee::util::wire_reader &reader) {
+    _buckets.resize(NumBuckets, sk);
+    for (std::size_t age(0); age < NumBuckets; ++age) {
+      _buckets[_index(age)].unpack(reader);
+      _counts[_index(age)] = reader.get<std::uint64_t>();
+    }
+  }
 };
 
+/**
+ * Windowed summary of 8 buckets. Define an alias of
+ * krowkee::stream::BoundedWindowedSummary for other window lengths.
+ */
+template <typename SketchType, template <typename> class PtrType>
+using WindowedSummary = BoundedWindowedSummary<SketchType, PtrType, 8>;
+
 }  // namespace stream
 }  // namespace krowkee
 
@@ -10,16 +10,26 @@
 
 #include <krowkee/transform/CountSketch.hpp>
 #include <krowkee/transform/FWHT.hpp>
+#include <krowkee/transform/MultiRowCountSketch.hpp>
 
 #include <krowkee/sketch/Dense.hpp>
 #include <krowkee/sketch/Promotable.hpp>
 #include <krowkee/sketch/Sparse.hpp>
 
 #include <krowkee/sketch/Sketch.hpp>
+#include <krowkee/sketch/interface.hpp>
 
 #include <krowkee/stream/Multi.hpp>
+#include <krowkee/stream/PooledMulti.hpp>
+#include <krowkee/stream/ShardedMulti.hpp>
+#include <krowkee/stream/Similarity.hpp>
 #include <krowkee/stream/Summary.hpp>
 
+#if __has_include(<sys/mman.h>)
+#include <krowkee/stream/Ingest.hpp>
+#include <krowkee/stream/MultiView.hpp>
+#endif
+
 #if __has_include(<ygm/comm.hpp>)
 #include <krowkee/stream/Distributed.hpp>
 // #include <ygm/detail/ygm_ptr.hpp>
@@ -54,6 +64,74 @@ using MultiLocalFWHT =
     MultiLocal<krowkee::transform::FWHTFunctor, krowkee::sketch::Dense,
                std::plus, KeyType, RegType>;
 
+template <template <typename, typename...> class SketchFunc,
+          template <typename, typename> class ContainerType,
+          template <typename> class MergeOp, typename KeyType, typename RegType,
+          typename... Args>
+using PooledMultiLocal =
+    PooledMulti<CountingSummary, krowkee::sketch::Sketch, SketchFunc,
+                ContainerType, MergeOp, KeyType, RegType, std::shared_ptr,
+                Args...>;
+
+template <template <typename, typename> class ContainerType, typename KeyType,
+          typename RegType>
+using PooledMultiLocalCountSketch =
+    PooledMultiLocal<krowkee::transform::CountSketchFunctor, ContainerType,
+                     std::plus, KeyType, RegType, krowkee::hash::MulAddShift>;
+
+/**
+ * PooledMulti of CountSketches with `RangeSize` registers fixed at compile
+ * time. The registers are held inline in the pool, so that a reserved pool
+ * performs no allocation per key.
+ */
+template <typename KeyType, typename RegType, std::size_t RangeSize>
+using PooledMultiLocalFixedCountSketch = PooledMultiLocal<
+    krowkee::sketch::fixed_range<RangeSize>::template CountSketchFunctor,
+    krowkee::sketch::fixed_range<RangeSize>::template Dense, std::plus, KeyType,
+    RegType>;
+
+template <template <typename, typename...> class SketchFunc,
+          template <typename, typename> class ContainerType,
+          template <typename> class MergeOp, typename KeyType, typename RegType,
+          typename... Args>
+using ShardedMultiLocal =
+    ShardedMulti<CountingSummary, krowkee::sketch::Sketch, SketchFunc,
+                 ContainerType, MergeOp, KeyType, RegType, std::shared_ptr,
+                 Args...>;
+
+template <template <typename, typename> class ContainerType, typename KeyType,
+          typename RegType>
+using ShardedMultiLocalCountSketch =
+    ShardedMultiLocal<krowkee::transform::CountSketchFunctor, ContainerType,
+                      std::plus, KeyType, RegType, krowkee::hash::MulAddShift>;
+
+template <template <typename, typename> class ContainerType, typename KeyType,
+          typename RegType>
+using HeavyHitterMultiLocalMultiRowCountSketch =
+    Multi<HeavyHitterSummary, krowkee::sketch::Sketch,
+          krowkee::transform::MultiRowCountSketchFunctor, ContainerType,
+          std::plus, KeyType, RegType, std::shared_ptr>;
+
+template <template <typename, typename> class ContainerType, typename KeyType,
+          typename RegType>
+using WindowedMultiLocalCountSketch =
+    Multi<WindowedSummary, krowkee::sketch::Sketch,
+          krowkee::transform::CountSketchFunctor, ContainerType, std::plus,
+          KeyType, RegType, std::shared_ptr, krowkee::hash::MulAddShift>;
+
+template <template <typename, typename> class ContainerType, typename KeyType,
+          typename RegType>
+using CachedMultiLocalCountSketch =
+    Multi<CachedCountingSummary, krowkee::sketch::Sketch,
+          krowkee::transform::CountSketchFunctor, ContainerType, std::plus,
+          KeyType, RegType, std::shared_ptr, krowkee::hash::MulAddShift>;
+
+template <typename KeyType, typename RegType>
+using CachedMultiLocalFWHT =
+    Multi<CachedCountingSummary, krowkee::sketch::Sketch,
+          krowkee::transform::FWHTFunctor, krowkee::sketch::Dense, std::plus,
+          KeyType, RegType, std::shared_ptr>;
+
 }  // namespace stream
 }  // namespace krowkee
 
@@ -112,6 +190,27 @@ using CountingDistributedFWHT =
     CountingDistributed<krowkee::transform::FWHTFunctor, krowkee::sketch::Dense,
                         std::plus, KeyType, RegType>;
 
+template <template <typename, typename> class ContainerType, typename KeyType,
+          typename RegType>
+using HeavyHitterDistributedMultiRowCountSketch =
+    Distributed<HeavyHitterSummary, krowkee::sketch::Sketch,
+                krowkee::transform::MultiRowCountSketchFunctor, ContainerType,
+                std::plus, KeyType, RegType>;
+
+template <template <typename, typename> class ContainerType, typename KeyType,
+          typename RegType>
+using WindowedDistributedCountSketch =
+    Distributed<WindowedSummary, krowkee::sketch::Sketch,
+                krowkee::transform::CountSketchFunctor, ContainerType,
+                std::plus, KeyType, RegType, krowkee::hash::MulAddShift>;
+
+template <template <typename, typename> class ContainerType, typename KeyType,
+          typename RegType>
+using CachedDistributedCountSketch =
+    Distributed<CachedCountingSummary, krowkee::sketch::Sketch,
+                krowkee::transform::CountSketchFunctor, ContainerType,
+                std::plus, KeyType, RegType, krowkee::hash::MulAddShift>;
+
 }  // namespace stream
 }  // namespace krowkee
 
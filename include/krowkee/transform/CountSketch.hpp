@@ -10,6 +10,7 @@
 
 #include <krowkee/hash/util.hpp>
 
+#include <algorithm>
 #include <sstream>
 #include <vector>
 
@@ -25,7 +26,8 @@ using krowkee::stream::Element;
  * CountSketchFunctor
  *
  * Implements CountSketch using a single pair of hash functions (i.e. no
- * Chernoff approximation tricks).
+ * Chernoff approximation tricks). See MultiRowCountSketchFunctor for the
+ * median-of-rows variant.
  *
  * [0] M. Charikar, K. Chen, M. Farach-Colton. Finding frequent items in data
  * streams. Theoretical Computer Science. 2004.
@@ -120,6 +122,86 @@ class CountSketchFunctor {
     _apply_to_container<MergeOp>(registers, item_args...);
   }
 
+  //////////////////////////////////////////////////////////////////////////////
+  // Function: Apply Batch to Container
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Update a vector of registers with a block of observations.
+   *
+   * Produces exactly the same registers as calling `operator()` once per item,
+   * in order.
+   *
+   * @tparam ContainerType The type of the underlying sketch data structure.
+   *
+   * @param[out] registers the vector of registers.
+   * @param[in] items pointer to the `count` items to be inserted.
+   * @param[in] multiplicities pointer to the `count` multiplicities of
+   *     `items`, or `nullptr` if every multiplicity is `1`.
+   * @param[in] count the number of items.
+   */
+  template <template <typename, typename> class ContainerType, typename MergeOp>
+  inline void apply_batch(ContainerType<RegType, MergeOp> &registers,
+                          const std::uint64_t             *items,
+                          const RegType                   *multiplicities,
+                          const std::size_t                count) const {
+    _apply_batch_to_container<MergeOp>(registers, items, multiplicities, count);
+  }
+
+  /**
+   * Update a vector of registers with a block of observations.
+   *
+   * @tparam ContainerType The type of the underlying sketch data structure.
+   *
+   * @param[out] registers the vector of registers.
+   * @param[in] items pointer to the `count` items to be inserted.
+   * @param[in] multiplicities pointer to the `count` multiplicities of
+   *     `items`, or `nullptr` if every multiplicity is `1`.
+   * @param[in] count the number of items.
+   */
+  template <template <typename, typename, template <typename, typename> class,
+                      typename>
+            class ContainerType,
+            typename MergeOp, template <typename, typename> class MapType,
+            typename KeyType>
+  inline void apply_batch(
+      ContainerType<RegType, MergeOp, MapType, KeyType> &registers,
+      const std::uint64_t *items, const RegType *multiplicities,
+      const std::size_t count) const {
+    _apply_batch_to_container<MergeOp>(registers, items, multiplicities, count);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Function: Point Query
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Estimate the total multiplicity inserted for `item`.
+   *
+   * @tparam ContainerType The type of the underlying sketch data structure.
+   *
+   * @param[in] registers the vector of registers.
+   * @param[in] item the item to be queried.
+   */
+  template <typename ContainerType>
+  inline RegType point_query(const ContainerType &registers,
+                             const std::uint64_t  item) const {
+    const RegType polarity((_pol_hf(item) == 1) ? RegType(1) : RegType(-1));
+    return polarity * registers.get(_reg_hf(item));
+  }
+
+  /**
+   * Call `func(index)` on each register that inserting `item` updates.
+   *
+   * Lets callers such as krowkee::stream::CachedCountingSummary maintain
+   * register statistics without rescanning the registers.
+   */
+  template <typename Func>
+  inline void visit_registers(const std::uint64_t item,
+                              const Func         &func) const {
+    func(_reg_hf(item));
+  }
+
  private:
   template <typename MergeOp, typename ContainerType, typename... ItemArgs>
   constexpr void _apply_to_container(ContainerType &registers,
@@ -128,13 +210,50 @@ class CountSketchFunctor {
     const std::uint64_t    index(_reg_hf(stream_element.item));
     const RegType polarity((_pol_hf(stream_element.item) == 1) ? RegType(1)
                                                                : RegType(-1));
-    RegType      &reg = registers[index];
+    auto        &&reg = registers[index];
     reg               = MergeOp()(reg, polarity * stream_element.multiplicity);
     if (reg == 0) {
       registers.erase(index);
     }
   }
 
+  /**
+   * Hash each item and scatter its signed multiplicity in one pass.
+   *
+   * Hashing blocks ahead of the scatter with `HashFunc::hash_many` measured
+   * slower than this fused loop, even with native 64-bit lane multiplies; the
+   * emulated lane multiplies of AVX2, NEON and auto-vectorized SSE2 code are
+   * slower still than the scalar multiply.
+   */
+  template <typename MergeOp, typename ContainerType>
+  inline void _apply_batch_to_container(ContainerType       &registers,
+                                        const std::uint64_t *items,
+                                        const RegType       *multiplicities,
+                                        const std::size_t    count) const {
+    for (std::size_t i(0); i < count; ++i) {
+      _scatter<MergeOp>(
+          registers, _reg_hf(items[i]), _pol_hf(items[i]),
+          (multiplicities == nullptr) ? RegType(1) : multiplicities[i]);
+    }
+  }
+
+  /**
+   * Add `multiplicity` to register `index` with the sign of `polarity`, which
+   * is `0` or `1`. The sign is computed rather than selected, as a branch on
+   * the polarity is mispredicted for half of the items.
+   */
+  template <typename MergeOp, typename ContainerType>
+  inline void _scatter(ContainerType &registers, const std::uint64_t index,
+                       const std::uint64_t polarity,
+                       const RegType       multiplicity) const {
+    const RegType sign(RegType(2 * polarity) - RegType(1));
+    auto        &&reg = registers[index];
+    reg               = MergeOp()(reg, sign * multiplicity);
+    if (reg == 0) {
+      registers.erase(index);
+    }
+  }
+
  public:
   //////////////////////////////////////////////////////////////////////////////
   // Getters
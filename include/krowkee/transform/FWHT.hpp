@@ -6,10 +6,13 @@
 #ifndef _KROWKEE_TRANSFORM_FWHT_HPP
 #define _KROWKEE_TRANSFORM_FWHT_HPP
 
+#include <krowkee/transform/fwht/plan_cache.hpp>
+#include <krowkee/transform/fwht/transform.hpp>
 #include <krowkee/transform/fwht/utils.hpp>
 
 #include <krowkee/stream/Element.hpp>
 
+#include <memory>
 #include <sstream>
 #include <vector>
 
@@ -26,12 +29,16 @@ using krowkee::stream::Element;
  */
 template <typename RegType>
 class FWHTFunctor {
-  typedef FWHTFunctor<RegType> fwhtf_t;
+  typedef FWHTFunctor<RegType>          fwhtf_t;
+  typedef fwht::plan_cache<RegType>     plan_cache_t;
+  typedef std::shared_ptr<plan_cache_t> plan_cache_ptr_t;
 
  protected:
-  std::uint64_t _range_size;
-  std::uint64_t _seed;
-  std::uint64_t _domain_size;
+  std::uint64_t    _range_size;
+  std::uint64_t    _seed;
+  std::uint64_t    _domain_size;
+  std::size_t      _plan_cache_size;
+  plan_cache_ptr_t _plan_cache;
 
  public:
   /**Quick
@@ -44,16 +51,26 @@ class FWHTFunctor {
    *
    * @param s the desired embedding dimension.
    * @param seed the random seed.
+   * @param domain_size the number of columns of the transform.
+   * @param plan_cache_size the number of per-column sampling plans to cache.
+   *     `0` (the default) disables caching. If at least `domain_size`, the
+   *     plans of all columns are precomputed into a table up front.
    * @param args any additional paramters required by the hash functions.
    */
   template <typename... Args>
   FWHTFunctor<RegType>(const std::uint64_t range_size = 64,
                        const std::uint64_t seed = krowkee::hash::default_seed,
-                       const std::uint64_t domain_size = 1024,
+                       const std::uint64_t domain_size     = 1024,
+                       const std::size_t   plan_cache_size = 0,
                        const Args &&...args)
-      : _range_size(range_size), _seed(seed), _domain_size(domain_size) {}
+      : _range_size(range_size),
+        _seed(seed),
+        _domain_size(domain_size),
+        _plan_cache_size(plan_cache_size) {
+    _make_plan_cache();
+  }
 
-  FWHTFunctor() {}
+  FWHTFunctor() : _plan_cache_size(0) {}
 
   //////////////////////////////////////////////////////////////////////////////
   // Cereal Archives
@@ -61,8 +78,14 @@ class FWHTFunctor {
 
 #if __has_include(<cereal/cereal.hpp>)
   template <class Archive>
-  void serialize(Archive &archive) {
-    archive(_range_size, _seed, _domain_size);
+  void save(Archive &archive) const {
+    archive(_range_size, _seed, _domain_size, _plan_cache_size);
+  }
+
+  template <class Archive>
+  void load(Archive &archive) {
+    archive(_range_size, _seed, _domain_size, _plan_cache_size);
+    _make_plan_cache();
   }
 #endif
 
@@ -89,14 +112,101 @@ class FWHTFunctor {
     const std::uint64_t    col_index    = stream_element.item;
     const std::uint64_t    row_index    = stream_element.identifier;
     const RegType          multiplicity = stream_element.multiplicity;
-    std::vector<RegType>   sketch_vec =
-        krowkee::transform::fwht::get_sketch_vector(multiplicity, row_index,
-                                                    col_index, _domain_size,
-                                                    _range_size, _seed);
-
-    std::transform(std::begin(registers), std::end(registers),
-                   std::begin(sketch_vec), std::begin(registers),
-                   std::plus<RegType>());
+    if (_plan_cache) {
+      const RegType signed_multiplicity =
+          fwht::rademacher_flip(multiplicity, row_index, _seed);
+      const typename plan_cache_t::plan_ptr_t plan(
+          _plan_cache->get(col_index));
+      std::transform(std::begin(registers), std::end(registers),
+                     std::begin(*plan), std::begin(registers),
+                     [signed_multiplicity](const RegType reg,
+                                           const RegType sign) {
+                       return reg + signed_multiplicity * sign;
+                     });
+      return;
+    }
+    fwht::accumulate_sketch_vector(std::begin(registers), multiplicity,
+                                   row_index, col_index, _domain_size,
+                                   _range_size, _seed);
+  }
+
+  /**
+   * Update a vector of registers with a block of observations.
+   *
+   * Every FWHT update touches all of the registers, so there is nothing to be
+   * gained from blocking; this simply applies `operator()` to each item in
+   * order so that FWHT sketches support the same batch interface as
+   * CountSketch.
+   *
+   * @tparam ContainerType The type of the underlying sketch data structure.
+   *
+   * @param[out] registers the vector of registers.
+   * @param[in] items pointer to the `count` items to be inserted.
+   * @param[in] multiplicities pointer to the `count` multiplicities of
+   *     `items`, or `nullptr` if every multiplicity is `1`.
+   * @param[in] count the number of items.
+   */
+  template <template <typename, typename> class ContainerType, typename MergeOp>
+  inline void apply_batch(ContainerType<RegType, MergeOp> &registers,
+                          const std::uint64_t             *items,
+                          const RegType                   *multiplicities,
+                          const std::size_t                count) const {
+    for (std::size_t i(0); i < count; ++i) {
+      (*this)(registers, items[i],
+              (multiplicities != nullptr) ? multiplicities[i] : RegType(1));
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Function: Apply to Whole Vector
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Add the subsampled randomized Hadamard projection of a dense vector to a
+   * vector of registers.
+   *
+   * Computes `registers += S H D x`, where `x` is zero-padded to
+   * `n = ceil_pow2(domain_size())`, `D` flips the sign of entry `j` by
+   * `rademacher_sign(j, seed())`, `H` is the `n x n` Hadamard matrix applied
+   * with the fast transform, and `S` selects `range_size()` rows of `H x`
+   * sampled uniformly with replacement. The cost is O(n log n) rather than the
+   * O(n * range_size()) of inserting each entry.
+   *
+   * The projection is linear, so the registers of vectors projected by the
+   * same functor can be merged. It is a different projection from the one
+   * applied by `operator()`, whose sampled rows vary per column, so the two
+   * should not be mixed in the same registers.
+   *
+   * @tparam ContainerType The type of the underlying sketch data structure.
+   *
+   * @param[out] registers the vector of registers.
+   * @param[in] x the dense input vector. At most `domain_size()` entries.
+   * @param[in] num_threads the number of threads used by the transform. `0`
+   *     means one per hardware thread.
+   *
+   * @throws std::invalid_argument if `x` is longer than `domain_size()`.
+   */
+  template <template <typename, typename> class ContainerType, typename MergeOp>
+  inline void project(ContainerType<RegType, MergeOp> &registers,
+                      const std::vector<RegType>      &x,
+                      const std::size_t                num_threads = 1) const {
+    if (x.size() > _domain_size) {
+      std::stringstream ss;
+      ss << "error: attempting to project a vector of length " << x.size()
+         << " with an FWHT of domain size " << _domain_size;
+      throw std::invalid_argument(ss.str());
+    }
+    const std::uint64_t  padded_size(krowkee::hash::ceil_pow2_64(_domain_size));
+    std::vector<RegType> buffer(padded_size, RegType(0));
+    for (std::uint64_t j(0); j < x.size(); ++j) {
+      buffer[j] = fwht::rademacher_sign<RegType>(j, _seed) * x[j];
+    }
+    fwht::transform(buffer, num_threads);
+    // No column uses the sample stream keyed by `_domain_size`.
+    fwht::uniform_sampler sampler(padded_size, _domain_size, _seed);
+    for (auto itr(std::begin(registers)); itr != std::end(registers); ++itr) {
+      *itr = MergeOp()(*itr, buffer[sampler.next()]);
+    }
   }
 
   //////////////////////////////////////////////////////////////////////////////
@@ -109,6 +219,19 @@ class FWHTFunctor {
 
   constexpr std::uint64_t domain_size() const { return _domain_size; }
 
+  constexpr std::size_t plan_cache_size() const { return _plan_cache_size; }
+
+ private:
+  inline void _make_plan_cache() {
+    _plan_cache = (_plan_cache_size > 0)
+                      ? std::make_shared<plan_cache_t>(_range_size, _seed,
+                                                       _domain_size,
+                                                       _plan_cache_size)
+                      : plan_cache_ptr_t();
+  }
+
+ public:
+
   static inline std::string name() { return "FWHT"; }
 
   static inline std::string full_name() {
@@ -0,0 +1,282 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_TRANSFORM_FIXEDCOUNTSKETCH_HPP
+#define _KROWKEE_TRANSFORM_FIXEDCOUNTSKETCH_HPP
+
+#include <krowkee/stream/Element.hpp>
+
+#include <krowkee/hash/util.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+namespace krowkee {
+namespace transform {
+
+using krowkee::stream::Element;
+
+/**
+ * FixedCountSketchFunctor
+ *
+ * CountSketch (see CountSketchFunctor) into a compile-time number of
+ * registers `RangeSize`, which must be a power of two. The register and
+ * polarity hashes are multiply-add-shift hashes [0] whose shifts are
+ * constants, so that hashing an item costs two multiply-adds and two
+ * immediate shifts.
+ *
+ * [0] https://en.wikipedia.org/wiki/Universal_hashing
+ */
+template <typename RegType, std::size_t RangeSize>
+class FixedCountSketchFunctor {
+  typedef FixedCountSketchFunctor<RegType, RangeSize> fcsf_t;
+
+  static_assert(RangeSize >= 2 && (RangeSize & (RangeSize - 1)) == 0,
+                "FixedCountSketchFunctor requires a power of two range");
+  static_assert(RangeSize <= (std::size_t(1) << 32),
+                "FixedCountSketchFunctor supports at most 2^32 registers");
+
+  /// shift truncating a 64-bit hash to a register index
+  static constexpr std::uint64_t _shift =
+      64 - __builtin_ctzll(std::uint64_t(RangeSize));
+
+  std::uint64_t _seed;
+  std::uint64_t _reg_a;
+  std::uint64_t _reg_b;
+  std::uint64_t _pol_a;
+  std::uint64_t _pol_b;
+
+ public:
+  /**
+   * Initialize hash parameters.
+   *
+   * @tparam Args type(s) of additional (ignored) parameters.
+   *
+   * @param range_size the desired embedding dimension. Must round up to
+   *     `RangeSize`; it is accepted so that the functor constructs like the
+   *     other sketch functors.
+   * @param seed the random seed.
+   *
+   * @throws std::invalid_argument if `range_size` does not round up to
+   *     `RangeSize`.
+   */
+  template <typename... Args>
+  FixedCountSketchFunctor(
+      const std::uint64_t range_size,
+      const std::uint64_t seed = krowkee::hash::default_seed, const Args &...)
+      : _seed(seed) {
+    if ((std::uint64_t(1) << krowkee::hash::ceil_log2_64(range_size)) !=
+        RangeSize) {
+      std::stringstream ss;
+      ss << "error: range size " << range_size
+         << " does not match the fixed range " << RangeSize << "!";
+      throw std::invalid_argument(ss.str());
+    }
+    std::mt19937_64 rnd_gen(krowkee::hash::wang64(seed));
+    std::uniform_int_distribution<std::uint64_t> udist(
+        0, std::numeric_limits<std::uint64_t>::max());
+    _reg_a = udist(rnd_gen) | 1;
+    _reg_b = udist(rnd_gen);
+    _pol_a = udist(rnd_gen) | 1;
+    _pol_b = udist(rnd_gen);
+  }
+
+  FixedCountSketchFunctor() {}
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Cereal Archives
+  //////////////////////////////////////////////////////////////////////////////
+
+#if __has_include(<cereal/cereal.hpp>)
+  template <class Archive>
+  void serialize(Archive &archive) {
+    archive(_seed, _reg_a, _reg_b, _pol_a, _pol_b);
+  }
+#endif
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Function: Apply to Container
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Update a vector of registers with an observation.
+   *
+   * @tparam ContainerType The type of the underlying sketch data structure.
+   * @tparam ItemArgs... types of parameters of the stream object to be
+   *     inserted. Will be used to construct a krowkee::stream::Element object.
+   *
+   * @param[out] registers the vector of registers.
+   * @param[in] x the object to be inserted.
+   * @param[in] multiplicity a multiple to modulate insertion.
+   */
+  template <template <typename, typename> class ContainerType, typename MergeOp,
+            typename... ItemArgs>
+  constexpr void operator()(ContainerType<RegType, MergeOp> &registers,
+                            const ItemArgs &...item_args) const {
+    const Element<RegType> stream_element(item_args...);
+    _apply<MergeOp>(registers, stream_element.item,
+                    stream_element.multiplicity);
+  }
+
+  /**
+   * Update fixed-range registers with an observation.
+   *
+   * @tparam ContainerType The type of the underlying sketch data structure,
+   *     such as krowkee::sketch::FixedDense.
+   * @tparam ItemArgs... types of parameters of the stream object to be
+   *     inserted. Will be used to construct a krowkee::stream::Element object.
+   *
+   * @param[out] registers the vector of registers.
+   * @param[in] x the object to be inserted.
+   * @param[in] multiplicity a multiple to modulate insertion.
+   */
+  template <template <typename, typename, std::size_t> class ContainerType,
+            typename MergeOp, typename... ItemArgs>
+  constexpr void operator()(
+      ContainerType<RegType, MergeOp, RangeSize> &registers,
+      const ItemArgs &...item_args) const {
+    const Element<RegType> stream_element(item_args...);
+    _apply<MergeOp>(registers, stream_element.item,
+                    stream_element.multiplicity);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Function: Apply Batch to Container
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Update a vector of registers with a block of observations. Produces
+   * exactly the same registers as calling `operator()` once per item, in
+   * order.
+   *
+   * @param[out] registers the vector of registers.
+   * @param[in] items pointer to the `count` items to be inserted.
+   * @param[in] multiplicities pointer to the `count` multiplicities of
+   *     `items`, or `nullptr` if every multiplicity is `1`.
+   * @param[in] count the number of items.
+   */
+  template <template <typename, typename> class ContainerType, typename MergeOp>
+  inline void apply_batch(ContainerType<RegType, MergeOp> &registers,
+                          const std::uint64_t             *items,
+                          const RegType                   *multiplicities,
+                          const std::size_t                count) const {
+    _apply_batch<MergeOp>(registers, items, multiplicities, count);
+  }
+
+  /**
+   * Update fixed-range registers with a block of observations.
+   *
+   * @param[out] registers the vector of registers.
+   * @param[in] items pointer to the `count` items to be inserted.
+   * @param[in] multiplicities pointer to the `count` multiplicities of
+   *     `items`, or `nullptr` if every multiplicity is `1`.
+   * @param[in] count the number of items.
+   */
+  template <template <typename, typename, std::size_t> class ContainerType,
+            typename MergeOp>
+  inline void apply_batch(
+      ContainerType<RegType, MergeOp, RangeSize> &registers,
+      const std::uint64_t *items, const RegType *multiplicities,
+      const std::size_t count) const {
+    _apply_batch<MergeOp>(registers, items, multiplicities, count);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Function: Point Query
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Estimate the total multiplicity inserted for `item`.
+   *
+   * @param[in] registers the vector of registers.
+   * @param[in] item the item to be queried.
+   */
+  template <typename ContainerType>
+  inline RegType point_query(const ContainerType &registers,
+                             const std::uint64_t  item) const {
+    return _polarity(item) * registers.get(_index(item));
+  }
+
+  /**
+   * Call `func(index)` on each register that inserting `item` updates.
+   *
+   * Lets callers such as krowkee::stream::CachedCountingSummary maintain
+   * register statistics without rescanning the registers.
+   */
+  template <typename Func>
+  inline void visit_registers(const std::uint64_t item,
+                              const Func         &func) const {
+    func(_index(item));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Getters
+  //////////////////////////////////////////////////////////////////////////////
+
+  static constexpr std::size_t range_size() { return RangeSize; }
+
+  constexpr std::uint64_t seed() const { return _seed; }
+
+  static inline std::string name() { return "FixedCountSketch"; }
+
+  static inline std::string full_name() {
+    std::stringstream ss;
+    ss << name() << " of " << RangeSize << " registers using MulAddShift "
+       << "hashes and " << sizeof(RegType) << " byte registers";
+    return ss.str();
+  }
+
+  friend constexpr bool operator==(const fcsf_t &lhs, const fcsf_t &rhs) {
+    return lhs._seed == rhs._seed;
+  }
+
+  friend constexpr bool operator!=(const fcsf_t &lhs, const fcsf_t &rhs) {
+    return !operator==(lhs, rhs);
+  }
+
+  friend std::ostream &operator<<(std::ostream &os, const fcsf_t &func) {
+    os << RangeSize << " " << func._seed;
+    return os;
+  }
+
+ private:
+  constexpr std::uint64_t _index(const std::uint64_t item) const {
+    return (_reg_a * item + _reg_b) >> _shift;
+  }
+
+  constexpr RegType _polarity(const std::uint64_t item) const {
+    return ((_pol_a * item + _pol_b) >> 63) ? RegType(1) : RegType(-1);
+  }
+
+  template <typename MergeOp, typename ContainerType>
+  constexpr void _apply(ContainerType &registers, const std::uint64_t item,
+                        const RegType multiplicity) const {
+    const std::uint64_t index(_index(item));
+    auto              &&reg = registers[index];
+    reg                     = MergeOp()(reg, _polarity(item) * multiplicity);
+    if (reg == 0) {
+      registers.erase(index);
+    }
+  }
+
+  template <typename MergeOp, typename ContainerType>
+  inline void _apply_batch(ContainerType &registers, const std::uint64_t *items,
+                           const RegType    *multiplicities,
+                           const std::size_t count) const {
+    for (std::size_t i(0); i < count; ++i) {
+      _apply<MergeOp>(
+          registers, items[i],
+          (multiplicities == nullptr) ? RegType(1) : multiplicities[i]);
+    }
+  }
+};
+
+}  // namespace transform
+}  // namespace krowkee
+
+#endif
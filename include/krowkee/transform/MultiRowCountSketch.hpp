@@ -0,0 +1,372 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_TRANSFORM_MULTIROWCOUNTSKETCH_HPP
+#define _KROWKEE_TRANSFORM_MULTIROWCOUNTSKETCH_HPP
+
+#include <krowkee/stream/Element.hpp>
+
+#include <krowkee/hash/simd.hpp>
+#include <krowkee/hash/util.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace krowkee {
+namespace transform {
+
+using krowkee::stream::Element;
+
+/**
+ * MultiRowCountSketchFunctor
+ *
+ * Implements the `depth x width` CountSketch of [0]. Each insert updates one
+ * register in each of `depth` independent rows of `width` registers, and
+ * point queries take the median of the per-row estimates. The rows are stored
+ * row-major in a single register block of `range_size() = depth * width`
+ * registers, so row `r` occupies `[r * width, (r + 1) * width)`.
+ *
+ * All of the row hashes are derived from one seeded mixer and one 128-bit
+ * product per item. The item is mixed with `wang64(x ^ key)`, and multiplying
+ * that by an odd seeded multiplier yields the two 64-bit halves `h1, h2` used
+ * to double hash [1] row `r` as `g_r = h1 + r * h2`. The register index is the
+ * top `log2(width)` bits of `g_r` and the polarity is the following bit.
+ *
+ * [0] M. Charikar, K. Chen, M. Farach-Colton. Finding frequent items in data
+ * streams. Theoretical Computer Science. 2004.
+ * https://edoliberty.github.io/datamining2011aFiles/FindingFrequentItemsInDataStreams.pdf
+ *
+ * [1] A. Kirsch, M. Mitzenmacher. Less hashing, same performance: building a
+ * better Bloom filter. Random Structures & Algorithms. 2008.
+ */
+template <typename RegType>
+class MultiRowCountSketchFunctor {
+  typedef MultiRowCountSketchFunctor<RegType> mrcsf_t;
+
+  std::uint64_t _log2_width;
+  std::uint64_t _depth;
+  std::uint64_t _seed;
+  std::uint64_t _key;
+  std::uint64_t _mul;
+
+ public:
+  /**
+   * Initialize hash parameters.
+   *
+   * The row width is rounded up to the next power of two.
+   *
+   * @tparam Args type(s) of additional (ignored) parameters.
+   *
+   * @param width the desired number of registers per row.
+   * @param seed the random seed.
+   * @param depth the number of rows. Odd depths give a true median.
+   *
+   * @throws std::invalid_argument if `width < 2`, as each register index
+   *     and polarity needs at least one hash bit.
+   */
+  template <typename... Args>
+  MultiRowCountSketchFunctor(
+      const std::uint64_t width,
+      const std::uint64_t seed  = krowkee::hash::default_seed,
+      const std::uint64_t depth = 5, const Args &...)
+      : _log2_width(krowkee::hash::ceil_log2_64(width)),
+        _depth(std::max(depth, std::uint64_t(1))),
+        _seed(seed),
+        _key(krowkee::hash::wang64(seed)),
+        _mul(krowkee::hash::wang64(_key) | 1) {
+    if (width < 2) {
+      std::stringstream ss;
+      ss << "error: row width " << width << " must be at least 2!";
+      throw std::invalid_argument(ss.str());
+    }
+  }
+
+  MultiRowCountSketchFunctor() {}
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Cereal Archives
+  //////////////////////////////////////////////////////////////////////////////
+
+#if __has_include(<cereal/cereal.hpp>)
+  template <class Archive>
+  void serialize(Archive &archive) {
+    archive(_log2_width, _depth, _seed, _key, _mul);
+  }
+#endif
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Function: Apply to Container
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Update a vector of registers with an observation.
+   *
+   * @tparam ContainerType The type of the underlying sketch data structure.
+   * @tparam ItemArgs... types of parameters of the stream object to be
+   *     inserted. Will be used to construct a krowkee::stream::Element object.
+   *
+   * @param[out] registers the vector of registers.
+   * @param[in] x the object to be inserted.
+   * @param[in] multiplicity a multiple to modulate insertion.
+   */
+  template <template <typename, typename> class ContainerType, typename MergeOp,
+            typename... ItemArgs>
+  constexpr void operator()(ContainerType<RegType, MergeOp> &registers,
+                            const ItemArgs &...item_args) const {
+    const Element<RegType> stream_element(item_args...);
+    _apply_rows<MergeOp>(registers, _mix(stream_element.item),
+                         stream_element.multiplicity);
+  }
+
+  /**
+   * Update a vector of registers with an observation.
+   *
+   * @tparam ContainerType The type of the underlying sketch data structure.
+   * @tparam ItemArgs... types of parameters of the stream object to be
+   *     inserted. Will be used to construct a krowkee::stream::Element object.
+   *
+   * @param[out] registers the vector of registers.
+   * @param[in] x the object to be inserted.
+   * @param[in] multiplicity a multiple to modulate insertion.
+   */
+  template <template <typename, typename, template <typename, typename> class,
+                      typename>
+            class ContainerType,
+            typename MergeOp, template <typename, typename> class MapType,
+            typename KeyType, typename... ItemArgs>
+  constexpr void operator()(
+      ContainerType<RegType, MergeOp, MapType, KeyType> &registers,
+      const ItemArgs &...item_args) const {
+    const Element<RegType> stream_element(item_args...);
+    _apply_rows<MergeOp>(registers, _mix(stream_element.item),
+                         stream_element.multiplicity);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Function: Apply Batch to Container
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Update a vector of registers with a block of observations.
+   *
+   * Produces exactly the same registers as calling `operator()` once per item,
+   * in order.
+   *
+   * @tparam ContainerType The type of the underlying sketch data structure.
+   *
+   * @param[out] registers the vector of registers.
+   * @param[in] items pointer to the `count` items to be inserted.
+   * @param[in] multiplicities pointer to the `count` multiplicities of
+   *     `items`, or `nullptr` if every multiplicity is `1`.
+   * @param[in] count the number of items.
+   */
+  template <template <typename, typename> class ContainerType, typename MergeOp>
+  inline void apply_batch(ContainerType<RegType, MergeOp> &registers,
+                          const std::uint64_t             *items,
+                          const RegType                   *multiplicities,
+                          const std::size_t                count) const {
+    _apply_batch_to_container<MergeOp>(registers, items, multiplicities, count);
+  }
+
+  /**
+   * Update a vector of registers with a block of observations.
+   *
+   * @tparam ContainerType The type of the underlying sketch data structure.
+   *
+   * @param[out] registers the vector of registers.
+   * @param[in] items pointer to the `count` items to be inserted.
+   * @param[in] multiplicities pointer to the `count` multiplicities of
+   *     `items`, or `nullptr` if every multiplicity is `1`.
+   * @param[in] count the number of items.
+   */
+  template <template <typename, typename, template <typename, typename> class,
+                      typename>
+            class ContainerType,
+            typename MergeOp, template <typename, typename> class MapType,
+            typename KeyType>
+  inline void apply_batch(
+      ContainerType<RegType, MergeOp, MapType, KeyType> &registers,
+      const std::uint64_t *items, const RegType *multiplicities,
+      const std::size_t count) const {
+    _apply_batch_to_container<MergeOp>(registers, items, multiplicities, count);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Function: Point Query
+  //////////////////////////////////////////////////////////////////////////////
+
+  /**
+   * Estimate the total multiplicity inserted for `item`.
+   *
+   * Returns the median of the `depth()` signed row estimates. For even depths
+   * the two middle estimates are averaged.
+   *
+   * @tparam ContainerType The type of the underlying sketch data structure.
+   *
+   * @param[in] registers the vector of registers.
+   * @param[in] item the item to be queried.
+   */
+  template <typename ContainerType>
+  inline RegType point_query(const ContainerType &registers,
+                             const std::uint64_t  item) const {
+    const auto [h1, h2] = _double_hash(_mix(item));
+    // typical depths fit on the stack, so that queries do not allocate
+    constexpr std::size_t stack_depth(16);
+    RegType               stack_estimates[stack_depth];
+    std::vector<RegType>  heap_estimates;
+    RegType              *estimates(stack_estimates);
+    if (_depth > stack_depth) {
+      heap_estimates.resize(_depth);
+      estimates = heap_estimates.data();
+    }
+    std::uint64_t g(h1);
+    for (std::uint64_t row(0); row < _depth; ++row, g += h2) {
+      estimates[row] =
+          _polarity(g) * registers.get(row * width() + _row_index(g));
+    }
+    const std::size_t mid(_depth / 2);
+    std::nth_element(estimates, estimates + mid, estimates + _depth);
+    const RegType upper(estimates[mid]);
+    if (_depth % 2 == 1) {
+      return upper;
+    }
+    const RegType lower(*std::max_element(estimates, estimates + mid));
+    return lower + (upper - lower) / 2;
+  }
+
+  /**
+   * Call `func(index)` on each of the `depth()` registers, one per row, that
+   * inserting `item` updates.
+   *
+   * Lets callers such as krowkee::stream::CachedCountingSummary maintain
+   * register statistics without rescanning the registers.
+   */
+  template <typename Func>
+  inline void visit_registers(const std::uint64_t item,
+                              const Func         &func) const {
+    const auto [h1, h2] = _double_hash(_mix(item));
+    std::uint64_t g(h1);
+    for (std::uint64_t row(0); row < _depth; ++row, g += h2) {
+      func(row * width() + _row_index(g));
+    }
+  }
+
+ private:
+  constexpr std::uint64_t _mix(const std::uint64_t item) const {
+    return krowkee::hash::wang64(item ^ _key);
+  }
+
+  /**
+   * Split the seeded 128-bit product of a mixed item into the two double
+   * hashing components. The step is forced odd so that it is never zero.
+   */
+  constexpr std::pair<std::uint64_t, std::uint64_t> _double_hash(
+      const std::uint64_t mixed) const {
+    const unsigned __int128 product((unsigned __int128)mixed * _mul);
+    return {std::uint64_t(product >> 64), std::uint64_t(product) | 1};
+  }
+
+  constexpr std::uint64_t _row_index(const std::uint64_t g) const {
+    return g >> (64 - _log2_width);
+  }
+
+  constexpr RegType _polarity(const std::uint64_t g) const {
+    return ((g >> (63 - _log2_width)) & 1) ? RegType(1) : RegType(-1);
+  }
+
+  template <typename MergeOp, typename ContainerType>
+  constexpr void _apply_rows(ContainerType &registers, const std::uint64_t mixed,
+                             const RegType multiplicity) const {
+    const auto [h1, h2] = _double_hash(mixed);
+    std::uint64_t g(h1);
+    for (std::uint64_t row(0); row < _depth; ++row, g += h2) {
+      const std::uint64_t index(row * width() + _row_index(g));
+      auto              &&reg = registers[index];
+      reg = MergeOp()(reg, _polarity(g) * multiplicity);
+      if (reg == 0) {
+        registers.erase(index);
+      }
+    }
+  }
+
+  /**
+   * Mix the items in blocks of `_batch_block_size` on vector lanes, then
+   * update every row of each item.
+   */
+  template <typename MergeOp, typename ContainerType>
+  inline void _apply_batch_to_container(ContainerType       &registers,
+                                        const std::uint64_t *items,
+                                        const RegType       *multiplicities,
+                                        const std::size_t    count) const {
+    std::uint64_t mixed[_batch_block_size];
+    for (std::size_t offset(0); offset < count; offset += _batch_block_size) {
+      const std::size_t block_size(
+          std::min(_batch_block_size, count - offset));
+      for (std::size_t i(0); i < block_size; ++i) {
+        mixed[i] = items[offset + i] ^ _key;
+      }
+      krowkee::hash::simd::wang_many(mixed, mixed, block_size, 0);
+      for (std::size_t i(0); i < block_size; ++i) {
+        _apply_rows<MergeOp>(registers, mixed[i],
+                             (multiplicities != nullptr)
+                                 ? multiplicities[offset + i]
+                                 : RegType(1));
+      }
+    }
+  }
+
+  static constexpr std::size_t _batch_block_size = 256;
+
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  // Getters
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr std::size_t range_size() const { return _depth * width(); }
+
+  constexpr std::size_t width() const {
+    return std::size_t(1) << _log2_width;
+  }
+
+  constexpr std::size_t depth() const { return _depth; }
+
+  constexpr std::uint64_t seed() const { return _seed; }
+
+  static inline std::string name() { return "MultiRowCountSketch"; }
+
+  static inline std::string full_name() {
+    std::stringstream ss;
+    ss << name() << " using fused hashes and " << sizeof(RegType)
+       << " byte registers";
+    return ss.str();
+  }
+};
+
+template <typename RegType>
+constexpr bool operator==(const MultiRowCountSketchFunctor<RegType> &lhs,
+                          const MultiRowCountSketchFunctor<RegType> &rhs) {
+  return (lhs.seed() == rhs.seed()) && (lhs.width() == rhs.width()) &&
+         (lhs.depth() == rhs.depth());
+}
+
+template <typename RegType>
+constexpr bool operator!=(const MultiRowCountSketchFunctor<RegType> &lhs,
+                          const MultiRowCountSketchFunctor<RegType> &rhs) {
+  return !operator==(lhs, rhs);
+}
+
+template <typename RegType>
+std::ostream &operator<<(std::ostream                              &os,
+                         const MultiRowCountSketchFunctor<RegType> &func) {
+  os << func.depth() << "x" << func.width() << " " << func.seed();
+  return os;
+}
+}  // namespace transform
+}  // namespace krowkee
+
+#endif
@@ -0,0 +1,156 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_TRANSFORM_FWHT_PLAN_CACHE_HPP
+#define _KROWKEE_TRANSFORM_FWHT_PLAN_CACHE_HPP
+
+#include <krowkee/transform/fwht/utils.hpp>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace krowkee {
+namespace transform {
+namespace fwht {
+
+/**
+ * Compute the sampling plan of column `col_index`.
+ *
+ * The plan is the vector of `sketch_size` Hadamard signs
+ * `H[col_index, s_i]`, where `s_i` are the uniform samples of the column. An
+ * FWHT update of `(row_index, col_index, val)` adds
+ * `rademacher_flip(val, row_index, seed) * plan[i]` to register `i`.
+ */
+template <typename RegType>
+inline std::vector<RegType> get_column_plan(
+    const std::uint64_t col_index, const std::uint64_t num_vertices,
+    const std::uint64_t sketch_size,
+    const std::uint64_t seed = krowkee::hash::default_seed) {
+  uniform_sampler      sampler(num_vertices, col_index, seed);
+  std::vector<RegType> plan(sketch_size);
+  for (std::uint64_t i(0); i < sketch_size; ++i) {
+    plan[i] = get_hadamard_element<RegType>(col_index, sampler.next());
+  }
+  return plan;
+}
+
+/**
+ * Cache of per-column FWHT sampling plans.
+ *
+ * If `capacity >= domain_size`, the plans of every column in the domain are
+ * precomputed into an immutable table at construction, and lookups take no
+ * locks. Otherwise plans are computed on demand and kept in a bounded LRU
+ * cache of `capacity` columns guarded by a mutex. Plans are handed out as
+ * shared pointers, so a caller may keep reading one after it is evicted.
+ * Columns outside the domain are computed but not cached.
+ */
+template <typename RegType>
+class plan_cache {
+ public:
+  typedef std::vector<RegType>          plan_t;
+  typedef std::shared_ptr<const plan_t> plan_ptr_t;
+
+ private:
+  typedef std::list<std::pair<std::uint64_t, plan_ptr_t>> lru_t;
+  typedef typename lru_t::iterator                         lru_iter_t;
+
+  std::uint64_t _range_size;
+  std::uint64_t _seed;
+  std::uint64_t _domain_size;
+  std::size_t   _capacity;
+
+  std::vector<plan_ptr_t>                       _table;
+  lru_t                                         _lru;
+  std::unordered_map<std::uint64_t, lru_iter_t> _lru_index;
+  std::mutex                                    _mutex;
+
+ public:
+  /**
+   * @param range_size the number of registers.
+   * @param seed the random seed of the transform.
+   * @param domain_size the size of the column domain.
+   * @param capacity the maximum number of cached columns.
+   */
+  plan_cache(const std::uint64_t range_size, const std::uint64_t seed,
+             const std::uint64_t domain_size, const std::size_t capacity)
+      : _range_size(range_size),
+        _seed(seed),
+        _domain_size(domain_size),
+        _capacity(capacity) {
+    if (is_table()) {
+      _table.reserve(_domain_size);
+      for (std::uint64_t col_index(0); col_index < _domain_size; ++col_index) {
+        _table.push_back(std::make_shared<const plan_t>(_make_plan(col_index)));
+      }
+    }
+  }
+
+  /**
+   * Look up the plan of `col_index`, computing it on a miss.
+   */
+  plan_ptr_t get(const std::uint64_t col_index) {
+    if (col_index >= _domain_size) {
+      return std::make_shared<const plan_t>(_make_plan(col_index));
+    }
+    if (is_table()) {
+      return _table[col_index];
+    }
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      auto                        itr = _lru_index.find(col_index);
+      if (itr != std::end(_lru_index)) {
+        _lru.splice(std::begin(_lru), _lru, itr->second);
+        return itr->second->second;
+      }
+    }
+    // Compute outside of the lock; a concurrent miss on the same column
+    // computes an identical plan, and only one copy is kept.
+    plan_ptr_t plan(std::make_shared<const plan_t>(_make_plan(col_index)));
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto                        itr = _lru_index.find(col_index);
+    if (itr != std::end(_lru_index)) {
+      return itr->second->second;
+    }
+    _lru.emplace_front(col_index, plan);
+    _lru_index[col_index] = std::begin(_lru);
+    if (_lru.size() > _capacity) {
+      _lru_index.erase(_lru.back().first);
+      _lru.pop_back();
+    }
+    return plan;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Getters
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr bool is_table() const { return _capacity >= _domain_size; }
+
+  constexpr std::size_t capacity() const { return _capacity; }
+
+  inline std::size_t size() {
+    if (is_table()) {
+      return _table.size();
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _lru.size();
+  }
+
+ private:
+  inline plan_t _make_plan(const std::uint64_t col_index) const {
+    return get_column_plan<RegType>(col_index, _domain_size, _range_size,
+                                    _seed);
+  }
+};
+
+}  // namespace fwht
+}  // namespace transform
+}  // namespace krowkee
+
+#endif
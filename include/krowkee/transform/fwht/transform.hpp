@@ -0,0 +1,122 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_TRANSFORM_FWHT_TRANSFORM_HPP
+#define _KROWKEE_TRANSFORM_FWHT_TRANSFORM_HPP
+
+#include <krowkee/hash/util.hpp>
+
+#include <krowkee/util/parallel.hpp>
+
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace krowkee {
+namespace transform {
+namespace fwht {
+
+/**
+ * Number of elements transformed entirely in cache before the butterflies
+ * start spanning blocks. 2^12 registers of 8 bytes fit comfortably in L1/L2.
+ */
+constexpr std::size_t transform_block_size = std::size_t(1) << 12;
+
+/**
+ * Minimum number of butterflies handed to a thread.
+ */
+constexpr std::size_t transform_grain = std::size_t(1) << 14;
+
+/**
+ * Apply one butterfly stage of half-width `h` to pairs `[pair_begin,
+ * pair_end)` of the length-`n` array `data`.
+ *
+ * Pair `p` combines `data[j]` and `data[j + h]` for
+ * `j = (p / h) * 2h + p % h`. The inner loop runs over contiguous runs of
+ * up to `h` elements, which the compiler vectorizes.
+ */
+template <typename RegType>
+inline void butterfly_stage(RegType *data, const std::size_t h,
+                            const std::size_t pair_begin,
+                            const std::size_t pair_end) {
+  std::size_t pair(pair_begin);
+  while (pair < pair_end) {
+    const std::size_t offset(pair % h);
+    const std::size_t run(std::min(h - offset, pair_end - pair));
+    RegType *__restrict lo(data + (pair / h) * 2 * h + offset);
+    RegType *__restrict hi(lo + h);
+    for (std::size_t k(0); k < run; ++k) {
+      const RegType a(lo[k]);
+      const RegType b(hi[k]);
+      lo[k] = a + b;
+      hi[k] = a - b;
+    }
+    pair += run;
+  }
+}
+
+/**
+ * In-place unnormalized fast Walsh-Hadamard transform.
+ *
+ * Computes `data <- H data` in O(n log n), where `H` is the Sylvester
+ * Hadamard matrix with entries `get_hadamard_element(i, j)`. Stages whose
+ * butterflies fit in `transform_block_size` elements are run block by block
+ * so that each block stays in cache; the remaining stages sweep the whole
+ * array. Both phases are split across `num_threads` threads.
+ *
+ * @param data pointer to the `n` values to transform.
+ * @param n the transform length. Must be a power of two.
+ * @param num_threads the number of threads. `0` means one per hardware
+ *     thread.
+ *
+ * @throws std::invalid_argument if `n` is not a power of two.
+ */
+template <typename RegType>
+void transform(RegType *data, const std::size_t n,
+               const std::size_t num_threads = 1) {
+  if (!krowkee::hash::is_pow2(n)) {
+    std::stringstream ss;
+    ss << "error: fast Walsh-Hadamard transform length " << n
+       << " is not a power of two";
+    throw std::invalid_argument(ss.str());
+  }
+  const std::size_t block_size(std::min(n, transform_block_size));
+  const std::size_t num_blocks(n / block_size);
+  krowkee::util::parallel_for(
+      0, num_blocks, num_threads,
+      [data, block_size](const std::size_t begin, const std::size_t end) {
+        for (std::size_t block(begin); block < end; ++block) {
+          RegType *block_data(data + block * block_size);
+          for (std::size_t h(1); h < block_size; h *= 2) {
+            butterfly_stage(block_data, h, 0, block_size / 2);
+          }
+        }
+      },
+      std::max(transform_grain / block_size, std::size_t(1)));
+  for (std::size_t h(block_size); h < n; h *= 2) {
+    krowkee::util::parallel_for(
+        0, n / 2, num_threads,
+        [data, h](const std::size_t begin, const std::size_t end) {
+          butterfly_stage(data, h, begin, end);
+        },
+        transform_grain);
+  }
+}
+
+/**
+ * In-place unnormalized fast Walsh-Hadamard transform of a vector.
+ *
+ * @throws std::invalid_argument if `data.size()` is not a power of two.
+ */
+template <typename RegType>
+void transform(std::vector<RegType> &data, const std::size_t num_threads = 1) {
+  transform(data.data(), data.size(), num_threads);
+}
+
+}  // namespace fwht
+}  // namespace transform
+}  // namespace krowkee
+
+#endif
@@ -9,13 +9,30 @@
 
 #include <krowkee/transform/fwht/utils_temp.hpp>
 
+#include <krowkee/hash/util.hpp>
+
+#include <cstdlib>
+#include <random>
+#include <vector>
+
 namespace krowkee {
 namespace transform {
 namespace fwht {
 
+/**
+ * Legacy FWHT random number generation.
+ *
+ * These reproduce the original generators, which reseed the global C RNG on
+ * every sign flip and construct a fresh `std::default_random_engine` for every
+ * sample. They are not thread safe. Define `KROWKEE_FWHT_LEGACY_RNG` to have
+ * the FWHT transform use them, e.g. to reproduce sketches built by earlier
+ * versions.
+ */
+namespace legacy {
+
 template <typename RegType>
-constexpr RegType rademacher_flip(RegType val, const std::uint64_t col_index,
-                                  const std::uint64_t seed) {
+inline RegType rademacher_flip(RegType val, const std::uint64_t col_index,
+                               const std::uint64_t seed) {
   const std::uint64_t col_seed = seed + col_index;
   std::srand(col_seed);
   return ((std::rand() % 2 == 0)
@@ -24,7 +41,7 @@ constexpr RegType rademacher_flip(RegType val, const std::uint64_t col_index,
                                      // number used for each row
 }
 
-std::vector<uint64_t> uniform_sample_vec(
+inline std::vector<uint64_t> uniform_sample_vec(
     const std::uint64_t input_size, const std::uint64_t sketch_size,
     const std::uint64_t row_index,
     const std::uint64_t seed = krowkee::hash::default_seed) {
@@ -42,13 +59,139 @@ std::vector<uint64_t> uniform_sample_vec(
   return sketch_vec;
 }
 
-uint64_t count_set_bits(std::uint64_t num) {
-  std::uint64_t count = 0;
-  while (num) {
-    count += num & 1;
-    num >>= 1;
+}  // namespace legacy
+
+/**
+ * Stateless counter-based mixer.
+ *
+ * Hashes the pair `(key, counter)` to 64 bits with two rounds of wang64. The
+ * key is mixed before the counter is folded in, so that nearby seeds and
+ * nearby counters produce unrelated streams (unlike `seed + counter`).
+ *
+ * @param key the stream key, e.g. a seed.
+ * @param counter the position in the stream.
+ */
+constexpr std::uint64_t counter_hash(const std::uint64_t key,
+                                     const std::uint64_t counter) {
+  return krowkee::hash::wang64(krowkee::hash::wang64(key) ^ counter);
+}
+
+/**
+ * Map a 64-bit hash uniformly onto `[0, range)` by multiply-high.
+ *
+ * CURRENTLY NOT PORTABLE. Uses `unsigned __int128`.
+ */
+constexpr std::uint64_t reduce_range(const std::uint64_t hash,
+                                     const std::uint64_t range) {
+  return std::uint64_t((static_cast<unsigned __int128>(hash) * range) >> 64);
+}
+
+/**
+ * Rademacher sign associated with `col_index`.
+ *
+ * Reproducible, thread safe and allocation free.
+ *
+ * @param col_index the index whose sign is requested.
+ * @param seed the random seed.
+ *
+ * @return `+1` or `-1` with equal probability.
+ */
+template <typename RegType>
+constexpr RegType rademacher_sign(const std::uint64_t col_index,
+                                  const std::uint64_t seed) {
+  return (counter_hash(seed, col_index) >> 63) ? RegType(-1) : RegType(1);
+}
+
+/**
+ * Flip the sign of `val` according to the Rademacher sign of `col_index`.
+ */
+template <typename RegType>
+constexpr RegType rademacher_flip(RegType val, const std::uint64_t col_index,
+                                  const std::uint64_t seed) {
+#if defined(KROWKEE_FWHT_LEGACY_RNG)
+  return legacy::rademacher_flip(val, col_index, seed);
+#else
+  return rademacher_sign<RegType>(col_index, seed) * val;
+#endif
+}
+
+/**
+ * The `sample_index`-th uniform sample in `[0, input_size)` of the sample row
+ * keyed by `row_index`.
+ *
+ * Random access, so a sample row can be regenerated entry by entry without
+ * storing it.
+ */
+constexpr std::uint64_t uniform_sample(
+    const std::uint64_t input_size, const std::uint64_t row_index,
+    const std::uint64_t sample_index,
+    const std::uint64_t seed = krowkee::hash::default_seed) {
+  return reduce_range(counter_hash(counter_hash(seed, row_index), sample_index),
+                      input_size);
+}
+
+/**
+ * Sequential generator of the uniform samples of one sample row.
+ *
+ * Yields the same sequence as `uniform_sample_vec(input_size, sketch_size,
+ * row_index, seed)`, one entry per call to `next()`, without allocating. If
+ * `KROWKEE_FWHT_LEGACY_RNG` is defined it wraps the legacy engine instead.
+ */
+#if defined(KROWKEE_FWHT_LEGACY_RNG)
+class uniform_sampler {
+  std::default_random_engine              _engine;
+  std::uniform_int_distribution<uint64_t> _dist;
+
+ public:
+  uniform_sampler(const std::uint64_t input_size, const std::uint64_t row_index,
+                  const std::uint64_t seed = krowkee::hash::default_seed)
+      : _engine(seed + row_index), _dist(0, input_size - 1) {}
+
+  inline std::uint64_t next() { return _dist(_engine); }
+};
+#else
+class uniform_sampler {
+  std::uint64_t _input_size;
+  std::uint64_t _row_key;
+  std::uint64_t _sample_index;
+
+ public:
+  constexpr uniform_sampler(
+      const std::uint64_t input_size, const std::uint64_t row_index,
+      const std::uint64_t seed = krowkee::hash::default_seed)
+      : _input_size(input_size),
+        _row_key(counter_hash(seed, row_index)),
+        _sample_index(0) {}
+
+  constexpr std::uint64_t next() {
+    return reduce_range(counter_hash(_row_key, _sample_index++), _input_size);
   }
-  return count;
+};
+#endif
+
+/**
+ * Draw `sketch_size` uniform samples from `[0, input_size)` for the sample row
+ * keyed by `row_index`.
+ */
+inline std::vector<uint64_t> uniform_sample_vec(
+    const std::uint64_t input_size, const std::uint64_t sketch_size,
+    const std::uint64_t row_index,
+    const std::uint64_t seed = krowkee::hash::default_seed) {
+  uniform_sampler            sampler(input_size, row_index, seed);
+  std::vector<std::uint64_t> sketch_vec(sketch_size);
+  for (std::uint64_t i(0); i < sketch_size; ++i) {
+    sketch_vec[i] = sampler.next();
+  }
+  return sketch_vec;
+}
+
+/**
+ * Population count of `num`.
+ *
+ * CURRENTLY NOT PORTABLE. Uses `__builtin_popcountll`.
+ */
+constexpr std::uint64_t count_set_bits(const std::uint64_t num) {
+  return __builtin_popcountll(num);
 }
 
 constexpr bool get_parity(std::uint64_t num) { return (num & 1); }
@@ -61,20 +204,40 @@ constexpr RegType get_hadamard_element(const std::uint64_t row_index,
   return (is_odd) ? RegType(-1) : RegType(1);
 }
 
+/**
+ * Add the FWHT sketch vector of `(row_index, col_index, val)` to the
+ * `sketch_size` registers starting at `registers`.
+ *
+ * Register `i` receives `rademacher_flip(val, row_index, seed) *
+ * get_hadamard_element(col_index, s_i)`, where `s_i` is the `i`th uniform
+ * sample of column `col_index`. Nothing is allocated, and with the
+ * counter-based generator each iteration is a pure function of `i`.
+ *
+ * @tparam RegIter random access iterator over the registers.
+ */
+template <typename RegType, typename RegIter>
+constexpr void accumulate_sketch_vector(
+    RegIter registers, const RegType val, const std::uint64_t row_index,
+    const std::uint64_t col_index, const std::uint64_t num_vertices,
+    const std::uint64_t sketch_size,
+    const std::uint64_t seed = krowkee::hash::default_seed) {
+  const RegType   signed_multiplicity = rademacher_flip(val, row_index, seed);
+  uniform_sampler sampler(num_vertices, col_index, seed);
+  for (std::uint64_t i(0); i < sketch_size; ++i) {
+    registers[i] += signed_multiplicity *
+                    get_hadamard_element<RegType>(col_index, sampler.next());
+  }
+}
+
 template <typename RegType>
-constexpr std::vector<RegType> get_sketch_vector(
+inline std::vector<RegType> get_sketch_vector(
     const RegType val, const std::uint64_t row_index,
     const std::uint64_t col_index, const std::uint64_t num_vertices,
     const std::uint64_t sketch_size,
     const std::uint64_t seed = krowkee::hash::default_seed) {
-  const RegType signed_multiplicity = rademacher_flip(val, row_index, seed);
-  const std::vector<uint64_t> sample_indices =
-      uniform_sample_vec(num_vertices, sketch_size, col_index, seed);
-  std::vector<RegType> out_sketch(sketch_size);
-  for (int i = 0; i < sketch_size; i++) {
-    out_sketch[i] = signed_multiplicity *
-                    get_hadamard_element<RegType>(col_index, sample_indices[i]);
-  }
+  std::vector<RegType> out_sketch(sketch_size, RegType(0));
+  accumulate_sketch_vector(std::begin(out_sketch), val, row_index, col_index,
+                           num_vertices, sketch_size, seed);
   return out_sketch;
 }
 }  // namespace fwht
@@ -10,7 +10,7 @@
 
 namespace krowkee {
 namespace util {
-enum class cmap_type_t : std::uint8_t { std, boost };
+enum class cmap_type_t : std::uint8_t { std, boost, staging, hash };
 
 cmap_type_t get_cmap_type(char *arg) {
   if (strcmp(arg, "std") == 0) {
@@ -19,6 +19,10 @@ cmap_type_t get_cmap_type(char *arg) {
   } else if (strcmp(arg, "boost") == 0) {
     return cmap_type_t::boost;
 #endif
+  } else if (strcmp(arg, "staging") == 0) {
+    return cmap_type_t::staging;
+  } else if (strcmp(arg, "hash") == 0) {
+    return cmap_type_t::hash;
   } else {
     std::stringstream ss;
     ss << "error: requested map type " << arg << " is not supported !";
@@ -0,0 +1,312 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_UTIL_COUNTERS_HPP
+#define _KROWKEE_UTIL_COUNTERS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+/**
+ * Hot-path instrumentation.
+ *
+ * Defining `KROWKEE_ENABLE_COUNTERS` (the `KROWKEE_ENABLE_COUNTERS` CMake
+ * option) turns on counters and timers in the compacting maps, Promotable
+ * containers, Sketch insertion and merging, and the messages sent by
+ * krowkee::stream::Distributed. Otherwise `KROWKEE_COUNT` and
+ * `KROWKEE_COUNT_TIME` expand to nothing, and their arguments are never
+ * evaluated.
+ *
+ * Each thread counts into its own block of relaxed atomics, so counting never
+ * contends. `snapshot_counters()` sums the blocks of the live threads and the
+ * totals of the threads that have exited.
+ */
+#if defined(KROWKEE_ENABLE_COUNTERS)
+#define KROWKEE_COUNT(counter, n) \
+  krowkee::util::add_count(krowkee::util::counter_t::counter, (n))
+#define KROWKEE_COUNT_TIME(counter)                            \
+  const krowkee::util::counter_timer _krowkee_timer_##counter( \
+      krowkee::util::counter_t::counter)
+#else
+#define KROWKEE_COUNT(counter, n) ((void)0)
+#define KROWKEE_COUNT_TIME(counter) ((void)0)
+#endif
+
+namespace krowkee {
+namespace util {
+
+#if defined(KROWKEE_ENABLE_COUNTERS)
+constexpr bool counters_enabled = true;
+#else
+constexpr bool counters_enabled = false;
+#endif
+
+/**
+ * The instrumented events. Counters ending in `_ns` accumulate nanoseconds.
+ */
+enum class counter_t : std::size_t {
+  compactions,       /// compacting map compactions
+  compaction_moves,  /// elements moved or written by compactions
+  tombstones,        /// erased elements dropped by compactions and merges
+  compaction_ns,     /// time spent compacting
+  promotions,        /// Promotable sparse to dense promotions
+  demotions,         /// Promotable dense to sparse demotions
+  promotion_ns,      /// time spent promoting and demoting
+  sparse_accesses,   /// Promotable register accesses while sparse
+  dense_accesses,    /// Promotable register accesses while dense
+  sketch_inserts,    /// items inserted into Sketches
+  sketch_merges,     /// Sketch `+=` merges
+  sketch_merge_ns,   /// time spent in Sketch `+=`
+  update_messages,   /// Distributed single-update visitors sent
+  update_bytes,      /// argument bytes of the above
+  batch_messages,    /// Distributed flushed update batches sent
+  batch_bytes,       /// item and multiplicity bytes of the above
+  merge_messages,    /// Distributed packed-sketch merge visitors sent
+  merge_bytes,       /// packed register bytes of the above
+  reduce_messages,   /// Distributed collective reduction messages sent
+  reduce_bytes,      /// packed register bytes of the above
+  num_counters
+};
+
+constexpr std::size_t num_counters = std::size_t(counter_t::num_counters);
+
+inline const char *counter_name(const counter_t counter) {
+  static constexpr std::array<const char *, num_counters> names{
+      "compactions",     "compaction_moves", "tombstones",
+      "compaction_ns",   "promotions",       "demotions",
+      "promotion_ns",    "sparse_accesses",  "dense_accesses",
+      "sketch_inserts",  "sketch_merges",    "sketch_merge_ns",
+      "update_messages", "update_bytes",     "batch_messages",
+      "batch_bytes",     "merge_messages",   "merge_bytes",
+      "reduce_messages", "reduce_bytes"};
+  return names[std::size_t(counter)];
+}
+
+/**
+ * The totals of every counter at some point in time.
+ *
+ * Snapshots add, so that per-rank snapshots can be reduced, and subtract, so
+ * that the events of an interval are the difference of the snapshots taken
+ * at its ends.
+ */
+struct counter_snapshot {
+  std::array<std::uint64_t, num_counters> values{};
+
+  std::uint64_t &operator[](const counter_t counter) {
+    return values[std::size_t(counter)];
+  }
+  std::uint64_t operator[](const counter_t counter) const {
+    return values[std::size_t(counter)];
+  }
+
+  counter_snapshot &operator+=(const counter_snapshot &rhs) {
+    for (std::size_t i(0); i < num_counters; ++i) {
+      values[i] += rhs.values[i];
+    }
+    return *this;
+  }
+
+  friend counter_snapshot operator+(counter_snapshot lhs,
+                                    const counter_snapshot &rhs) {
+    lhs += rhs;
+    return lhs;
+  }
+
+  friend counter_snapshot operator-(counter_snapshot lhs,
+                                    const counter_snapshot &rhs) {
+    for (std::size_t i(0); i < num_counters; ++i) {
+      lhs.values[i] -= rhs.values[i];
+    }
+    return lhs;
+  }
+
+  friend bool operator==(const counter_snapshot &lhs,
+                         const counter_snapshot &rhs) {
+    return lhs.values == rhs.values;
+  }
+
+  friend bool operator!=(const counter_snapshot &lhs,
+                         const counter_snapshot &rhs) {
+    return !operator==(lhs, rhs);
+  }
+
+  /**
+   * Write one `name: value` line per counter.
+   */
+  friend std::ostream &operator<<(std::ostream &os,
+                                  const counter_snapshot &snapshot) {
+    for (std::size_t i(0); i < num_counters; ++i) {
+      os << counter_name(counter_t(i)) << ": " << snapshot.values[i] << "\n";
+    }
+    return os;
+  }
+};
+
+namespace detail {
+
+struct counter_block;
+
+/**
+ * The process-wide list of live thread blocks, and the totals of the threads
+ * that have exited.
+ */
+class counter_registry {
+  std::mutex                    _mutex;
+  std::vector<counter_block *>  _blocks;
+  counter_snapshot              _retired;
+
+ public:
+  static counter_registry &instance() {
+    static counter_registry registry;
+    return registry;
+  }
+
+  inline void attach(counter_block *block);
+  inline void detach(counter_block *block);
+  inline counter_snapshot snapshot();
+  inline void             reset();
+};
+
+struct counter_block {
+  std::array<std::atomic<std::uint64_t>, num_counters> values;
+
+  counter_block() {
+    for (auto &val : values) {
+      val.store(0, std::memory_order_relaxed);
+    }
+    counter_registry::instance().attach(this);
+  }
+  ~counter_block() { counter_registry::instance().detach(this); }
+
+  counter_block(const counter_block &)            = delete;
+  counter_block &operator=(const counter_block &) = delete;
+};
+
+void counter_registry::attach(counter_block *block) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _blocks.push_back(block);
+}
+
+void counter_registry::detach(counter_block *block) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (std::size_t i(0); i < num_counters; ++i) {
+    _retired.values[i] += block->values[i].load(std::memory_order_relaxed);
+  }
+  _blocks.erase(std::find(std::begin(_blocks), std::end(_blocks), block));
+}
+
+counter_snapshot counter_registry::snapshot() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  counter_snapshot            ret(_retired);
+  for (const counter_block *block : _blocks) {
+    for (std::size_t i(0); i < num_counters; ++i) {
+      ret.values[i] += block->values[i].load(std::memory_order_relaxed);
+    }
+  }
+  return ret;
+}
+
+void counter_registry::reset() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _retired = counter_snapshot();
+  for (counter_block *block : _blocks) {
+    for (auto &val : block->values) {
+      val.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+inline counter_block &local_counters() {
+  thread_local counter_block block;
+  return block;
+}
+
+}  // namespace detail
+
+/**
+ * Add `n` to the calling thread's `counter`.
+ *
+ * Only the owning thread writes its block, so a relaxed load and store
+ * suffices.
+ */
+inline void add_count(const counter_t counter, const std::uint64_t n = 1) {
+  std::atomic<std::uint64_t> &val(
+      detail::local_counters().values[std::size_t(counter)]);
+  val.store(val.load(std::memory_order_relaxed) + n,
+            std::memory_order_relaxed);
+}
+
+/**
+ * The totals of every thread of this process.
+ */
+inline counter_snapshot snapshot_counters() {
+  return detail::counter_registry::instance().snapshot();
+}
+
+/**
+ * Zero every counter. Counts made concurrently by other threads may be lost,
+ * so call this while no other thread is counting.
+ */
+inline void reset_counters() { detail::counter_registry::instance().reset(); }
+
+/**
+ * Sum `local` over every rank of `comm`. Collective.
+ *
+ * @tparam Comm a communicator providing `all_reduce(value, op)`, such as
+ *     `ygm::comm`.
+ */
+template <typename Comm>
+counter_snapshot all_reduce_counters(Comm                   &comm,
+                                     const counter_snapshot &local) {
+  const std::vector<std::uint64_t> values(comm.all_reduce(
+      std::vector<std::uint64_t>(std::begin(local.values),
+                                 std::end(local.values)),
+      [](const std::vector<std::uint64_t> &lhs,
+         const std::vector<std::uint64_t> &rhs) {
+        std::vector<std::uint64_t> ret(lhs);
+        for (std::size_t i(0); i < ret.size(); ++i) {
+          ret[i] += rhs[i];
+        }
+        return ret;
+      }));
+  counter_snapshot ret;
+  std::copy(std::begin(values), std::end(values), std::begin(ret.values));
+  return ret;
+}
+
+/**
+ * Adds the nanoseconds between its construction and destruction to a
+ * counter.
+ */
+class counter_timer {
+  typedef std::chrono::steady_clock timer_clock_t;
+
+  counter_t                 _counter;
+  timer_clock_t::time_point _start;
+
+ public:
+  counter_timer(const counter_t counter)
+      : _counter(counter), _start(timer_clock_t::now()) {}
+
+  ~counter_timer() {
+    add_count(_counter, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            timer_clock_t::now() - _start)
+                            .count());
+  }
+
+  counter_timer(const counter_timer &)            = delete;
+  counter_timer &operator=(const counter_timer &) = delete;
+};
+
+}  // namespace util
+}  // namespace krowkee
+
+#endif
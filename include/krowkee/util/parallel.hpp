@@ -0,0 +1,158 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_UTIL_PARALLEL_HPP
+#define _KROWKEE_UTIL_PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace krowkee {
+namespace util {
+
+/**
+ * Resolve a requested thread count.
+ *
+ * @param num_threads the requested number of threads. `0` means one per
+ *     hardware thread.
+ */
+inline std::size_t resolve_num_threads(const std::size_t num_threads) {
+  if (num_threads > 0) {
+    return num_threads;
+  }
+  return std::max(std::size_t(std::thread::hardware_concurrency()),
+                  std::size_t(1));
+}
+
+/**
+ * Split `[begin, end)` into at most `num_threads` contiguous chunks of at
+ * least `grain` indices and call `func(chunk_begin, chunk_end)` on each chunk
+ * from its own thread.
+ *
+ * The calling thread executes the first chunk. Runs serially if only one
+ * chunk results. The first exception thrown by any chunk is rethrown after
+ * all threads are joined.
+ *
+ * @tparam Func callable with signature `void(std::size_t, std::size_t)`.
+ *
+ * @param begin the first index.
+ * @param end one past the last index.
+ * @param num_threads the maximum number of threads. `0` means one per
+ *     hardware thread.
+ * @param func the chunk kernel.
+ * @param grain the minimum number of indices per chunk.
+ */
+template <typename Func>
+void parallel_for(const std::size_t begin, const std::size_t end,
+                  const std::size_t num_threads, const Func &func,
+                  const std::size_t grain = 1) {
+  if (end <= begin) {
+    return;
+  }
+  const std::size_t count(end - begin);
+  const std::size_t max_chunks(
+      std::max(count / std::max(grain, std::size_t(1)), std::size_t(1)));
+  const std::size_t num_chunks(
+      std::min(resolve_num_threads(num_threads), max_chunks));
+  if (num_chunks == 1) {
+    func(begin, end);
+    return;
+  }
+  const std::size_t               chunk_size((count + num_chunks - 1) /
+                                             num_chunks);
+  std::vector<std::thread>        threads;
+  std::vector<std::exception_ptr> errors(num_chunks);
+  threads.reserve(num_chunks - 1);
+  for (std::size_t chunk(1); chunk < num_chunks; ++chunk) {
+    const std::size_t chunk_begin(begin + chunk * chunk_size);
+    const std::size_t chunk_end(std::min(chunk_begin + chunk_size, end));
+    if (chunk_begin >= chunk_end) {
+      break;
+    }
+    threads.emplace_back([&func, &errors, chunk, chunk_begin, chunk_end]() {
+      try {
+        func(chunk_begin, chunk_end);
+      } catch (...) {
+        errors[chunk] = std::current_exception();
+      }
+    });
+  }
+  try {
+    func(begin, std::min(begin + chunk_size, end));
+  } catch (...) {
+    errors[0] = std::current_exception();
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  for (const std::exception_ptr &error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+/**
+ * Call `func(i)` for every `i` in `[0, weights.size())` from at most
+ * `num_threads` threads, balancing the load by the estimated cost
+ * `weights[i]` of each call.
+ *
+ * Indices are claimed heaviest first from a shared counter, so that threads
+ * finishing early take over the remaining work and a few heavy calls started
+ * first do not leave the other threads idle at the end. The first exception
+ * thrown by any call is rethrown after all threads are joined.
+ *
+ * @tparam Func callable with signature `void(std::size_t)`.
+ *
+ * @param weights the estimated cost of each call.
+ * @param num_threads the maximum number of threads. `0` means one per
+ *     hardware thread.
+ * @param func the kernel.
+ */
+template <typename Func>
+void parallel_for_weighted(const std::vector<std::size_t> &weights,
+                           const std::size_t num_threads, const Func &func) {
+  const std::size_t count(weights.size());
+  if (count == 0) {
+    return;
+  }
+  std::vector<std::size_t> order(count);
+  std::iota(std::begin(order), std::end(order), std::size_t(0));
+  std::stable_sort(std::begin(order), std::end(order),
+                   [&weights](const std::size_t lhs, const std::size_t rhs) {
+                     return weights[lhs] > weights[rhs];
+                   });
+  std::atomic<std::size_t> next(0);
+  const std::size_t workers(std::min(resolve_num_threads(num_threads), count));
+  // each worker claims items from `next` rather than its own range
+  parallel_for(0, workers, workers, [&](const std::size_t, const std::size_t) {
+    for (std::size_t pos(next.fetch_add(1)); pos < count;
+         pos = next.fetch_add(1)) {
+      func(order[pos]);
+    }
+  });
+}
+
+/**
+ * Execution policy requesting that a bulk operation, such as compacting or
+ * merging every sketch of a collection, run on up to `num_threads` threads.
+ * `0` means one per hardware thread.
+ */
+struct parallel_policy {
+  std::size_t num_threads = 0;
+};
+
+/// run bulk operations on every hardware thread
+inline constexpr parallel_policy par{};
+
+}  // namespace util
+}  // namespace krowkee
+
+#endif
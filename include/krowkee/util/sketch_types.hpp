@@ -14,7 +14,11 @@ enum class sketch_type_t : std::uint8_t {
   cst,
   fwht,
   sparse_cst,
-  promotable_cst
+  soa_sparse_cst,
+  promotable_cst,
+  multirow_cst,
+  widening_cst,
+  widening_promotable_cst
 };
 
 sketch_type_t get_sketch_type(char *arg) {
@@ -22,10 +26,18 @@ sketch_type_t get_sketch_type(char *arg) {
     return sketch_type_t::cst;
   } else if (strcmp(arg, "sparse_cst") == 0) {
     return sketch_type_t::sparse_cst;
+  } else if (strcmp(arg, "soa_sparse_cst") == 0) {
+    return sketch_type_t::soa_sparse_cst;
   } else if (strcmp(arg, "fwht") == 0) {
     return sketch_type_t::fwht;
   } else if (strcmp(arg, "promotable_cst") == 0) {
     return sketch_type_t::promotable_cst;
+  } else if (strcmp(arg, "multirow_cst") == 0) {
+    return sketch_type_t::multirow_cst;
+  } else if (strcmp(arg, "widening_cst") == 0) {
+    return sketch_type_t::widening_cst;
+  } else if (strcmp(arg, "widening_promotable_cst") == 0) {
+    return sketch_type_t::widening_promotable_cst;
   } else {
     std::stringstream ss;
     ss << "error: requested sketch type " << arg << " is not supported!";
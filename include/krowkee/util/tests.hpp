@@ -7,6 +7,7 @@
 #define _KROWKEE_UTIL_TESTS_HPP
 
 #include <krowkee/util/check.hpp>
+#include <krowkee/util/wire.hpp>
 
 #include <algorithm>
 #include <chrono>
@@ -57,6 +58,28 @@ struct make_shared_functor_t {
   static constexpr std::string name() { return "std::shared_ptr"; }
 };
 
+/**
+ * Write `obj` in the wire format.
+ */
+template <typename T>
+krowkee::util::wire_bytes_t wire_pack(const T &obj) {
+  krowkee::util::wire_writer writer;
+  obj.pack(writer);
+  return writer.release();
+}
+
+/**
+ * Read `obj` from wire format `bytes`.
+ *
+ * @return whether `obj` consumed all of `bytes`.
+ */
+template <typename T>
+bool wire_unpack(const krowkee::util::wire_bytes_t &bytes, T &obj) {
+  krowkee::util::wire_reader reader(bytes);
+  obj.unpack(reader);
+  return reader.empty();
+}
+
 // See Knuth TAOCP vol 2, 3rd edition, page 232
 class online_statistics {
  public:
@@ -0,0 +1,477 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#ifndef _KROWKEE_UTIL_WIRE_HPP
+#define _KROWKEE_UTIL_WIRE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace krowkee {
+namespace util {
+
+/**
+ * Compact byte encoding of sketch registers for messages between ranks.
+ *
+ * Sketches are packed with `pack(wire_writer &)` and unpacked with
+ * `unpack(wire_reader &)`, which each container implements for its own
+ * layout. Only register contents are encoded. Construction parameters and
+ * functor handles are not, so a message must be unpacked into an object
+ * constructed with the sender's parameters.
+ *
+ * Unsigned integers are written as LEB128 varints and signed integers are
+ * zigzag encoded first, so that small registers of either sign take a byte.
+ * Register arrays are bit-packed at the width of their widest register, or
+ * written as runs of nonzero registers, when either is smaller than their
+ * varint encoding. Sorted sparse registers write the differences between
+ * consecutive indices. Floating point values are written verbatim.
+ */
+typedef std::vector<std::uint8_t> wire_bytes_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Scalar Encodings
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+constexpr std::uint64_t zigzag_encode(const T val) {
+  if constexpr (std::is_signed_v<T>) {
+    const std::int64_t wide(val);
+    return (std::uint64_t(wide) << 1) ^ std::uint64_t(wide >> 63);
+  } else {
+    return std::uint64_t(val);
+  }
+}
+
+template <typename T>
+constexpr T zigzag_decode(const std::uint64_t val) {
+  if constexpr (std::is_signed_v<T>) {
+    return T(std::int64_t(val >> 1) ^ -std::int64_t(val & 1));
+  } else {
+    return T(val);
+  }
+}
+
+/**
+ * Number of bytes in the varint encoding of `val`.
+ */
+constexpr std::size_t varint_size(std::uint64_t val) {
+  std::size_t ret(1);
+  while (val >= 0x80) {
+    val >>= 7;
+    ++ret;
+  }
+  return ret;
+}
+
+/**
+ * Number of bits needed to represent `val`.
+ */
+constexpr std::size_t bit_width(std::uint64_t val) {
+  std::size_t ret(0);
+  while (val > 0) {
+    val >>= 1;
+    ++ret;
+  }
+  return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Writer
+////////////////////////////////////////////////////////////////////////////////
+
+class wire_writer {
+ public:
+  /// layouts of `put_array`
+  enum : std::uint8_t {
+    varint_array = 0,
+    packed_array = 1,
+    raw_array    = 2,
+    run_array    = 3
+  };
+
+ private:
+  wire_bytes_t _bytes;
+
+ public:
+  wire_writer() {}
+
+  inline void put_varint(std::uint64_t val) {
+    while (val >= 0x80) {
+      _bytes.push_back(std::uint8_t(val) | 0x80);
+      val >>= 7;
+    }
+    _bytes.push_back(std::uint8_t(val));
+  }
+
+  /**
+   * Write a scalar. Integers are (zigzag) varints, bools a single byte, and
+   * floating point values their raw bytes.
+   */
+  template <typename T>
+  inline void put(const T val) {
+    if constexpr (std::is_floating_point_v<T>) {
+      put_raw(&val, sizeof(T));
+    } else {
+      put_varint(zigzag_encode(val));
+    }
+  }
+
+  inline void put_raw(const void *data, const std::size_t size) {
+    const std::uint8_t *begin(static_cast<const std::uint8_t *>(data));
+    _bytes.insert(std::end(_bytes), begin, begin + size);
+  }
+
+  /**
+   * Write a row identifier, either an integer or a std::string.
+   */
+  template <typename T>
+  inline void put_key(const T &key) {
+    if constexpr (std::is_same_v<T, std::string>) {
+      put_varint(key.size());
+      put_raw(key.data(), key.size());
+    } else {
+      put(key);
+    }
+  }
+
+  /**
+   * Write `size` values, choosing the smallest of the varint, bit-packed and
+   * nonzero run layouts for integers.
+   *
+   * The run layout writes the offset and length of each run of nonzero
+   * values followed by its varints, so that mostly-zero arrays such as the
+   * registers of a sparsely updated Dense sketch cost only their nonzero
+   * ranges.
+   */
+  template <typename T>
+  void put_array(const T *values, const std::size_t size) {
+    put_varint(size);
+    if constexpr (std::is_floating_point_v<T>) {
+      _bytes.push_back(raw_array);
+      put_raw(values, size * sizeof(T));
+    } else {
+      std::size_t   varint_bytes(0);
+      std::uint64_t widest(0);
+      std::size_t   run_bytes(0);
+      std::size_t   num_runs(0);
+      std::size_t   run_begin(0);
+      std::size_t   run_end(0);
+      for (std::size_t i(0); i < size; ++i) {
+        const std::uint64_t code(zigzag_encode(values[i]));
+        varint_bytes += varint_size(code);
+        widest |= code;
+        if (code != 0) {
+          if (num_runs == 0 || i != run_end) {
+            if (num_runs > 0) {
+              run_bytes += varint_size(run_end - run_begin);
+            }
+            run_bytes += varint_size(i - run_end);
+            run_begin = i;
+            ++num_runs;
+          }
+          run_end = i + 1;
+          run_bytes += varint_size(code);
+        }
+      }
+      if (num_runs > 0) {
+        run_bytes += varint_size(run_end - run_begin);
+      }
+      run_bytes += varint_size(num_runs);
+      const std::size_t bits(bit_width(widest));
+      const std::size_t packed_bytes((size * bits + 7) / 8 + 1);
+      if (run_bytes < varint_bytes && run_bytes < packed_bytes) {
+        _bytes.push_back(run_array);
+        _put_runs(values, size, num_runs);
+      } else if (packed_bytes < varint_bytes) {
+        _bytes.push_back(packed_array);
+        _bytes.push_back(std::uint8_t(bits));
+        _put_packed(values, size, bits);
+      } else {
+        _bytes.push_back(varint_array);
+        for (std::size_t i(0); i < size; ++i) {
+          put_varint(zigzag_encode(values[i]));
+        }
+      }
+    }
+  }
+
+  /**
+   * Write the `(index, value)` pairs of `[first, last)`, which must be
+   * sorted by index, as index deltas interleaved with values.
+   */
+  template <typename Iterator>
+  void put_sorted_pairs(Iterator first, const Iterator last,
+                        const std::size_t size) {
+    put_varint(size);
+    std::uint64_t prev(0);
+    for (; first != last; ++first) {
+      const std::uint64_t index(first->first);
+      put_varint(index - prev);
+      put(first->second);
+      prev = index;
+    }
+  }
+
+  inline const wire_bytes_t &bytes() const { return _bytes; }
+
+  inline wire_bytes_t release() { return std::move(_bytes); }
+
+  inline std::size_t size() const { return _bytes.size(); }
+
+ private:
+  template <typename T>
+  void _put_runs(const T *values, const std::size_t size,
+                 const std::size_t num_runs) {
+    put_varint(num_runs);
+    std::size_t i(0);
+    std::size_t prev_end(0);
+    while (i < size) {
+      if (values[i] == 0) {
+        ++i;
+        continue;
+      }
+      std::size_t end(i + 1);
+      while (end < size && values[end] != 0) {
+        ++end;
+      }
+      put_varint(i - prev_end);
+      put_varint(end - i);
+      for (; i < end; ++i) {
+        put_varint(zigzag_encode(values[i]));
+      }
+      prev_end = end;
+    }
+  }
+
+  template <typename T>
+  void _put_packed(const T *values, const std::size_t size,
+                   const std::size_t bits) {
+    std::uint64_t acc(0);
+    std::size_t   acc_bits(0);
+    for (std::size_t i(0); i < size; ++i) {
+      const std::uint64_t code(zigzag_encode(values[i]));
+      std::size_t         done(0);
+      while (done < bits) {
+        const std::size_t take(std::min(bits - done, 8 - acc_bits));
+        acc |= ((code >> done) & ((std::uint64_t(1) << take) - 1)) << acc_bits;
+        acc_bits += take;
+        done += take;
+        if (acc_bits == 8) {
+          _bytes.push_back(std::uint8_t(acc));
+          acc      = 0;
+          acc_bits = 0;
+        }
+      }
+    }
+    if (acc_bits > 0) {
+      _bytes.push_back(std::uint8_t(acc));
+    }
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Reader
+////////////////////////////////////////////////////////////////////////////////
+
+class wire_reader {
+  const std::uint8_t *_pos;
+  const std::uint8_t *_end;
+
+ public:
+  wire_reader(const wire_bytes_t &bytes)
+      : _pos(bytes.data()), _end(bytes.data() + bytes.size()) {}
+
+  wire_reader(const std::uint8_t *data, const std::size_t size)
+      : _pos(data), _end(data + size) {}
+
+  /**
+   * @throws std::out_of_range if the message is truncated or malformed.
+   */
+  inline std::uint64_t get_varint() {
+    std::uint64_t ret(0);
+    for (std::size_t shift(0); shift < 64; shift += 7) {
+      const std::uint8_t byte(_next());
+      ret |= std::uint64_t(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return ret;
+      }
+    }
+    throw std::out_of_range("error: malformed varint in wire message!");
+  }
+
+  template <typename T>
+  inline T get() {
+    if constexpr (std::is_floating_point_v<T>) {
+      T ret;
+      get_raw(&ret, sizeof(T));
+      return ret;
+    } else {
+      return zigzag_decode<T>(get_varint());
+    }
+  }
+
+  inline void get_raw(void *data, const std::size_t size) {
+    _require(size);
+    std::memcpy(data, _pos, size);
+    _pos += size;
+  }
+
+  /**
+   * Read a row identifier written by `wire_writer::put_key`.
+   */
+  template <typename T>
+  inline T get_key() {
+    if constexpr (std::is_same_v<T, std::string>) {
+      const std::size_t size(get_varint());
+      _require(size);
+      T ret(reinterpret_cast<const char *>(_pos), size);
+      _pos += size;
+      return ret;
+    } else {
+      return get<T>();
+    }
+  }
+
+  /**
+   * Read an array written by `wire_writer::put_array`.
+   *
+   * The size is checked before the array is allocated. Layouts that store
+   * every value must fit it in the remaining bytes, while zero-width and run
+   * layouts, which encode any number of zeros, are bounded only by
+   * `max_size`.
+   *
+   * @param max_size the largest array the caller accepts.
+   *
+   * @throws std::out_of_range if the message is truncated or malformed, or
+   *     holds more than `max_size` values.
+   */
+  template <typename T>
+  std::vector<T> get_array(
+      const std::size_t max_size = std::numeric_limits<std::size_t>::max()) {
+    const std::size_t  size(get_varint());
+    const std::uint8_t layout(_next());
+    if (size > max_size) {
+      std::stringstream ss;
+      ss << "error: wire array of " << size << " values exceeds " << max_size
+         << "!";
+      throw std::out_of_range(ss.str());
+    }
+    std::size_t bits(0);
+    if (layout == wire_writer::packed_array) {
+      bits = _next();
+      if (bits > 64) {
+        throw std::out_of_range("error: bad bit width in wire message!");
+      }
+    } else if (layout == wire_writer::raw_array) {
+      bits = 8 * sizeof(T);
+    } else if (layout == wire_writer::varint_array) {
+      bits = 8;
+    }
+    if (bits > 0 && size > std::size_t(_end - _pos) * 8 / bits) {
+      throw std::out_of_range("error: truncated wire message!");
+    }
+    std::vector<T> ret(size);
+    if (layout == wire_writer::raw_array) {
+      if constexpr (std::is_floating_point_v<T>) {
+        get_raw(ret.data(), size * sizeof(T));
+        return ret;
+      }
+    } else if (layout == wire_writer::varint_array) {
+      for (std::size_t i(0); i < size; ++i) {
+        ret[i] = get<T>();
+      }
+      return ret;
+    } else if (layout == wire_writer::packed_array) {
+      _get_packed(ret.data(), size, bits);
+      return ret;
+    } else if (layout == wire_writer::run_array) {
+      _get_runs(ret.data(), size);
+      return ret;
+    }
+    std::stringstream ss;
+    ss << "error: unexpected array layout " << int(layout)
+       << " in wire message!";
+    throw std::out_of_range(ss.str());
+  }
+
+  /**
+   * Read pairs written by `wire_writer::put_sorted_pairs`, calling
+   * `func(index, value)` on each in index order.
+   */
+  template <typename KeyType, typename ValueType, typename Func>
+  void get_sorted_pairs(const Func &func) {
+    const std::size_t size(get_varint());
+    std::uint64_t     index(0);
+    for (std::size_t i(0); i < size; ++i) {
+      index += get_varint();
+      func(KeyType(index), get<ValueType>());
+    }
+  }
+
+  constexpr bool empty() const { return _pos == _end; }
+
+ private:
+  inline void _require(const std::size_t size) const {
+    if (std::size_t(_end - _pos) < size) {
+      throw std::out_of_range("error: truncated wire message!");
+    }
+  }
+
+  inline std::uint8_t _next() {
+    _require(1);
+    return *_pos++;
+  }
+
+  template <typename T>
+  void _get_runs(T *values, const std::size_t size) {
+    const std::size_t num_runs(get_varint());
+    std::size_t       pos(0);
+    for (std::size_t run(0); run < num_runs; ++run) {
+      const std::size_t gap(get_varint());
+      const std::size_t length(get_varint());
+      if (gap > size - pos || length > size - pos - gap) {
+        throw std::out_of_range("error: bad register run in wire message!");
+      }
+      pos += gap;
+      for (const std::size_t end(pos + length); pos < end; ++pos) {
+        values[pos] = get<T>();
+      }
+    }
+  }
+
+  template <typename T>
+  void _get_packed(T *values, const std::size_t size, const std::size_t bits) {
+    _require((size * bits + 7) / 8);
+    std::size_t bit(0);
+    for (std::size_t i(0); i < size; ++i) {
+      std::uint64_t code(0);
+      std::size_t   done(0);
+      while (done < bits) {
+        const std::size_t offset(bit % 8);
+        const std::size_t take(std::min(bits - done, 8 - offset));
+        code |= (std::uint64_t(_pos[bit / 8] >> offset) &
+                 ((std::uint64_t(1) << take) - 1))
+                << done;
+        done += take;
+        bit += take;
+      }
+      values[i] = zigzag_decode<T>(code);
+    }
+    _pos += (size * bits + 7) / 8;
+  }
+};
+
+}  // namespace util
+}  // namespace krowkee
+
+#endif
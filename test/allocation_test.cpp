@@ -0,0 +1,310 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+#include <krowkee/sketch/interface.hpp>
+#include <krowkee/stream/interface.hpp>
+
+#include <krowkee/hash/util.hpp>
+
+#include <krowkee/util/tests.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Allocation Counting
+////////////////////////////////////////////////////////////////////////////////
+
+/// number of calls to the global operator new
+static std::size_t allocation_count(0);
+
+void *operator new(std::size_t size) {
+  ++allocation_count;
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+/**
+ * Count the allocations made by `func()`.
+ */
+template <typename Func>
+std::size_t count_allocations(const Func &func) {
+  const std::size_t start(allocation_count);
+  func();
+  return allocation_count - start;
+}
+
+/**
+ * Struct bundling the experiment parameters.
+ */
+struct parameters_t {
+  std::uint64_t count;
+  std::uint64_t range_size;
+  std::size_t   compaction_threshold;
+  std::size_t   promotion_threshold;
+  std::uint64_t seed;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Sketch Moves
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Verify that moving a sketch neither copies nor allocates.
+ */
+template <typename SketchType>
+struct move_check {
+  typedef SketchType              ls_t;
+  typedef typename ls_t::sf_t     sf_t;
+  typedef typename ls_t::sf_ptr_t sf_ptr_t;
+
+  static_assert(std::is_nothrow_move_constructible_v<ls_t> &&
+                    std::is_nothrow_move_assignable_v<ls_t> &&
+                    std::is_nothrow_move_constructible_v<
+                        typename ls_t::container_t>,
+                "sketches should be nothrow movable");
+
+  inline std::string name() const {
+    std::stringstream ss;
+    ss << ls_t::full_name() << " moves";
+    return ss.str();
+  }
+
+  void operator()(const parameters_t &params) const {
+    sf_ptr_t sf_ptr(std::make_shared<sf_t>(params.range_size, params.seed));
+    ls_t ls(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+    for (std::uint64_t i(0); i < params.count; ls.insert(i++)) {
+    }
+    ls.compactify();
+    const ls_t expected(ls);
+    ls_t       other(sf_ptr, params.compaction_threshold,
+                     params.promotion_threshold);
+
+    std::size_t allocations(count_allocations([&]() {
+      ls_t moved(std::move(ls));
+      other = std::move(moved);
+    }));
+    std::cout << "\tallocations per move: " << allocations << std::endl;
+    CHECK_CONDITION(allocations == 0 && other == expected,
+                    "move construction and assignment");
+
+    std::vector<ls_t> sketches;
+    for (std::size_t i(0); i < 16; ++i) {
+      sketches.push_back(expected);
+    }
+    // reallocation moves rather than copies, so only the buffer is allocated
+    allocations = count_allocations([&]() { sketches.reserve(1024); });
+    CHECK_CONDITION(allocations == 1 && sketches.back() == expected,
+                    "vector reallocation");
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Multi Insertion
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Verify that Multi constructs sketches in place, and report allocations per
+ * insert.
+ */
+template <typename MultiType>
+struct insert_allocation_check {
+  typedef MultiType                msk_t;
+  typedef typename msk_t::sf_t     sf_t;
+  typedef typename msk_t::sf_ptr_t sf_ptr_t;
+  typedef typename msk_t::data_t   data_t;
+
+  static_assert(std::is_nothrow_move_constructible_v<data_t> &&
+                    std::is_nothrow_move_assignable_v<data_t> &&
+                    std::is_nothrow_move_constructible_v<msk_t>,
+                "summaries and Multi should be nothrow movable");
+
+  inline std::string name() const {
+    std::stringstream ss;
+    ss << msk_t::full_name() << " insert allocations";
+    return ss.str();
+  }
+
+  void operator()(const parameters_t &params) const {
+    sf_ptr_t sf_ptr(std::make_shared<sf_t>(params.range_size, params.seed));
+    const std::size_t keys(16);
+    msk_t msk(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+
+    // a new key costs the map node and the sketch itself, and nothing more
+    const std::size_t data_allocations(count_allocations([&]() {
+      data_t data(sf_ptr, params.compaction_threshold,
+                  params.promotion_threshold);
+      data.update(1);
+    }));
+    const std::size_t new_key_allocations(
+        count_allocations([&]() { msk.insert(0, 1); }));
+    std::cout << "\tallocations per new key: " << new_key_allocations
+              << std::endl;
+    CHECK_CONDITION(new_key_allocations == data_allocations + 1,
+                    "new key constructed in place");
+
+    // inserts into existing keys allocate only what the sketches themselves
+    // allocate
+    for (std::size_t key(1); key < keys; msk.insert(key++, 1)) {
+    }
+    std::vector<data_t> singles;
+    for (std::size_t key(0); key < keys; ++key) {
+      singles.emplace_back(sf_ptr, params.compaction_threshold,
+                           params.promotion_threshold);
+      singles.back().update(1);
+    }
+    const std::size_t single_allocations(count_allocations([&]() {
+      for (std::uint64_t i(0); i < params.count; ++i) {
+        singles[i % keys].update(i);
+      }
+    }));
+    const std::size_t multi_allocations(count_allocations([&]() {
+      for (std::uint64_t i(0); i < params.count; ++i) {
+        msk.insert(i % keys, i);
+      }
+    }));
+    std::cout << "\tallocations per insert: "
+              << double(multi_allocations) / params.count << std::endl;
+    CHECK_CONDITION(multi_allocations == single_allocations,
+                    "inserts into existing keys do not copy");
+
+    msk.compactify();
+    {
+      msk_t       rhs(sf_ptr, params.compaction_threshold,
+                      params.promotion_threshold);
+      const msk_t expected(msk);
+      const std::size_t allocations(
+          count_allocations([&]() { rhs += std::move(msk); }));
+      CHECK_CONDITION(allocations == 0 && rhs == expected,
+                      "move merge into empty Multi");
+      msk = rhs;
+    }
+    {
+      msk_t rhs(sf_ptr, params.compaction_threshold,
+                params.promotion_threshold);
+      for (std::size_t key(keys); key < 2 * keys; ++key) {
+        rhs.insert(key, key);
+      }
+      rhs.compactify();
+      msk_t expected(msk);
+      expected += rhs;
+      const std::size_t allocations(
+          count_allocations([&]() { msk += std::move(rhs); }));
+      CHECK_CONDITION(allocations == keys && msk == expected,
+                      "move merge allocates only map nodes");
+    }
+    {
+      data_t data(sf_ptr, params.compaction_threshold,
+                  params.promotion_threshold);
+      data.update(7);
+      const std::size_t allocations(count_allocations(
+          [&]() { msk.emplace(2 * keys, std::move(data)); }));
+      CHECK_CONDITION(allocations == 1 && msk[2 * keys].sk.point_query(7) != 0,
+                      "emplace moves the sketch");
+    }
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Pooled Multi Insertion
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Verify that a PooledMulti of fixed-range sketches holds every key in a few
+ * large allocations.
+ */
+template <typename PooledType>
+struct pooled_allocation_check {
+  typedef PooledType                pmsk_t;
+  typedef typename pmsk_t::sf_t     sf_t;
+  typedef typename pmsk_t::sf_ptr_t sf_ptr_t;
+
+  inline std::string name() const {
+    std::stringstream ss;
+    ss << pmsk_t::full_name() << " pooled allocations";
+    return ss.str();
+  }
+
+  void operator()(const parameters_t &params) const {
+    sf_ptr_t sf_ptr(std::make_shared<sf_t>(params.range_size, params.seed));
+    const std::size_t keys(params.count);
+
+    std::size_t allocations(count_allocations([&]() {
+      pmsk_t pooled(sf_ptr, params.compaction_threshold,
+                    params.promotion_threshold);
+      for (std::uint64_t key(0); key < keys; ++key) {
+        pooled.insert(key, key);
+      }
+    }));
+    std::cout << "\tallocations for " << keys << " keys: " << allocations
+              << std::endl;
+    // per doubling, the pool reallocates once and the index its slots and
+    // occupancy bitmap
+    CHECK_CONDITION(allocations <= 3 * krowkee::hash::ceil_log2_64(keys),
+                    "growing pool allocates logarithmically");
+
+    pmsk_t pooled(sf_ptr, params.compaction_threshold,
+                  params.promotion_threshold, keys);
+    allocations = count_allocations([&]() {
+      for (std::uint64_t i(0); i < 4 * keys; ++i) {
+        pooled.insert(i % keys, i);
+      }
+    });
+    CHECK_CONDITION(allocations == 0 && pooled.size() == keys,
+                    "reserved pool does not allocate");
+  }
+};
+
+int main() {
+  parameters_t params{10000, 1024, 10, 256, krowkee::hash::default_seed};
+
+  do_test<move_check<krowkee::sketch::LocalCountSketch<krowkee::sketch::Dense,
+                                                       std::int32_t>>>(params);
+  do_test<move_check<krowkee::sketch::LocalCountSketch<
+      krowkee::sketch::MapSparse32, std::int32_t>>>(params);
+  do_test<move_check<krowkee::sketch::LocalCountSketch<
+      krowkee::sketch::StagingSparse32, std::int32_t>>>(params);
+  do_test<move_check<krowkee::sketch::LocalCountSketch<
+      krowkee::sketch::HashSparse32, std::int32_t>>>(params);
+  do_test<move_check<krowkee::sketch::LocalCountSketch<
+      krowkee::sketch::MapSoASparse32, std::int32_t>>>(params);
+  do_test<move_check<krowkee::sketch::LocalCountSketch<
+      krowkee::sketch::MapPromotable32, std::int32_t>>>(params);
+  do_test<move_check<krowkee::sketch::LocalCountSketch<
+      krowkee::sketch::WideningDense, std::int32_t>>>(params);
+
+  do_test<insert_allocation_check<krowkee::stream::MultiLocalCountSketch<
+      krowkee::sketch::Dense, std::uint64_t, std::int32_t>>>(params);
+  do_test<insert_allocation_check<krowkee::stream::MultiLocalCountSketch<
+      krowkee::sketch::MapSparse32, std::uint64_t, std::int32_t>>>(params);
+  do_test<insert_allocation_check<krowkee::stream::MultiLocalCountSketch<
+      krowkee::sketch::MapPromotable32, std::uint64_t, std::int32_t>>>(params);
+  do_test<insert_allocation_check<
+      krowkee::stream::HeavyHitterMultiLocalMultiRowCountSketch<
+          krowkee::sketch::Dense, std::uint64_t, std::int32_t>>>(params);
+
+  do_test<pooled_allocation_check<
+      krowkee::stream::PooledMultiLocalFixedCountSketch<std::uint64_t,
+                                                        std::int16_t, 1024>>>(
+      params);
+  return 0;
+}
@@ -4,6 +4,9 @@
 // SPDX-License-Identifier: MIT
 
 #include <krowkee/container/compacting_map.hpp>
+#include <krowkee/container/open_hash_map.hpp>
+#include <krowkee/container/soa_compacting_map.hpp>
+#include <krowkee/container/staging_buffer.hpp>
 
 #include <krowkee/hash/util.hpp>
 
@@ -29,7 +32,9 @@
 #include <ctime>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <random>
+#include <set>
 #include <vector>
 
 using cmap_type_t = krowkee::util::cmap_type_t;
@@ -41,6 +46,10 @@ typedef krowkee::container::compacting_map<int, int, boost::container::flat_map>
     cbm_t;
 #endif
 
+typedef krowkee::container::compacting_map<int, int,
+                                           krowkee::container::staging_buffer>
+    cstm_t;
+
 typedef std::map<int, int>  map_t;
 typedef std::pair<int, int> pair_t;
 
@@ -331,6 +340,400 @@ struct copy_check {
   }
 };
 
+/**
+ * The original two-copy compaction, kept as a reference for compactify_check.
+ */
+template <typename MapType>
+void reference_compactify(std::vector<pair_t> &archive,
+                          std::vector<bool> &erased, MapType &dynamic) {
+  if constexpr (krowkee::container::is_staging_buffer<MapType>::value) {
+    dynamic.sort();
+  }
+  std::vector<pair_t> tmp1;
+  tmp1.reserve(archive.size());
+  for (std::size_t i(0); i < archive.size(); ++i) {
+    if (erased[i] == false) {
+      tmp1.push_back(archive[i]);
+    }
+  }
+  std::vector<pair_t> tmp2;
+  tmp2.reserve(tmp1.size() + dynamic.size());
+  std::set_union(std::begin(tmp1), std::end(tmp1), std::begin(dynamic),
+                 std::end(dynamic), std::back_inserter(tmp2),
+                 [](const pair_t &lhs, const pair_t &rhs) {
+                   return lhs.first < rhs.first;
+                 });
+  dynamic.clear();
+  std::swap(archive, tmp2);
+  erased.assign(archive.size(), false);
+}
+
+/**
+ * Verify in-place compaction against a std::map model, and time it against the
+ * reference two-copy compaction on identical workloads.
+ */
+struct compactify_check {
+  const char *name() { return "compactify check"; }
+
+  template <typename MapType>
+  void operator()(MapType &, const parameters_t params) const {
+    typedef typename MapType::map_t dyn_t;
+
+    const std::size_t rounds(64);
+    const std::size_t round_size(std::max(params.count / 16, std::uint32_t(1)));
+    std::mt19937      gen(params.seed);
+    std::uniform_int_distribution<int> key_dist(0, 4 * params.count);
+
+    MapType             cm(round_size + 1);
+    map_t               model;
+    std::vector<pair_t> ref_archive;
+    std::vector<bool>   ref_erased;
+    dyn_t               ref_dynamic;
+    std::int64_t        cm_ns(0);
+    std::int64_t        ref_ns(0);
+    bool                model_success(true);
+    bool                ref_success(true);
+
+    for (std::size_t round(0); round < rounds; ++round) {
+      for (std::size_t i(0); i < round_size; ++i) {
+        const int key(key_dist(gen));
+        if (i % 4 == 3 && model.count(key) > 0) {
+          // erase an archived key through both maps
+          cm.erase(key);
+          model.erase(key);
+          auto itr = std::lower_bound(
+              std::begin(ref_archive), std::end(ref_archive), pair_t{key, 0},
+              [](const pair_t &lhs, const pair_t &rhs) {
+                return lhs.first < rhs.first;
+              });
+          if (itr != std::end(ref_archive) && itr->first == key) {
+            ref_erased[itr - std::begin(ref_archive)] = true;
+          } else {
+            ref_dynamic.erase(key);
+          }
+        } else if (model.count(key) == 0) {
+          cm.insert({key, key});
+          model[key] = key;
+          auto itr   = std::lower_bound(
+              std::begin(ref_archive), std::end(ref_archive), pair_t{key, 0},
+              [](const pair_t &lhs, const pair_t &rhs) {
+                return lhs.first < rhs.first;
+              });
+          if (itr != std::end(ref_archive) && itr->first == key) {
+            itr->second                               = key;
+            ref_erased[itr - std::begin(ref_archive)] = false;
+          } else {
+            ref_dynamic.insert(std::make_pair(key, key));
+          }
+        }
+      }
+      auto cm_start(Clock::now());
+      cm.compactify();
+      auto ref_start(Clock::now());
+      reference_compactify(ref_archive, ref_erased, ref_dynamic);
+      auto end(Clock::now());
+      cm_ns += std::chrono::duration_cast<ns_t>(ref_start - cm_start).count();
+      ref_ns += std::chrono::duration_cast<ns_t>(end - ref_start).count();
+
+      model_success = model_success && cm.size() == model.size() &&
+                      std::equal(std::cbegin(cm), std::cend(cm),
+                                 std::cbegin(model),
+                                 [](const pair_t &lhs, const auto &rhs) {
+                                   return lhs.first == rhs.first &&
+                                          lhs.second == rhs.second;
+                                 });
+      ref_success   = ref_success && cm.size() == ref_archive.size() &&
+                    std::equal(std::cbegin(cm), std::cend(cm),
+                               std::cbegin(ref_archive));
+    }
+    CHECK_CONDITION(model_success, "compactify agrees with std::map");
+    CHECK_CONDITION(ref_success, "compactify agrees with reference compaction");
+    std::cout << "Compacted " << rounds << " rounds of " << round_size
+              << " updates in " << cm_ns << " ns versus reference in " << ref_ns
+              << " ns (" << ((double)ref_ns / (double)std::max(cm_ns, 1l))
+              << " speedup)" << std::endl;
+  }
+};
+
+/**
+ * Verify merge against a std::map model for balanced and skewed right hand
+ * sides, the latter of which take the in-place path. Some ties cancel to zero
+ * and must be dropped.
+ */
+struct merge_check {
+  const char *name() { return "merge check"; }
+
+  template <typename MapType>
+  void operator()(MapType &, const parameters_t params) const {
+    std::mt19937                       gen(params.seed);
+    std::uniform_int_distribution<int> key_dist(0, 4 * params.count);
+    std::uniform_int_distribution<int> val_dist(1, 100);
+
+    const std::size_t lhs_size(params.count);
+    bool              success(true);
+    for (const std::size_t rhs_size :
+         {lhs_size, lhs_size / MapType::in_place_merge_ratio, lhs_size / 64,
+          std::size_t(1), std::size_t(0)}) {
+      MapType lhs(params.thresh);
+      MapType rhs(params.thresh);
+      map_t   model;
+      for (std::size_t i(0); i < lhs_size; ++i) {
+        const int key(key_dist(gen));
+        const int val(val_dist(gen));
+        lhs[key]   = val;
+        model[key] = val;
+      }
+      lhs.compactify();
+      auto lhs_itr(std::begin(model));
+      for (std::size_t i(0); i < rhs_size; ++i) {
+        // every third key ties with, and cancels, a left hand side key
+        int key(key_dist(gen));
+        int val(val_dist(gen));
+        if (i % 3 == 0 && lhs_itr != std::end(model)) {
+          key = lhs_itr->first;
+          val = -lhs_itr->second;
+          for (int step(0); step < 3 && lhs_itr != std::end(model); ++step) {
+            ++lhs_itr;
+          }
+        }
+        if (rhs.at(key, 0) != 0) {
+          continue;
+        }
+        rhs[key] = val;
+      }
+      rhs.compactify();
+      for (const auto &pair : rhs) {
+        const int merged(model[pair.first] + pair.second);
+        if (merged == 0) {
+          model.erase(pair.first);
+        } else {
+          model[pair.first] = merged;
+        }
+      }
+      lhs.merge(rhs, std::plus<int>());
+      success = success && lhs.is_compact() && lhs.size() == model.size() &&
+                std::equal(std::cbegin(lhs), std::cend(lhs),
+                           std::cbegin(model),
+                           [](const pair_t &lhs, const auto &rhs) {
+                             return lhs.first == rhs.first &&
+                                    lhs.second == rhs.second;
+                           });
+    }
+    CHECK_CONDITION(success, "merge agrees with std::map");
+  }
+};
+
+/**
+ * Verify sort_by_key against std::sort on both sides of the radix sort cutoff,
+ * for signed and unsigned keys.
+ */
+struct sort_by_key_check {
+  const char *name() { return "sort by key check"; }
+
+  template <typename KeyType>
+  bool check_sort(const std::size_t size, std::mt19937 &gen) const {
+    typedef std::pair<KeyType, int> kv_t;
+    std::uniform_int_distribution<KeyType> key_dist(
+        std::numeric_limits<KeyType>::min(),
+        std::numeric_limits<KeyType>::max());
+    std::set<KeyType> keys;
+    std::vector<kv_t> data;
+    std::vector<kv_t> scratch;
+    while (keys.size() < size) {
+      // compacting_map never stages duplicate keys
+      const KeyType key(key_dist(gen));
+      if (keys.insert(key).second == true) {
+        data.push_back({key, int(data.size())});
+      }
+    }
+    std::vector<kv_t> expected(data);
+    std::sort(std::begin(expected), std::end(expected),
+              [](const kv_t &lhs, const kv_t &rhs) {
+                return lhs.first < rhs.first;
+              });
+    krowkee::container::sort_by_key(data, scratch);
+    return data == expected;
+  }
+
+  void operator()(const parameters_t params) const {
+    std::mt19937 gen(params.seed);
+    bool         success(true);
+    for (const std::size_t size :
+         {std::size_t(0), std::size_t(1), std::size_t(17),
+          krowkee::container::radix_sort_cutoff, std::size_t(params.count)}) {
+      success = success && check_sort<int>(size, gen) &&
+                check_sort<std::uint32_t>(size, gen) &&
+                check_sort<std::int64_t>(size, gen) &&
+                check_sort<std::uint16_t>(size, gen);
+    }
+    CHECK_CONDITION(success, "sort_by_key agrees with std::sort");
+  }
+};
+
+/**
+ * Drive a soa_compacting_map and a compacting_map through the same random
+ * accesses, erasures, compactions and merges, and verify that they agree.
+ */
+struct soa_check {
+  const char *name() { return "soa_compacting_map check"; }
+
+  template <template <typename, typename> class MapType>
+  bool check_map_type(const parameters_t &params) const {
+    typedef krowkee::container::soa_compacting_map<int, int, MapType> soa_t;
+    typedef krowkee::container::compacting_map<int, int, MapType>     ref_t;
+
+    std::mt19937                       gen(params.seed);
+    std::uniform_int_distribution<int> key_dist(0, 2 * params.count);
+    std::uniform_int_distribution<int> val_dist(-3, 3);
+
+    auto agree = [](const soa_t &soa, const ref_t &ref) {
+      return soa.size() == ref.size() &&
+             std::equal(std::cbegin(soa), std::cend(soa), std::cbegin(ref),
+                        [](const auto &lhs, const pair_t &rhs) {
+                          return lhs.first == rhs.first &&
+                                 lhs.second == rhs.second;
+                        });
+    };
+
+    // accumulate signed updates, erasing registers that reach zero
+    auto update = [&](soa_t &soa, ref_t &ref, const std::size_t count) {
+      for (std::size_t i(0); i < count; ++i) {
+        const int key(key_dist(gen));
+        const int val(val_dist(gen));
+        int      &soa_reg(soa[key]);
+        int      &ref_reg(ref[key]);
+        soa_reg += val;
+        ref_reg += val;
+        if (soa_reg == 0) {
+          soa.erase(key);
+          ref.erase(key);
+        }
+      }
+    };
+
+    bool  success(true);
+    soa_t soa(params.thresh);
+    ref_t ref(params.thresh);
+    update(soa, ref, params.count);
+    for (int key(0); key < 2 * int(params.count); key += 7) {
+      success = success && soa.at(key, 0) == ref.at(key, 0);
+    }
+    soa.compactify();
+    ref.compactify();
+    success = success && agree(soa, ref);
+
+    for (const std::size_t rhs_count :
+         {std::size_t(params.count), std::size_t(params.count / 32)}) {
+      soa_t soa_rhs(params.thresh);
+      ref_t ref_rhs(params.thresh);
+      update(soa_rhs, ref_rhs, rhs_count);
+      soa_rhs.compactify();
+      ref_rhs.compactify();
+      soa.merge(soa_rhs, std::plus<int>());
+      ref.merge(ref_rhs, std::plus<int>());
+      success = success && soa.is_compact() && agree(soa, ref);
+    }
+    return success;
+  }
+
+  void operator()(const parameters_t params) const {
+    bool success(check_map_type<std::map>(params));
+    CHECK_CONDITION(success, "agrees with compacting_map using std::map");
+#if __has_include(<boost/container/flat_map.hpp>)
+    success = check_map_type<boost::container::flat_map>(params);
+    CHECK_CONDITION(success, "agrees with compacting_map using flat_map");
+#endif
+    success = check_map_type<krowkee::container::staging_buffer>(params);
+    CHECK_CONDITION(success, "agrees with compacting_map using staging_buffer");
+
+    krowkee::container::soa_compacting_map<std::uint32_t, std::int8_t> narrow(
+        params.thresh);
+    for (std::uint32_t key(0); key < params.count; ++key) {
+      narrow[key] = 1;
+    }
+    narrow.compactify();
+    const bool packed(narrow.archive_bytes() == params.count * 5);
+    CHECK_CONDITION(packed, "uint32_t keys and int8_t values use 5 bytes each");
+  }
+};
+
+struct open_hash_map_check {
+  const char *name() { return "open_hash_map check"; }
+
+  void operator()(const parameters_t params) const {
+    typedef krowkee::container::open_hash_map<std::uint32_t, int> ohm_t;
+    typedef std::map<std::uint32_t, int>                          ref_t;
+
+    std::mt19937                                 gen(params.seed);
+    std::uniform_int_distribution<std::uint32_t> key_dist(0, 2 * params.count);
+    std::uniform_int_distribution<int>           val_dist(-3, 3);
+
+    auto agree = [](const ohm_t &ohm, const ref_t &ref) {
+      const typename ohm_t::vec_t sorted(ohm.sorted());
+      return ohm.size() == ref.size() &&
+             std::equal(std::cbegin(sorted), std::cend(sorted),
+                        std::cbegin(ref),
+                        [](const auto &lhs, const auto &rhs) {
+                          return lhs.first == rhs.first &&
+                                 lhs.second == rhs.second;
+                        });
+    };
+
+    // accumulate signed updates, erasing registers that reach zero
+    auto update = [&](ohm_t &ohm, ref_t &ref, const std::size_t count) {
+      for (std::size_t i(0); i < count; ++i) {
+        const std::uint32_t key(key_dist(gen));
+        const int           val(val_dist(gen));
+        int                &ohm_reg(ohm[key]);
+        int                &ref_reg(ref[key]);
+        ohm_reg += val;
+        ref_reg += val;
+        if (ohm_reg == 0) {
+          ohm.erase(key);
+          ref.erase(key);
+        }
+      }
+    };
+
+    ohm_t ohm(params.thresh);
+    ref_t ref;
+    update(ohm, ref, 4 * params.count);
+    bool success(agree(ohm, ref));
+    for (std::uint32_t key(0); key < 2 * params.count; key += 7) {
+      const auto iter(ref.find(key));
+      success = success && ohm.at(key, 0) == (iter == std::end(ref)
+                                                  ? 0
+                                                  : iter->second);
+    }
+    CHECK_CONDITION(success, "updates and erasures agree with std::map");
+
+    ohm_t ohm_rhs(params.thresh);
+    ref_t ref_rhs;
+    update(ohm_rhs, ref_rhs, params.count);
+    ohm.merge(ohm_rhs, std::plus<int>());
+    for (const auto &pair : ref_rhs) {
+      int &reg(ref[pair.first]);
+      reg += pair.second;
+      if (reg == 0) {
+        ref.erase(pair.first);
+      }
+    }
+    success = agree(ohm, ref);
+    CHECK_CONDITION(success, "merge agrees with std::map");
+
+    ohm_t rebuilt(4 * ohm.capacity());
+    for (const auto &pair : ohm.sorted()) {
+      rebuilt.insert(pair);
+    }
+    success = (rebuilt == ohm) && rebuilt.capacity() != ohm.capacity();
+    CHECK_CONDITION(success, "equality ignores table layout");
+
+    const bool under_load(ohm.size() * ohm_t::max_load_denominator <=
+                          ohm.capacity() * ohm_t::max_load_numerator);
+    CHECK_CONDITION(under_load, "load stays below maximum");
+  }
+};
+
 #if __has_include(<cereal/cereal.hpp>)
 template <typename StreamType, typename ArchiveType, typename MapType>
 void check_throws_uncompacted_archive(const MapType &cm) {
@@ -378,6 +781,8 @@ void do_experiment(const parameters_t params) {
   do_test<erase_check>(cm, params);
   do_test<const_funcs_check>(cm, params);
   do_test<copy_check>(cm, params);
+  do_test<compactify_check>(cm, params);
+  do_test<merge_check>(cm, params);
 #if __has_include(<cereal/cereal.hpp>)
   do_test<serialize_check>(cm, params);
 #endif
@@ -387,7 +792,7 @@ void do_experiment(const parameters_t params) {
 void print_help(char *exe_name) {
   std::cout << "\nusage:  " << exe_name << "\n"
             << "\t-c, --count <int>     - number of insertions\n"
-            << "\t-m, --map-type <str>  - map type (std, boost)\n"
+            << "\t-m, --map-type <str>  - map type (std, boost, staging)\n"
             << "\t-s, --seed <int>      - random seed\n"
             << "\t-t, --thresh <int>    - compaction threshold\n"
             << "\t-v, --verbose         - print additional debug information.\n"
@@ -471,6 +876,8 @@ int main(int argc, char **argv) {
   cmap_type_t   cmap_type(cmap_type_t::std);
   bool          verbose(false);
 
+  bool          do_all(argc == 1);
+
   parameters_t params{
       get_random_vector(count, seed), count, thresh, seed, cmap_type, verbose};
 
@@ -478,12 +885,24 @@ int main(int argc, char **argv) {
 
   params.to_insert = get_random_vector(params.count, params.seed);
 
-  if (params.cmap_type == cmap_type_t::std) {
+  do_test<sort_by_key_check>(params);
+  do_test<soa_check>(params);
+  do_test<open_hash_map_check>(params);
+
+  if (do_all == true) {
+    do_experiment<csm_t>(params);
+#if __has_include(<boost/container/flat_map.hpp>)
+    do_experiment<cbm_t>(params);
+#endif
+    do_experiment<cstm_t>(params);
+  } else if (params.cmap_type == cmap_type_t::std) {
     do_experiment<csm_t>(params);
 #if __has_include(<boost/container/flat_map.hpp>)
   } else if (params.cmap_type == cmap_type_t::boost) {
     do_experiment<cbm_t>(params);
 #endif
+  } else if (params.cmap_type == cmap_type_t::staging) {
+    do_experiment<cstm_t>(params);
   }
   return 0;
 }
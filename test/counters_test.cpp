@@ -0,0 +1,246 @@
+// Copyright 2021-2022 Lawrence Livermore National Security, LLC and other
+// krowkee Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: MIT
+
+// The counters are exercised whether or not the library is configured with
+// them.
+#ifndef KROWKEE_ENABLE_COUNTERS
+#define KROWKEE_ENABLE_COUNTERS
+#endif
+
+#include <krowkee/container/compacting_map.hpp>
+#include <krowkee/sketch/interface.hpp>
+
+#include <krowkee/hash/util.hpp>
+
+#include <krowkee/util/counters.hpp>
+#include <krowkee/util/parallel.hpp>
+#include <krowkee/util/tests.hpp>
+
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+using counter_t = krowkee::util::counter_t;
+using krowkee::util::counter_snapshot;
+using krowkee::util::snapshot_counters;
+
+/**
+ * Struct bundling the experiment parameters.
+ */
+struct parameters_t {
+  std::uint64_t count;
+  std::uint64_t range_size;
+  std::size_t   compaction_threshold;
+  std::size_t   promotion_threshold;
+  std::uint64_t seed;
+};
+
+/**
+ * The counts made by `func()`.
+ */
+template <typename Func>
+counter_snapshot count_events(const Func &func) {
+  const counter_snapshot start(snapshot_counters());
+  func();
+  return snapshot_counters() - start;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Snapshots
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Communicator stub presenting two ranks holding the same values.
+ */
+struct two_rank_comm {
+  template <typename T, typename Op>
+  T all_reduce(const T &val, Op op) {
+    return op(val, val);
+  }
+};
+
+struct snapshot_check {
+  std::string name() const { return "counter snapshots"; }
+
+  void operator()(const parameters_t &) const {
+    krowkee::util::reset_counters();
+    CHECK_CONDITION(snapshot_counters() == counter_snapshot(), "reset");
+
+    const counter_snapshot events(count_events([]() {
+      KROWKEE_COUNT(merge_messages, 3);
+      KROWKEE_COUNT(merge_bytes, 40);
+    }));
+    counter_snapshot expected;
+    expected[counter_t::merge_messages] = 3;
+    expected[counter_t::merge_bytes]    = 40;
+    CHECK_CONDITION(events == expected, "count");
+
+    std::stringstream ss;
+    ss << events;
+    CHECK_CONDITION(ss.str().find("merge_bytes: 40\n") != std::string::npos,
+                    "print");
+
+    two_rank_comm comm;
+    CHECK_CONDITION(krowkee::util::all_reduce_counters(comm, events) ==
+                        events + events,
+                    "all reduce");
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Compacting Map
+////////////////////////////////////////////////////////////////////////////////
+
+struct compacting_map_check {
+  typedef krowkee::container::compacting_map<int, int> csm_t;
+
+  std::string name() const { return "compacting_map counters"; }
+
+  void operator()(const parameters_t &params) const {
+    csm_t csm(params.compaction_threshold);
+    counter_snapshot events(count_events([&]() {
+      for (int key(0); key < 3; ++key) {
+        csm[key] = key + 1;
+      }
+      csm.compactify();
+    }));
+    CHECK_CONDITION(events[counter_t::compactions] == 1 &&
+                        events[counter_t::compaction_moves] == 3 &&
+                        events[counter_t::tombstones] == 0,
+                    "compaction of dynamic elements");
+
+    // erasing the first key shifts the other two down over its tombstone
+    events = count_events([&]() {
+      csm.erase(0);
+      csm.compactify();
+      csm.compactify();
+    });
+    CHECK_CONDITION(events[counter_t::compactions] == 1 &&
+                        events[counter_t::compaction_moves] == 2 &&
+                        events[counter_t::tombstones] == 1,
+                    "compaction of tombstones");
+
+    csm_t filled(params.compaction_threshold);
+    events = count_events([&]() {
+      for (int key(0); key < int(params.count); ++key) {
+        filled[key] = 1;
+      }
+    });
+    CHECK_CONDITION(
+        events[counter_t::compactions] ==
+            params.count / params.compaction_threshold,
+        "compaction at threshold");
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Sketches
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename SketchType>
+struct sketch_check {
+  typedef SketchType              ls_t;
+  typedef typename ls_t::sf_t     sf_t;
+  typedef typename ls_t::sf_ptr_t sf_ptr_t;
+
+  inline std::string name() const {
+    std::stringstream ss;
+    ss << ls_t::full_name() << " counters";
+    return ss.str();
+  }
+
+  void operator()(const parameters_t &params) const {
+    sf_ptr_t sf_ptr(std::make_shared<sf_t>(params.range_size, params.seed));
+    ls_t ls(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+    ls_t rhs(ls);
+
+    counter_snapshot events(count_events([&]() {
+      for (std::uint64_t i(0); i < params.count; ls.insert(i++)) {
+      }
+      std::vector<std::uint64_t> items(params.count);
+      for (std::uint64_t i(0); i < params.count; ++i) {
+        items[i] = i;
+      }
+      rhs.insert_batch(items);
+      ls.compactify();
+      rhs.compactify();
+      ls += rhs;
+    }));
+    std::cout << events;
+    CHECK_CONDITION(events[counter_t::sketch_inserts] == 2 * params.count,
+                    "inserts");
+    CHECK_CONDITION(events[counter_t::sketch_merges] == 1, "merges");
+
+    // inserts from other threads are counted once they exit
+    const std::size_t num_threads(4);
+    events = count_events([&]() {
+      krowkee::util::parallel_for(
+          0, num_threads, num_threads,
+          [&](const std::size_t begin, const std::size_t end) {
+            ls_t local(sf_ptr, params.compaction_threshold,
+                       params.promotion_threshold);
+            for (std::size_t i(begin); i < end; ++i) {
+              for (std::uint64_t j(0); j < params.count; local.insert(j++)) {
+              }
+            }
+          });
+    });
+    CHECK_CONDITION(
+        events[counter_t::sketch_inserts] == num_threads * params.count,
+        "inserts from threads");
+  }
+};
+
+/**
+ * With one register per item, a Promotable sketch of distinct items promotes
+ * once, and every insert touches a sparse or a dense register.
+ */
+template <typename SketchType>
+struct promotable_check {
+  typedef SketchType              ls_t;
+  typedef typename ls_t::sf_t     sf_t;
+  typedef typename ls_t::sf_ptr_t sf_ptr_t;
+
+  inline std::string name() const {
+    std::stringstream ss;
+    ss << ls_t::full_name() << " promotion counters";
+    return ss.str();
+  }
+
+  void operator()(const parameters_t &params) const {
+    sf_ptr_t sf_ptr(std::make_shared<sf_t>(params.range_size, params.seed));
+    ls_t ls(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+
+    const counter_snapshot events(count_events([&]() {
+      for (std::uint64_t i(0); i < params.count; ls.insert(i++)) {
+      }
+    }));
+    std::cout << events;
+    CHECK_CONDITION(ls.get_container().is_sparse() == false &&
+                        events[counter_t::promotions] == 1 &&
+                        events[counter_t::demotions] == 0,
+                    "one promotion");
+    CHECK_CONDITION(events[counter_t::sparse_accesses] > 0 &&
+                        events[counter_t::sparse_accesses] +
+                                events[counter_t::dense_accesses] ==
+                            params.count,
+                    "register residency");
+  }
+};
+
+int main() {
+  parameters_t params{10000, 1024, 10, 256, krowkee::hash::default_seed};
+
+  do_test<snapshot_check>(params);
+  do_test<compacting_map_check>(params);
+  do_test<sketch_check<krowkee::sketch::LocalCountSketch<
+      krowkee::sketch::Dense, std::int32_t>>>(params);
+  do_test<sketch_check<krowkee::sketch::LocalCountSketch<
+      krowkee::sketch::MapSparse32, std::int32_t>>>(params);
+  do_test<promotable_check<krowkee::sketch::LocalCountSketch<
+      krowkee::sketch::MapPromotable32, std::int32_t>>>(params);
+  return 0;
+}
@@ -48,6 +48,14 @@ using CountingDistributedFlatMapPromotable32CountSketch =
 using CountingDistributedDense32FWHT =
     krowkee::stream::CountingDistributedFWHT<std::uint64_t, std::int32_t>;
 
+using WindowedDistributedDense32CountSketch =
+    krowkee::stream::WindowedDistributedCountSketch<
+        krowkee::sketch::Dense, std::uint64_t, std::int32_t>;
+
+using WindowedDistributedMapSparse32CountSketch =
+    krowkee::stream::WindowedDistributedCountSketch<
+        krowkee::sketch::MapSparse32, std::uint64_t, std::int32_t>;
+
 /**
  * Struct bundling the experiment parameters.
  */
@@ -470,6 +478,146 @@ struct ingest_check {
     func(world, dsk.ygm_map(), params, "(distributed insert)", d1, d2);
   }
 
+  void buffered_insert_equality(ygm::comm &world, const sf_ptr_t &sf_ptr,
+                                const parameters_t &params, const data_t &d1,
+                                const data_t &d2) const {
+    equality_test_t func;
+
+    // a small threshold exercises threshold flushes as well as barrier()
+    dsk_t dsk(world, sf_ptr, params.compaction_threshold,
+              params.promotion_threshold, params.count / 3 + 1);
+
+    if (world.rank0()) {
+      // duplicate and cancelling updates pre-aggregate to those of d1
+      for (std::uint64_t i(0); i < params.count; ++i) {
+        dsk.buffered_update(1, i);
+        dsk.buffered_update(1, i + 2 * params.count, 2);
+        dsk.buffered_update(1, i + 2 * params.count, -2);
+      }
+    }
+    if (world.rank() == 1) {
+      for (std::uint64_t i(0); i < params.count; ++i) {
+        dsk.buffered_update(2, i);
+      }
+    }
+    if (world.rank() == 2) {
+      for (std::uint64_t i(0); i < params.count; ++i) {
+        dsk.buffered_update(3, i + params.count);
+      }
+    }
+    dsk.barrier();
+    dsk.compactify();
+    func(world, dsk.ygm_map(), params, "(buffered insert)", d1, d2);
+  }
+
+  void combined_insert_equality(ygm::comm &world, const sf_ptr_t &sf_ptr,
+                                const parameters_t &params, const data_t &d1,
+                                const data_t &d2) const {
+    equality_test_t func;
+
+    dsk_t dsk(world, sf_ptr, params.compaction_threshold,
+              params.promotion_threshold);
+
+    // every rank sketches a share of each key, and sends one sketch per key
+    for (std::uint64_t i(world.rank()); i < params.count; i += world.size()) {
+      dsk.combined_update(1, i);
+      dsk.combined_update(2, i);
+      dsk.combined_update(3, i + params.count);
+    }
+    dsk.barrier();
+    dsk.compactify();
+    func(world, dsk.ygm_map(), params, "(combined insert)", d1, d2);
+  }
+
+  void emplace_equality(ygm::comm &world, const sf_ptr_t &sf_ptr,
+                        const parameters_t &params, const data_t &d1,
+                        const data_t &d2) const {
+    equality_test_t func;
+
+    dsk_t dsk(world, sf_ptr, params.compaction_threshold,
+              params.promotion_threshold);
+
+    // every rank sketches a share of each key, and merges it at the owner
+    data_t share(sf_ptr, params.compaction_threshold,
+                 params.promotion_threshold);
+    data_t other_share(share);
+    for (std::uint64_t i(world.rank()); i < params.count; i += world.size()) {
+      share.update(i);
+      other_share.update(i + params.count);
+    }
+    dsk.async_emplace(1, share);
+    dsk.async_emplace(2, std::move(share));
+    dsk.async_emplace(3, std::move(other_share));
+    world.barrier();
+    dsk.compactify();
+    func(world, dsk.ygm_map(), params, "(emplace)", d1, d2);
+  }
+
+  void snapshot_equality(ygm::comm &world, const sf_ptr_t &sf_ptr,
+                         const parameters_t &params, const data_t &d1,
+                         const data_t &d2) const {
+    typedef typename dsk_t::packed_t packed_t;
+    equality_test_t func;
+
+    dsk_t dsk(world, sf_ptr, params.compaction_threshold,
+              params.promotion_threshold);
+    dsk_t restored(world, sf_ptr, params.compaction_threshold,
+                   params.promotion_threshold);
+    dsk.track_deltas();
+
+    // the base snapshot holds the first half of each key, and the delta the
+    // rest
+    const std::uint64_t half(params.count / 2);
+    for (std::uint64_t i(world.rank()); i < half; i += world.size()) {
+      dsk.async_update(1, i);
+      dsk.async_update(2, i);
+      dsk.async_update(3, i + params.count);
+    }
+    packed_t bytes(dsk.snapshot());
+    for (std::uint64_t i(half + world.rank()); i < params.count;
+         i += world.size()) {
+      dsk.async_update(1, i);
+      dsk.buffered_update(2, i);
+      dsk.combined_update(3, i + params.count);
+    }
+    const packed_t delta(dsk.delta_snapshot());
+    bytes.insert(std::end(bytes), std::begin(delta), std::end(delta));
+
+    restored.restore(bytes);
+    restored.compactify();
+    func(world, restored.ygm_map(), params, "(snapshot restore)", d1, d2);
+  }
+
+  void reduction_equality(ygm::comm &world, const sf_ptr_t &sf_ptr,
+                          const parameters_t &params, const data_t &d1,
+                          const data_t &d2) const {
+    dsk_t dsk(world, sf_ptr, params.compaction_threshold,
+              params.promotion_threshold);
+
+    // every rank updates a share of each key
+    for (std::uint64_t i(world.rank()); i < params.count; i += world.size()) {
+      dsk.async_update(1, i);
+      dsk.async_update(2, i + params.count);
+      dsk.async_update(3, i);
+    }
+
+    data_t d12(d1 + d2);
+    data_t d123(d12 + d1);
+
+    data_t reduced(dsk.reduce_all({1, 2, 4}));
+    reduced.compactify();
+    if (world.rank0()) {
+      CHECK_CONDITION(reduced == d12, "reduce agreement");
+    }
+
+    data_t all_reduced(dsk.all_reduce());
+    all_reduced.compactify();
+    const int disagreements(world.all_reduce_sum(int(all_reduced != d123)));
+    if (world.rank0()) {
+      CHECK_CONDITION(disagreements == 0, "all-reduce agreement");
+    }
+  }
+
   void distributed_merge(ygm::comm &world, const sf_ptr_t &sf_ptr,
                          const parameters_t &params, const data_t &d1,
                          const data_t &d2, const data_t &d3) const {
@@ -546,10 +694,69 @@ struct ingest_check {
 
     insert_equality(world, sf_ptr, params, d1, d2);
 
+    buffered_insert_equality(world, sf_ptr, params, d1, d2);
+
+    combined_insert_equality(world, sf_ptr, params, d1, d2);
+
+    emplace_equality(world, sf_ptr, params, d1, d2);
+
+    snapshot_equality(world, sf_ptr, params, d1, d2);
+
+    reduction_equality(world, sf_ptr, params, d1, d2);
+
     distributed_merge(world, sf_ptr, params, d1, d2, d3);
   }
 };
 
+template <typename DistributedType>
+struct window_reduce_check {
+  typedef DistributedType              dsk_t;
+  typedef typename dsk_t::data_t       data_t;
+  typedef typename data_t::sk_t        sk_t;
+  typedef typename sk_t::sf_t          sf_t;
+  typedef typename sk_t::sf_ptr_t      sf_ptr_t;
+  typedef make_ygm_ptr_functor_t<sf_t> make_ygm_ptr_t;
+
+  std::string name() const {
+    std::stringstream ss;
+    ss << dsk_t::name() << " window reduce test";
+    return ss.str();
+  }
+
+  void operator()(ygm::comm &world, const parameters_t &params) const {
+    make_ygm_ptr_t make_ygm_ptr = make_ygm_ptr_t();
+    sf_ptr_t       sf_ptr(make_ygm_ptr(params.range_size, params.seed));
+
+    dsk_t dsk(world, sf_ptr, params.compaction_threshold,
+              params.promotion_threshold);
+
+    // every rank spreads its updates over more steps than the window holds
+    const std::size_t steps(2 * data_t::num_buckets);
+    for (std::size_t step(0); step < steps; ++step) {
+      for (std::uint64_t i(world.rank()); i < params.count;
+           i += world.size()) {
+        dsk.async_update(1, step * params.count + i);
+      }
+      if (step + 1 < steps) {
+        dsk.advance();
+      }
+    }
+    dsk.compactify();
+
+    data_t reduced(dsk.all_reduce({1}));
+    reduced.advance(data_t::num_buckets);
+    reduced.compactify();
+
+    const data_t empty(sf_ptr, params.compaction_threshold,
+                       params.promotion_threshold);
+    const int    stale(world.all_reduce_sum(
+        int(reduced.count != 0 || reduced.sk != empty.sk)));
+    if (world.rank0()) {
+      CHECK_CONDITION(stale == 0, "reduced window expires every rank");
+    }
+  }
+};
+
 void print_help(char *exe_name) {
   std::cout << "\nusage:  " << exe_name << "\n"
             << "\t-c, --count <int>              - number of insertions\n"
@@ -709,6 +916,10 @@ void do_all_tests(ygm::comm &world, const parameters_t &params) {
                                                                    params);
 #endif
   perform_tests<CountingDistributedDense32FWHT>(world, params);
+  do_mpi_test<window_reduce_check<WindowedDistributedDense32CountSketch>>(
+      world, params);
+  do_mpi_test<window_reduce_check<WindowedDistributedMapSparse32CountSketch>>(
+      world, params);
 }
 
 int main(int argc, char **argv) {
@@ -155,6 +155,46 @@ struct empirical_histograms {
   }
 };
 
+struct hash_many_check {
+  const char *name() const { return "block hashing check"; }
+
+  template <typename HashType>
+  void compare_scalar(const parameters_t                &params,
+                      const std::vector<std::uint64_t> &inputs) const {
+    HashType                   hash{params.range, params.seed};
+    std::vector<std::uint64_t> outputs(inputs.size());
+    auto                       start = Clock::now();
+    hash.hash_many(inputs.data(), outputs.data(), inputs.size());
+    auto block_ns =
+        std::chrono::duration_cast<ns_t>(Clock::now() - start).count();
+    bool matches = true;
+    for (std::size_t i(0); i < inputs.size(); ++i) {
+      if (outputs[i] != hash(inputs[i])) {
+        matches = false;
+      }
+    }
+    if (params.verbose == true) {
+      std::cout << "\t" << HashType::name() << " hashed " << inputs.size()
+                << " values in " << block_ns << " ns using "
+                << krowkee::hash::simd::isa_name() << std::endl;
+    }
+    std::stringstream ss;
+    ss << HashType::name() << " hash_many matches operator()";
+    CHECK_CONDITION(matches, ss.str());
+  }
+
+  void operator()(const parameters_t &params) const {
+    // Odd length exercises the scalar tail after the vector lanes.
+    std::vector<std::uint64_t> inputs;
+    for (std::uint64_t i(0); i < params.count + 7; ++i) {
+      inputs.push_back(krowkee::hash::wang64(i) ^ (i << 17));
+    }
+    compare_scalar<wh_t>(params, inputs);
+    compare_scalar<ms_t>(params, inputs);
+    compare_scalar<mas_t>(params, inputs);
+  }
+};
+
 #if __has_include(<cereal/cereal.hpp>)
 struct serialize_check {
   const char *name() { return "serialize check"; }
@@ -185,6 +225,7 @@ void do_experiment(const parameters_t params) {
   do_test<pow2_check>(params);
   do_test<init_check>();
   do_test<empirical_histograms>(params);
+  do_test<hash_many_check>(params);
 #if __has_include(<cereal/cereal.hpp>)
   do_test<serialize_check>(params);
 #endif
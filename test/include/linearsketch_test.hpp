@@ -12,8 +12,13 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <limits>
+#include <random>
+#include <type_traits>
+#include <utility>
 
 using sketch_type_t = krowkee::util::sketch_type_t;
 using cmap_type_t   = krowkee::util::cmap_type_t;
@@ -104,6 +109,18 @@ struct init_check {
       }
       CHECK_CONDITION(swap_matches, "copy-and-swap assignment");
     }
+    {
+      sf_ptr_t sf_ptr(_make_ptr(32));
+      ls_t ls(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+      ls_t ls2(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+      for (int i(0); i < 1000; ls.insert(i++)) {
+      }
+      ls.compactify();
+      ls2.insert(1);
+      ls2              = ls;
+      bool assign_matches = ls == ls2;
+      CHECK_CONDITION(assign_matches, "assignment to existing sketch");
+    }
   }
 };
 
@@ -153,6 +170,145 @@ struct ingest_check {
   }
 };
 
+template <typename SketchType>
+void check_throws_bad_batch(
+    SketchType &ls, const std::vector<std::uint64_t> &items,
+    const std::vector<typename SketchType::reg_t> &mults) {
+  ls.insert_batch(items, mults);
+}
+
+/**
+ * Verify that batch insertion agrees with per-item insertion.
+ */
+template <typename SketchType, template <typename> class MakePtrFunc>
+struct batch_insert_check {
+  typedef SketchType              ls_t;
+  typedef typename ls_t::sf_t     sf_t;
+  typedef typename ls_t::sf_ptr_t sf_ptr_t;
+  typedef typename ls_t::reg_t    reg_t;
+  typedef MakePtrFunc<sf_t>       make_ptr_t;
+
+  inline std::string name() const {
+    std::stringstream ss;
+    ss << sf_t::name() << " batch insert";
+    return ss.str();
+  }
+
+  void operator()(const parameters_t &params) const {
+    make_ptr_t _make_ptr{};
+    sf_ptr_t   sf_ptr(_make_ptr(params.range_size, params.seed));
+    std::vector<std::uint64_t> items;
+    std::vector<reg_t>         mults;
+    for (std::uint64_t i(0); i < params.count; ++i) {
+      items.push_back(i);
+      mults.push_back(reg_t(i % 3) + 1);
+    }
+    {
+      ls_t single(sf_ptr, params.compaction_threshold,
+                  params.promotion_threshold);
+      ls_t batch(sf_ptr, params.compaction_threshold,
+                 params.promotion_threshold);
+      for (std::uint64_t i(0); i < params.count; single.insert(i++)) {
+      }
+      batch.insert_batch(items);
+      single.compactify();
+      batch.compactify();
+      CHECK_CONDITION(single == batch, "unit multiplicity batch insert");
+    }
+    {
+      ls_t single(sf_ptr, params.compaction_threshold,
+                  params.promotion_threshold);
+      ls_t batch(sf_ptr, params.compaction_threshold,
+                 params.promotion_threshold);
+      for (std::uint64_t i(0); i < params.count; ++i) {
+        single.insert(items[i], mults[i]);
+      }
+      batch.insert_batch(items, mults);
+      single.compactify();
+      batch.compactify();
+      CHECK_CONDITION(single == batch, "weighted batch insert");
+    }
+    {
+      ls_t ls(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+      std::vector<reg_t> short_mults(mults.begin(), mults.end() - 1);
+      CHECK_THROWS<std::invalid_argument>(
+          check_throws_bad_batch<SketchType>,
+          "batch insert with mismatched multiplicities", ls, items,
+          short_mults);
+    }
+  }
+};
+
+/**
+ * Detects sketch functors that support point queries.
+ */
+template <typename SketchType, typename = void>
+struct has_point_query : std::false_type {};
+
+template <typename SketchType>
+struct has_point_query<
+    SketchType,
+    std::void_t<decltype(std::declval<const typename SketchType::sf_t &>()
+                             .point_query(
+                                 std::declval<
+                                     const typename SketchType::container_t &>(),
+                                 std::uint64_t(0)))>> : std::true_type {};
+
+/**
+ * Verify that point queries recover item multiplicities.
+ */
+template <typename SketchType, template <typename> class MakePtrFunc>
+struct point_query_check {
+  typedef SketchType              ls_t;
+  typedef typename ls_t::sf_t     sf_t;
+  typedef typename ls_t::sf_ptr_t sf_ptr_t;
+  typedef typename ls_t::reg_t    reg_t;
+  typedef MakePtrFunc<sf_t>       make_ptr_t;
+
+  inline std::string name() const {
+    std::stringstream ss;
+    ss << sf_t::name() << " point query";
+    return ss.str();
+  }
+
+  void operator()(const parameters_t &params) const {
+    make_ptr_t _make_ptr{};
+    sf_ptr_t   sf_ptr(_make_ptr(params.range_size, params.seed));
+    const std::uint64_t heavy_item(params.count + 7);
+    const reg_t         heavy_count(reg_t(params.count));
+    {
+      ls_t ls(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+      ls.insert(heavy_item, heavy_count);
+      ls.compactify();
+      CHECK_CONDITION(ls.point_query(heavy_item) == heavy_count,
+                      "single item point query");
+    }
+    {
+      ls_t ls(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+      for (std::uint64_t i(0); i < params.count; ls.insert(i++)) {
+      }
+      ls.insert(heavy_item, heavy_count);
+      ls.compactify();
+      const reg_t estimate(ls.point_query(heavy_item));
+      const reg_t error(estimate - heavy_count);
+      if (params.verbose == true) {
+        std::cout << "\theavy item estimate " << estimate << " of "
+                  << heavy_count << std::endl;
+      }
+      CHECK_CONDITION(std::abs(error) < heavy_count / 4,
+                      "heavy item point query");
+    }
+    if constexpr (std::is_same_v<
+                      sf_t, krowkee::transform::MultiRowCountSketchFunctor<
+                                reg_t>>) {
+      std::uint64_t narrow_width(1);
+      CHECK_THROWS<std::invalid_argument>(
+          [](const std::uint64_t width) { sf_t sf(width); },
+          "functor with a single register per row", narrow_width);
+    }
+  }
+};
+
 template <typename SketchType>
 void check_throws_bad_plus_equals(SketchType &lhs, const SketchType &rhs) {
   lhs += rhs;
@@ -266,6 +422,13 @@ struct good_merge_check {
       bool inplace_merge_success = both == first;
       CHECK_CONDITION(inplace_merge_success == true, "merge (+=)");
     }
+    {
+      typedef typename ls_t::reg_t reg_t;
+      all.merge_with(last, std::minus<reg_t>());
+      all.compactify();
+      bool subtract_success = all == both;
+      CHECK_CONDITION(subtract_success == true, "merge with std::minus");
+    }
   }
 };
 
@@ -300,6 +463,50 @@ struct serialize_check {
 };
 #endif
 
+/**
+ * Verify that sketches survive a round trip through the wire format.
+ */
+template <typename SketchType, template <typename> class MakePtrFunc>
+struct wire_check {
+  typedef SketchType              ls_t;
+  typedef typename ls_t::sf_t     sf_t;
+  typedef typename ls_t::sf_ptr_t sf_ptr_t;
+  typedef MakePtrFunc<sf_t>       make_ptr_t;
+
+  inline std::string name() const {
+    std::stringstream ss;
+    ss << sf_t::name() << " wire format";
+    return ss.str();
+  }
+
+  static ls_t round_trip(const ls_t &ls, const sf_ptr_t &sf_ptr,
+                         const parameters_t &params) {
+    ls_t copy(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+    wire_unpack(wire_pack(ls), copy);
+    return copy;
+  }
+
+  void operator()(const parameters_t &params) const {
+    make_ptr_t _make_ptr{};
+    sf_ptr_t   sf_ptr(_make_ptr(params.range_size, params.seed));
+
+    ls_t empty(sf_ptr, params.compaction_threshold,
+               params.promotion_threshold);
+    CHECK_CONDITION(round_trip(empty, sf_ptr, params) == empty,
+                    "empty round trip");
+
+    ls_t ls(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+    for (std::uint64_t i(0); i < params.count; ++i) {
+      ls.insert(i);
+      if (i % 3 == 0) {
+        ls.insert(i, -5);
+      }
+    }
+    ls.compactify();
+    CHECK_CONDITION(round_trip(ls, sf_ptr, params) == ls, "round trip");
+  }
+};
+
 /**
  * Verify that merge (+/+=) operators work as expected.
  */
@@ -353,6 +560,18 @@ struct promotion_check {
     d2.compactify();
     d12.compactify();
     dall.compactify();
+    {
+      ls_t s1_copy(s1);
+      ls_t dall_copy(dall);
+      bool mode_success = s1_copy.is_sparse() == true &&
+                          dall_copy.is_sparse() == false &&
+                          s1_copy == s1 && dall_copy == dall;
+      s1_copy           = dall;
+      dall_copy         = s1;
+      mode_success      = mode_success && s1_copy == dall && dall_copy == s1 &&
+                     s1_copy.is_sparse() == false && dall_copy.is_sparse();
+      CHECK_CONDITION(mode_success == true, "copy and assign across modes");
+    }
     {
       ls_t d1_ = s1 + dall;
       d1_.compactify();
@@ -407,6 +626,414 @@ struct promotion_check {
   }
 };
 
+/**
+ * Detects sketches whose containers take a promotion policy.
+ */
+template <typename SketchType, typename = void>
+struct has_promotion_policy : std::false_type {};
+
+template <typename SketchType>
+struct has_promotion_policy<
+    SketchType,
+    std::void_t<decltype(std::declval<const typename SketchType::container_t &>()
+                             .get_promotion_policy())>> : std::true_type {};
+
+/**
+ * Verify that memory-based promotion policies promote and demote as expected.
+ */
+template <typename SketchType, template <typename> class MakePtrFunc>
+struct memory_promotion_check {
+  typedef SketchType                           ls_t;
+  typedef typename ls_t::sf_t                  sf_t;
+  typedef typename ls_t::sf_ptr_t              sf_ptr_t;
+  typedef typename ls_t::reg_t                 reg_t;
+  typedef typename ls_t::container_t::sparse_t sparse_t;
+  typedef MakePtrFunc<sf_t>                    make_ptr_t;
+
+  inline std::string name() const {
+    std::stringstream ss;
+    ss << sf_t::name() << " memory promotion check";
+    return ss.str();
+  }
+
+  void operator()(const parameters_t &params) const {
+    make_ptr_t _make_ptr{};
+    sf_ptr_t   sf_ptr(_make_ptr(params.range_size, params.seed));
+    const krowkee::sketch::promotion_policy policy(
+        krowkee::sketch::promotion_policy::by_memory(1.0, 0.25));
+    const std::size_t dense_bytes(params.range_size * sizeof(reg_t));
+
+    ls_t ls(sf_ptr, params.compaction_threshold, policy);
+    bool bounded(true);
+    for (std::uint64_t i(0); i < params.count; ++i) {
+      ls.insert(i);
+      if (ls.is_sparse() == true) {
+        bounded = bounded && ls.size() * sparse_t::entry_bytes() <= dense_bytes;
+      }
+    }
+    ls.compactify();
+    CHECK_CONDITION(bounded && ls.is_sparse() == false,
+                    "promote before sparse bytes exceed dense bytes");
+
+    ls_t negated(sf_ptr, params.compaction_threshold, policy);
+    for (std::uint64_t i(0); i < params.count; ++i) {
+      negated.insert(i, reg_t(-1));
+    }
+    negated.compactify();
+    {
+      ls_t merged(ls);
+      merged += negated;
+      const bool demoted(merged.is_sparse() == true && merged.size() == 0);
+      CHECK_CONDITION(demoted, "demote after a cancelling merge");
+    }
+    {
+      // one message per item, as when merging a stream of sparse deltas
+      ls_t merged(ls);
+      for (std::uint64_t i(0); i < params.count; ++i) {
+        ls_t delta(sf_ptr, params.compaction_threshold, policy);
+        delta.insert(i, reg_t(-1));
+        delta.compactify();
+        merged.compactify();
+        merged += delta;
+      }
+      const bool demoted(merged.is_sparse() == true && merged.size() == 0);
+      CHECK_CONDITION(demoted, "demote after cancelling sparse merges");
+    }
+    {
+      for (std::uint64_t i(0); i < params.count; ++i) {
+        ls.insert(i, reg_t(-1));
+      }
+      const bool dense_until_compact(ls.is_sparse() == false);
+      ls.compactify();
+      const bool demoted(dense_until_compact && ls.is_sparse() == true &&
+                         ls.size() == 0);
+      CHECK_CONDITION(demoted, "demote on compaction after erasures");
+    }
+  }
+};
+
+/**
+ * Verify that the Dense merge kernels agree with element-wise merges.
+ */
+struct dense_merge_check {
+  const char *name() { return "Dense merge kernels"; }
+
+  template <typename RegType>
+  static std::vector<RegType> random_registers(std::mt19937     &gen,
+                                               const std::size_t n) {
+    // floating point registers hold exactly representable integers, and
+    // integral registers stay below half their range, so that plain sums of
+    // two registers do not overflow
+    constexpr std::int64_t bound(
+        std::is_floating_point_v<RegType>
+            ? std::int64_t(1) << 20
+            : std::int64_t(std::numeric_limits<RegType>::max() / 4));
+    std::uniform_int_distribution<std::int64_t> dist(
+        std::is_signed_v<RegType> ? -bound : 0, bound);
+    std::vector<RegType> ret(n);
+    for (RegType &reg : ret) {
+      reg = RegType(dist(gen)) * RegType(2) + RegType(dist(gen) % 2);
+    }
+    return ret;
+  }
+
+  /**
+   * Merge random registers with `MergeOp`, directly and via `Dense`.
+   */
+  template <typename RegType, typename MergeOp>
+  static bool agrees(std::mt19937 &gen, const std::size_t n) {
+    typedef krowkee::sketch::Dense<RegType, MergeOp> dense_t;
+    dense_t              lhs(n);
+    dense_t              rhs(n);
+    std::vector<RegType> expected(n);
+    const std::vector<RegType> lhs_regs(random_registers<RegType>(gen, n));
+    const std::vector<RegType> rhs_regs(random_registers<RegType>(gen, n));
+    for (std::size_t i(0); i < n; ++i) {
+      lhs[i]      = lhs_regs[i];
+      rhs[i]      = rhs_regs[i];
+      expected[i] = MergeOp()(lhs_regs[i], rhs_regs[i]);
+    }
+    lhs.merge(rhs);
+    return lhs.get_registers() == expected;
+  }
+
+  template <typename RegType>
+  static bool saturates() {
+    typedef krowkee::sketch::saturating_plus<RegType> op_t;
+    typedef krowkee::sketch::Dense<RegType, op_t>     dense_t;
+    constexpr RegType max(std::numeric_limits<RegType>::max());
+    constexpr RegType min(std::numeric_limits<RegType>::min());
+    const std::size_t n(100);
+    dense_t           lhs(n);
+    dense_t           rhs(n);
+    for (std::size_t i(0); i < n; ++i) {
+      lhs[i] = (i % 2 == 0) ? max : min;
+      rhs[i] = (i % 2 == 0) ? RegType(i + 1) : RegType(min / 2);
+    }
+    lhs.merge(rhs);
+    bool success(true);
+    for (std::size_t i(0); i < n; ++i) {
+      success = success && lhs.get(i) == ((i % 2 == 0) ? max : min);
+    }
+    return success;
+  }
+
+  void operator()(const parameters_t &params) const {
+    std::mt19937      gen(params.seed);
+    const std::size_t n(1021);
+    const bool        plus_success(
+        agrees<std::int8_t, std::plus<std::int8_t>>(gen, n) &&
+        agrees<std::uint8_t, std::plus<std::uint8_t>>(gen, n) &&
+        agrees<std::int16_t, std::plus<std::int16_t>>(gen, n) &&
+        agrees<std::int32_t, std::plus<std::int32_t>>(gen, n) &&
+        agrees<std::uint32_t, std::plus<std::uint32_t>>(gen, n) &&
+        agrees<std::int64_t, std::plus<std::int64_t>>(gen, n) &&
+        agrees<float, std::plus<float>>(gen, n) &&
+        agrees<double, std::plus<double>>(gen, n));
+    CHECK_CONDITION(plus_success, "std::plus kernels");
+
+    const bool saturating_success(
+        agrees<std::int8_t, krowkee::sketch::saturating_plus<std::int8_t>>(
+            gen, n) &&
+        agrees<std::uint16_t, krowkee::sketch::saturating_plus<std::uint16_t>>(
+            gen, n) &&
+        agrees<std::int32_t, krowkee::sketch::saturating_plus<std::int32_t>>(
+            gen, n) &&
+        saturates<std::int8_t>() && saturates<std::uint8_t>() &&
+        saturates<std::int16_t>() && saturates<std::uint16_t>() &&
+        saturates<std::int32_t>() && saturates<std::int64_t>());
+    CHECK_CONDITION(saturating_success, "saturating_plus kernels");
+
+    typedef krowkee::sketch::Dense<std::int32_t, std::plus<std::int32_t>>
+                      dense_t;
+    const std::size_t range(2 * dense_t::parallel_merge_grain + 17);
+    std::vector<dense_t> sources;
+    for (std::size_t i(0); i < 5; ++i) {
+      dense_t source(range);
+      for (const std::int32_t reg : random_registers<std::int32_t>(gen, 7)) {
+        source[std::size_t(reg) % range] += reg;
+      }
+      for (std::size_t j(i); j < range; j += 3) {
+        source[j] += std::int32_t(j);
+      }
+      sources.push_back(source);
+    }
+    std::vector<const dense_t *> ptrs;
+    dense_t                      expected(range);
+    for (const dense_t &source : sources) {
+      ptrs.push_back(&source);
+      expected.merge(source);
+    }
+    {
+      dense_t merged(range);
+      merged.merge_many(ptrs);
+      CHECK_CONDITION(merged == expected, "merge_many");
+    }
+    {
+      dense_t merged(range);
+      merged.merge_many(ptrs, 4);
+      dense_t threaded(range);
+      for (const dense_t *source : ptrs) {
+        threaded.merge(*source, 4);
+      }
+      CHECK_CONDITION(merged == expected && threaded == expected,
+                      "threaded merge and merge_many");
+    }
+    {
+      dense_t short_dense(range - 1);
+      ptrs.push_back(&short_dense);
+      dense_t merged(range);
+      CHECK_THROWS<std::invalid_argument>(
+          [](dense_t &lhs, std::vector<const dense_t *> &rhs) {
+            lhs.merge_many(rhs);
+          },
+          "merge_many with mismatched sizes", merged, ptrs);
+    }
+  }
+};
+
+/**
+ * Verify that fixed-range sketches agree with the same functor applied to
+ * Dense registers.
+ */
+template <typename SketchType, template <typename> class MakePtrFunc>
+struct fixed_range_check {
+  typedef SketchType                                       ls_t;
+  typedef typename ls_t::sf_t                              sf_t;
+  typedef typename ls_t::sf_ptr_t                          sf_ptr_t;
+  typedef typename ls_t::reg_t                             reg_t;
+  typedef typename ls_t::container_t                       container_t;
+  typedef krowkee::sketch::Dense<reg_t, std::plus<reg_t>> dense_t;
+  typedef MakePtrFunc<sf_t>                                make_ptr_t;
+
+  static_assert(std::is_trivially_copyable_v<container_t>,
+                "fixed-range registers should be trivially copyable");
+
+  inline std::string name() const {
+    std::stringstream ss;
+    ss << sf_t::name() << " fixed range";
+    return ss.str();
+  }
+
+  void operator()(const parameters_t &params) const {
+    constexpr std::size_t range_size(container_t::size());
+    make_ptr_t            _make_ptr{};
+    sf_ptr_t              sf_ptr(_make_ptr(range_size, params.seed));
+
+    ls_t    ls(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+    ls_t    rhs(sf_ptr, params.compaction_threshold,
+                params.promotion_threshold);
+    dense_t expected(range_size);
+    dense_t expected_rhs(range_size);
+    std::vector<std::uint64_t> items;
+    std::vector<reg_t>         mults;
+    for (std::uint64_t i(0); i < params.count; ++i) {
+      ls.insert(i);
+      (*sf_ptr)(expected, i);
+      items.push_back(i * 7 + 1);
+      mults.push_back(reg_t(i % 3) - 1);
+      (*sf_ptr)(expected_rhs, items.back(), mults.back());
+    }
+    CHECK_CONDITION(ls.get_container().get_registers() ==
+                        expected.get_registers(),
+                    "insert agrees with Dense");
+
+    rhs.insert_batch(items, mults);
+    CHECK_CONDITION(rhs.get_container().get_registers() ==
+                        expected_rhs.get_registers(),
+                    "batch insert agrees with Dense");
+
+    bool query_success(true);
+    for (std::uint64_t i(0); i < params.count; ++i) {
+      query_success = query_success && ls.point_query(i) ==
+                                           sf_ptr->point_query(expected, i);
+    }
+    CHECK_CONDITION(query_success, "point query agrees with Dense");
+
+    ls += rhs;
+    expected += expected_rhs;
+    CHECK_CONDITION(ls.get_container().get_registers() ==
+                        expected.get_registers(),
+                    "merge agrees with Dense");
+
+    {
+      const krowkee::util::wire_bytes_t bytes(wire_pack(ls));
+      ls_t copy(sf_ptr, params.compaction_threshold,
+                params.promotion_threshold);
+      const bool consumed(wire_unpack(bytes, copy));
+      CHECK_CONDITION(consumed && copy == ls, "wire round trip");
+      CHECK_CONDITION(wire_pack(expected) == bytes,
+                      "wire format matches Dense");
+    }
+    {
+      container_t copy;
+      std::memcpy(&copy, &ls.get_container(), sizeof(container_t));
+      CHECK_CONDITION(copy == ls.get_container(), "byte copy");
+    }
+    std::size_t short_range(range_size / 2);
+    std::size_t long_range(range_size * 2);
+    CHECK_THROWS<std::invalid_argument>(
+        [](const std::size_t range) { container_t con(range); },
+        "container with mismatched range", short_range);
+    CHECK_THROWS<std::invalid_argument>(
+        [](const std::size_t range) { sf_t sf(range); },
+        "functor with mismatched range", long_range);
+  }
+};
+
+/**
+ * Verify that concurrently fed sketches agree with the same functor applied
+ * sequentially to Dense registers, both with per-thread register replicas and
+ * with a single set of atomic registers.
+ */
+template <typename SketchType, template <typename> class MakePtrFunc>
+struct concurrent_check {
+  typedef SketchType                                       ls_t;
+  typedef typename ls_t::sf_t                              sf_t;
+  typedef typename ls_t::sf_ptr_t                          sf_ptr_t;
+  typedef typename ls_t::reg_t                             reg_t;
+  typedef typename ls_t::container_t                       container_t;
+  typedef krowkee::sketch::Dense<reg_t, std::plus<reg_t>> dense_t;
+  typedef MakePtrFunc<sf_t>                                make_ptr_t;
+
+  static constexpr std::size_t num_threads = 4;
+
+  inline std::string name() const {
+    std::stringstream ss;
+    ss << ls_t::full_name() << " concurrent updates";
+    return ss.str();
+  }
+
+  void operator()(const parameters_t &params) const {
+    const std::uint64_t large_range(
+        std::uint64_t(1) << krowkee::hash::ceil_log2_64(
+            2 * container_t::replica_max_bytes / sizeof(reg_t)));
+    CHECK_CONDITION(container_t::default_replicas(large_range) == 1,
+                    "large sketches keep a single replica");
+    check_range(params, params.range_size, "small range");
+    check_range(params, large_range, "large range");
+  }
+
+  void check_range(const parameters_t &params, const std::uint64_t range_size,
+                   const std::string &label) const {
+    make_ptr_t _make_ptr{};
+    sf_ptr_t   sf_ptr(_make_ptr(range_size, params.seed));
+
+    dense_t expected(range_size);
+    for (std::uint64_t i(0); i < params.count; ++i) {
+      (*sf_ptr)(expected, i);
+    }
+
+    container_t con(container_t::with_replicas(range_size, num_threads));
+    krowkee::util::parallel_for(
+        0, params.count, num_threads,
+        [&](const std::size_t begin, const std::size_t end) {
+          for (std::uint64_t i(begin); i < end; ++i) {
+            (*sf_ptr)(con, i);
+          }
+        });
+    CHECK_CONDITION(con.num_replicas() == num_threads &&
+                        con.get_registers() == expected.get_registers(),
+                    label + " replicated updates agree with Dense");
+    con.compactify();
+    CHECK_CONDITION(con.get_registers() == expected.get_registers(),
+                    label + " compactify");
+
+    ls_t ls(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+    krowkee::util::parallel_for(
+        0, params.count, num_threads,
+        [&](const std::size_t begin, const std::size_t end) {
+          for (std::uint64_t i(begin); i < end; ls.insert(i++)) {
+          }
+        });
+    CHECK_CONDITION(ls.get_container().get_registers() ==
+                        expected.get_registers(),
+                    label + " concurrent inserts agree with Dense");
+
+    bool query_success(true);
+    for (std::uint64_t i(0); i < params.count; ++i) {
+      query_success = query_success && ls.point_query(i) ==
+                                           sf_ptr->point_query(expected, i);
+    }
+    CHECK_CONDITION(query_success, label + " point query agrees with Dense");
+
+    const ls_t    rhs(ls);
+    const dense_t expected_rhs(expected);
+    ls += rhs;
+    expected += expected_rhs;
+    CHECK_CONDITION(ls.get_container().get_registers() ==
+                        expected.get_registers(),
+                    label + " merge agrees with Dense");
+
+    const krowkee::util::wire_bytes_t bytes(wire_pack(ls));
+    ls_t copy(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+    const bool consumed(wire_unpack(bytes, copy));
+    CHECK_CONDITION(consumed && copy == ls, label + " wire round trip");
+    CHECK_CONDITION(wire_pack(expected) == bytes,
+                    label + " wire format matches Dense");
+  }
+};
+
 /**
  * Execute the batter of tests for the given sketch functor.
  */
@@ -428,17 +1055,286 @@ void perform_tests(const parameters_t &params) {
 
   do_test<init_check<ls_t, MakePtrFunc>>(params);
   do_test<ingest_check<ls_t, MakePtrFunc>>(params);
+  do_test<batch_insert_check<ls_t, MakePtrFunc>>(params);
   do_test<bad_merge_check<ls_t, MakePtrFunc>>(params);
   do_test<good_merge_check<ls_t, MakePtrFunc>>(params);
 #if __has_include(<cereal/cereal.hpp>)
   do_test<serialize_check<ls_t, MakePtrFunc>>(params);
 #endif
-  if (params.sketch_type == sketch_type_t::promotable_cst &&
+  do_test<wire_check<ls_t, MakePtrFunc>>(params);
+  if constexpr (has_point_query<ls_t>::value) {
+    do_test<point_query_check<ls_t, MakePtrFunc>>(params);
+  }
+  if ((params.sketch_type == sketch_type_t::promotable_cst ||
+       params.sketch_type == sketch_type_t::widening_promotable_cst) &&
       params.promotion_threshold < params.range_size) {
     do_test<promotion_check<ls_t, MakePtrFunc>>(params);
   }
+  if constexpr (has_promotion_policy<ls_t>::value) {
+    if (params.count >= params.range_size) {
+      do_test<memory_promotion_check<ls_t, MakePtrFunc>>(params);
+    }
+  }
 }
 
+/**
+ * Verify that WideningDense widens as needed and agrees with Dense.
+ */
+struct widening_dense_check {
+  const char *name() { return "WideningDense registers"; }
+
+  template <typename RegType>
+  static bool agrees(std::mt19937 &gen, const std::size_t n) {
+    typedef std::plus<RegType>                                op_t;
+    typedef krowkee::sketch::Dense<RegType, op_t>             dense_t;
+    typedef krowkee::sketch::WideningDense<RegType, op_t>     widening_t;
+    const std::int64_t                          bound(std::numeric_limits<RegType>::max() / 4);
+    std::uniform_int_distribution<std::int64_t> dist(
+        std::is_signed_v<RegType> ? -bound : 0, bound);
+    dense_t    lhs_dense(n);
+    dense_t    rhs_dense(n);
+    widening_t lhs(n);
+    widening_t rhs(n);
+    // registers grow through every width, so that each one is repacked
+    std::int64_t scale(1);
+    for (std::size_t i(0); i < n;
+         ++i, scale = (scale > bound / 3) ? bound : scale * 3) {
+      const RegType lhs_reg(RegType(dist(gen) % scale));
+      const RegType rhs_reg(RegType(dist(gen) % scale));
+      lhs_dense[i] = lhs_reg;
+      rhs_dense[i] = rhs_reg;
+      lhs[i]       = lhs_reg;
+      rhs[i] += rhs_reg;
+    }
+    bool success(lhs.register_bits() == sizeof(RegType) * 8 &&
+                 lhs.get_registers() == lhs_dense.get_registers());
+    lhs += rhs;
+    lhs_dense += rhs_dense;
+    return success && lhs.get_registers() == lhs_dense.get_registers();
+  }
+
+  void operator()(const parameters_t &params) const {
+    typedef std::plus<std::int32_t>                           op_t;
+    typedef krowkee::sketch::WideningDense<std::int32_t, op_t> widening_t;
+    const std::size_t                                          n(1000);
+    {
+      widening_t wd(n);
+      bool       success(wd.register_bits() == 4);
+      for (std::size_t i(0); i < n; ++i) {
+        wd[i] = std::int32_t(i % 15) - 7;
+      }
+      // 4-bit registers take an eighth of the memory of Dense
+      success = success && wd.register_bits() == 4 &&
+                wd.memory_bytes() < sizeof(std::int32_t) * n / 7;
+      wd[n / 2] = 8;
+      success   = success && wd.register_bits() == 8;
+      wd[n - 1] = -129;
+      success   = success && wd.register_bits() == 16;
+      wd[0]     = 1 << 20;
+      success   = success && wd.register_bits() == 32;
+      for (std::size_t i(1); i < n - 1; ++i) {
+        const std::int32_t expected(i == n / 2 ? 8 : std::int32_t(i % 15) - 7);
+        success = success && wd[i] == expected;
+      }
+      success = success && wd.get(0) == 1 << 20 && wd.get(n - 1) == -129;
+      CHECK_CONDITION(success, "widen on overflow");
+    }
+    {
+      widening_t narrow(n);
+      widening_t wide(n);
+      narrow[3] = 5;
+      wide[3]   = 5;
+      wide[7] = 1 << 20;
+      wide[7] = 0;
+      CHECK_CONDITION(narrow == wide && narrow.register_bits() == 4 &&
+                          wide.register_bits() == 32,
+                      "equality ignores register width");
+      narrow += wide;
+      CHECK_CONDITION(narrow.register_bits() == 32 && narrow.get(3) == 10,
+                      "merge widens to the wider operand");
+    }
+    {
+      typedef krowkee::sketch::saturating_plus<std::int8_t> sat_t;
+      krowkee::sketch::WideningDense<std::int8_t, sat_t>  wd(n);
+      for (std::size_t i(0); i < 200; ++i) {
+        wd[0] = sat_t()(wd[0], std::int8_t(1));
+        wd[1] = sat_t()(wd[1], std::int8_t(-1));
+      }
+      CHECK_CONDITION(wd.register_bits() == 8 &&
+                          wd.get(0) == std::numeric_limits<std::int8_t>::max() &&
+                          wd.get(1) == std::numeric_limits<std::int8_t>::min(),
+                      "saturate at full width");
+    }
+    {
+      const std::vector<std::int32_t> values(n, 1);
+      krowkee::util::wire_writer      writer;
+      writer.put_varint(12);
+      writer.put_array(values.data(), values.size());
+      const krowkee::util::wire_bytes_t bytes(writer.bytes());
+      CHECK_THROWS<std::out_of_range>(
+          [](const krowkee::util::wire_bytes_t &b) {
+            krowkee::util::wire_reader reader(b);
+            widening_t                 wd;
+            wd.unpack(reader);
+          },
+          "unpack with a 12 bit register width", bytes);
+    }
+    std::mt19937 gen(params.seed);
+    const bool   agree_success(
+        agrees<std::int8_t>(gen, n) && agrees<std::uint8_t>(gen, n) &&
+        agrees<std::int16_t>(gen, n) && agrees<std::uint16_t>(gen, n) &&
+        agrees<std::int32_t>(gen, n) && agrees<std::uint32_t>(gen, n) &&
+        agrees<std::int64_t>(gen, n) && agrees<std::uint64_t>(gen, n));
+    CHECK_CONDITION(agree_success, "agree with Dense");
+  }
+};
+
+/**
+ * Verify the wire format encodings.
+ */
+struct wire_format_check {
+  const char *name() { return "wire format encodings"; }
+
+  template <typename T>
+  static krowkee::util::wire_bytes_t packed_array(
+      const std::vector<T> &values) {
+    krowkee::util::wire_writer writer;
+    writer.put_array(values.data(), values.size());
+    return writer.release();
+  }
+
+  template <typename T>
+  static bool array_round_trips(const std::vector<T> &values) {
+    const krowkee::util::wire_bytes_t bytes(packed_array(values));
+    krowkee::util::wire_reader        reader(bytes);
+    return reader.get_array<T>() == values && reader.empty();
+  }
+
+  void operator()(const parameters_t &params) const {
+    {
+      typedef std::numeric_limits<std::int64_t> limits_t;
+      const std::int64_t extremes[] = {0, -1, 1, limits_t::min(),
+                                       limits_t::max()};
+      krowkee::util::wire_writer writer;
+      for (const std::int64_t val : extremes) {
+        writer.put(val);
+      }
+      writer.put(std::numeric_limits<std::uint64_t>::max());
+      writer.put(-2.5);
+      krowkee::util::wire_reader reader(writer.bytes());
+      bool                       success(true);
+      for (const std::int64_t val : extremes) {
+        success = success && reader.get<std::int64_t>() == val;
+      }
+      success = success &&
+                reader.get<std::uint64_t>() ==
+                    std::numeric_limits<std::uint64_t>::max() &&
+                reader.get<double>() == -2.5 && reader.empty();
+      CHECK_CONDITION(success, "scalar round trip");
+    }
+    {
+      std::mt19937 gen(params.seed);
+      bool         success(true);
+      for (std::size_t bits(0); bits <= 64; ++bits) {
+        std::vector<std::int64_t> values(37);
+        for (std::int64_t &val : values) {
+          const std::uint64_t raw((std::uint64_t(gen()) << 32) | gen());
+          const std::uint64_t code(
+              bits == 64 ? raw : raw & ((std::uint64_t(1) << bits) - 1));
+          val = krowkee::util::zigzag_decode<std::int64_t>(code);
+        }
+        success = success && array_round_trips(values);
+      }
+      success = success && array_round_trips(std::vector<std::uint8_t>{}) &&
+                array_round_trips(std::vector<float>{1.5f, -0.25f});
+      CHECK_CONDITION(success, "array round trip at every width");
+    }
+    {
+      // small registers bit-pack well below their width
+      std::vector<std::int32_t> values(1000);
+      for (std::size_t i(0); i < values.size(); ++i) {
+        values[i] = std::int32_t(i % 7) - 3;
+      }
+      CHECK_CONDITION(packed_array(values).size() <
+                          values.size() * sizeof(std::int32_t) / 8,
+                      "bit-packed array size");
+    }
+    {
+      // mostly-zero registers cost only their nonzero runs
+      std::vector<std::int32_t> values(4096);
+      values[0]    = -5;
+      values[1]    = 1 << 20;
+      values[2000] = 3;
+      values[4095] = 7;
+      const bool success(packed_array(values).size() < 24 &&
+                         array_round_trips(values) &&
+                         array_round_trips(std::vector<std::int32_t>(9)));
+      CHECK_CONDITION(success, "nonzero run array");
+    }
+    {
+      krowkee::util::wire_writer writer;
+      writer.put_key(std::string("row \0 key", 9));
+      writer.put_key(std::uint64_t(1) << 40);
+      writer.put_key(std::string());
+      krowkee::util::wire_reader reader(writer.bytes());
+      const bool success(reader.get_key<std::string>() ==
+                             std::string("row \0 key", 9) &&
+                         reader.get_key<std::uint64_t>() ==
+                             std::uint64_t(1) << 40 &&
+                         reader.get_key<std::string>().empty() &&
+                         reader.empty());
+      CHECK_CONDITION(success, "key round trip");
+    }
+    {
+      const std::vector<std::pair<std::uint32_t, std::int32_t>> pairs{
+          {3, -1}, {4, 7}, {1000, 2}, {4000000000u, -9}};
+      krowkee::util::wire_writer writer;
+      writer.put_sorted_pairs(std::cbegin(pairs), std::cend(pairs),
+                              pairs.size());
+      krowkee::util::wire_reader reader(writer.bytes());
+      std::vector<std::pair<std::uint32_t, std::int32_t>> read;
+      reader.get_sorted_pairs<std::uint32_t, std::int32_t>(
+          [&](const std::uint32_t key, const std::int32_t val) {
+            read.emplace_back(key, val);
+          });
+      CHECK_CONDITION(read == pairs && reader.empty(),
+                      "sorted pair round trip");
+    }
+    {
+      std::vector<std::int32_t> values(100, 1 << 20);
+      krowkee::util::wire_bytes_t truncated(packed_array(values));
+      truncated.pop_back();
+      CHECK_THROWS<std::out_of_range>(
+          [](const krowkee::util::wire_bytes_t &bytes) {
+            krowkee::util::wire_reader reader(bytes);
+            reader.get_array<std::int32_t>();
+          },
+          "truncated message", truncated);
+    }
+    {
+      // a corrupt size must throw rather than allocate
+      krowkee::util::wire_writer writer;
+      writer.put_varint(std::uint64_t(1) << 60);
+      writer.put_varint(krowkee::util::wire_writer::varint_array);
+      writer.put_varint(1);
+      CHECK_THROWS<std::out_of_range>(
+          [](const krowkee::util::wire_bytes_t &bytes) {
+            krowkee::util::wire_reader reader(bytes);
+            reader.get_array<std::int32_t>();
+          },
+          "oversized array", writer.bytes());
+      const krowkee::util::wire_bytes_t bytes(
+          packed_array(std::vector<std::int32_t>(100, 1 << 20)));
+      CHECK_THROWS<std::out_of_range>(
+          [](const krowkee::util::wire_bytes_t &bytes) {
+            krowkee::util::wire_reader reader(bytes);
+            reader.get_array<std::int32_t>(99);
+          },
+          "array larger than the caller accepts", bytes);
+    }
+  }
+};
+
 void print_help(char *exe_name) {
   std::cout << "\nusage:  " << exe_name << "\n"
             << "\t-c, --count <int>              - number of insertions\n"
@@ -446,12 +1342,13 @@ void print_help(char *exe_name) {
             << "\t-o, --compaction-thresh <int>  - compaction threshold\n"
             << "\t-p, --promotion-thresh <int>   - promotion threshold\n"
             << "\t-t, --sketch-type <str>        - sketch type "
-               "(cst, sparse_cst, promotable_cst, fwht)\n"
+               "(cst, sparse_cst, soa_sparse_cst, promotable_cst, "
+               "multirow_cst, widening_cst, widening_promotable_cst, fwht)\n"
             << "\t-m, --map-type <str>           - map type "
 #if __has_include(<boost/container/flat_map.hpp>)
-               "(std, boost)\n"
+               "(std, boost, staging, hash)\n"
 #else
-               "(std)\n"
+               "(std, staging, hash)\n"
 #endif
             << "\t-s, --seed <int>               - random seed\n"
             << "\t-v, --verbose                  - print additional debug "
@@ -552,6 +1449,20 @@ void choose_tests(const parameters_t &params) {
     } else if (params.cmap_type == cmap_type_t::boost) {
       perform_tests<FlatMapSparse32CountSketch, make_ptr_functor_t>(params);
 #endif
+    } else if (params.cmap_type == cmap_type_t::staging) {
+      perform_tests<StagingSparse32CountSketch, make_ptr_functor_t>(params);
+    } else if (params.cmap_type == cmap_type_t::hash) {
+      perform_tests<HashSparse32CountSketch, make_ptr_functor_t>(params);
+    }
+  } else if (params.sketch_type == sketch_type_t::soa_sparse_cst) {
+    if (params.cmap_type == cmap_type_t::std) {
+      perform_tests<MapSoASparse32CountSketch, make_ptr_functor_t>(params);
+#if __has_include(<boost/container/flat_map.hpp>)
+    } else if (params.cmap_type == cmap_type_t::boost) {
+      perform_tests<FlatMapSoASparse32CountSketch, make_ptr_functor_t>(params);
+#endif
+    } else if (params.cmap_type == cmap_type_t::staging) {
+      perform_tests<StagingSoASparse32CountSketch, make_ptr_functor_t>(params);
     }
   } else if (params.sketch_type == sketch_type_t::promotable_cst) {
     if (params.cmap_type == cmap_type_t::std) {
@@ -560,7 +1471,23 @@ void choose_tests(const parameters_t &params) {
     } else if (params.cmap_type == cmap_type_t::boost) {
       perform_tests<FlatMapPromotable32CountSketch, make_ptr_functor_t>(params);
 #endif
+    } else if (params.cmap_type == cmap_type_t::staging) {
+      perform_tests<StagingPromotable32CountSketch, make_ptr_functor_t>(params);
+    } else if (params.cmap_type == cmap_type_t::hash) {
+      perform_tests<HashPromotable32CountSketch, make_ptr_functor_t>(params);
+    }
+  } else if (params.sketch_type == sketch_type_t::widening_cst) {
+    perform_tests<WideningDense32CountSketch, make_ptr_functor_t>(params);
+  } else if (params.sketch_type == sketch_type_t::widening_promotable_cst) {
+    if (params.cmap_type == cmap_type_t::std) {
+      perform_tests<MapWideningPromotable32CountSketch, make_ptr_functor_t>(
+          params);
+    } else if (params.cmap_type == cmap_type_t::hash) {
+      perform_tests<HashWideningPromotable32CountSketch, make_ptr_functor_t>(
+          params);
     }
+  } else if (params.sketch_type == sketch_type_t::multirow_cst) {
+    perform_tests<Dense32MultiRowCountSketch, make_ptr_functor_t>(params);
   } else if (params.sketch_type == sketch_type_t::fwht) {
     perform_tests<Dense32FWHT, make_ptr_functor_t>(params);
   }
@@ -570,11 +1497,27 @@ void do_all_tests(const parameters_t &params) {
   perform_tests<Dense32CountSketch, make_ptr_functor_t>(params);
   perform_tests<MapSparse32CountSketch, make_ptr_functor_t>(params);
   perform_tests<MapPromotable32CountSketch, make_ptr_functor_t>(params);
+  perform_tests<StagingSparse32CountSketch, make_ptr_functor_t>(params);
+  perform_tests<StagingPromotable32CountSketch, make_ptr_functor_t>(params);
+  perform_tests<HashSparse32CountSketch, make_ptr_functor_t>(params);
+  perform_tests<HashPromotable32CountSketch, make_ptr_functor_t>(params);
+  perform_tests<MapSoASparse32CountSketch, make_ptr_functor_t>(params);
+  perform_tests<StagingSoASparse32CountSketch, make_ptr_functor_t>(params);
+  perform_tests<WideningDense32CountSketch, make_ptr_functor_t>(params);
+  perform_tests<MapWideningPromotable32CountSketch, make_ptr_functor_t>(params);
+  perform_tests<HashWideningPromotable32CountSketch, make_ptr_functor_t>(
+      params);
 #if __has_include(<boost/container/flat_map.hpp>)
   perform_tests<FlatMapSparse32CountSketch, make_ptr_functor_t>(params);
   perform_tests<FlatMapPromotable32CountSketch, make_ptr_functor_t>(params);
+  perform_tests<FlatMapSoASparse32CountSketch, make_ptr_functor_t>(params);
 #endif
+  perform_tests<Dense32MultiRowCountSketch, make_ptr_functor_t>(params);
   perform_tests<Dense32FWHT, make_ptr_functor_t>(params);
+  do_test<fixed_range_check<Fixed32CountSketch, make_ptr_functor_t>>(params);
+  perform_tests<Concurrent32CountSketch, make_ptr_functor_t>(params);
+  do_test<concurrent_check<Concurrent32CountSketch, make_ptr_functor_t>>(
+      params);
 }
 
 int do_main(int argc, char **argv) {
@@ -599,6 +1542,10 @@ int do_main(int argc, char **argv) {
 
   parse_args(argc, argv, params);
 
+  do_test<dense_merge_check>(params);
+  do_test<widening_dense_check>(params);
+  do_test<wire_format_check>(params);
+
   if (do_all == true) {
     do_all_tests(params);
   } else {
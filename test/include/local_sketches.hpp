@@ -18,6 +18,42 @@ using MapPromotable32CountSketch =
     krowkee::sketch::LocalCountSketch<krowkee::sketch::MapPromotable32,
                                       std::int32_t>;
 
+using StagingSparse32CountSketch =
+    krowkee::sketch::LocalCountSketch<krowkee::sketch::StagingSparse32,
+                                      std::int32_t>;
+
+using StagingPromotable32CountSketch =
+    krowkee::sketch::LocalCountSketch<krowkee::sketch::StagingPromotable32,
+                                      std::int32_t>;
+
+using HashSparse32CountSketch =
+    krowkee::sketch::LocalCountSketch<krowkee::sketch::HashSparse32,
+                                      std::int32_t>;
+
+using HashPromotable32CountSketch =
+    krowkee::sketch::LocalCountSketch<krowkee::sketch::HashPromotable32,
+                                      std::int32_t>;
+
+using WideningDense32CountSketch =
+    krowkee::sketch::LocalCountSketch<krowkee::sketch::WideningDense,
+                                      std::int32_t>;
+
+using MapWideningPromotable32CountSketch =
+    krowkee::sketch::LocalCountSketch<krowkee::sketch::MapWideningPromotable32,
+                                      std::int32_t>;
+
+using HashWideningPromotable32CountSketch =
+    krowkee::sketch::LocalCountSketch<
+        krowkee::sketch::HashWideningPromotable32, std::int32_t>;
+
+using MapSoASparse32CountSketch =
+    krowkee::sketch::LocalCountSketch<krowkee::sketch::MapSoASparse32,
+                                      std::int32_t>;
+
+using StagingSoASparse32CountSketch =
+    krowkee::sketch::LocalCountSketch<krowkee::sketch::StagingSoASparse32,
+                                      std::int32_t>;
+
 #if __has_include(<boost/container/flat_map.hpp>)
 using FlatMapSparse32CountSketch =
     krowkee::sketch::LocalCountSketch<krowkee::sketch::FlatMapSparse32,
@@ -26,9 +62,24 @@ using FlatMapSparse32CountSketch =
 using FlatMapPromotable32CountSketch =
     krowkee::sketch::LocalCountSketch<krowkee::sketch::FlatMapPromotable32,
                                       std::int32_t>;
+
+using FlatMapSoASparse32CountSketch =
+    krowkee::sketch::LocalCountSketch<krowkee::sketch::FlatMapSoASparse32,
+                                      std::int32_t>;
 #endif
 
 using Dense32FWHT = krowkee::sketch::LocalFWHT<std::int32_t>;
 
+using Dense32MultiRowCountSketch =
+    krowkee::sketch::LocalMultiRowCountSketch<krowkee::sketch::Dense,
+                                              std::int32_t>;
+
+using Fixed32CountSketch =
+    krowkee::sketch::LocalFixedCountSketch<std::int32_t, 1024>;
+
+using Concurrent32CountSketch =
+    krowkee::sketch::LocalCountSketch<krowkee::sketch::ConcurrentDense,
+                                      std::int32_t>;
+
 template <typename T>
 using make_ptr_functor_t = make_shared_functor_t<T>;
\ No newline at end of file
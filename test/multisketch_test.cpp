@@ -16,7 +16,14 @@
 #include <stdio.h>
 #include <unistd.h>
 
+#include <cmath>
 #include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
 
 using sketch_type_t = krowkee::util::sketch_type_t;
 using cmap_type_t   = krowkee::util::cmap_type_t;
@@ -45,6 +52,69 @@ using MultiLocalFlatMapPromotable32CountSketch =
 using MultiLocalDense32FWHT =
     krowkee::stream::MultiLocalFWHT<std::uint64_t, std::int32_t>;
 
+using PooledMultiLocalDense32CountSketch =
+    krowkee::stream::PooledMultiLocalCountSketch<krowkee::sketch::Dense,
+                                                 std::uint64_t, std::int32_t>;
+
+using PooledMultiLocalMapPromotable32CountSketch =
+    krowkee::stream::PooledMultiLocalCountSketch<
+        krowkee::sketch::MapPromotable32, std::uint64_t, std::int32_t>;
+
+using MultiLocalStringDense32CountSketch =
+    krowkee::stream::MultiLocalCountSketch<krowkee::sketch::Dense, std::string,
+                                           std::int32_t>;
+
+using PooledMultiLocalStringDense32CountSketch =
+    krowkee::stream::PooledMultiLocalCountSketch<krowkee::sketch::Dense,
+                                                 std::string, std::int32_t>;
+
+using ShardedMultiLocalDense32CountSketch =
+    krowkee::stream::ShardedMultiLocalCountSketch<krowkee::sketch::Dense,
+                                                  std::uint64_t, std::int32_t>;
+
+using ShardedMultiLocalMapSparse32CountSketch =
+    krowkee::stream::ShardedMultiLocalCountSketch<krowkee::sketch::MapSparse32,
+                                                  std::uint64_t, std::int32_t>;
+
+using ShardedMultiLocalMapPromotable32CountSketch =
+    krowkee::stream::ShardedMultiLocalCountSketch<
+        krowkee::sketch::MapPromotable32, std::uint64_t, std::int32_t>;
+
+using HeavyHitterMultiLocalDense32MultiRowCountSketch =
+    krowkee::stream::HeavyHitterMultiLocalMultiRowCountSketch<
+        krowkee::sketch::Dense, std::uint64_t, std::int32_t>;
+
+using HeavyHitterMultiLocalMapSparse32MultiRowCountSketch =
+    krowkee::stream::HeavyHitterMultiLocalMultiRowCountSketch<
+        krowkee::sketch::MapSparse32, std::uint64_t, std::int32_t>;
+
+using WindowedMultiLocalDense32CountSketch =
+    krowkee::stream::WindowedMultiLocalCountSketch<krowkee::sketch::Dense,
+                                                   std::uint64_t, std::int32_t>;
+
+using WindowedMultiLocalMapSparse32CountSketch =
+    krowkee::stream::WindowedMultiLocalCountSketch<
+        krowkee::sketch::MapSparse32, std::uint64_t, std::int32_t>;
+
+using WindowedMultiLocalMapPromotable32CountSketch =
+    krowkee::stream::WindowedMultiLocalCountSketch<
+        krowkee::sketch::MapPromotable32, std::uint64_t, std::int32_t>;
+
+using CachedMultiLocalDense32CountSketch =
+    krowkee::stream::CachedMultiLocalCountSketch<krowkee::sketch::Dense,
+                                                 std::uint64_t, std::int32_t>;
+
+using CachedMultiLocalMapSparse32CountSketch =
+    krowkee::stream::CachedMultiLocalCountSketch<
+        krowkee::sketch::MapSparse32, std::uint64_t, std::int32_t>;
+
+using CachedMultiLocalMapPromotable32CountSketch =
+    krowkee::stream::CachedMultiLocalCountSketch<
+        krowkee::sketch::MapPromotable32, std::uint64_t, std::int32_t>;
+
+using CachedMultiLocalDense32FWHT =
+    krowkee::stream::CachedMultiLocalFWHT<std::uint64_t, std::int32_t>;
+
 /**
  * Struct bundling the experiment parameters.
  */
@@ -163,6 +233,1066 @@ struct multi_ingest_check {
   }
 };
 
+/**
+ * Verify that sharded, threaded ingestion agrees with serial ingestion into a
+ * single Multi.
+ */
+template <typename ShardedType, template <typename> class MakePtrFunc>
+struct sharded_ingest_check {
+  typedef ShardedType               smsk_t;
+  typedef typename smsk_t::msk_t    msk_t;
+  typedef typename smsk_t::sf_t     sf_t;
+  typedef typename smsk_t::sf_ptr_t sf_ptr_t;
+  typedef MakePtrFunc<sf_t>         make_ptr_t;
+
+  std::string name() const {
+    std::stringstream ss;
+    ss << smsk_t::name() << " sharded ingest";
+    return ss.str();
+  }
+
+  void operator()(const parameters_t &params) const {
+    make_ptr_t _make_ptr = make_ptr_t();
+    sf_ptr_t   sf_ptr(_make_ptr(params.range_size, params.seed));
+
+    std::mt19937                                 gen(params.seed);
+    std::uniform_int_distribution<std::uint64_t> key_dist(0, 63);
+    std::uniform_int_distribution<std::int32_t>  mult_dist(-3, 3);
+    std::vector<std::uint64_t>                   keys(params.count);
+    std::vector<std::uint64_t>                   items(params.count);
+    std::vector<std::int32_t>                    mults(params.count);
+    for (std::uint64_t i(0); i < params.count; ++i) {
+      keys[i]  = key_dist(gen);
+      items[i] = gen() % (4 * params.count);
+      mults[i] = mult_dist(gen);
+    }
+
+    msk_t serial(sf_ptr, params.compaction_threshold,
+                 params.promotion_threshold);
+    msk_t first_half(sf_ptr, params.compaction_threshold,
+                     params.promotion_threshold);
+    msk_t second_half(sf_ptr, params.compaction_threshold,
+                      params.promotion_threshold);
+    for (std::uint64_t i(0); i < params.count; ++i) {
+      serial.insert(keys[i], items[i], mults[i]);
+      if (2 * i < params.count) {
+        first_half.insert(keys[i], items[i], mults[i]);
+      } else {
+        second_half.insert(keys[i], items[i], mults[i]);
+      }
+    }
+    serial.compactify();
+
+    smsk_t sharded(sf_ptr, 5, params.compaction_threshold,
+                   params.promotion_threshold);
+    sharded.insert_batch(keys, items, mults, 3);
+    sharded.compactify(3);
+    {
+      bool routing_success(sharded.size() == serial.size());
+      for (std::size_t shard(0); shard < sharded.num_shards(); ++shard) {
+        for (const auto &pair : sharded.shard(shard)) {
+          routing_success =
+              routing_success && sharded.shard_of(pair.first) == shard;
+        }
+      }
+      CHECK_CONDITION(routing_success, "keys routed to their shards");
+    }
+    {
+      msk_t merged(sharded.merged());
+      CHECK_CONDITION(merged == serial, "threaded batch matches serial");
+    }
+    {
+      first_half.compactify();
+      second_half.compactify();
+      first_half += second_half;
+      first_half.compactify();
+      CHECK_CONDITION(first_half == serial, "Multi merge");
+    }
+    {
+      smsk_t unit(sf_ptr, 2, params.compaction_threshold,
+                  params.promotion_threshold);
+      unit.insert_batch(keys, items, 2);
+      unit.compactify(2);
+      msk_t unit_serial(sf_ptr, params.compaction_threshold,
+                        params.promotion_threshold);
+      for (std::uint64_t i(0); i < params.count; ++i) {
+        unit_serial.insert(keys[i], items[i]);
+      }
+      unit_serial.compactify();
+      CHECK_CONDITION(unit.merged() == unit_serial,
+                      "threaded batch without multiplicities");
+    }
+    items.pop_back();
+    CHECK_THROWS<std::invalid_argument>(
+        [](smsk_t &msk, std::vector<std::uint64_t> &keys,
+           std::vector<std::uint64_t> &items) {
+          msk.insert_batch(keys, items);
+        },
+        "batch with mismatched lengths", sharded, keys, items);
+  }
+};
+
+/**
+ * Verify that PooledMulti agrees with Multi and keeps its sketches in one
+ * contiguous pool.
+ */
+template <typename PooledType, typename MultiType,
+          template <typename> class MakePtrFunc>
+struct pooled_index_check {
+  typedef PooledType                pmsk_t;
+  typedef MultiType                 msk_t;
+  typedef typename pmsk_t::sf_t     sf_t;
+  typedef typename pmsk_t::sf_ptr_t sf_ptr_t;
+  typedef MakePtrFunc<sf_t>         make_ptr_t;
+  typedef typename pmsk_t::sk_pair_t::first_type key_t;
+
+  static key_t make_key(const std::uint64_t i, const std::uint64_t num_keys) {
+    const std::uint64_t key(krowkee::hash::wang64(i) % num_keys);
+    if constexpr (std::is_integral_v<key_t>) {
+      return key;
+    } else {
+      return std::to_string(key);
+    }
+  }
+
+  static key_t missing_key(const std::uint64_t num_keys) {
+    if constexpr (std::is_integral_v<key_t>) {
+      return num_keys;
+    } else {
+      return "missing";
+    }
+  }
+
+  std::string name() const {
+    std::stringstream ss;
+    ss << pmsk_t::name() << " pooled index";
+    return ss.str();
+  }
+
+  void operator()(const parameters_t &params) const {
+    make_ptr_t          _make_ptr = make_ptr_t();
+    sf_ptr_t            sf_ptr(_make_ptr(params.range_size, params.seed));
+    const std::uint64_t num_keys(1000);
+
+    pmsk_t pooled(sf_ptr, params.compaction_threshold,
+                  params.promotion_threshold, num_keys);
+    msk_t  multi(sf_ptr, params.compaction_threshold,
+                 params.promotion_threshold);
+    const auto *const pool_begin(&*std::begin(pooled));
+    for (std::uint64_t i(0); i < params.count; ++i) {
+      const key_t key(make_key(i, num_keys));
+      pooled.insert(key, i);
+      multi.insert(key, i);
+    }
+    pooled.compactify();
+    multi.compactify();
+    {
+      bool agree(pooled.size() == multi.size());
+      for (const auto &pair : multi) {
+        agree = agree && pooled.at(pair.first) == pair.second;
+      }
+      CHECK_CONDITION(agree, "agrees with Multi");
+    }
+    {
+      const bool in_place(&*std::begin(pooled) == pool_begin &&
+                          pooled.capacity() == num_keys);
+      CHECK_CONDITION(in_place, "reserved pool is not reallocated");
+    }
+    {
+      std::vector<key_t> first_seen;
+      std::set<key_t>    seen;
+      for (std::uint64_t i(0); i < params.count; ++i) {
+        const key_t key(make_key(i, num_keys));
+        if (seen.insert(key).second == true) {
+          first_seen.push_back(key);
+        }
+      }
+      std::vector<key_t> pool_order;
+      for (const auto &pair : pooled) {
+        pool_order.push_back(pair.first);
+      }
+      CHECK_CONDITION(pool_order == first_seen, "iteration in insertion order");
+    }
+    {
+      pmsk_t lhs(sf_ptr, params.compaction_threshold,
+                 params.promotion_threshold);
+      pmsk_t rhs(sf_ptr, params.compaction_threshold,
+                 params.promotion_threshold);
+      msk_t  multi_lhs(sf_ptr, params.compaction_threshold,
+                       params.promotion_threshold);
+      msk_t  multi_rhs(sf_ptr, params.compaction_threshold,
+                       params.promotion_threshold);
+      for (std::uint64_t i(0); i < params.count; ++i) {
+        const key_t key(make_key(i, num_keys));
+        ((i % 2 == 0) ? lhs : rhs).insert(key, i);
+        ((i % 2 == 0) ? multi_lhs : multi_rhs).insert(key, i);
+      }
+      lhs.compactify();
+      rhs.compactify();
+      multi_lhs.compactify();
+      multi_rhs.compactify();
+      lhs += rhs;
+      multi_lhs += multi_rhs;
+      bool agree(lhs.size() == multi_lhs.size());
+      for (const auto &pair : multi_lhs) {
+        agree = agree && lhs.at(pair.first) == pair.second;
+      }
+      CHECK_CONDITION(agree, "merge agrees with Multi");
+    }
+    {
+      pmsk_t doubled(pooled);
+      msk_t  multi_doubled(multi);
+      doubled += doubled;
+      multi_doubled += multi;
+      bool agree(doubled.size() == multi_doubled.size());
+      for (const auto &pair : multi_doubled) {
+        agree = agree && doubled.at(pair.first) == pair.second;
+      }
+      CHECK_CONDITION(agree, "self merge agrees with Multi");
+    }
+    key_t missing(missing_key(num_keys));
+    CHECK_THROWS<std::invalid_argument>(
+        [](pmsk_t &msk, const key_t &key) { msk.at(key); }, "missing key",
+        pooled, missing);
+  }
+};
+
+/**
+ * Verify that a MultiView of a written Multi agrees with the Multi without
+ * materializing its sketches.
+ */
+template <typename MultiType, template <typename> class MakePtrFunc>
+struct multi_view_check {
+  typedef MultiType                         msk_t;
+  typedef krowkee::stream::MultiView<msk_t> mv_t;
+  typedef typename msk_t::sf_t              sf_t;
+  typedef typename msk_t::sf_ptr_t          sf_ptr_t;
+  typedef typename msk_t::data_t            data_t;
+  typedef MakePtrFunc<sf_t>                 make_ptr_t;
+
+  std::string name() const {
+    std::stringstream ss;
+    ss << mv_t::name() << " mapped file";
+    return ss.str();
+  }
+
+  void operator()(const parameters_t &params) const {
+    make_ptr_t          _make_ptr = make_ptr_t();
+    sf_ptr_t            sf_ptr(_make_ptr(params.range_size, params.seed));
+    const std::uint64_t num_keys(100);
+    const std::string   path("multi_view_check.krk");
+
+    msk_t multi(sf_ptr, params.compaction_threshold,
+                params.promotion_threshold);
+    for (std::uint64_t i(0); i < params.count; ++i) {
+      multi.insert(krowkee::hash::wang64(i) % num_keys, i);
+    }
+    // A sparse, a dense and an empty sketch.
+    multi.insert(num_keys, 3);
+    for (std::uint64_t i(0); i < params.range_size * 8; ++i) {
+      multi.insert(num_keys + 1, i);
+    }
+    multi[num_keys + 2];
+    multi.compactify();
+    mv_t::write(path, multi);
+
+    mv_t view(path, sf_ptr);
+    {
+      bool agree(view.size() == multi.size());
+      auto key_itr(view.keys_begin());
+      for (auto &pair : multi) {
+        const auto &con(pair.second.sk.get_container());
+        const auto  sketch(view.at(pair.first));
+        agree = agree && *key_itr++ == pair.first &&
+                sketch.count() == pair.second.count;
+        for (std::uint64_t i(0); i < params.range_size; ++i) {
+          agree = agree && sketch.get(i) == con.get(i);
+        }
+      }
+      CHECK_CONDITION(agree, "registers agree with Multi");
+    }
+    {
+      bool agree(true);
+      for (auto &pair : multi) {
+        agree = agree &&
+                view.materialize(pair.first, params.compaction_threshold,
+                                 params.promotion_threshold) == pair.second;
+      }
+      CHECK_CONDITION(agree, "materialized sketches agree with Multi");
+    }
+    {
+      msk_t merged(sf_ptr, params.compaction_threshold,
+                   params.promotion_threshold);
+      view.merge_into(merged);
+      merged.compactify();
+      CHECK_CONDITION(merged == multi, "merge into empty Multi");
+
+      msk_t doubled(multi);
+      doubled += multi;
+      view.merge_into(merged);
+      merged.compactify();
+      CHECK_CONDITION(merged == doubled, "merge into populated Multi");
+    }
+    {
+      const krowkee::stream::multi_file_header header(
+          krowkee::stream::multi_file_header::read(path));
+      const bool agree(header.range_size == params.range_size &&
+                       header.seed == params.seed &&
+                       header.num_keys == multi.size() &&
+                       krowkee::stream::multi_file_header::read_name(path) ==
+                           sf_t::full_name());
+      CHECK_CONDITION(agree, "header records functor parameters");
+    }
+    std::uint64_t missing(num_keys + 3);
+    CHECK_THROWS<std::invalid_argument>(
+        [](const mv_t &mv, const std::uint64_t key) { mv.at(key); },
+        "missing key", view, missing);
+    sf_ptr_t other_ptr(_make_ptr(params.range_size, params.seed + 1));
+    CHECK_THROWS<std::invalid_argument>(
+        [](const std::string &p, const sf_ptr_t &ptr) { mv_t(p, ptr); },
+        "functor mismatch", path, other_ptr);
+    {
+      const std::string corrupt_path("multi_view_check_corrupt.krk");
+      // Copy the file with the word at byte `pos` replaced by `word`.
+      const auto corrupt = [&](const std::uint64_t pos,
+                               const std::uint64_t word) {
+        std::ifstream ifs(path, std::ios::binary);
+        std::string   bytes((std::istreambuf_iterator<char>(ifs)),
+                            std::istreambuf_iterator<char>());
+        std::memcpy(bytes.data() + pos, &word, sizeof(word));
+        std::ofstream(corrupt_path, std::ios::binary) << bytes;
+      };
+      const krowkee::stream::multi_file_header header(
+          krowkee::stream::multi_file_header::read(path));
+      std::uint64_t second_offset;
+      {
+        std::ifstream ifs(path, std::ios::binary);
+        ifs.seekg(header.offsets_offset + sizeof(std::uint64_t));
+        ifs.read(reinterpret_cast<char *>(&second_offset),
+                 sizeof(second_offset));
+      }
+      const auto open = [](const std::string &p, const sf_ptr_t &ptr) {
+        mv_t(p, ptr);
+      };
+      corrupt(header.offsets_offset + 2 * sizeof(std::uint64_t),
+              second_offset - 1);
+      CHECK_THROWS<std::invalid_argument>(open, "decreasing offsets",
+                                          corrupt_path, sf_ptr);
+      // a sparse record of every register is larger than any record
+      corrupt(header.blob_offset + (header.has_count ? sizeof(std::uint64_t)
+                                                     : 0),
+              header.range_size);
+      CHECK_THROWS<std::invalid_argument>(open, "record overruns its offset",
+                                          corrupt_path, sf_ptr);
+      std::remove(corrupt_path.c_str());
+    }
+    std::remove(path.c_str());
+  }
+};
+
+/**
+ * Verify that ingesting text and binary files, in one or several parts,
+ * agrees with inserting their tuples directly.
+ */
+template <typename MultiType, typename ShardedType,
+          template <typename> class MakePtrFunc>
+struct file_ingest_check {
+  typedef MultiType                                       msk_t;
+  typedef ShardedType                                     smsk_t;
+  typedef typename msk_t::sf_t                            sf_t;
+  typedef typename msk_t::sf_ptr_t                        sf_ptr_t;
+  typedef typename msk_t::sk_t::reg_t                     reg_t;
+  typedef krowkee::stream::Ingester<std::uint64_t, reg_t> ingester_t;
+  typedef krowkee::stream::ingest_format_t                format_t;
+  typedef MakePtrFunc<sf_t>                               make_ptr_t;
+
+  std::string name() const {
+    std::stringstream ss;
+    ss << msk_t::name() << " file ingestion";
+    return ss.str();
+  }
+
+  void operator()(const parameters_t &params) const {
+    make_ptr_t          _make_ptr = make_ptr_t();
+    sf_ptr_t            sf_ptr(_make_ptr(params.range_size, params.seed));
+    const std::uint64_t num_keys(50);
+    const std::string   text_path("file_ingest_check.txt");
+    const std::string   binary_path("file_ingest_check.bin");
+
+    msk_t expected(sf_ptr, params.compaction_threshold,
+                   params.promotion_threshold);
+    {
+      std::ofstream text(text_path);
+      std::ofstream binary(binary_path, std::ios::binary);
+      text << "# key item multiplicity\n\n";
+      for (std::uint64_t i(0); i < params.count; ++i) {
+        const std::uint64_t key(krowkee::hash::wang64(i) % num_keys);
+        const reg_t         mult(reg_t(i % 5) - reg_t(2));
+        expected.insert(key, i, mult);
+        text << key << ((i % 3 == 0) ? "\t" : " ") << i << "," << mult
+             << ((i % 7 == 0) ? " \r\n" : "\n");
+        binary.write(reinterpret_cast<const char *>(&key), sizeof(key));
+        binary.write(reinterpret_cast<const char *>(&i), sizeof(i));
+        binary.write(reinterpret_cast<const char *>(&mult), sizeof(mult));
+      }
+    }
+    expected.compactify();
+
+    for (const format_t format : {format_t::text, format_t::binary}) {
+      const std::string &path(
+          (format == format_t::text) ? text_path : binary_path);
+      const std::string  label(
+          (format == format_t::text) ? "text" : "binary");
+      {
+        msk_t            multi(sf_ptr, params.compaction_threshold,
+                               params.promotion_threshold);
+        const ingester_t ingester(path, format, true, 3, 256);
+        const bool       counted(ingester.ingest(multi) == params.count);
+        multi.compactify();
+        CHECK_CONDITION(counted && multi == expected,
+                        label + " ingest into Multi");
+      }
+      {
+        msk_t         multi(sf_ptr, params.compaction_threshold,
+                            params.promotion_threshold);
+        std::uint64_t count(0);
+        for (std::size_t part(0); part < 3; ++part) {
+          const ingester_t ingester(path, format, true, 2, 100, part, 3);
+          count += ingester.ingest(multi);
+        }
+        multi.compactify();
+        CHECK_CONDITION(count == params.count && multi == expected,
+                        label + " ingest in parts");
+      }
+      {
+        smsk_t sharded(sf_ptr, 4, params.compaction_threshold,
+                       params.promotion_threshold);
+        const ingester_t ingester(path, format, true, 2, 1 << 12);
+        ingester.ingest(sharded);
+        sharded.compactify();
+        CHECK_CONDITION(sharded.merged() == expected,
+                        label + " ingest into ShardedMulti");
+      }
+    }
+    {
+      std::ofstream text(text_path);
+      text << "1 2\n3 x\n";
+    }
+    CHECK_THROWS<std::invalid_argument>(
+        [](const std::string &path, msk_t &multi) {
+          ingester_t(path, format_t::text).ingest(multi);
+        },
+        "malformed record", text_path, expected);
+    std::remove(text_path.c_str());
+    std::remove(binary_path.c_str());
+  }
+};
+
+/**
+ * Verify the similarity engine against inner products computed register by
+ * register.
+ */
+template <typename MultiType, template <typename> class MakePtrFunc>
+struct similarity_check {
+  typedef MultiType                                  msk_t;
+  typedef typename msk_t::sf_t                       sf_t;
+  typedef typename msk_t::sf_ptr_t                   sf_ptr_t;
+  typedef krowkee::stream::Similarity<std::uint64_t> sim_t;
+  typedef typename sim_t::matches_t                  matches_t;
+  typedef krowkee::stream::similarity_t              similarity_t;
+  typedef MakePtrFunc<sf_t>                          make_ptr_t;
+
+  std::string name() const {
+    std::stringstream ss;
+    ss << msk_t::name() << " similarity";
+    return ss.str();
+  }
+
+  static bool near(const double lhs, const double rhs) {
+    return std::abs(lhs - rhs) <= 1e-9 * std::max(1.0, std::abs(lhs));
+  }
+
+  static bool same_matches(const matches_t &lhs, const matches_t &rhs) {
+    bool ret(lhs.size() == rhs.size());
+    for (std::size_t i(0); ret && i < lhs.size(); ++i) {
+      ret = lhs[i].first == rhs[i].first && near(lhs[i].second, rhs[i].second);
+    }
+    return ret;
+  }
+
+  void operator()(const parameters_t &params) const {
+    make_ptr_t _make_ptr = make_ptr_t();
+    // A second range size spans several register tiles of the dense kernel.
+    for (const std::uint64_t range_size : {params.range_size,
+                                           std::uint64_t(600)}) {
+      sf_ptr_t            sf_ptr(_make_ptr(range_size, params.seed));
+      const std::uint64_t num_keys(70);
+      msk_t multi(sf_ptr, params.compaction_threshold,
+                  params.promotion_threshold);
+      for (std::uint64_t key(0); key < num_keys; ++key) {
+        // Vary the number of inserts so that sparse sketches mix sparse and
+        // dense rows.
+        for (std::uint64_t i(0); i < (key % 10) * (key % 10) * 8 + 1; ++i) {
+          multi.insert(key, krowkee::hash::wang64(key * 1000 + i) % 100);
+        }
+      }
+      multi.compactify();
+      const sim_t         sim(multi, 3);
+      const std::size_t   n(sim.size());
+      std::vector<double> expected(n * n, 0);
+      for (std::size_t i(0); i < n; ++i) {
+        const auto &lhs(multi.at(sim.keys()[i]).sk.get_container());
+        for (std::size_t j(0); j < n; ++j) {
+          const auto &rhs(multi.at(sim.keys()[j]).sk.get_container());
+          for (std::uint64_t r(0); r < sim.range_size(); ++r) {
+            expected[i * n + j] += double(lhs.get(r)) * double(rhs.get(r));
+          }
+        }
+      }
+      {
+        const std::vector<double> gram(sim.all_pairs());
+        bool agree(n == num_keys && gram.size() == n * n);
+        for (std::size_t i(0); agree && i < n * n; ++i) {
+          agree = near(gram[i], expected[i]) &&
+                  near(sim.inner_product(sim.keys()[i / n],
+                                         sim.keys()[i % n]),
+                       expected[i]);
+        }
+        CHECK_CONDITION(agree, "inner products agree with registers");
+      }
+      for (const similarity_t metric :
+           {similarity_t::inner_product, similarity_t::cosine,
+            similarity_t::euclidean}) {
+        const std::vector<std::vector<std::pair<std::uint64_t, double>>>
+                  all(sim.all_top_k(5, metric));
+        bool      agree(true);
+        for (std::size_t i(0); i < n; ++i) {
+          const std::uint64_t key(sim.keys()[i]);
+          matches_t           brute;
+          for (std::size_t j(0); j < n; ++j) {
+            if (j != i) {
+              brute.emplace_back(
+                  sim.keys()[j],
+                  sim_t::score(expected[i * n + j], expected[i * n + i],
+                               expected[j * n + j], metric));
+            }
+          }
+          brute = sim_t::select(brute, 5, metric);
+          agree = agree && same_matches(sim.top_k(key, 5, metric), brute) &&
+                  same_matches(all[i], brute) &&
+                  same_matches(
+                      sim.top_k_of(multi.at(key).sk, 5, metric, &key), brute);
+        }
+        CHECK_CONDITION(agree, "top-k agrees with brute force");
+      }
+    }
+    sf_ptr_t sf_ptr(_make_ptr(params.range_size, params.seed));
+    msk_t    multi(sf_ptr, params.compaction_threshold,
+                   params.promotion_threshold);
+    multi.insert(1, 1);
+    multi.compactify();
+    sim_t         sim(multi);
+    std::uint64_t missing(2);
+    CHECK_THROWS<std::invalid_argument>(
+        [](const sim_t &s, const std::uint64_t key) { s.top_k(key, 1); },
+        "missing key", sim, missing);
+  }
+};
+
+/**
+ * Verify that heavy hitter summaries find the frequent items of a stream,
+ * both in a single pass and after merging the summaries of its halves.
+ */
+template <typename MultiType, template <typename> class MakePtrFunc>
+struct heavy_hitter_check {
+  typedef MultiType                   msk_t;
+  typedef typename msk_t::sf_t        sf_t;
+  typedef typename msk_t::sf_ptr_t    sf_ptr_t;
+  typedef typename msk_t::data_t      data_t;
+  typedef typename data_t::hh_t       hh_t;
+  typedef typename hh_t::candidates_t candidates_t;
+  typedef MakePtrFunc<sf_t>           make_ptr_t;
+
+  std::string name() const {
+    std::stringstream ss;
+    ss << msk_t::name() << " heavy hitters";
+    return ss.str();
+  }
+
+  static std::set<std::uint64_t> items(const candidates_t &candidates) {
+    std::set<std::uint64_t> ret;
+    for (const auto &candidate : candidates) {
+      ret.insert(candidate.first);
+    }
+    return ret;
+  }
+
+  static bool estimates_agree(const data_t &data) {
+    for (const auto &candidate : data.heavy_hitters(data.hh.capacity())) {
+      if (candidate.second != data.sk.point_query(candidate.first)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void operator()(const parameters_t &params) const {
+    make_ptr_t _make_ptr = make_ptr_t();
+    // Heavy items are interleaved with a long tail of distinct light items,
+    // so that they must displace light candidates from a full table. The
+    // rows are wide enough that no light item shares a median with a heavy
+    // one.
+    sf_ptr_t                sf_ptr(_make_ptr(1024, params.seed));
+    const std::uint64_t     num_heavy(5);
+    std::set<std::uint64_t> heavy;
+    msk_t                   whole(sf_ptr, params.compaction_threshold,
+                                  params.promotion_threshold);
+    msk_t                   lhs(whole);
+    msk_t                   rhs(whole);
+    for (std::uint64_t i(0); i < 3000; ++i) {
+      const std::uint64_t light(
+          10000 + krowkee::hash::wang64(params.seed + i) % 1000000);
+      whole.insert(0, light);
+      ((i % 2 == 0) ? lhs : rhs).insert(0, light);
+      if (i % 3 == 0) {
+        const std::uint64_t item(1000 + (i / 3) % num_heavy);
+        heavy.insert(item);
+        whole.insert(0, item);
+        ((i % 4 == 0) ? lhs : rhs).insert(0, item);
+      }
+    }
+    whole.compactify();
+    lhs.compactify();
+    rhs.compactify();
+    CHECK_CONDITION(whole.at(0).hh.size() == whole.at(0).hh.capacity(),
+                    "table fills to capacity");
+    CHECK_CONDITION(items(whole.at(0).heavy_hitters(num_heavy)) == heavy,
+                    "single pass heavy hitters");
+    CHECK_CONDITION(estimates_agree(whole.at(0)),
+                    "single pass estimates agree with point queries");
+    lhs += rhs;
+    CHECK_CONDITION(items(lhs.at(0).heavy_hitters(num_heavy)) == heavy,
+                    "merged heavy hitters");
+    CHECK_CONDITION(estimates_agree(lhs.at(0)) &&
+                        lhs.at(0).heavy_hitters(num_heavy) ==
+                            whole.at(0).heavy_hitters(num_heavy),
+                    "merged estimates agree with single pass");
+    CHECK_CONDITION(lhs.at(0).count == whole.at(0).count, "merged count");
+    {
+      data_t unpacked(sf_ptr, params.compaction_threshold,
+                      params.promotion_threshold);
+      const bool consumed(wire_unpack(wire_pack(whole.at(0)), unpacked));
+      CHECK_CONDITION(consumed && unpacked == whole.at(0),
+                      "wire format round trip");
+    }
+    {
+      hh_t empty;
+      empty.update(1, 1);
+      CHECK_CONDITION(empty.size() == 0, "default table ignores updates");
+    }
+  }
+};
+
+/**
+ * Verify that parallel compaction and merges agree with their serial
+ * counterparts over rows of very different sizes.
+ */
+template <typename MultiType, template <typename> class MakePtrFunc>
+struct parallel_bulk_check {
+  typedef MultiType                msk_t;
+  typedef typename msk_t::sf_t     sf_t;
+  typedef typename msk_t::sf_ptr_t sf_ptr_t;
+  typedef MakePtrFunc<sf_t>        make_ptr_t;
+
+  std::string name() const {
+    std::stringstream ss;
+    ss << msk_t::name() << " parallel compaction and merges";
+    return ss.str();
+  }
+
+  /**
+   * A few heavy rows followed by a long tail of light ones, some of which
+   * are shared with `offset` rows of another Multi.
+   */
+  void fill(msk_t &msk, const std::uint64_t offset,
+            const std::uint64_t count) const {
+    for (std::uint64_t key(0); key < 4; ++key) {
+      for (std::uint64_t i(0); i < count; msk.insert(key, offset + i++)) {
+      }
+    }
+    for (std::uint64_t key(4); key < 256; ++key) {
+      msk.insert(key + offset, key);
+      msk.insert(key + offset, count + key);
+    }
+  }
+
+  void operator()(const parameters_t &params) const {
+    make_ptr_t _make_ptr = make_ptr_t();
+    sf_ptr_t   sf_ptr(_make_ptr(params.range_size, params.seed));
+    const krowkee::util::parallel_policy policy{4};
+
+    msk_t lhs(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+    msk_t rhs(lhs);
+    fill(lhs, 0, params.count);
+    fill(rhs, 128, params.count);
+
+    msk_t serial_lhs(lhs);
+    msk_t serial_rhs(rhs);
+    serial_lhs.compactify();
+    serial_rhs.compactify();
+    lhs.compactify(policy);
+    rhs.compactify(krowkee::util::par);
+    CHECK_CONDITION(lhs == serial_lhs && rhs == serial_rhs,
+                    "parallel compaction agrees with serial");
+
+    serial_lhs += serial_rhs;
+    lhs.merge(rhs, policy);
+    CHECK_CONDITION(lhs == serial_lhs && lhs.size() == 256 + 128,
+                    "parallel merge agrees with serial");
+
+    msk_t empty(sf_ptr, params.compaction_threshold,
+                params.promotion_threshold);
+    empty.merge(rhs, policy);
+    CHECK_CONDITION(empty == rhs, "parallel merge into empty Multi");
+
+    msk_t other(_make_ptr(params.range_size, params.seed + 1),
+                params.compaction_threshold, params.promotion_threshold);
+    CHECK_THROWS<std::invalid_argument>(
+        [](msk_t &lhs, msk_t &rhs, const krowkee::util::parallel_policy &p) {
+          lhs.merge(rhs, p);
+        },
+        "parallel merge with mismatched parameters", other, rhs, policy);
+  }
+};
+
+/**
+ * Verify that a snapshot followed by delta snapshots restores a Multi, and
+ * that deltas hold only the changed keys.
+ */
+template <typename MultiType, template <typename> class MakePtrFunc>
+struct delta_snapshot_check {
+  typedef MultiType                msk_t;
+  typedef typename msk_t::sf_t     sf_t;
+  typedef typename msk_t::sf_ptr_t sf_ptr_t;
+  typedef typename msk_t::data_t   data_t;
+  typedef MakePtrFunc<sf_t>        make_ptr_t;
+
+  std::string name() const {
+    std::stringstream ss;
+    ss << msk_t::name() << " delta snapshots";
+    return ss.str();
+  }
+
+  void operator()(const parameters_t &params) const {
+    make_ptr_t _make_ptr = make_ptr_t();
+    sf_ptr_t   sf_ptr(_make_ptr(1024, params.seed));
+    const std::uint64_t keys(64);
+
+    msk_t msk(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+    CHECK_THROWS<std::logic_error>(
+        [](msk_t &msk) {
+          krowkee::util::wire_writer writer;
+          msk.delta_snapshot(writer);
+        },
+        "delta snapshot without tracking", msk);
+
+    msk.track_deltas();
+    for (std::uint64_t i(0); i < params.count; ++i) {
+      msk.insert(i % keys, i);
+    }
+    krowkee::util::wire_writer base;
+    msk.snapshot(base);
+    CHECK_CONDITION(msk.dirty_size() == 0, "snapshot starts an epoch");
+
+    // change two existing keys and add two new ones
+    msk.insert(3, 1);
+    msk.insert(3, 2, 5);
+    msk.insert(7, 9);
+    data_t data(sf_ptr, params.compaction_threshold,
+                params.promotion_threshold);
+    data.update(4);
+    msk.emplace(keys, std::move(data));
+    msk_t rhs(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+    rhs.insert(7, 11);
+    rhs.insert(keys + 1, 12);
+    rhs.compactify();
+    msk.compactify();
+    msk += rhs;
+    CHECK_CONDITION(msk.dirty_size() == 4, "dirty keys");
+    krowkee::util::wire_writer delta1;
+    msk.delta_snapshot(delta1);
+    std::cout << "\tbase snapshot: " << base.size()
+              << " bytes, delta snapshot: " << delta1.size() << " bytes"
+              << std::endl;
+    CHECK_CONDITION(msk.dirty_size() == 0 && delta1.size() * 8 < base.size(),
+                    "delta holds only the changed keys");
+
+    const std::vector<std::uint64_t> batch_keys{5, 5, keys};
+    const std::vector<std::uint64_t> batch_items{1, 2, 3};
+    msk.insert_batch(batch_keys.data(), batch_items.data(), nullptr,
+                     batch_keys.size());
+    // moving in a Multi that shares a key with a non-empty `msk`
+    msk_t moved(sf_ptr, params.compaction_threshold,
+                params.promotion_threshold);
+    moved.insert(7, 13);
+    moved.insert(keys + 2, 14);
+    moved.compactify();
+    msk.compactify();
+    msk += std::move(moved);
+    CHECK_CONDITION(msk.dirty_size() == 4, "dirty keys after moved merge");
+    krowkee::util::wire_writer delta2;
+    msk.delta_snapshot(delta2);
+    msk.compactify();
+
+    msk_t restored(sf_ptr, params.compaction_threshold,
+                   params.promotion_threshold);
+    for (const krowkee::util::wire_writer *writer : {&base, &delta1, &delta2}) {
+      krowkee::util::wire_reader reader(writer->bytes());
+      restored.restore(reader);
+    }
+    restored.compactify();
+    CHECK_CONDITION(restored == msk, "base plus deltas restores");
+
+    krowkee::util::wire_bytes_t concatenated(base.bytes());
+    for (const krowkee::util::wire_writer *writer : {&delta1, &delta2}) {
+      concatenated.insert(std::end(concatenated), std::begin(writer->bytes()),
+                          std::end(writer->bytes()));
+    }
+    msk_t                      appended(sf_ptr, params.compaction_threshold,
+                                        params.promotion_threshold);
+    krowkee::util::wire_reader reader(concatenated);
+    while (reader.empty() == false) {
+      appended.restore(reader);
+    }
+    appended.compactify();
+    CHECK_CONDITION(appended == msk, "concatenated snapshots restore");
+  }
+};
+
+/**
+ * Verify that advancing a windowed summary leaves the sketch of the updates
+ * of its latest buckets, and that windows merge and pack by bucket age.
+ */
+template <typename MultiType, template <typename> class MakePtrFunc>
+struct window_check {
+  typedef MultiType                msk_t;
+  typedef typename msk_t::sf_t     sf_t;
+  typedef typename msk_t::sf_ptr_t sf_ptr_t;
+  typedef typename msk_t::data_t   data_t;
+  typedef typename data_t::sk_t    sk_t;
+  typedef MakePtrFunc<sf_t>        make_ptr_t;
+
+  std::string name() const {
+    std::stringstream ss;
+    ss << msk_t::name() << " sliding windows";
+    return ss.str();
+  }
+
+  /**
+   * Compare registers rather than containers, as a Promotable window may be
+   * dense where a sketch of the same updates is still sparse.
+   */
+  static bool same_registers(const sk_t &lhs, const sk_t &rhs) {
+    for (std::uint64_t i(0); i < lhs.range_size(); ++i) {
+      if (lhs.get_container().get(i) != rhs.get_container().get(i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static std::uint64_t item(const std::uint64_t epoch, const std::uint64_t i) {
+    return krowkee::hash::wang64(epoch * 1000 + i);
+  }
+
+  void operator()(const parameters_t &params) const {
+    make_ptr_t          _make_ptr = make_ptr_t();
+    sf_ptr_t            sf_ptr(_make_ptr(256, params.seed));
+    const std::uint64_t buckets(data_t::num_buckets);
+    const std::uint64_t per_epoch(40);
+
+    msk_t msk(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+    msk_t lhs(msk);
+    msk_t rhs(msk);
+    bool  windows_agree(true);
+    for (std::uint64_t epoch(0); epoch < 3 * buckets; ++epoch) {
+      for (std::uint64_t i(0); i < per_epoch; ++i) {
+        msk.insert(0, item(epoch, i));
+        ((i % 2 == 0) ? lhs : rhs).insert(0, item(epoch, i));
+      }
+      data_t expected(sf_ptr, params.compaction_threshold,
+                      params.promotion_threshold);
+      const std::uint64_t first(epoch + 1 >= buckets ? epoch + 1 - buckets
+                                                     : 0);
+      for (std::uint64_t past(first); past <= epoch; ++past) {
+        for (std::uint64_t i(0); i < per_epoch; ++i) {
+          expected.update(item(past, i));
+        }
+      }
+      msk.compactify();
+      expected.compactify();
+      windows_agree &= same_registers(msk.at(0).sk, expected.sk) &&
+                       msk.at(0).count == (epoch + 1 - first) * per_epoch;
+      msk.advance();
+      lhs.advance();
+      rhs.advance();
+    }
+    CHECK_CONDITION(windows_agree, "window holds its latest buckets");
+    CHECK_CONDITION(msk.at(0).bucket_count(0) == 0 &&
+                        msk.at(0).bucket_count(1) == per_epoch,
+                    "advance opens an empty bucket");
+
+    lhs.compactify();
+    rhs.compactify();
+    lhs += rhs;
+    lhs.compactify();
+    CHECK_CONDITION(same_registers(lhs.at(0).sk, msk.at(0).sk) &&
+                        lhs.at(0).count == msk.at(0).count,
+                    "merged windows");
+    bool buckets_agree(true);
+    for (std::uint64_t age(0); age < buckets; ++age) {
+      buckets_agree &=
+          same_registers(lhs.at(0).bucket(age), msk.at(0).bucket(age));
+    }
+    CHECK_CONDITION(buckets_agree, "merged windows combine buckets by age");
+
+    {
+      data_t unpacked(sf_ptr, params.compaction_threshold,
+                      params.promotion_threshold);
+      const bool consumed(wire_unpack(wire_pack(msk.at(0)), unpacked));
+      CHECK_CONDITION(consumed && unpacked == msk.at(0), "wire round trip");
+    }
+
+    data_t empty(sf_ptr, params.compaction_threshold,
+                 params.promotion_threshold);
+    msk.advance(buckets);
+    msk.compactify();
+    CHECK_CONDITION(same_registers(msk.at(0).sk, empty.sk) &&
+                        msk.at(0).count == 0,
+                    "advancing a whole window empties it");
+  }
+};
+
+/**
+ * Verify that the cached register statistics of a CachedCountingSummary agree
+ * with a scan of its registers through updates, compaction, merges and wire
+ * round trips, and that only the operations meant to invalidate the cache
+ * leave it stale.
+ */
+template <typename MultiType, template <typename> class MakePtrFunc>
+struct cached_statistics_check {
+  typedef MultiType                 msk_t;
+  typedef typename msk_t::sf_t      sf_t;
+  typedef typename msk_t::sf_ptr_t  sf_ptr_t;
+  typedef typename msk_t::data_t    data_t;
+  typedef typename data_t::reg_t    reg_t;
+  typedef typename data_t::square_t square_t;
+  typedef MakePtrFunc<sf_t>         make_ptr_t;
+
+  template <typename T, typename = void>
+  struct has_register_visitor : std::false_type {};
+
+  template <typename T>
+  struct has_register_visitor<
+      T, std::void_t<decltype(std::declval<const T &>().visit_registers(
+             std::uint64_t(0), std::declval<void (*)(std::uint64_t)>()))>>
+      : std::true_type {};
+
+  /// functors without a register visitor leave the cache stale on update
+  static constexpr bool updates_stale = !has_register_visitor<sf_t>::value;
+
+  std::string name() const {
+    std::stringstream ss;
+    ss << msk_t::name() << " cached statistics";
+    return ss.str();
+  }
+
+  static bool agrees(const data_t &data) {
+    square_t      sum_of_squares(0);
+    std::uint64_t nonzeros(0);
+    for (std::uint64_t i(0); i < data.sk.range_size(); ++i) {
+      const reg_t reg(data.sk.get_container().get(i));
+      sum_of_squares += square_t(reg) * square_t(reg);
+      nonzeros += (reg != 0);
+    }
+    return data.sum_of_squares() == sum_of_squares &&
+           data.nonzeros() == nonzeros &&
+           data.l2_norm() == std::sqrt(double(sum_of_squares)) &&
+           data.statistics_stale() == false;
+  }
+
+  void operator()(const parameters_t &params) const {
+    make_ptr_t          _make_ptr = make_ptr_t();
+    sf_ptr_t            sf_ptr(_make_ptr(256, params.seed));
+    const std::uint64_t num_keys(4);
+
+    msk_t msk(sf_ptr, params.compaction_threshold, params.promotion_threshold);
+    msk_t lhs(msk);
+    msk_t rhs(msk);
+    bool  updates_agree(true);
+    bool  updates_cached(true);
+    for (std::uint64_t i(0); i < params.count; ++i) {
+      const std::uint64_t key(i % num_keys);
+      const std::uint64_t item(krowkee::hash::wang64(i % 300));
+      msk.insert(key, item);
+      ((i % 3 == 0) ? lhs : rhs).insert(key, item);
+      updates_cached &= msk.at(key).statistics_stale() == updates_stale;
+      if (i % 97 == 0) {
+        updates_agree &= agrees(msk.at(key));
+      }
+    }
+    CHECK_CONDITION(updates_agree, "updates");
+    CHECK_CONDITION(updates_cached, "updates keep the cache state");
+
+    bool keys_agree(true);
+    bool keys_cached(true);
+    msk.compactify();
+    lhs.compactify();
+    rhs.compactify();
+    for (std::uint64_t key(0); key < num_keys; ++key) {
+      keys_cached &= msk.at(key).statistics_stale() == updates_stale &&
+                     lhs.at(key).statistics_stale() == updates_stale &&
+                     rhs.at(key).statistics_stale() == updates_stale;
+      keys_agree &= agrees(msk.at(key)) && agrees(lhs.at(key)) &&
+                    agrees(rhs.at(key));
+    }
+    CHECK_CONDITION(keys_cached, "compaction keeps the cache state");
+    CHECK_CONDITION(keys_agree, "compaction");
+
+    lhs += rhs;
+    bool merges_cached(true);
+    bool merges_agree(true);
+    for (std::uint64_t key(0); key < num_keys; ++key) {
+      merges_cached &= lhs.at(key).statistics_stale() == false;
+      merges_agree &= agrees(lhs.at(key)) &&
+                      lhs.at(key).sum_of_squares() ==
+                          msk.at(key).sum_of_squares() &&
+                      lhs.at(key).nonzeros() == msk.at(key).nonzeros();
+    }
+    CHECK_CONDITION(merges_cached, "merges keep the cache fresh");
+    CHECK_CONDITION(merges_agree, "merges");
+
+    {
+      data_t unpacked(sf_ptr, params.compaction_threshold,
+                      params.promotion_threshold);
+      const bool consumed(wire_unpack(wire_pack(msk.at(0)), unpacked));
+      const bool stale(unpacked.statistics_stale());
+      CHECK_CONDITION(consumed && stale && unpacked == msk.at(0) &&
+                          agrees(unpacked) &&
+                          unpacked.sum_of_squares() ==
+                              msk.at(0).sum_of_squares(),
+                      "wire round trip");
+    }
+
+    {
+      data_t invalidated(msk.at(0));
+      invalidated.invalidate_statistics();
+      const bool stale(invalidated.statistics_stale());
+      CHECK_CONDITION(stale && agrees(invalidated), "invalidation");
+    }
+  }
+};
+
 void print_help(char *exe_name) {
   std::cout << "\nusage:  " << exe_name << "\n"
             << "\t-c, --count <int>              - number of insertions\n"
@@ -286,13 +1416,38 @@ void perform_tests(const parameters_t &params) {
   do_test<multi_ingest_check<msk_t, MakePtrFunc>>(params);
 }
 
+/**
+ * Print a banner naming `label` and execute the `Check` test.
+ */
+template <typename Check>
+void perform_check(const parameters_t &params, const std::string &label) {
+  print_line();
+  print_line();
+  std::cout << "Testing " << label << std::endl;
+  print_line();
+  print_line();
+
+  std::cout << std::endl << std::endl;
+
+  do_test<Check>(params);
+}
+
 void choose_local_tests(const parameters_t &params) {
   if (params.sketch_type == sketch_type_t::cst) {
     perform_tests<MultiLocalDense32CountSketch, make_shared_functor_t>(params);
+    perform_tests<PooledMultiLocalDense32CountSketch, make_shared_functor_t>(
+        params);
+    perform_check<sharded_ingest_check<ShardedMultiLocalDense32CountSketch,
+                                       make_shared_functor_t>>(
+        params, ShardedMultiLocalDense32CountSketch::full_name());
   } else if (params.sketch_type == sketch_type_t::sparse_cst) {
     if (params.cmap_type == cmap_type_t::std) {
       perform_tests<MultiLocalMapSparse32CountSketch, make_shared_functor_t>(
           params);
+      perform_check<
+          sharded_ingest_check<ShardedMultiLocalMapSparse32CountSketch,
+                               make_shared_functor_t>>(
+          params, ShardedMultiLocalMapSparse32CountSketch::full_name());
 #if __has_include(<boost/container/flat_map.hpp>)
     } else if (params.cmap_type == cmap_type_t::boost) {
       perform_tests<MultiLocalFlatMapSparse32CountSketch,
@@ -303,6 +1458,12 @@ void choose_local_tests(const parameters_t &params) {
     if (params.cmap_type == cmap_type_t::std) {
       perform_tests<MultiLocalMapPromotable32CountSketch,
                     make_shared_functor_t>(params);
+      perform_tests<PooledMultiLocalMapPromotable32CountSketch,
+                    make_shared_functor_t>(params);
+      perform_check<
+          sharded_ingest_check<ShardedMultiLocalMapPromotable32CountSketch,
+                               make_shared_functor_t>>(
+          params, ShardedMultiLocalMapPromotable32CountSketch::full_name());
 #if __has_include(<boost/container/flat_map.hpp>)
     } else if (params.cmap_type == cmap_type_t::boost) {
       perform_tests<MultiLocalFlatMapPromotable32CountSketch,
@@ -327,6 +1488,117 @@ void do_all_local_tests(const parameters_t &params) {
                 make_shared_functor_t>(params);
 #endif
   perform_tests<MultiLocalDense32FWHT, make_shared_functor_t>(params);
+  perform_tests<PooledMultiLocalDense32CountSketch, make_shared_functor_t>(
+      params);
+  perform_tests<PooledMultiLocalMapPromotable32CountSketch,
+                make_shared_functor_t>(params);
+  perform_check<pooled_index_check<PooledMultiLocalDense32CountSketch,
+                                   MultiLocalDense32CountSketch,
+                                   make_shared_functor_t>>(
+      params, PooledMultiLocalDense32CountSketch::full_name());
+  perform_check<pooled_index_check<PooledMultiLocalMapPromotable32CountSketch,
+                                   MultiLocalMapPromotable32CountSketch,
+                                   make_shared_functor_t>>(
+      params, PooledMultiLocalMapPromotable32CountSketch::full_name());
+  perform_check<pooled_index_check<PooledMultiLocalStringDense32CountSketch,
+                                   MultiLocalStringDense32CountSketch,
+                                   make_shared_functor_t>>(
+      params, PooledMultiLocalStringDense32CountSketch::full_name());
+  perform_check<sharded_ingest_check<ShardedMultiLocalDense32CountSketch,
+                                     make_shared_functor_t>>(
+      params, ShardedMultiLocalDense32CountSketch::full_name());
+  perform_check<sharded_ingest_check<ShardedMultiLocalMapSparse32CountSketch,
+                                     make_shared_functor_t>>(
+      params, ShardedMultiLocalMapSparse32CountSketch::full_name());
+  perform_check<
+      sharded_ingest_check<ShardedMultiLocalMapPromotable32CountSketch,
+                           make_shared_functor_t>>(
+      params, ShardedMultiLocalMapPromotable32CountSketch::full_name());
+  perform_check<multi_view_check<MultiLocalDense32CountSketch,
+                                 make_shared_functor_t>>(
+      params, MultiLocalDense32CountSketch::full_name());
+  perform_check<multi_view_check<MultiLocalMapSparse32CountSketch,
+                                 make_shared_functor_t>>(
+      params, MultiLocalMapSparse32CountSketch::full_name());
+  perform_check<multi_view_check<MultiLocalMapPromotable32CountSketch,
+                                 make_shared_functor_t>>(
+      params, MultiLocalMapPromotable32CountSketch::full_name());
+  perform_check<multi_view_check<MultiLocalDense32FWHT, make_shared_functor_t>>(
+      params, MultiLocalDense32FWHT::full_name());
+  perform_check<file_ingest_check<MultiLocalDense32CountSketch,
+                                  ShardedMultiLocalDense32CountSketch,
+                                  make_shared_functor_t>>(
+      params, MultiLocalDense32CountSketch::full_name());
+  perform_check<file_ingest_check<MultiLocalMapSparse32CountSketch,
+                                  ShardedMultiLocalMapSparse32CountSketch,
+                                  make_shared_functor_t>>(
+      params, MultiLocalMapSparse32CountSketch::full_name());
+  perform_check<similarity_check<MultiLocalDense32CountSketch,
+                                 make_shared_functor_t>>(
+      params, MultiLocalDense32CountSketch::full_name());
+  perform_check<similarity_check<MultiLocalMapSparse32CountSketch,
+                                 make_shared_functor_t>>(
+      params, MultiLocalMapSparse32CountSketch::full_name());
+  perform_check<similarity_check<MultiLocalMapPromotable32CountSketch,
+                                 make_shared_functor_t>>(
+      params, MultiLocalMapPromotable32CountSketch::full_name());
+  perform_check<similarity_check<MultiLocalDense32FWHT, make_shared_functor_t>>(
+      params, MultiLocalDense32FWHT::full_name());
+  perform_check<
+      heavy_hitter_check<HeavyHitterMultiLocalDense32MultiRowCountSketch,
+                         make_shared_functor_t>>(
+      params, HeavyHitterMultiLocalDense32MultiRowCountSketch::full_name());
+  perform_check<
+      heavy_hitter_check<HeavyHitterMultiLocalMapSparse32MultiRowCountSketch,
+                         make_shared_functor_t>>(
+      params, HeavyHitterMultiLocalMapSparse32MultiRowCountSketch::full_name());
+  perform_check<parallel_bulk_check<MultiLocalDense32CountSketch,
+                                    make_shared_functor_t>>(
+      params, MultiLocalDense32CountSketch::full_name());
+  perform_check<parallel_bulk_check<MultiLocalMapSparse32CountSketch,
+                                    make_shared_functor_t>>(
+      params, MultiLocalMapSparse32CountSketch::full_name());
+  perform_check<parallel_bulk_check<MultiLocalMapPromotable32CountSketch,
+                                    make_shared_functor_t>>(
+      params, MultiLocalMapPromotable32CountSketch::full_name());
+  perform_check<
+      parallel_bulk_check<HeavyHitterMultiLocalDense32MultiRowCountSketch,
+                          make_shared_functor_t>>(
+      params, HeavyHitterMultiLocalDense32MultiRowCountSketch::full_name());
+  perform_check<delta_snapshot_check<MultiLocalDense32CountSketch,
+                                     make_shared_functor_t>>(
+      params, MultiLocalDense32CountSketch::full_name());
+  perform_check<delta_snapshot_check<MultiLocalMapSparse32CountSketch,
+                                     make_shared_functor_t>>(
+      params, MultiLocalMapSparse32CountSketch::full_name());
+  perform_check<delta_snapshot_check<MultiLocalMapPromotable32CountSketch,
+                                     make_shared_functor_t>>(
+      params, MultiLocalMapPromotable32CountSketch::full_name());
+  perform_check<delta_snapshot_check<MultiLocalDense32FWHT,
+                                     make_shared_functor_t>>(
+      params, MultiLocalDense32FWHT::full_name());
+  perform_check<window_check<WindowedMultiLocalDense32CountSketch,
+                             make_shared_functor_t>>(
+      params, WindowedMultiLocalDense32CountSketch::full_name());
+  perform_check<window_check<WindowedMultiLocalMapSparse32CountSketch,
+                             make_shared_functor_t>>(
+      params, WindowedMultiLocalMapSparse32CountSketch::full_name());
+  perform_check<window_check<WindowedMultiLocalMapPromotable32CountSketch,
+                             make_shared_functor_t>>(
+      params, WindowedMultiLocalMapPromotable32CountSketch::full_name());
+  perform_check<cached_statistics_check<CachedMultiLocalDense32CountSketch,
+                                        make_shared_functor_t>>(
+      params, CachedMultiLocalDense32CountSketch::full_name());
+  perform_check<cached_statistics_check<CachedMultiLocalMapSparse32CountSketch,
+                                        make_shared_functor_t>>(
+      params, CachedMultiLocalMapSparse32CountSketch::full_name());
+  perform_check<
+      cached_statistics_check<CachedMultiLocalMapPromotable32CountSketch,
+                              make_shared_functor_t>>(
+      params, CachedMultiLocalMapPromotable32CountSketch::full_name());
+  perform_check<cached_statistics_check<CachedMultiLocalDense32FWHT,
+                                        make_shared_functor_t>>(
+      params, CachedMultiLocalDense32FWHT::full_name());
 }
 
 int main(int argc, char **argv) {
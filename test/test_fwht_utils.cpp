@@ -3,8 +3,14 @@
 //
 // SPDX-License-Identifier: MIT
 
+#include <krowkee/transform/fwht/plan_cache.hpp>
+#include <krowkee/transform/fwht/transform.hpp>
 #include <krowkee/transform/fwht/utils.hpp>
 
+#include <krowkee/transform/FWHT.hpp>
+
+#include <krowkee/sketch/Dense.hpp>
+
 #include <krowkee/util/tests.hpp>
 
 #include <getopt.h>
@@ -108,6 +114,47 @@ struct run_uniform_sample_test {
   }
 };
 
+#if !defined(KROWKEE_FWHT_LEGACY_RNG)
+struct counter_sampling_test {
+  std::string name() const { return "counter-based sampling"; }
+
+  void operator()(const parameters_t& params) const {
+    std::vector<std::uint64_t> samples =
+        krowkee::transform::fwht::uniform_sample_vec(
+            params.num_vertices, params.sketch_size, params.row_index,
+            params.seed);
+    bool random_access_success(true);
+    for (std::uint64_t i(0); i < params.sketch_size; ++i) {
+      if (samples[i] != krowkee::transform::fwht::uniform_sample(
+                            params.num_vertices, params.row_index, i,
+                            params.seed)) {
+        random_access_success = false;
+      }
+    }
+    CHECK_CONDITION(random_access_success, "random access sample agreement");
+
+    // seed + row_index collides for (seed + 1, row) and (seed, row + 1) under
+    // the legacy generator; the counter-based streams should not.
+    std::vector<std::uint64_t> shifted =
+        krowkee::transform::fwht::uniform_sample_vec(
+            params.num_vertices, params.sketch_size, params.row_index + 1,
+            params.seed - 1);
+    CHECK_CONDITION(!(samples == shifted), "independent neighboring streams");
+
+    bool sign_success(true);
+    for (std::uint64_t i(0); i < params.count; ++i) {
+      if (krowkee::transform::fwht::rademacher_flip<std::int32_t>(
+              params.val, i, params.seed) !=
+          krowkee::transform::fwht::rademacher_flip<std::int32_t>(
+              params.val, i, params.seed)) {
+        sign_success = false;
+      }
+    }
+    CHECK_CONDITION(sign_success, "reproducible signs");
+  }
+};
+#endif
+
 /**
  * @note[BWP] Only run if verbose
  */
@@ -213,6 +260,184 @@ struct get_sketch_vector_test {
       bool agree_success = test_sketch_vec == second_sketch_vec;
       CHECK_CONDITION(agree_success, "agreement");
     }
+    {
+      std::vector<int32_t> registers(params.sketch_size);
+      std::vector<std::uint64_t> samples(
+          krowkee::transform::fwht::uniform_sample_vec(
+              params.num_vertices, params.sketch_size, params.col_index,
+              params.seed));
+      const int32_t signed_val(krowkee::transform::fwht::rademacher_flip(
+          int32_t(params.val), params.row_index, params.seed));
+      for (std::uint64_t i(0); i < params.sketch_size; ++i) {
+        registers[i] = int32_t(i);
+      }
+      krowkee::transform::fwht::accumulate_sketch_vector(
+          std::begin(registers), int32_t(params.val), params.row_index,
+          params.col_index, params.num_vertices, params.sketch_size,
+          params.seed);
+      bool accumulate_success(true);
+      for (std::uint64_t i(0); i < params.sketch_size; ++i) {
+        const int32_t expected(
+            int32_t(i) +
+            signed_val * krowkee::transform::fwht::get_hadamard_element<int32_t>(
+                             params.col_index, samples[i]));
+        if (registers[i] != expected) {
+          accumulate_success = false;
+        }
+      }
+      CHECK_CONDITION(accumulate_success, "in-place accumulation");
+    }
+  }
+};
+
+template <typename RegType>
+struct plan_cache_test {
+  typedef krowkee::transform::FWHTFunctor<RegType>           fwhtf_t;
+  typedef krowkee::sketch::Dense<RegType, std::plus<RegType>> dense_t;
+
+  std::string name() const { return "sampling plan cache"; }
+
+  void check_functor(const parameters_t& params, const std::size_t cache_size,
+                     const std::string& msg) const {
+    fwhtf_t uncached(params.sketch_size, params.seed, params.num_vertices);
+    fwhtf_t cached(params.sketch_size, params.seed, params.num_vertices,
+                   cache_size);
+    dense_t uncached_registers(params.sketch_size);
+    dense_t cached_registers(params.sketch_size);
+    for (std::uint64_t i(0); i < params.count; ++i) {
+      // Revisit a small working set of columns, plus some outside the domain.
+      const std::uint64_t col_index((i * 7) % (params.num_vertices + 10));
+      uncached(uncached_registers, col_index, i % 13, RegType(1 + i % 3));
+      cached(cached_registers, col_index, i % 13, RegType(1 + i % 3));
+    }
+    CHECK_CONDITION(uncached_registers == cached_registers, msg);
+  }
+
+  void operator()(const parameters_t& params) const {
+    {
+      bool plan_success(true);
+      for (std::uint64_t col_index(0); col_index < params.num_vertices;
+           ++col_index) {
+        std::vector<RegType> plan =
+            krowkee::transform::fwht::get_column_plan<RegType>(
+                col_index, params.num_vertices, params.sketch_size,
+                params.seed);
+        std::vector<RegType> sketch_vec =
+            krowkee::transform::fwht::get_sketch_vector<RegType>(
+                params.val, params.row_index, col_index, params.num_vertices,
+                params.sketch_size, params.seed);
+        const RegType sign(krowkee::transform::fwht::rademacher_flip<RegType>(
+            params.val, params.row_index, params.seed));
+        for (std::uint64_t i(0); i < params.sketch_size; ++i) {
+          if (sign * plan[i] != sketch_vec[i]) {
+            plan_success = false;
+          }
+        }
+      }
+      CHECK_CONDITION(plan_success, "column plan agrees with sketch vector");
+    }
+    {
+      krowkee::transform::fwht::plan_cache<RegType> cache(
+          params.sketch_size, params.seed, params.num_vertices, 4);
+      for (std::uint64_t col_index(0); col_index < 10; ++col_index) {
+        cache.get(col_index);
+      }
+      CHECK_CONDITION(cache.is_table() == false && cache.size() == 4,
+                      "bounded LRU cache size");
+    }
+    check_functor(params, 8, "LRU cached updates");
+    check_functor(params, params.num_vertices, "table cached updates");
+  }
+};
+
+template <typename RegType>
+struct fast_transform_test {
+  typedef krowkee::transform::FWHTFunctor<RegType>           fwhtf_t;
+  typedef krowkee::sketch::Dense<RegType, std::plus<RegType>> dense_t;
+
+  std::string name() const { return "fast Walsh-Hadamard transform"; }
+
+  std::vector<RegType> naive_transform(const std::vector<RegType>& x) const {
+    std::vector<RegType> y(x.size(), RegType(0));
+    for (std::uint64_t i(0); i < x.size(); ++i) {
+      for (std::uint64_t j(0); j < x.size(); ++j) {
+        y[i] += krowkee::transform::fwht::get_hadamard_element<RegType>(i, j) *
+                x[j];
+      }
+    }
+    return y;
+  }
+
+  std::vector<RegType> make_input(const std::uint64_t n) const {
+    std::vector<RegType> x(n);
+    for (std::uint64_t i(0); i < n; ++i) {
+      x[i] = RegType(krowkee::hash::wang64(i) % 7) - RegType(3);
+    }
+    return x;
+  }
+
+  void operator()(const parameters_t& params) const {
+    {
+      bool naive_success(true);
+      for (std::uint64_t n(1); n <= params.size_mat; n *= 2) {
+        std::vector<RegType> x(make_input(n));
+        std::vector<RegType> y(x);
+        krowkee::transform::fwht::transform(y);
+        if (!(y == naive_transform(x))) {
+          std::cout << "transform of length " << n << " disagrees" << std::endl;
+          naive_success = false;
+        }
+      }
+      CHECK_CONDITION(naive_success, "agreement with Hadamard elements");
+    }
+    {
+      // Long enough to span several cache blocks and threads.
+      const std::uint64_t  n(std::uint64_t(1) << 16);
+      std::vector<RegType> x(make_input(n));
+      std::vector<RegType> serial(x);
+      std::vector<RegType> threaded(x);
+      krowkee::transform::fwht::transform(serial);
+      krowkee::transform::fwht::transform(threaded, 4);
+      CHECK_CONDITION(serial == threaded, "multithreaded transform");
+      krowkee::transform::fwht::transform(serial);
+      bool involution_success(true);
+      for (std::uint64_t i(0); i < n; ++i) {
+        if (serial[i] != RegType(n) * x[i]) {
+          involution_success = false;
+        }
+      }
+      CHECK_CONDITION(involution_success, "H H x = n x");
+    }
+    {
+      std::vector<RegType> x(6);
+      CHECK_THROWS<std::invalid_argument>(
+          [](std::vector<RegType> y) { krowkee::transform::fwht::transform(y); },
+          "non power of two transform", x);
+    }
+    {
+      const std::uint64_t domain_size(100);
+      fwhtf_t             functor(params.sketch_size, params.seed, domain_size);
+      dense_t             registers(params.sketch_size);
+      std::vector<RegType> x(make_input(domain_size));
+      functor.project(registers, x);
+      const std::uint64_t  padded_size(128);
+      std::vector<RegType> signed_x(padded_size, RegType(0));
+      for (std::uint64_t j(0); j < domain_size; ++j) {
+        signed_x[j] =
+            krowkee::transform::fwht::rademacher_sign<RegType>(j, params.seed) *
+            x[j];
+      }
+      std::vector<RegType> hx(naive_transform(signed_x));
+      krowkee::transform::fwht::uniform_sampler sampler(
+          padded_size, domain_size, params.seed);
+      bool project_success(true);
+      for (std::uint64_t i(0); i < params.sketch_size; ++i) {
+        if (registers[i] != hx[sampler.next()]) {
+          project_success = false;
+        }
+      }
+      CHECK_CONDITION(project_success, "subsampled randomized projection");
+    }
   }
 };
 
@@ -335,8 +560,13 @@ int main(int argc, char** argv) {
   do_test<get_parity_test>(params);
   do_test<run_rademacher_test<std::int32_t>>(params);
   do_test<run_uniform_sample_test>(params);
+#if !defined(KROWKEE_FWHT_LEGACY_RNG)
+  do_test<counter_sampling_test>(params);
+#endif
   do_test<get_hadamard_element_test<std::int32_t>>(params);
   do_test<get_sketch_vector_test<std::int32_t>>(params);
+  do_test<plan_cache_test<std::int32_t>>(params);
+  do_test<fast_transform_test<std::int32_t>>(params);
   do_test<orthonormality_test>(params);
 
   return (0);